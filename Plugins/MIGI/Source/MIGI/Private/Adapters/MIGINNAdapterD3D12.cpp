@@ -1,6 +1,9 @@
 ﻿#include "MIGINNAdapterD3D12.h"
 
 #include "MIGILogCategory.h"
+#include "MIGIConfig.h"
+#include "MIGIConstants.h"
+#include "MIGIRendering.h"
 #include "ID3D12DynamicRHI.h"
 #include "MIGINN.h"
 
@@ -33,6 +36,10 @@ public:
 
 	// The next shared fence value we're using. Incremented for one each time it's used.
 	uint64 NextFenceValue {1};
+
+	// Timeline of the ring slots: the fence value CUDA signals once it's done with each slot.
+	// Zero means the slot has never been handed to CUDA and is free to be written.
+	TArray<uint64> SlotFenceValues {};
 	
 	void Destroy ()
 	{
@@ -80,10 +87,42 @@ void FMIGICUDAAdapterD3D12::Initialize_RenderThread (FRHICommandListImmediate &
 			&SharedFenceHandle) == S_OK);
 
 	}
+	HANDLE SharedInputBufferHandle, SharedOutputBufferHandle;
+	CreateSharedBuffers_RenderThread(RHICmd, SharedInputBufferHandle, SharedOutputBufferHandle);
+
+	// CUDA device initialization, interop imports and network construction are slow.
+	// Move them off the render thread. Frames keep rendering without MIGI until the task is done.
+	InitializationTask = Async(EAsyncExecution::ThreadPool,
+		[this, SharedFenceHandle, SharedInputBufferHandle, SharedOutputBufferHandle]()
+		{
+			const bool bSuccess = InitializeNN_AnyThread(SharedFenceHandle, SharedInputBufferHandle, SharedOutputBufferHandle);
+			// Destroy the Windows HANDLEs.
+			CloseHandle(SharedInputBufferHandle);
+			CloseHandle(SharedOutputBufferHandle);
+			CloseHandle(SharedFenceHandle);
+			if(bSuccess)
+			{
+				UE_LOG(MIGI, Display, TEXT("Successfully initialized CUDA adapter for D3D12."));
+				ActivityState = EMIGINNAdapterState::Ready;
+			}
+			else
+			{
+				UE_LOG(MIGI, Error, TEXT("Failed to initialize MIGINN: %s. MIGI wont be active."), UTF8_TO_TCHAR(MIGIGetCUDAErrorString().c_str()));
+				ActivityState = EMIGINNAdapterState::Failed;
+			}
+		});
+}
+
+void FMIGICUDAAdapterD3D12::CreateSharedBuffers_RenderThread (FRHICommandListImmediate & RHICmd, void *& OutSharedInputBufferHandle, void *& OutSharedOutputBufferHandle)
+{
+	auto D3D = GetDynamicRHI<ID3D12DynamicRHI>();
+	auto Device = D3D->RHIGetDevice(0);
+
 	// Shared memory allocation
 	
 	// We need this buffer to be a storage buffer and shared.
-	auto BufferDesc1 = FRHIBufferDesc (SharedInputBufferSize, 4,
+	// All ring slots live in the same buffer, so a single interop import covers them.
+	auto BufferDesc1 = FRHIBufferDesc (GetSharedInputBufferSize(), 4,
 		EBufferUsageFlags::Shared | EBufferUsageFlags::UnorderedAccess
 		| EBufferUsageFlags::StructuredBuffer | EBufferUsageFlags::ShaderResource);
 	auto BufferCreateInfo1 = FRHIResourceCreateInfo (TEXT("MIGI Shared Input Buffer"));
@@ -92,13 +131,16 @@ void FMIGICUDAAdapterD3D12::Initialize_RenderThread (FRHICommandListImmediate &
 	State->SharedNNInputBufferD3D12 = D3D->RHICreateBuffer(RHICmd, BufferDesc1, ERHIAccess::UAVMask, BufferCreateInfo1);
 	check(State->SharedNNInputBufferD3D12.IsValid());
 	
-	auto BufferDesc2 = FRHIBufferDesc (SharedInputBufferSize, 4, 
+	auto BufferDesc2 = FRHIBufferDesc (GetSharedOutputBufferSize(), 4, 
 		EBufferUsageFlags::Shared | EBufferUsageFlags::UnorderedAccess
 		| EBufferUsageFlags::StructuredBuffer | EBufferUsageFlags::ShaderResource);
 	auto BufferCreateInfo2 = FRHIResourceCreateInfo (TEXT("MIGI Shared Output Buffer"));
 	State->SharedNNOutputBufferD3D12 = D3D->RHICreateBuffer(RHICmd, BufferDesc2, ERHIAccess::UAVMask, BufferCreateInfo2);
 	check(State->SharedNNOutputBufferD3D12.IsValid());
 
+	// Fresh buffers, all the slots are free.
+	State->SlotFenceValues.Init(0, NumSlots);
+
 	// Create a Windows HANDLE of the shared buffer for interop
 	HANDLE SharedInputBufferHandle, SharedOutputBufferHandle;
 	auto SecurityAttributes = SECURITY_ATTRIBUTES{};
@@ -108,9 +150,13 @@ void FMIGICUDAAdapterD3D12::Initialize_RenderThread (FRHICommandListImmediate &
 	check(Device->CreateSharedHandle(
 		D3D->RHIGetResource(State->SharedNNOutputBufferD3D12), &SecurityAttributes, GENERIC_ALL, nullptr,
 		&SharedOutputBufferHandle) == S_OK);
+	OutSharedInputBufferHandle = SharedInputBufferHandle;
+	OutSharedOutputBufferHandle = SharedOutputBufferHandle;
+}
 
-	// Call the external function to initialize neural networks and the interop layer.
-	auto Params = MIGINNInitializeParams {
+static MIGINNInitializeParams MakeInitializeParams (void * SharedFenceHandle, void * SharedInputBufferHandle, void * SharedOutputBufferHandle)
+{
+	return MIGINNInitializeParams {
 		.Platform = {
 			.Win_D3D12 = {
 				.InD3D12FenceHandle = SharedFenceHandle,
@@ -118,15 +164,48 @@ void FMIGICUDAAdapterD3D12::Initialize_RenderThread (FRHICommandListImmediate &
 				.InD3D12OutputBufferResourceHandle = SharedOutputBufferHandle
 			},
 		},
-		.InInputBufferSize = SharedInputBufferSize,
-		.InOutputBufferSize = SharedOutputBufferSize,
+		.InInputBufferSize = GetSharedInputBufferSize(),
+		.InOutputBufferSize = GetSharedOutputBufferSize(),
 		.InInputBufferOffset = 0,
 		.InOutputBufferOffset = 0,
 		.InDeviceIndex = 0,
 		.InPlatformType = MIGIPlatformType::eWindowsD3D12
 	};
+}
+
+bool FMIGICUDAAdapterD3D12::InitializeNN_AnyThread (void * SharedFenceHandle, void * SharedInputBufferHandle, void * SharedOutputBufferHandle)
+{
+	// Call the external function to initialize neural networks and the interop layer.
+	// CUDA keeps the current device per host thread. Device 0 is the default of every thread,
+	// so the render thread can keep using the stream created here.
+	auto Params = MakeInitializeParams(SharedFenceHandle, SharedInputBufferHandle, SharedOutputBufferHandle);
 	auto result = MIGINNInitialize(Params);
-	check(result == MIGINNResultType::eSuccess);
+	if(result != MIGINNResultType::eSuccess) return false;
+
+	if(GetMIGICacheType() == 1)
+	{
+		// The hash grid reads the first three input dimensions as the position and bins the direction (the next three),
+		// 4x4 octahedral bins: the cache box holds 128^3 cells, so finer bins would spread the samples too thin.
+		auto HashGridConfig = MIGINNNetworkConfig {
+			.Details = {
+				.HashGrid = {
+					.InNumInputDimensions = C::NNInputWidth,
+					.InNumOutputDimensions = C::NNOutputWidth,
+					.InPositionOffset = 0,
+					.InDirectionOffset = 3,
+					.InNumDirectionBins = 4,
+					.InLog2TableSize = 20,
+					.InCellSize = 1.f / 128.f,
+					.InBlendFactor = 0.05f,
+					// A few seconds of training steps, cells out of view for longer give way to new ones.
+					.InMaxAge = 256
+				}
+			},
+			.Type = MIGINNNetworkType::eHashGrid
+		};
+		result = MIGINNInitializeNeuralNetwork(HashGridConfig);
+		return result == MIGINNResultType::eSuccess;
+	}
 
 	auto NetworkConfigJson = nlohmann::json {
 		{"loss", {
@@ -159,12 +238,64 @@ void FMIGICUDAAdapterD3D12::Initialize_RenderThread (FRHICommandListImmediate &
 			{"output_activation", "None"},
 		}},
 	};
+	if(IsMIGIHashEncoding())
+	{
+		// The trainable grid carries the high frequency detail, so a shallower MLP is enough.
+		// tiny-cuda-nn grids take at most 4 dimensions: the grid covers the position (the first three input dimensions).
+		// The direction is a raw unit vector, which the frequency encoding takes as is. The roughness is in [0, 1]
+		// and smooth, a few blobs are enough. See EncodeRadianceCacheQuery in MIGIRadianceCacheCommon.ush.
+		const auto HashEncoding = GetMIGIHashEncodingSettings();
+		NetworkConfigJson["encoding"] = {
+			{"otype", "Composite"},
+			{"nested", nlohmann::json::array({
+				{
+					{"otype", "HashGrid"},
+					{"n_dims_to_encode", 3},
+					{"n_levels", HashEncoding.NumLevels},
+					{"n_features_per_level", HashEncoding.NumFeatures},
+					{"log2_hashmap_size", HashEncoding.Log2TableSize},
+					{"base_resolution", 16},
+					{"per_level_scale", 2.0f},
+				},
+				{
+					{"otype", "Frequency"},
+					{"n_dims_to_encode", 3},
+					{"n_frequencies", 12},
+				},
+				{
+					{"otype", "OneBlob"},
+					{"n_bins", 4},
+				},
+			})},
+		};
+		NetworkConfigJson["network"]["n_hidden_layers"] = 2;
+	}
+	if(IsMIGIDistillation())
+	{
+		// Same network type, only narrower and shallower. The optimizer defaults to the teacher's.
+		const FIntPoint StudentSize = GetMIGIDistillationStudentSize();
+		auto StudentNetworkJson = NetworkConfigJson["network"];
+		StudentNetworkJson["n_neurons"] = StudentSize.X;
+		StudentNetworkJson["n_hidden_layers"] = StudentSize.Y;
+		NetworkConfigJson["student"] = {
+			{"network", StudentNetworkJson},
+			{"loss", {{"otype", "L2"}}},
+		};
+	}
 	
+	const auto ResultCache = GetMIGIResultCacheSettings();
 	auto NetworkConfig = MIGINNNetworkConfig {
 		.Details = {
 			.MLP = {
-				.InNumInputDimensions = 4,
-				.InNumOutputDimensions = 4
+				.InNumInputDimensions = C::NNInputWidth,
+				.InNumOutputDimensions = C::NNOutputWidth,
+				.InQuantizedInference = IsMIGIQuantizedInference(),
+				.InQuantizationRefreshInterval = static_cast<uint32_t>(GetMIGIQuantizationRefreshInterval()),
+				.InDeduplicationQuantum = GetMIGIDeduplicationQuantum(),
+				.InLog2ResultCacheSize = IsMIGIResultCache() ? static_cast<uint32_t>(ResultCache.Log2Size) : 0u,
+				.InResultCacheMaxAge = static_cast<uint32_t>(ResultCache.MaxAge),
+				.InResultCacheTolerance = ResultCache.Tolerance,
+				.InResultCacheMinRefreshProbability = ResultCache.MinRefreshProbability
 			}
 		},
 		.Type =  MIGINNNetworkType::eMLP
@@ -175,12 +306,50 @@ void FMIGICUDAAdapterD3D12::Initialize_RenderThread (FRHICommandListImmediate &
 	memcpy(NetworkConfig.Details.MLP.InExtraOptionsJson, JsonString.c_str(), JsonString.length());
 	
 	result = MIGINNInitializeNeuralNetwork(NetworkConfig);
-	check(result == MIGINNResultType::eSuccess);
-	
-	// Destroy the Windows HANDLEs.
-	CloseHandle(SharedInputBufferHandle);
-	CloseHandle(SharedOutputBufferHandle);
-	CloseHandle(SharedFenceHandle);
+	return result == MIGINNResultType::eSuccess;
+}
+
+bool FMIGICUDAAdapterD3D12::Suspend_RenderThread (FRHICommandListImmediate & RHICmd)
+{
+	// Nothing on the GPU may touch the shared buffers anymore.
+	RHICmd.BlockUntilGPUIdle();
+	// Spills the weights to host memory and frees everything CUDA allocated, interop imports included.
+	if(MIGINNSuspend() != MIGINNResultType::eSuccess)
+	{
+		// The network and its interop imports may still be alive, keep the buffers they point to.
+		UE_LOG(MIGI, Warning, TEXT("Failed to suspend MIGINN: %s. The NN GPU memory stays allocated."), UTF8_TO_TCHAR(MIGIGetCUDAErrorString().c_str()));
+		return false;
+	}
+	// Drop the D3D12 side of the shared buffers. The fence is tiny and stays alive.
+	MIGIRenderingContext::Get().Destroy_RenderThread();
+	State->Destroy();
+	UE_LOG(MIGI, Display, TEXT("MIGINN suspended, NN GPU memory released."));
+	return true;
+}
+
+void FMIGICUDAAdapterD3D12::Resume_RenderThread (FRHICommandListImmediate & RHICmd)
+{
+	HANDLE SharedInputBufferHandle, SharedOutputBufferHandle;
+	CreateSharedBuffers_RenderThread(RHICmd, SharedInputBufferHandle, SharedOutputBufferHandle);
+	// Restoring the weights allocates the network again. Keep it off the render thread just like the initialization.
+	InitializationTask = Async(EAsyncExecution::ThreadPool,
+		[this, SharedInputBufferHandle, SharedOutputBufferHandle]()
+		{
+			auto Params = MakeInitializeParams(nullptr, SharedInputBufferHandle, SharedOutputBufferHandle);
+			const bool bSuccess = MIGINNResume(Params) == MIGINNResultType::eSuccess;
+			CloseHandle(SharedInputBufferHandle);
+			CloseHandle(SharedOutputBufferHandle);
+			if(bSuccess)
+			{
+				UE_LOG(MIGI, Display, TEXT("MIGINN resumed."));
+				ActivityState = EMIGINNAdapterState::Ready;
+			}
+			else
+			{
+				UE_LOG(MIGI, Error, TEXT("Failed to resume MIGINN: %s. MIGI wont be active."), UTF8_TO_TCHAR(MIGIGetCUDAErrorString().c_str()));
+				ActivityState = EMIGINNAdapterState::Failed;
+			}
+		});
 }
 
 bool FMIGICUDAAdapterD3D12::CanActivate() const
@@ -202,42 +371,74 @@ bool FMIGICUDAAdapterD3D12::CanActivate() const
 void FMIGICUDAAdapterD3D12::Activate()
 {
 	State = MakeUnique<MIGICUDAAdapterD3D12State>();
-	// Enqueue the render command.
-	ENQUEUE_RENDER_COMMAND(MIGICUDAAdapterD3D12Initialize)(
-		[this](FRHICommandListImmediate & RHICmd)
-		{
-			Initialize_RenderThread(RHICmd);
-			bReady = true;
-		}
-	);
-	
-	UE_LOG(MIGI, Display, TEXT("Successfully initialized CUDA adapter for D3D12."));
+	// CUDA is not touched until MIGI gets enabled, see Update_RenderThread.
+	UE_LOG(MIGI, Display, TEXT("Selected CUDA adapter for D3D12. Initialization is deferred until MIGI is enabled."));
 }
 
 FMIGICUDAAdapterD3D12::FMIGICUDAAdapterD3D12() = default;
 
 FMIGICUDAAdapterD3D12::~FMIGICUDAAdapterD3D12()
 {
+	// The initialization task captures this adapter.
+	if(InitializationTask.IsValid())
+	{
+		InitializationTask.Wait();
+	}
 	FModuleManager::Get().OnModulesChanged().Remove(
 		RHIExtensionRegistrationDelegateHandle
 	);
 	RHIExtensionRegistrationDelegateHandle.Reset();
 }
 
-void FMIGICUDAAdapterD3D12::SynchronizeFromNN(FRHICommandList& RHICmdList)
+void FMIGICUDAAdapterD3D12::BeginFrame_RenderThread()
+{
+	check(IsInRenderingThread());
+	// Called for every view, and the ring only has room for the frames in flight.
+	if(CurrentSlotFrame == GFrameCounterRenderThread) return ;
+	CurrentSlotFrame = GFrameCounterRenderThread;
+	CurrentSlot = (CurrentSlot + 1) % NumSlots;
+}
+
+void FMIGICUDAAdapterD3D12::WaitForSlot(FRHICommandList& RHICmdList, uint32 Slot)
+{
+	auto SlotFenceValue = State->SlotFenceValues[Slot];
+	// The slot has never been used by CUDA.
+	if(SlotFenceValue == 0) return ;
+	auto D3D = GetID3D12DynamicRHI();
+	RHICmdList.EnqueueLambda(TEXT("RHIWaitManualFence"),
+		[D3D, SlotFenceValue, Fence = State->SharedFenceD3D12](FRHICommandList& RHICmdList){
+		D3D->RHIWaitManualFence(RHICmdList, Fence.Get(), SlotFenceValue);
+	});
+}
+
+void FMIGICUDAAdapterD3D12::SynchronizeFromNN(FRHICommandList& RHICmdList, uint32 Slot, bool bLastFrame)
 {
 	auto SyncFenceValue = State->NextFenceValue++;
 	check(MIGINNSignalFenceValue(SyncFenceValue) == MIGINNResultType::eSuccess);
+	// Everything CUDA queued for the slot is done once this value is signaled.
+	State->SlotFenceValues[Slot] = SyncFenceValue;
+	// When compositing the last frame's output, only wait for the NN work of the previous slot.
+	// The NN work of this frame then overlaps with the rest of the frame.
+	auto WaitFenceValue = bLastFrame ? State->SlotFenceValues[GetPreviousSlot(Slot)] : SyncFenceValue;
+	// The previous slot has never been used. Nothing to wait for.
+	if(WaitFenceValue == 0) return ;
 	// Stall until NN signals.
 	auto D3D = GetID3D12DynamicRHI();
 	// It's possible for non-bypass mode RHICmdList to have no ComputeContext.
 	// So we queue a RHI lambda command for delayed execution.
 	RHICmdList.EnqueueLambda(TEXT("RHIWaitManualFence"),
-		[D3D, SyncFenceValue, Fence = State->SharedFenceD3D12](FRHICommandList& RHICmdList){
-		D3D->RHIWaitManualFence(RHICmdList, Fence.Get(), SyncFenceValue);
+		[D3D, WaitFenceValue, Fence = State->SharedFenceD3D12](FRHICommandList& RHICmdList){
+		D3D->RHIWaitManualFence(RHICmdList, Fence.Get(), WaitFenceValue);
 	});
 }
 
+void FMIGICUDAAdapterD3D12::ReleaseSlot(uint32 Slot)
+{
+	auto SyncFenceValue = State->NextFenceValue++;
+	const auto Result = MIGINNSignalFenceValue(SyncFenceValue);
+	check(Result == MIGINNResultType::eSuccess);
+	State->SlotFenceValues[Slot] = SyncFenceValue;
+}
 
 void FMIGICUDAAdapterD3D12::SynchronizeToNN(FRHICommandList& RHICmdList)
 {
@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include "CoreMinimal.h"
+#include "Async/Async.h"
 #include "..\MIGINNAdapter.h"
 
 struct CUDA_DRIVER_API_FUNCTION_LIST;
@@ -10,8 +11,11 @@ class FMIGICUDAAdapterD3D12 : public IMIGINNAdapter
 {
 public:
 	virtual bool InstallRHIConfigurations() override;
-	virtual void SynchronizeFromNN(FRHICommandList& RHICmdList) override;
+	virtual void BeginFrame_RenderThread() override;
+	virtual void WaitForSlot(FRHICommandList& RHICmdList, uint32 Slot) override;
+	virtual void SynchronizeFromNN(FRHICommandList& RHICmdList, uint32 Slot, bool bLastFrame) override;
 	virtual void SynchronizeToNN(FRHICommandList& RHICmdList) override;
+	virtual void ReleaseSlot(uint32 Slot) override;
 	FMIGICUDAAdapterD3D12 () ;
 	virtual ~FMIGICUDAAdapterD3D12() override;
 	virtual FRHIBuffer* GetSharedInputBuffer() const override;
@@ -19,7 +23,14 @@ public:
 protected:
 	virtual bool CanActivate () const override;
 	virtual void Activate() override;
-	void Initialize_RenderThread (FRHICommandListImmediate & RHICmd) ;
+	virtual void Initialize_RenderThread (FRHICommandListImmediate & RHICmd) override;
+	virtual bool Suspend_RenderThread (FRHICommandListImmediate & RHICmd) override;
+	virtual void Resume_RenderThread (FRHICommandListImmediate & RHICmd) override;
+	// Create the shared input & output buffers and their Windows HANDLEs for interop.
+	void CreateSharedBuffers_RenderThread (FRHICommandListImmediate & RHICmd, void *& OutSharedInputBufferHandle, void *& OutSharedOutputBufferHandle) ;
+	// CUDA side of the initialization, runs on a background task.
+	bool InitializeNN_AnyThread (void * SharedFenceHandle, void * SharedInputBufferHandle, void * SharedOutputBufferHandle) ;
+	TFuture<void> InitializationTask;
 	FDelegateHandle RHIExtensionRegistrationDelegateHandle;
 	TUniquePtr<MIGICUDAAdapterD3D12State> State;
 };
\ No newline at end of file
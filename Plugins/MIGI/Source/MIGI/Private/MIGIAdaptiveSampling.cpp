@@ -0,0 +1,253 @@
+﻿#include "MIGIAdaptiveSampling.h"
+
+#include "PathTracing.h"
+#include "RenderGraphBuilder.h"
+#include "RenderGraphUtils.h"
+#include "RHIGPUReadback.h"
+#include "ScenePrivate.h"
+#include "SystemTextures.h"
+
+#include "MIGIConstants.h"
+#include "MIGIPathCompaction.h"
+
+BEGIN_SHADER_PARAMETER_STRUCT(FMIGIAdaptiveSamplingParameters, )
+	SHADER_PARAMETER_RDG_TEXTURE(Texture2D<float2>, LuminanceMoments)
+	SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<uint>, ConvergenceMap)
+	SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<uint>, ActiveTileCount)
+	SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<int>, PixelSlots)
+	SHADER_PARAMETER(FUintVector2, ViewSize)
+	SHADER_PARAMETER(uint32, Iteration)
+	SHADER_PARAMETER(uint32, MinSamples)
+	SHADER_PARAMETER(float, ErrorThreshold)
+	SHADER_PARAMETER(FIntPoint, TileTextureOffset)
+	SHADER_PARAMETER(FUintVector2, TileSize)
+END_SHADER_PARAMETER_STRUCT()
+
+class FMIGIAdaptiveSamplingShaderDefines final
+{
+public:
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return ShouldCompilePathTracingShadersForProject(Parameters.Platform);
+	}
+
+	static void ModifyCompilationEnvironment(FShaderCompilerEnvironment& OutEnvironment)
+	{
+		OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE_1D"), C::ThreadGroupSize1D);
+		OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE_2D"), C::ThreadGroupSize2D);
+	}
+};
+
+class FMIGIAdaptiveSamplingBuildCS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FMIGIAdaptiveSamplingBuildCS);
+	SHADER_USE_PARAMETER_STRUCT(FMIGIAdaptiveSamplingBuildCS, FGlobalShader);
+	using FParameters = FMIGIAdaptiveSamplingParameters;
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return FMIGIAdaptiveSamplingShaderDefines::ShouldCompilePermutation(Parameters);
+	}
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		FMIGIAdaptiveSamplingShaderDefines::ModifyCompilationEnvironment(OutEnvironment);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FMIGIAdaptiveSamplingBuildCS,
+	"/Plugin/MIGI/Private/MIGIAdaptiveSampling.usf", "AdaptiveSamplingBuildCS",
+	EShaderFrequency::SF_Compute);
+
+class FMIGIAdaptiveSamplingMarkCS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FMIGIAdaptiveSamplingMarkCS);
+	SHADER_USE_PARAMETER_STRUCT(FMIGIAdaptiveSamplingMarkCS, FGlobalShader);
+	using FParameters = FMIGIAdaptiveSamplingParameters;
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return FMIGIAdaptiveSamplingShaderDefines::ShouldCompilePermutation(Parameters);
+	}
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		FMIGIAdaptiveSamplingShaderDefines::ModifyCompilationEnvironment(OutEnvironment);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FMIGIAdaptiveSamplingMarkCS,
+	"/Plugin/MIGI/Private/MIGIAdaptiveSampling.usf", "AdaptiveSamplingMarkCS",
+	EShaderFrequency::SF_Compute);
+
+FMIGIAdaptiveSamplingState::FMIGIAdaptiveSamplingState() = default;
+FMIGIAdaptiveSamplingState::~FMIGIAdaptiveSamplingState() = default;
+
+void FMIGIAdaptiveSamplingState::Reset()
+{
+	LuminanceMomentsRT.SafeRelease();
+	ConvergenceMapRT.SafeRelease();
+	Generation++;
+	ActiveTileFraction = 1.f;
+}
+
+bool FMIGIAdaptiveSamplingState::HasMoments(FIntPoint ViewSize) const
+{
+	return LuminanceMomentsRT.IsValid() && LuminanceMomentsRT->GetDesc().Extent == ViewSize;
+}
+
+uint64 FMIGIAdaptiveSamplingState::GetMemorySize() const
+{
+	uint64 Size = 0;
+	for (const TRefCountPtr<IPooledRenderTarget>* Target : { &LuminanceMomentsRT, &ConvergenceMapRT })
+	{
+		if (Target->IsValid())
+		{
+			Size += (*Target)->ComputeMemorySize();
+		}
+	}
+	return Size;
+}
+
+void FMIGIAdaptiveSamplingState::UpdateReadback()
+{
+	if (!bReadbackPending || !ActiveTileReadback->IsReady()) return;
+	bReadbackPending = false;
+	const uint32 NumActiveTiles = *static_cast<const uint32*>(ActiveTileReadback->Lock(sizeof(uint32)));
+	ActiveTileReadback->Unlock();
+	if (ReadbackGeneration != Generation || !ConvergenceMapRT.IsValid()) return;
+	const FIntPoint NumTiles = ConvergenceMapRT->GetDesc().Extent;
+	ActiveTileFraction = (float)NumActiveTiles / (float)FMath::Max(NumTiles.X * NumTiles.Y, 1);
+}
+
+int32 MIGIGetAdaptiveSamplingPassCount(const FMIGIAdaptiveSamplingState& State, const FMIGIAdaptiveSamplingSettings& Settings)
+{
+	if (!Settings.bEnabled || State.ActiveTileFraction <= 0.f) return 1;
+	// Tiles are a coarse measure of the work left, but the tiles still active are the expensive ones anyway.
+	return FMath::Clamp(FMath::FloorToInt(1.f / State.ActiveTileFraction), 1, Settings.MaxPassesPerFrame);
+}
+
+void FMIGIAdaptiveSamplingFrame::SetPathParameters(FRDGBuilder& GraphBuilder, FMIGIAdaptiveSamplingPathParameters& OutParameters) const
+{
+	OutParameters.AdaptivePixels = GraphBuilder.CreateSRV(Pixels, PF_R32_UINT);
+	OutParameters.LuminanceMoments = GraphBuilder.CreateUAV(LuminanceMoments);
+	OutParameters.AdaptiveSampling = bEnabled ? 1 : 0;
+}
+
+static bool DisableAdaptiveSampling(FRDGBuilder& GraphBuilder, FMIGIAdaptiveSamplingState& State, FMIGIAdaptiveSamplingFrame& OutFrame)
+{
+	OutFrame.bEnabled = false;
+	State.Reset();
+	// Never read or written, the ray generation shader checks AdaptiveSampling first.
+	OutFrame.Pixels = GSystemTextures.GetDefaultBuffer(GraphBuilder, sizeof(uint32));
+	OutFrame.LuminanceMoments = GraphBuilder.CreateTexture(
+		FRDGTextureDesc::Create2D(FIntPoint(1, 1), PF_G32R32F, FClearValueBinding::None, TexCreate_ShaderResource | TexCreate_UAV),
+		TEXT("MIGI.AdaptiveSampling.DummyMoments"));
+	return false;
+}
+
+bool MIGIBeginAdaptiveSampling(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FMIGIAdaptiveSamplingSettings& Settings,
+	uint32 Iteration, bool bStartsIteration, uint32 NumSlots, FMIGIAdaptiveSamplingState& State, FMIGIAdaptiveSamplingFrame& OutFrame)
+{
+	if (!Settings.bEnabled)
+	{
+		return DisableAdaptiveSampling(GraphBuilder, State, OutFrame);
+	}
+	OutFrame.bEnabled = true;
+
+	const FIntPoint ViewSize = View.ViewRect.Size();
+	const FIntPoint NumTiles = FIntPoint::DivideAndRoundUp(ViewSize, C::ThreadGroupSize2D);
+	// Within an iteration, the tiles already traced have one more sample than Iteration.
+	bool bBuildConvergenceMap = bStartsIteration;
+	if (!State.HasMoments(ViewSize))
+	{
+		// The path tracer writes the moments of every sample from the first one on, see PathTracingInvalidate.
+		// Without the moments of the samples so far, sit this accumulation out. The path tracer restarts it
+		// next frame, the moments start over with it.
+		if (Iteration != 0)
+		{
+			return DisableAdaptiveSampling(GraphBuilder, State, OutFrame);
+		}
+		bBuildConvergenceMap = true;
+		OutFrame.LuminanceMoments = GraphBuilder.CreateTexture(
+			FRDGTextureDesc::Create2D(ViewSize, PF_G32R32F, FClearValueBinding::None, TexCreate_ShaderResource | TexCreate_UAV),
+			TEXT("MIGI.AdaptiveSampling.LuminanceMoments"), ERDGTextureFlags::MultiFrame);
+		OutFrame.ConvergenceMap = GraphBuilder.CreateTexture(
+			FRDGTextureDesc::Create2D(NumTiles, PF_R32_UINT, FClearValueBinding::None, TexCreate_ShaderResource | TexCreate_UAV),
+			TEXT("MIGI.AdaptiveSampling.ConvergenceMap"), ERDGTextureFlags::MultiFrame);
+	}
+	else
+	{
+		OutFrame.LuminanceMoments = GraphBuilder.RegisterExternalTexture(State.LuminanceMomentsRT, TEXT("MIGI.AdaptiveSampling.LuminanceMoments"));
+		OutFrame.ConvergenceMap = GraphBuilder.RegisterExternalTexture(State.ConvergenceMapRT, TEXT("MIGI.AdaptiveSampling.ConvergenceMap"));
+	}
+	OutFrame.PixelSlots = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(int32), NumSlots), TEXT("MIGI.AdaptiveSampling.PixelSlots"));
+	OutFrame.GroupSums = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(uint32), MIGIGetPathCompactionNumGroups(NumSlots)), TEXT("MIGI.AdaptiveSampling.GroupSums"));
+	OutFrame.Pixels = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(uint32), NumSlots), TEXT("MIGI.AdaptiveSampling.Pixels"));
+	OutFrame.DispatchArgs = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateIndirectDesc<int32>(3), TEXT("MIGI.AdaptiveSampling.DispatchArgs"));
+
+	if (bBuildConvergenceMap)
+	{
+		FRDGBufferRef ActiveTileCount = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(uint32), 1), TEXT("MIGI.AdaptiveSampling.ActiveTileCount"));
+		AddClearUAVPass(GraphBuilder, GraphBuilder.CreateUAV(ActiveTileCount, PF_R32_UINT), 0);
+		{
+			auto ComputeShader = View.ShaderMap->GetShader<FMIGIAdaptiveSamplingBuildCS>();
+			auto PassParameters = GraphBuilder.AllocParameters<FMIGIAdaptiveSamplingParameters>();
+			PassParameters->LuminanceMoments = OutFrame.LuminanceMoments;
+			PassParameters->ConvergenceMap = GraphBuilder.CreateUAV(OutFrame.ConvergenceMap);
+			PassParameters->ActiveTileCount = GraphBuilder.CreateUAV(ActiveTileCount, PF_R32_UINT);
+			PassParameters->ViewSize = FUintVector2(ViewSize.X, ViewSize.Y);
+			PassParameters->Iteration = Iteration;
+			PassParameters->MinSamples = Settings.MinSamples;
+			PassParameters->ErrorThreshold = Settings.ErrorThreshold;
+			ClearUnusedGraphResources(ComputeShader, PassParameters);
+			FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("MIGIAdaptiveSamplingBuild"), ComputeShader, PassParameters,
+				FIntVector(NumTiles.X, NumTiles.Y, 1));
+		}
+
+		// One readback in flight, the pass count only needs a rough idea of the work left.
+		if (!State.bReadbackPending)
+		{
+			if (!State.ActiveTileReadback.IsValid())
+			{
+				State.ActiveTileReadback = MakeUnique<FRHIGPUBufferReadback>(TEXT("MIGI.AdaptiveSampling.ActiveTileReadback"));
+			}
+			AddEnqueueCopyPass(GraphBuilder, State.ActiveTileReadback.Get(), ActiveTileCount, sizeof(uint32));
+			State.bReadbackPending = true;
+			State.ReadbackGeneration = State.Generation;
+		}
+	}
+	return true;
+}
+
+void MIGIAddAdaptiveSamplingTilePasses(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FMIGIAdaptiveSamplingFrame& Frame,
+	FIntPoint TileTextureOffset, FIntPoint TileSize, uint32 NumSamples)
+{
+	const uint32 NumSlots = TileSize.X * TileSize.Y;
+	{
+		auto ComputeShader = View.ShaderMap->GetShader<FMIGIAdaptiveSamplingMarkCS>();
+		auto PassParameters = GraphBuilder.AllocParameters<FMIGIAdaptiveSamplingParameters>();
+		PassParameters->ConvergenceMap = GraphBuilder.CreateUAV(Frame.ConvergenceMap);
+		PassParameters->PixelSlots = GraphBuilder.CreateUAV(Frame.PixelSlots, PF_R32_SINT);
+		PassParameters->TileTextureOffset = TileTextureOffset;
+		PassParameters->TileSize = FUintVector2(TileSize.X, TileSize.Y);
+		ClearUnusedGraphResources(ComputeShader, PassParameters);
+		FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("MIGIAdaptiveSamplingMark"), ComputeShader, PassParameters,
+			FComputeShaderUtils::GetGroupCount(NumSlots, C::ThreadGroupSize1D));
+	}
+	// In scanline order, neighbouring pixels stay together.
+	MIGIAddPathCompactionPasses(GraphBuilder, View, NumSlots, Frame.PixelSlots, Frame.GroupSums, Frame.Pixels, Frame.DispatchArgs, NumSamples);
+}
+
+void MIGIEndAdaptiveSampling(FRDGBuilder& GraphBuilder, const FMIGIAdaptiveSamplingFrame& Frame, FMIGIAdaptiveSamplingState& State)
+{
+	if (!Frame.bEnabled) return;
+	// Not queued for extraction, the next iteration may run in the same graph.
+	State.LuminanceMomentsRT = GraphBuilder.ConvertToExternalTexture(Frame.LuminanceMoments);
+	State.ConvergenceMapRT = GraphBuilder.ConvertToExternalTexture(Frame.ConvergenceMap);
+}
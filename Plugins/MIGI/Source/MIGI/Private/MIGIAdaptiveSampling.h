@@ -0,0 +1,83 @@
+﻿#pragma once
+#include "CoreMinimal.h"
+#include "RenderGraphResources.h"
+#include "ShaderParameterMacros.h"
+#include "MIGIConfig.h"
+
+class FRDGBuilder;
+class FRHIGPUBufferReadback;
+class FViewInfo;
+struct IPooledRenderTarget;
+
+// Adaptive sampling for the path tracer: tiles whose pixels have converged are retired, the next iterations only dispatch
+// the pixels of the other tiles, and spend what that saves on more iterations per frame. See MIGIAdaptiveSampling.usf.
+// Retired tiles stay retired until the accumulation restarts, so the pixels still traced have every sample so far and
+// the uniform blend factor of the accumulation stays right for them.
+
+// Bound to the path tracer's ray generation shader.
+BEGIN_SHADER_PARAMETER_STRUCT(FMIGIAdaptiveSamplingPathParameters, )
+	// Pixels to trace, packed x | y << 16 relative to the dispatch tile. Only read when AdaptiveSampling is set.
+	SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<uint>, AdaptivePixels)
+	SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float2>, LuminanceMoments)
+	SHADER_PARAMETER(uint32, AdaptiveSampling)
+END_SHADER_PARAMETER_STRUCT()
+
+// Kept with the other accumulation targets of a view.
+struct FMIGIAdaptiveSamplingState
+{
+	TRefCountPtr<IPooledRenderTarget> LuminanceMomentsRT;
+	TRefCountPtr<IPooledRenderTarget> ConvergenceMapRT;
+	// Number of tiles still active, read back a few frames late.
+	TUniquePtr<FRHIGPUBufferReadback> ActiveTileReadback;
+	bool bReadbackPending = false;
+	// Bumped when the accumulation restarts, readbacks of an older accumulation are dropped.
+	uint32 Generation = 0;
+	uint32 ReadbackGeneration = 0;
+	// From the last readback of this accumulation.
+	float ActiveTileFraction = 1.f;
+
+	FMIGIAdaptiveSamplingState ();
+	~FMIGIAdaptiveSamplingState ();
+
+	void Reset ();
+	// Whether the moments cover every sample accumulated so far at this view size. The path tracer restarts the
+	// accumulation when they don't.
+	bool HasMoments (FIntPoint ViewSize) const;
+	uint64 GetMemorySize () const;
+	// Poll the readback. Call once per frame before MIGIGetAdaptiveSamplingPassCount.
+	void UpdateReadback ();
+	bool IsConverged () const { return ActiveTileFraction <= 0.f; }
+};
+
+// Iterations to run this frame: as many as the retired tiles make room for, at most Settings.MaxPassesPerFrame.
+int32 MIGIGetAdaptiveSamplingPassCount (const FMIGIAdaptiveSamplingState & State, const FMIGIAdaptiveSamplingSettings & Settings);
+
+// Resources of adaptive sampling for one iteration of the path tracer.
+struct FMIGIAdaptiveSamplingFrame
+{
+	FRDGTextureRef LuminanceMoments {};
+	FRDGTextureRef ConvergenceMap {};
+	FRDGBufferRef PixelSlots {};
+	FRDGBufferRef GroupSums {};
+	FRDGBufferRef Pixels {};
+	// Indirect dispatch arguments of the pixels of the current dispatch tile.
+	FRDGBufferRef DispatchArgs {};
+	bool bEnabled = false;
+
+	void SetPathParameters (FRDGBuilder & GraphBuilder, FMIGIAdaptiveSamplingPathParameters & OutParameters) const;
+};
+
+// Update the convergence map when iteration Iteration starts, bStartsIteration is false for the next passes of an
+// iteration that spans several frames. The path tracer must dispatch indirectly for it, Settings.bEnabled
+// is only set when the RHI supports it. When adaptive sampling is disabled, OutFrame only holds
+// placeholders for the path tracer's parameters and false is returned.
+// NumSlots is the size of the largest dispatch tile.
+bool MIGIBeginAdaptiveSampling (FRDGBuilder & GraphBuilder, const FViewInfo & View, const FMIGIAdaptiveSamplingSettings & Settings,
+	uint32 Iteration, bool bStartsIteration, uint32 NumSlots, FMIGIAdaptiveSamplingState & State, FMIGIAdaptiveSamplingFrame & OutFrame);
+
+// List the pixels of a dispatch tile that are still converging into Frame.Pixels and Frame.DispatchArgs.
+// The dispatch arguments are NumSamples rows of the listed pixels, one per sample the path tracer launches at once.
+void MIGIAddAdaptiveSamplingTilePasses (FRDGBuilder & GraphBuilder, const FViewInfo & View, const FMIGIAdaptiveSamplingFrame & Frame,
+	FIntPoint TileTextureOffset, FIntPoint TileSize, uint32 NumSamples);
+
+void MIGIEndAdaptiveSampling (FRDGBuilder & GraphBuilder, const FMIGIAdaptiveSamplingFrame & Frame, FMIGIAdaptiveSamplingState & State);
@@ -4,6 +4,54 @@ TAutoConsoleVariable<bool> CVarMIGIEnabled(TEXT("r.MIGI.Enabled"), 0, TEXT("Enab
 TAutoConsoleVariable<bool> CVarMIGIDebugEnabled(TEXT("r.MIGI.DebugEnabled"), 0, TEXT("Enable MIGI Debug. 0: Disable, 1: Enable"), ECVF_RenderThreadSafe);
 TAutoConsoleVariable<int> CVarMIGIDebugPixelCoordsX(TEXT("r.MIGI.DebugPixelCoordsX"), 0, TEXT("X coordinate of the pixel to debug MIGI"), ECVF_RenderThreadSafe);
 TAutoConsoleVariable<int> CVarMIGIDebugPixelCoordsY(TEXT("r.MIGI.DebugPixelCoordsY"), 0, TEXT("Y coordinate of the pixel to debug MIGI"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<bool> CVarMIGIPathTracing(TEXT("r.MIGI.PathTracing"), 1, TEXT("Render the view with the MIGI path tracer. 0: Run the screen space NN query, training and composite passes instead, 1: Path tracer"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<bool> CVarMIGICompositeLastFrameNN(TEXT("r.MIGI.CompositeLastFrameNN"), 0, TEXT("Composite the NN output of the last frame, so NN work overlaps with rendering. 0: Disable, 1: Enable"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<bool> CVarMIGISuspendWhenDisabled(TEXT("r.MIGI.SuspendWhenDisabled"), 1, TEXT("Release the NN GPU memory while MIGI is disabled. The weights are kept in host memory. 0: Disable, 1: Enable"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<int> CVarMIGICacheType(TEXT("r.MIGI.CacheType"), 0, TEXT("Radiance cache used by MIGINN, read when the NN is initialized. 0: MLP, 1: Hash grid"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<bool> CVarMIGIHashEncoding(TEXT("r.MIGI.HashEncoding"), 0, TEXT("Encode the MLP inputs with a multiresolution hash grid instead of frequencies, read when the NN is initialized. 0: Disable, 1: Enable"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<int> CVarMIGIHashEncodingNumLevels(TEXT("r.MIGI.HashEncoding.NumLevels"), 16, TEXT("Number of levels of the hash encoding"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<int> CVarMIGIHashEncodingLog2TableSize(TEXT("r.MIGI.HashEncoding.Log2TableSize"), 19, TEXT("Log2 of the table size per level of the hash encoding"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<int> CVarMIGIHashEncodingNumFeatures(TEXT("r.MIGI.HashEncoding.NumFeatures"), 2, TEXT("Number of feature dimensions per level of the hash encoding: 1, 2, 4 or 8"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<bool> CVarMIGIQuantizedInference(TEXT("r.MIGI.QuantizedInference"), 0, TEXT("Serve NN inference from an INT8 copy of the MLP, read when the NN is initialized. 0: Disable, 1: Enable"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<int> CVarMIGIQuantizationRefreshInterval(TEXT("r.MIGI.QuantizedInference.RefreshInterval"), 64, TEXT("Number of training steps between re-quantizations of the INT8 MLP"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<bool> CVarMIGIDistillation(TEXT("r.MIGI.Distillation"), 0, TEXT("Distill the trained MLP into a smaller student that serves the inference, read when the NN is initialized. 0: Disable, 1: Enable"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<int> CVarMIGIDistillationNumNeurons(TEXT("r.MIGI.Distillation.NumNeurons"), 32, TEXT("Width of the student MLP: 16, 32, 64 or 128"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<int> CVarMIGIDistillationNumHiddenLayers(TEXT("r.MIGI.Distillation.NumHiddenLayers"), 2, TEXT("Number of hidden layers of the student MLP"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<float> CVarMIGIDeduplicationQuantum(TEXT("r.MIGI.Deduplication.Quantum"), 0.f, TEXT("Snap the NN inference queries to a grid of this step and evaluate each distinct query once, read when the NN is initialized. 0: Disable"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<bool> CVarMIGIResultCache(TEXT("r.MIGI.ResultCache"), 0, TEXT("Reuse the NN results of the deduplicated queries across frames, read when the NN is initialized. Needs r.MIGI.Deduplication.Quantum. 0: Disable, 1: Enable"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<int> CVarMIGIResultCacheLog2Size(TEXT("r.MIGI.ResultCache.Log2Size"), 20, TEXT("Log2 of the number of entries of the result cache"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<int> CVarMIGIResultCacheMaxAge(TEXT("r.MIGI.ResultCache.MaxAge"), 16, TEXT("Cached results older than this many training steps are always refreshed"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<float> CVarMIGIResultCacheTolerance(TEXT("r.MIGI.ResultCache.Tolerance"), 0.05f, TEXT("Change of a cached result at its last refresh that makes it refresh every frame"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<float> CVarMIGIResultCacheMinRefreshProbability(TEXT("r.MIGI.ResultCache.MinRefreshProbability"), 0.05f, TEXT("Per frame refresh probability of cached results that did not change"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<int> CVarMIGIQueryBudget(TEXT("r.MIGI.QueryBudget"), 0, TEXT("Fixed number of NN inference queries per frame, spread over the view and filtered back to full resolution. 0: One query per pixel"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<int> CVarMIGINNResolutionDivisor(TEXT("r.MIGI.NNResolutionDivisor"), 1, TEXT("Run the NN queries at a fraction of the view resolution and upsample the result. 1: Full, 2: Half, 4: Quarter"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<float> CVarMIGITrainSampleRatio(TEXT("r.MIGI.TrainSampleRatio"), 0.03f, TEXT("Number of NN training samples per frame, relative to the number of NN queries"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<int> CVarMIGITrainTileSize(TEXT("r.MIGI.TrainTileSize"), 32, TEXT("Size in pixels of the screen tiles the NN training samples are stratified over"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<int> CVarMIGISharedBufferSize(TEXT("r.MIGI.SharedBufferSize"), 4, TEXT("Size in MiB of each frame slot of the buffers shared with MIGINN, read when the module starts"), ECVF_ReadOnly);
+TAutoConsoleVariable<bool> CVarMIGIRadianceCache(TEXT("r.MIGI.RadianceCache"), 0, TEXT("Terminate path tracer paths early into the NN radiance cache, trained by a sparse set of longer paths. 0: Disable, 1: Enable"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<float> CVarMIGIRadianceCacheSpreadThreshold(TEXT("r.MIGI.RadianceCache.SpreadThreshold"), 0.01f, TEXT("Paths terminate into the cache once their spread exceeds this fraction of the spread of the primary vertex"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<float> CVarMIGIRadianceCacheTrainingPathRatio(TEXT("r.MIGI.RadianceCache.TrainingPathRatio"), 0.02f, TEXT("Fraction of the paths extended beyond their termination to train the cache"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<int> CVarMIGIRadianceCacheTrainingBounces(TEXT("r.MIGI.RadianceCache.TrainingBounces"), 3, TEXT("Number of bounces training paths are extended by before they terminate into the cache themselves"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<float> CVarMIGIRadianceCacheSceneExtent(TEXT("r.MIGI.RadianceCache.SceneExtent"), 20000.f, TEXT("Size in cm of the box around the world origin the cache positions are normalized to"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<int> CVarMIGIPathTracingStateBudget(TEXT("r.MIGI.PathTracingStateBudget"), 1024, TEXT("Size in MiB the accumulation targets of the path traced views may take, least recently used views are released beyond it"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<int> CVarMIGIPathTracingStateMaxAge(TEXT("r.MIGI.PathTracingStateMaxAge"), 300, TEXT("Number of frames a path traced view may go unrendered before its accumulation targets are released. 0: Never"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<int> CVarMIGIPathTracingAlbedoFormat(TEXT("r.MIGI.PathTracing.AlbedoFormat"), 1, TEXT("Format of the path tracer albedo target. 0: RGBA32F, 1: RGBA16F, 2: RGB10A2"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<int> CVarMIGIPathTracingNormalFormat(TEXT("r.MIGI.PathTracing.NormalFormat"), 0, TEXT("Format of the path tracer normal target, its alpha holds the depth. 0: RGBA32F, 1: RGBA16F"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<int> CVarMIGIPathTracingSortPaths(TEXT("r.MIGI.PathTracing.SortPaths"), 0, TEXT("Bin the active paths of the wavefront path tracer by ray direction, origin and shading class between bounces (r.PathTracing.Compaction 1 only)"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<float> CVarMIGIPathTracingSortCellSize(TEXT("r.MIGI.PathTracing.SortCellSize"), 1000.f, TEXT("Size in cm of the origin cells paths are binned by, 4 cells per axis around the camera"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<int> CVarMIGIPathTracingAdaptiveSampling(TEXT("r.MIGI.PathTracing.AdaptiveSampling"), 0, TEXT("Stop tracing the tiles of the path tracer whose pixels have converged, and run more iterations per frame with the time saved"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<float> CVarMIGIPathTracingAdaptiveErrorThreshold(TEXT("r.MIGI.PathTracing.AdaptiveErrorThreshold"), 0.01f, TEXT("Relative standard error of the luminance below which a pixel has converged"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<int> CVarMIGIPathTracingAdaptiveMinSamples(TEXT("r.MIGI.PathTracing.AdaptiveMinSamples"), 16, TEXT("Samples every pixel gets before its tile can be retired"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<int> CVarMIGIPathTracingAdaptiveMaxPassesPerFrame(TEXT("r.MIGI.PathTracing.AdaptiveMaxPassesPerFrame"), 4, TEXT("Maximum number of path tracer iterations per frame once tiles are retired"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<float> CVarMIGIPathTracingFrameBudgetMs(TEXT("r.MIGI.PathTracing.FrameBudgetMs"), 0.f, TEXT("GPU time in ms the path tracer may spend per frame, its iterations then span several frames (0: trace the whole view every frame)"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<int> CVarMIGIPathTracingFrameBudgetMaxIterations(TEXT("r.MIGI.PathTracing.FrameBudgetMaxIterations"), 8, TEXT("Maximum number of path tracer iterations per frame when the frame budget leaves room for more than one"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<int> CVarMIGIPathTracingTileOrder(TEXT("r.MIGI.PathTracing.TileOrder"), 0, TEXT("Order the tiles of an iteration are traced in under a frame budget. 0: Hilbert curve, 1: nearest to r.MIGI.PathTracing.TileFocus first"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<float> CVarMIGIPathTracingTileFocusX(TEXT("r.MIGI.PathTracing.TileFocusX"), 0.5f, TEXT("Horizontal position of the tile focus point, relative to the view"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<float> CVarMIGIPathTracingTileFocusY(TEXT("r.MIGI.PathTracing.TileFocusY"), 0.5f, TEXT("Vertical position of the tile focus point, relative to the view"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<int> CVarMIGIPathTracingAutoDispatchSize(TEXT("r.MIGI.PathTracing.AutoDispatchSize"), 0, TEXT("Tune the path tracer's dispatch size from measured tile timings instead of r.PathTracing.DispatchSize, saved per GPU and view size"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<float> CVarMIGIPathTracingAutoDispatchSizeTargetMs(TEXT("r.MIGI.PathTracing.AutoDispatchSizeTargetMs"), 16.f, TEXT("GPU time in ms the tuned dispatch size aims for per tile"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<int> CVarMIGIPathTracingSamplesPerLaunch(TEXT("r.MIGI.PathTracing.SamplesPerLaunch"), 1, TEXT("Samples per pixel each path tracer launch traces, to amortize the dispatch and pass overhead of low resolutions and simple scenes. 1 with the radiance cache"), ECVF_RenderThreadSafe);
+TAutoConsoleVariable<int> CVarMIGIPathTracingMinCameraSamples(TEXT("r.MIGI.PathTracing.MinCameraSamples"), 16, TEXT("Distinct camera rays (pixel jitter and lens sample) every pixel gets at least over its accumulated samples. The samples of a launch share one, r.MIGI.PathTracing.SamplesPerLaunch is lowered to keep them"), ECVF_RenderThreadSafe);
 
 bool IsMIGIEnabled() {
     return CVarMIGIEnabled.GetValueOnRenderThread();
@@ -29,4 +77,159 @@ bool IsMIGIDebugEnabled()
 void SetMIGIDebugEnabled(bool bEnabled)
 {
     CVarMIGIDebugEnabled->Set(bEnabled);
+}
+bool IsMIGIPathTracing()
+{
+    return CVarMIGIPathTracing.GetValueOnRenderThread();
+}
+bool IsMIGICompositeLastFrameNN()
+{
+    return CVarMIGICompositeLastFrameNN.GetValueOnRenderThread();
+}
+bool IsMIGISuspendWhenDisabled()
+{
+    return CVarMIGISuspendWhenDisabled.GetValueOnRenderThread();
+}
+int GetMIGIQueryBudget()
+{
+    return FMath::Max(CVarMIGIQueryBudget.GetValueOnRenderThread(), 0);
+}
+int GetMIGINNResolutionDivisor()
+{
+    const int Divisor = CVarMIGINNResolutionDivisor.GetValueOnRenderThread();
+    return Divisor >= 4 ? 4 : Divisor >= 2 ? 2 : 1;
+}
+float GetMIGITrainSampleRatio()
+{
+    return FMath::Clamp(CVarMIGITrainSampleRatio.GetValueOnRenderThread(), 0.f, 1.f);
+}
+int GetMIGITrainTileSize()
+{
+    return FMath::Max(CVarMIGITrainTileSize.GetValueOnRenderThread(), 4);
+}
+bool IsMIGIRadianceCache()
+{
+    return CVarMIGIRadianceCache.GetValueOnRenderThread();
+}
+FMIGIRadianceCacheSettings GetMIGIRadianceCacheSettings()
+{
+    return FMIGIRadianceCacheSettings {
+        .SpreadThreshold = FMath::Max(CVarMIGIRadianceCacheSpreadThreshold.GetValueOnRenderThread(), 0.f),
+        .TrainingPathRatio = FMath::Clamp(CVarMIGIRadianceCacheTrainingPathRatio.GetValueOnRenderThread(), 0.f, 1.f),
+        .TrainingBounces = FMath::Clamp(CVarMIGIRadianceCacheTrainingBounces.GetValueOnRenderThread(), 1, 8),
+        .SceneExtent = FMath::Max(CVarMIGIRadianceCacheSceneExtent.GetValueOnRenderThread(), 1.f)
+    };
+}
+FMIGIPathTracingStateSettings GetMIGIPathTracingStateSettings()
+{
+    return FMIGIPathTracingStateSettings {
+        .Budget = (uint64)FMath::Max(CVarMIGIPathTracingStateBudget.GetValueOnRenderThread(), 0) * 1024 * 1024,
+        .MaxAge = (uint32)FMath::Max(CVarMIGIPathTracingStateMaxAge.GetValueOnRenderThread(), 0)
+    };
+}
+int GetMIGIPathTracingAlbedoFormat()
+{
+    return FMath::Clamp(CVarMIGIPathTracingAlbedoFormat.GetValueOnRenderThread(), 0, 2);
+}
+int GetMIGIPathTracingNormalFormat()
+{
+    return FMath::Clamp(CVarMIGIPathTracingNormalFormat.GetValueOnRenderThread(), 0, 1);
+}
+FMIGIPathSortSettings GetMIGIPathSortSettings()
+{
+    return FMIGIPathSortSettings {
+        .bEnabled = CVarMIGIPathTracingSortPaths.GetValueOnRenderThread() != 0,
+        .CellSize = FMath::Max(CVarMIGIPathTracingSortCellSize.GetValueOnRenderThread(), 1.f)
+    };
+}
+FMIGIAdaptiveSamplingSettings GetMIGIAdaptiveSamplingSettings()
+{
+    return FMIGIAdaptiveSamplingSettings {
+        .bEnabled = CVarMIGIPathTracingAdaptiveSampling.GetValueOnRenderThread() != 0,
+        .ErrorThreshold = FMath::Max(CVarMIGIPathTracingAdaptiveErrorThreshold.GetValueOnRenderThread(), 0.f),
+        // The variance estimate needs two samples.
+        .MinSamples = (uint32)FMath::Max(CVarMIGIPathTracingAdaptiveMinSamples.GetValueOnRenderThread(), 2),
+        .MaxPassesPerFrame = FMath::Max(CVarMIGIPathTracingAdaptiveMaxPassesPerFrame.GetValueOnRenderThread(), 1)
+    };
+}
+FMIGITileSchedulerSettings GetMIGITileSchedulerSettings()
+{
+    return FMIGITileSchedulerSettings {
+        .BudgetMs = FMath::Max(CVarMIGIPathTracingFrameBudgetMs.GetValueOnRenderThread(), 0.f),
+        .MaxIterationsPerFrame = FMath::Max(CVarMIGIPathTracingFrameBudgetMaxIterations.GetValueOnRenderThread(), 1),
+        .TileOrder = FMath::Clamp(CVarMIGIPathTracingTileOrder.GetValueOnRenderThread(), 0, 1),
+        .Focus = FVector2f(
+            FMath::Clamp(CVarMIGIPathTracingTileFocusX.GetValueOnRenderThread(), 0.f, 1.f),
+            FMath::Clamp(CVarMIGIPathTracingTileFocusY.GetValueOnRenderThread(), 0.f, 1.f))
+    };
+}
+FMIGIDispatchSizeTuningSettings GetMIGIDispatchSizeTuningSettings()
+{
+    return FMIGIDispatchSizeTuningSettings {
+        .bEnabled = CVarMIGIPathTracingAutoDispatchSize.GetValueOnRenderThread() != 0,
+        .TargetMs = FMath::Max(CVarMIGIPathTracingAutoDispatchSizeTargetMs.GetValueOnRenderThread(), 1.f)
+    };
+}
+uint32 GetMIGIPathTracingSamplesPerLaunch(uint32 MaxSPP)
+{
+    const uint32 MinCameraSamples = (uint32)FMath::Max(CVarMIGIPathTracingMinCameraSamples.GetValueOnRenderThread(), 1);
+    return FMath::Max(FMath::Min<uint32>(FMath::Clamp(CVarMIGIPathTracingSamplesPerLaunch.GetValueOnRenderThread(), 1, 64), MaxSPP / MinCameraSamples), 1u);
+}
+// Read by the NN initialization task, off the render thread.
+int GetMIGICacheType()
+{
+    return CVarMIGICacheType.GetValueOnAnyThread();
+}
+bool IsMIGIHashEncoding()
+{
+    return CVarMIGIHashEncoding.GetValueOnAnyThread();
+}
+bool IsMIGIQuantizedInference()
+{
+    return CVarMIGIQuantizedInference.GetValueOnAnyThread();
+}
+int GetMIGIQuantizationRefreshInterval()
+{
+    return FMath::Max(CVarMIGIQuantizationRefreshInterval.GetValueOnAnyThread(), 1);
+}
+bool IsMIGIDistillation()
+{
+    return CVarMIGIDistillation.GetValueOnAnyThread();
+}
+FIntPoint GetMIGIDistillationStudentSize()
+{
+    // The fully fused MLP only comes in 16, 32, 64 and 128 neurons, round to the nearest.
+    const int NumNeurons = 1 << FMath::Clamp(FMath::RoundToInt(FMath::Log2((float)FMath::Max(CVarMIGIDistillationNumNeurons.GetValueOnAnyThread(), 1))), 4, 7);
+    return FIntPoint(NumNeurons, FMath::Max(CVarMIGIDistillationNumHiddenLayers.GetValueOnAnyThread(), 1));
+}
+FMIGIHashEncodingSettings GetMIGIHashEncodingSettings()
+{
+    return FMIGIHashEncodingSettings {
+        .NumLevels = FMath::Clamp(CVarMIGIHashEncodingNumLevels.GetValueOnAnyThread(), 1, 32),
+        .Log2TableSize = FMath::Clamp(CVarMIGIHashEncodingLog2TableSize.GetValueOnAnyThread(), 10, 24),
+        // tiny-cuda-nn only instantiates the grid for 1, 2, 4 and 8 features per level, round to the nearest.
+        .NumFeatures = 1 << FMath::Clamp(FMath::RoundToInt(FMath::Log2((float)FMath::Max(CVarMIGIHashEncodingNumFeatures.GetValueOnAnyThread(), 1))), 0, 3)
+    };
+}
+float GetMIGIDeduplicationQuantum()
+{
+    return FMath::Max(CVarMIGIDeduplicationQuantum.GetValueOnAnyThread(), 0.f);
+}
+bool IsMIGIResultCache()
+{
+    return CVarMIGIResultCache.GetValueOnAnyThread();
+}
+FMIGIResultCacheSettings GetMIGIResultCacheSettings()
+{
+    return FMIGIResultCacheSettings {
+        .Log2Size = FMath::Clamp(CVarMIGIResultCacheLog2Size.GetValueOnAnyThread(), 10, 26),
+        .MaxAge = FMath::Max(CVarMIGIResultCacheMaxAge.GetValueOnAnyThread(), 1),
+        .Tolerance = FMath::Max(CVarMIGIResultCacheTolerance.GetValueOnAnyThread(), 1e-6f),
+        .MinRefreshProbability = FMath::Clamp(CVarMIGIResultCacheMinRefreshProbability.GetValueOnAnyThread(), 0.f, 1.f)
+    };
+}
+// Read once when the module starts, the shared buffers are never resized.
+size_t GetMIGISharedBufferSize()
+{
+    return (size_t)FMath::Clamp(CVarMIGISharedBufferSize.GetValueOnAnyThread(), 1, 2048) * 1024 * 1024;
 }
\ No newline at end of file
@@ -12,4 +12,109 @@ void SetMIGIDebugPixelCoords (FIntPoint PixelCoords);
 bool IsMIGIDebugEnabled ();
 void SetMIGIDebugEnabled (bool bEnabled);
 
+// False when the screen space NN passes render the view instead of the path tracer.
+bool IsMIGIPathTracing ();
+
+bool IsMIGICompositeLastFrameNN ();
+
+bool IsMIGISuspendWhenDisabled ();
+
+// 0 when every pixel gets its own NN query.
+int GetMIGIQueryBudget ();
+// 1, 2 or 4.
+int GetMIGINNResolutionDivisor ();
+// Relative to the number of queries, in [0, 1].
+float GetMIGITrainSampleRatio ();
+int GetMIGITrainTileSize ();
+
+struct FMIGIRadianceCacheSettings
+{
+	float SpreadThreshold;
+	float TrainingPathRatio;
+	int TrainingBounces;
+	float SceneExtent;
+};
+bool IsMIGIRadianceCache ();
+FMIGIRadianceCacheSettings GetMIGIRadianceCacheSettings ();
+
+struct FMIGIPathTracingStateSettings
+{
+	// In bytes.
+	uint64 Budget;
+	// In frames, 0 keeps unused states forever.
+	uint32 MaxAge;
+};
+FMIGIPathTracingStateSettings GetMIGIPathTracingStateSettings ();
+// See MIGIPathTracingFormats.h.
+int GetMIGIPathTracingAlbedoFormat ();
+int GetMIGIPathTracingNormalFormat ();
+
+struct FMIGIPathSortSettings
+{
+	bool bEnabled;
+	// In cm.
+	float CellSize;
+};
+FMIGIPathSortSettings GetMIGIPathSortSettings ();
+
+struct FMIGIAdaptiveSamplingSettings
+{
+	bool bEnabled;
+	// Relative standard error of the luminance.
+	float ErrorThreshold;
+	uint32 MinSamples;
+	int32 MaxPassesPerFrame;
+};
+FMIGIAdaptiveSamplingSettings GetMIGIAdaptiveSamplingSettings ();
+
+struct FMIGITileSchedulerSettings
+{
+	// GPU time per frame, 0 without a budget.
+	float BudgetMs;
+	int32 MaxIterationsPerFrame;
+	// See MIGITileScheduler::ETileOrder.
+	int32 TileOrder;
+	// Relative to the view.
+	FVector2f Focus;
+};
+FMIGITileSchedulerSettings GetMIGITileSchedulerSettings ();
+
+struct FMIGIDispatchSizeTuningSettings
+{
+	bool bEnabled;
+	// GPU time per tile.
+	float TargetMs;
+};
+FMIGIDispatchSizeTuningSettings GetMIGIDispatchSizeTuningSettings ();
+// In [1, 64], and no more than MaxSPP / r.MIGI.PathTracing.MinCameraSamples.
+uint32 GetMIGIPathTracingSamplesPerLaunch (uint32 MaxSPP);
+
+int GetMIGICacheType ();
+
+struct FMIGIHashEncodingSettings
+{
+	int NumLevels;
+	int Log2TableSize;
+	// 1, 2, 4 or 8.
+	int NumFeatures;
+};
+bool IsMIGIHashEncoding ();
+bool IsMIGIQuantizedInference ();
+int GetMIGIQuantizationRefreshInterval ();
+bool IsMIGIDistillation ();
+// X: number of neurons (16, 32, 64 or 128), Y: number of hidden layers.
+FIntPoint GetMIGIDistillationStudentSize ();
+FMIGIHashEncodingSettings GetMIGIHashEncodingSettings ();
+float GetMIGIDeduplicationQuantum ();
+
+struct FMIGIResultCacheSettings
+{
+	int Log2Size;
+	int MaxAge;
+	float Tolerance;
+	float MinRefreshProbability;
+};
+bool IsMIGIResultCache ();
+FMIGIResultCacheSettings GetMIGIResultCacheSettings ();
+
 size_t GetMIGISharedBufferSize ();
\ No newline at end of file
@@ -1,10 +1,18 @@
 ﻿#pragma once
 namespace C
 {
-	// 1MB Shared buffer size by default.
-	constexpr size_t DefaultSharedBufferSize = 4 * 1024 * 1024;
+	// Number of ring slots in the shared buffers, i.e. frames D3D12 and CUDA can have in flight.
+	// Each slot is r.MIGI.SharedBufferSize large.
+	constexpr uint32 NNFramesInFlight = 3;
 	constexpr int C::ThreadGroupSize1D = 128;
 	constexpr int C::ThreadGroupSize2D = 16;
-	constexpr int NNInputWidth = 4;
+	// Position (3), direction (3), roughness (1) and one unused dimension of the radiance cache queries.
+	constexpr int NNInputWidth = 8;
 	constexpr int NNOutputWidth = 4;
+	// tiny-cuda-nn runs batches of a multiple of BATCH_SIZE_GRANULARITY elements.
+	constexpr uint32 NNBatchGranularity = 256;
+	// The per-tile training loss is summed in fixed point with this many steps per unit.
+	constexpr float NNTrainLossScale = 256.f;
+	// Per view state of views not rendered for this many frames is released.
+	constexpr uint32 ViewStateMaxAge = 300;
 }
@@ -11,7 +11,10 @@
 #include "MIGINNAdapter.h"
 #include "MIGINN.h"
 #include "MIGIConstants.h"
+#include "MIGILogCategory.h"
 #include "MIGIPT.h"
+#include "MIGITrainingSampleSelector.h"
+#include "RHIGPUReadback.h"
 #include "ScenePrivate.h"
 
 
@@ -19,8 +22,49 @@ BEGIN_SHADER_PARAMETER_STRUCT(FMIGINNCommonShaderParameters,)
 	SHADER_PARAMETER(FVector4f, TestParam)
 	SHADER_PARAMETER(unsigned, NNMaxInferenceSampleSize)
 	SHADER_PARAMETER(unsigned, NNTrainSampleSize)
+	// Offsets (in floats) of the ring slots used by this frame inside the shared buffers.
+	SHADER_PARAMETER(unsigned, NNInputSlotOffset)
+	SHADER_PARAMETER(unsigned, NNOutputSlotOffset)
+	// Queries are laid out on a grid of square cells, one pixel per cell. A cell size of 1 queries every pixel.
+	SHADER_PARAMETER(unsigned, NNQueryCellSize)
+	SHADER_PARAMETER(FIntPoint, NNQueryGridSize)
+	SHADER_PARAMETER(unsigned, NNQueryFrameIndex)
+	// Non-zero: a jittered pixel per cell, gathered back stochastically. Zero: the cell centre, upsampled bilaterally.
+	SHADER_PARAMETER(unsigned, NNQueryJitter)
+	// Training samples are stratified over square tiles of the view.
+	SHADER_PARAMETER(unsigned, NNTrainTileSize)
+	SHADER_PARAMETER(FIntPoint, NNTrainTileGridSize)
 END_SHADER_PARAMETER_STRUCT()
 
+// The smallest square cells that keep the number of queries within the budget, so the NN cost does not grow with resolution.
+// Cells are at least ResolutionDivisor large. They are jittered when the budget, not the divisor, sets their size.
+static FIntPoint GetNNQueryGrid (FIntPoint ViewSize, int32 QueryBudget, uint32 ResolutionDivisor, uint32 & OutCellSize, bool & bOutJitter)
+{
+	OutCellSize = ResolutionDivisor;
+	bOutJitter = false;
+	const int64 NumDivisorQueries = (int64)FMath::DivideAndRoundUp(ViewSize.X, (int32)ResolutionDivisor) * FMath::DivideAndRoundUp(ViewSize.Y, (int32)ResolutionDivisor);
+	if(QueryBudget > 0 && NumDivisorQueries > QueryBudget)
+	{
+		OutCellSize = FMath::Max((uint32)FMath::CeilToInt(FMath::Sqrt((double)ViewSize.X * ViewSize.Y / QueryBudget)), ResolutionDivisor);
+		// Rounding may still overshoot on very wide or tall views.
+		while(FMath::DivideAndRoundUp(ViewSize.X, (int32)OutCellSize) * FMath::DivideAndRoundUp(ViewSize.Y, (int32)OutCellSize) > QueryBudget)
+		{
+			OutCellSize++;
+		}
+		bOutJitter = true;
+	}
+	return FIntPoint(FMath::DivideAndRoundUp(ViewSize.X, (int32)OutCellSize), FMath::DivideAndRoundUp(ViewSize.Y, (int32)OutCellSize));
+}
+
+// The most query cells a ring slot of the shared buffers holds, with their share of training samples, in whole batches.
+static uint32 GetNNSlotQueryCapacity (float TrainSampleRatio)
+{
+	const double InputFloatsPerQuery = C::NNInputWidth + (double)TrainSampleRatio * (C::NNInputWidth + C::NNOutputWidth);
+	const uint64 NumInputQueries = (uint64)((double)(IMIGINNAdapter::GetSharedInputSlotSize() / sizeof(float)) / InputFloatsPerQuery);
+	const uint64 NumOutputQueries = IMIGINNAdapter::GetSharedOutputSlotSize() / sizeof(float) / C::NNOutputWidth;
+	return AlignDown((uint32)FMath::Min<uint64>(FMath::Min(NumInputQueries, NumOutputQueries), MAX_int32), C::NNBatchGranularity);
+}
+
 class FMIGINNParameters final
 {
 public:
@@ -31,6 +75,7 @@ public:
 		OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE_2D"), C::ThreadGroupSize2D);
 		OutEnvironment.SetDefine(TEXT("NN_INPUT_WIDTH"), C::NNInputWidth);
 		OutEnvironment.SetDefine(TEXT("NN_OUTPUT_WIDTH"), C::NNOutputWidth);
+		OutEnvironment.SetDefine(TEXT("NN_TRAIN_LOSS_SCALE"), C::NNTrainLossScale);
 	}
 };
 
@@ -44,6 +89,7 @@ public:
 		SHADER_PARAMETER_STRUCT_REF(FViewUniformShaderParameters, View)
 		SHADER_PARAMETER_STRUCT_INCLUDE(FMIGINNCommonShaderParameters, CommonParameters)
 		SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<float>, NNInputBuffer)
+		SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<uint>, NNTrainTileOffsets)
 	END_SHADER_PARAMETER_STRUCT()
 
 	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
@@ -61,10 +107,12 @@ class FMIGINNOutputShaderCS : public FGlobalShader
 {
 public:
 	DECLARE_GLOBAL_SHADER(FMIGINNOutputShaderCS);
+	SHADER_USE_PARAMETER_STRUCT(FMIGINNOutputShaderCS, FGlobalShader);
 	
 	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
 		SHADER_PARAMETER_STRUCT_REF(FViewUniformShaderParameters, View)
 		SHADER_PARAMETER_STRUCT_INCLUDE(FMIGINNCommonShaderParameters, CommonParameters)
+		SHADER_PARAMETER_RDG_UNIFORM_BUFFER(FSceneTextureUniformParameters, SceneTexturesStruct)
 		SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<float>, NNOutputBuffer)
 		SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float4>, ColorBuffer)
 	END_SHADER_PARAMETER_STRUCT()
@@ -81,6 +129,33 @@ IMPLEMENT_GLOBAL_SHADER(FMIGINNOutputShaderCS,
 	"/Plugin/MIGI/Private/NNInterface.usf", "NNOutput",
 	EShaderFrequency::SF_Compute);
 
+class FMIGINNTrainLossShaderCS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FMIGINNTrainLossShaderCS);
+	SHADER_USE_PARAMETER_STRUCT(FMIGINNTrainLossShaderCS, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER_STRUCT_REF(FViewUniformShaderParameters, View)
+		SHADER_PARAMETER_STRUCT_INCLUDE(FMIGINNCommonShaderParameters, CommonParameters)
+		// Only the training targets are read.
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<float>, NNInputBuffer)
+		SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<float>, NNOutputBuffer)
+		SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<uint>, NNTrainTileOffsets)
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<uint>, NNTrainTileLoss)
+	END_SHADER_PARAMETER_STRUCT()
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		FMIGINNParameters::ModifyCompilationEnvironment(OutEnvironment);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FMIGINNTrainLossShaderCS,
+	"/Plugin/MIGI/Private/NNInterface.usf", "NNTrainLoss",
+	EShaderFrequency::SF_Compute);
+
 class FMIGISimpleDiffuseRayTracing : public FLumenHardwareRayTracingShaderBase
 {
 	DECLARE_LUMEN_RAYTRACING_SHADER(FMIGISimpleDiffuseRayTracing, Lumen::ERayTracingShaderDispatchSize::DispatchSize2D)
@@ -142,29 +217,34 @@ void MIGIPrepareRayTracingDiffuseIndirect (const FViewInfo& View, TArray<FRHIRay
 
 void MIGIRenderDiffuseIndirect(const FScene& Scene, const FViewInfo& ViewInfo, FRDGBuilder& GraphBuilder, FGlobalIlluminationPluginResources &  RenderResources)
 {
-	// Try to initialize RDG buffers when possible.
-	MIGIRenderingContext::Get().Initialze_RenderThread();
-	
 	auto Adapter = IMIGINNAdapter::GetInstance();
-	// The adapter is not ready for some reason (reloading, etc). Render nothing.
-	if(!Adapter->IsReady()) return;
+	// Lazily initialize MIGINN the first time MIGI is enabled.
+	Adapter->Update_RenderThread(GraphBuilder.RHICmdList, IsMIGIEnabled());
+	// The adapter is not ready for some reason (initializing, reloading, etc). Render nothing.
+	if(!IsMIGIEnabled() || !Adapter->IsReady()) return;
 
+	// Try to initialize RDG buffers when possible.
+	MIGIRenderingContext::Get().Initialze_RenderThread();
 
-	// Let's check if the path tracing rendering works.
+	// Move on to the next ring slot of the shared buffers, so this frame doesn't wait for the NN work of the last one.
+	// Only the first view of the frame advances, the passes capture the slot by value.
+	Adapter->BeginFrame_RenderThread();
 
 	// RenderPathTracing(GraphBuilder, View, SceneTextures.UniformBuffer, SceneTextures.Color.Target, SceneTextures.Depth.Target,PathTracingResources);
 	FSceneRenderer * SceneRenderer = dynamic_cast<FDeferredShadingSceneRenderer*>(ViewInfo.Family->GetSceneRenderer());
 
 	// MIGI only supports the deferred render path.
 	check(SceneRenderer);
-	
-	MIGIRenderPathTracing(
-		&Scene, GraphBuilder, ViewInfo, SceneRenderer->SceneTextures.UniformBuffer,
-		RenderResources.SceneColor, RenderResources.SceneDepth, RenderResources.PathTracingResources
-		
-	);
 
-	return ;
+	if(IsMIGIPathTracing())
+	{
+		MIGIRenderPathTracing(
+			&Scene, GraphBuilder, ViewInfo, SceneRenderer->SceneTextures.UniformBuffer,
+			RenderResources.SceneColor, RenderResources.SceneDepth, RenderResources.PathTracingResources
+			
+		);
+		return ;
+	}
 	
 	// This function is running on the rendering thread, so it's okay to create FRDGBuffers outside of passes.
 	// Register NN external buffers.
@@ -174,6 +254,59 @@ void MIGIRenderDiffuseIndirect(const FScene& Scene, const FViewInfo& ViewInfo, F
 	FRDGBufferRef NNOutputBufferRDG = GraphBuilder.RegisterExternalBuffer(
 		MIGIRenderingContext::Get().GetNNOutputBufferRDG(), TEXT("MIGINNOutputBuffer"));
 
+	const uint32 InputSlot = Adapter->GetCurrentSlot();
+	// Composite the NN output of the last frame if requested, so the NN work of this frame overlaps with rendering.
+	const bool bCompositeLastFrame = IsMIGICompositeLastFrameNN();
+	const uint32 OutputSlot = bCompositeLastFrame ? Adapter->GetLastSlot() : InputSlot;
+
+	// The queries and the training batch of the frame share a ring slot, more queries than it holds are spread over
+	// the view like a query budget. The default 4 MiB slot holds the queries of about 350x350 pixels.
+	const uint32 SlotQueryCapacity = GetNNSlotQueryCapacity(GetMIGITrainSampleRatio());
+	if(SlotQueryCapacity == 0)
+	{
+		static bool bWarned = false;
+		if(!bWarned)
+		{
+			UE_LOG(MIGI, Warning, TEXT("r.MIGI.SharedBufferSize is too small for a single batch of NN queries, the NN passes are skipped."));
+			bWarned = true;
+		}
+		return;
+	}
+	const int32 QueryBudget = GetMIGIQueryBudget() > 0 ? FMath::Min(GetMIGIQueryBudget(), (int32)SlotQueryCapacity) : (int32)SlotQueryCapacity;
+	uint32 QueryCellSize = 1;
+	bool bQueryJitter = false;
+	const FIntPoint QueryGridSize = GetNNQueryGrid(ViewInfo.ViewRect.Size(), QueryBudget, GetMIGINNResolutionDivisor(), QueryCellSize, bQueryJitter);
+	// tiny-cuda-nn runs whole batches, the padding rows after the query cells are evaluated and never read.
+	// The capacity is in whole batches, so the padding still fits.
+	const uint32 NumQueries = Align(QueryGridSize.X * QueryGridSize.Y, C::NNBatchGranularity);
+	// The reconstruction must use the layout the composited queries were made with, the jitter follows the slot's frame.
+	const uint32 FrameNumber = ViewInfo.Family->FrameNumber;
+	const uint32 OutputFrameNumber = bCompositeLastFrame ? FrameNumber - 1 : FrameNumber;
+
+	// The query threads produce the training data too, so there are never more samples than query cells.
+	// Rounded down to whole batches, every row of the training batch is written.
+	// The rest of the slot after the queries caps them, the capacity leaves the ratio's share but the padding may eat into it.
+	const uint32 NumSlotTrainSamples = (uint32)((IMIGINNAdapter::GetSharedInputSlotSize() / sizeof(float) - (size_t)NumQueries * C::NNInputWidth)
+		/ (C::NNInputWidth + C::NNOutputWidth));
+	const uint32 NumTrainSamples = AlignDown(FMath::Min(
+		(uint32)FMath::FloorToInt((float)(QueryGridSize.X * QueryGridSize.Y) * GetMIGITrainSampleRatio()), NumSlotTrainSamples), C::NNBatchGranularity);
+	// Spread the training samples over the view, tiles where the NN is off the most get more of them.
+	const uint32 TrainTileSize = GetMIGITrainTileSize();
+	const FIntPoint TrainTileGridSize = MIGITrainingSampleSelector::GetTileGridSize(ViewInfo.ViewRect.Size(), TrainTileSize);
+	FMIGINNTrainingImportance & TrainingImportance = MIGIRenderingContext::Get().GetTrainingImportance(ViewInfo);
+	TrainingImportance.Resize(TrainTileGridSize);
+	TrainingImportance.UpdateReadback();
+	FRDGBufferRef TileOffsetsBuffer {};
+	{
+		TArray<float> TileImportance;
+		// A quarter of the uniform share at least.
+		MIGITrainingSampleSelector::GetTileImportance(TrainingImportance.TileLoss, 0.25f, TileImportance);
+		TArray<uint32> TileOffsets;
+		MIGITrainingSampleSelector::AllocateSamples(TileImportance, NumTrainSamples, MIGITrainingSampleSelector::GetFramePhase(FrameNumber), TileOffsets);
+		TileOffsetsBuffer = CreateVertexBuffer(GraphBuilder, TEXT("MIGINNTrainTileOffsets"),
+			FRDGBufferDesc::CreateBufferDesc(sizeof(uint32), TileOffsets.Num()), TileOffsets.GetData(), TileOffsets.Num() * sizeof(uint32));
+	}
+
 	// Input & inference & training
 	{
 		auto ComputeShader = ViewInfo.ShaderMap->GetShader<FMIGINNInputShaderCS>();
@@ -182,56 +315,70 @@ void MIGIRenderDiffuseIndirect(const FScene& Scene, const FViewInfo& ViewInfo, F
 		PassParameters->CommonParameters.TestParam = FVector4f{FMath::FRand(), FMath::FRand(), FMath::FRand(), FMath::FRand()};
         auto UAV = GraphBuilder.CreateUAV(FRDGBufferUAVDesc{NNInputBufferRDG});
         PassParameters->NNInputBuffer = UAV;
-		// TODO set to real inference sample count
-		PassParameters->CommonParameters.NNMaxInferenceSampleSize = ViewInfo.ViewRect.Area();
-		// TODO set to actual train sample count
-		PassParameters->CommonParameters.NNTrainSampleSize = FMath::Floor((float)ViewInfo.ViewRect.Area() * 0.03f);
-
-		// Check the total size of the NN input buffer. Make sure it doesn't exceeds the buffer limit.
+		PassParameters->CommonParameters.NNMaxInferenceSampleSize = NumQueries;
+		PassParameters->CommonParameters.NNTrainSampleSize = NumTrainSamples;
+		PassParameters->CommonParameters.NNTrainTileSize = TrainTileSize;
+		PassParameters->CommonParameters.NNTrainTileGridSize = TrainTileGridSize;
+		PassParameters->NNTrainTileOffsets = GraphBuilder.CreateSRV(TileOffsetsBuffer, PF_R32_UINT);
+		PassParameters->CommonParameters.NNQueryCellSize = QueryCellSize;
+		PassParameters->CommonParameters.NNQueryGridSize = QueryGridSize;
+		PassParameters->CommonParameters.NNQueryFrameIndex = FrameNumber;
+		PassParameters->CommonParameters.NNQueryJitter = bQueryJitter;
+		PassParameters->CommonParameters.NNInputSlotOffset = IMIGINNAdapter::GetInputSlotOffset(InputSlot) / sizeof(float);
+		PassParameters->CommonParameters.NNOutputSlotOffset = IMIGINNAdapter::GetOutputSlotOffset(InputSlot) / sizeof(float);
+
+		// The counts were sized to the slot above.
 		{
-			auto MaxInputBufferSize = C::DefaultSharedBufferSize;
-			auto TrainDataSize = PassParameters->CommonParameters.NNTrainSampleSize * (C::NNInputWidth + C::NNOutputWidth) * sizeof(float);
-			auto InferenceDataSize = PassParameters->CommonParameters.NNMaxInferenceSampleSize * C::NNInputWidth * sizeof(float);
+			auto MaxInputBufferSize = IMIGINNAdapter::GetSharedInputSlotSize();
+			auto TrainDataSize = (size_t)PassParameters->CommonParameters.NNTrainSampleSize * (C::NNInputWidth + C::NNOutputWidth) * sizeof(float);
+			auto InferenceDataSize = (size_t)PassParameters->CommonParameters.NNMaxInferenceSampleSize * C::NNInputWidth * sizeof(float);
 			auto TotalSize = TrainDataSize + InferenceDataSize;
 			check(TotalSize <= MaxInputBufferSize);
+			check((size_t)NumQueries * C::NNOutputWidth * sizeof(float) <= IMIGINNAdapter::GetSharedOutputSlotSize());
 		}
 		
 		GraphBuilder.AddPass( RDG_EVENT_NAME("MIGIRenderDiffuseIndirectNNInput"), PassParameters,
 			ERDGPassFlags::Compute | ERDGPassFlags::NeverCull,
 			// Be VERY VERY CAREFUL when capturing parameters! Especially by REFERENCE!
-			[ComputeShader, PassParameters, ViewRect = ViewInfo.ViewRect](FRHICommandListImmediate& RHICmdList)
+			[ComputeShader, PassParameters, QueryGridSize, InputSlot](FRHICommandListImmediate& RHICmdList)
 			{
-				// Dispatch the compute shader to produce NN queries & training data.
+				auto Adapter = IMIGINNAdapter::GetInstance();
+				// Don't overwrite the slot until CUDA is done with the frame that used it last.
+				Adapter->WaitForSlot(RHICmdList, InputSlot);
+				// Dispatch the compute shader to produce NN queries & training data, one thread per query cell.
 				auto ParameterMetadata = FMIGINNInputShaderCS::FParameters::FTypeInfo::GetStructMetadata();
 				auto NumGroups = FIntVector::DivideAndRoundUp(
-					FIntVector{ViewRect.Width(), ViewRect.Height(), 1},
+					FIntVector{QueryGridSize.X, QueryGridSize.Y, 1},
 					FIntVector{C::ThreadGroupSize2D, C::ThreadGroupSize2D, 1});
 				FComputeShaderUtils::Dispatch(RHICmdList, ComputeShader, ParameterMetadata, *PassParameters, NumGroups);
 				
 				// Synchronize the NN input buffer.
-				auto Adapter = IMIGINNAdapter::GetInstance();
 				Adapter->SynchronizeToNN(RHICmdList);
 				// IMPORTANT: Flush queued RHI commands to the GPU.
 				// MIGINNInference() possibly allocates GPU memory, which results in the calling of cudaDeviceWaitIdle()
 				// Thus it's possible to run into a deadlock if the signal RHI command has not been submitted yet.
 				RHICmdList.SubmitCommandsHint();
 				// Schedule NN inference.
+				auto InputSlotOffset = IMIGINNAdapter::GetInputSlotOffset(InputSlot);
 				auto InferenceParams = MIGINNInferenceParams {
-					.InInputBufferOffset = 0,
-					.InOutputBufferOffset = 0,
+					.InInputBufferOffset = InputSlotOffset,
+					.InOutputBufferOffset = IMIGINNAdapter::GetOutputSlotOffset(InputSlot),
 					.InNumElements = PassParameters->CommonParameters.NNMaxInferenceSampleSize
 				};
 				// Requires a NN inference
 				MIGINNInference(InferenceParams);
 				// Requires a NN training step
-				auto TrainInputBufferOffset = PassParameters->CommonParameters.NNMaxInferenceSampleSize * C::NNInputWidth * sizeof(float);
+				auto TrainInputBufferOffset = InputSlotOffset + PassParameters->CommonParameters.NNMaxInferenceSampleSize * C::NNInputWidth * sizeof(float);
 				auto TrainTargetBufferOffset = TrainInputBufferOffset + PassParameters->CommonParameters.NNTrainSampleSize * C::NNInputWidth * sizeof(float);
 				auto TrainParams = MIGINNTrainNetworkParams {
 					.InInputBufferOffset = TrainInputBufferOffset,
 					.InInputBufferTargetOffset = TrainTargetBufferOffset,
 					.InNumElements = PassParameters->CommonParameters.NNTrainSampleSize
 				};
-				MIGINNTrainNetwork(TrainParams);
+				if(TrainParams.InNumElements > 0)
+				{
+					MIGINNTrainNetwork(TrainParams);
+				}
 			}
 		);
 	}
@@ -241,14 +388,21 @@ void MIGIRenderDiffuseIndirect(const FScene& Scene, const FViewInfo& ViewInfo, F
 		PassParameters->View = ViewInfo.GetShaderParameters().View;
 		PassParameters->NNOutputBuffer = GraphBuilder.CreateSRV(NNOutputBufferRDG, PF_R32_FLOAT);
 		PassParameters->ColorBuffer = GraphBuilder.CreateUAV(FRDGTextureUAVDesc{RenderResources.SceneColor});
+		PassParameters->CommonParameters.NNOutputSlotOffset = IMIGINNAdapter::GetOutputSlotOffset(OutputSlot) / sizeof(float);
+		PassParameters->CommonParameters.NNQueryCellSize = QueryCellSize;
+		PassParameters->CommonParameters.NNQueryGridSize = QueryGridSize;
+		PassParameters->CommonParameters.NNQueryFrameIndex = OutputFrameNumber;
+		PassParameters->CommonParameters.NNQueryJitter = bQueryJitter;
+		// Depth & normals steer the reconstruction of sparse queries, see MIGIJointBilateralUpsample.h for the reference.
+		PassParameters->SceneTexturesStruct = SceneRenderer->SceneTextures.UniformBuffer;
 		auto ComputeShader = ViewInfo.ShaderMap->GetShader<FMIGINNOutputShaderCS>();
 		GraphBuilder.AddPass( RDG_EVENT_NAME("MIGIRenderDiffuseIndirectNNOutput"), PassParameters,
 			ERDGPassFlags::Compute | ERDGPassFlags::NeverCull,
-			[ComputeShader, PassParameters, ViewRect = ViewInfo.ViewRect] (FRHICommandListImmediate& RHICmdList)
+			[ComputeShader, PassParameters, ViewRect = ViewInfo.ViewRect, bCompositeLastFrame, InputSlot] (FRHICommandListImmediate& RHICmdList)
 			{
 				// Synchronize from the NN output buffer.
              	auto Adapter = IMIGINNAdapter::GetInstance();
-             	Adapter->SynchronizeFromNN(RHICmdList);
+             	Adapter->SynchronizeFromNN(RHICmdList, InputSlot, bCompositeLastFrame);
 				
 				// Dispatch the compute shader to produce NN inputs.
 				auto ParameterMetadata = FMIGINNOutputShaderCS::FParameters::FTypeInfo::GetStructMetadata();
@@ -261,4 +415,50 @@ void MIGIRenderDiffuseIndirect(const FScene& Scene, const FViewInfo& ViewInfo, F
 			}
 		);
 	}
+
+	// Measure the loss of the composited output per tile, one readback in flight. The pass follows the output pass,
+	// which already waited for the NN work of the slot.
+	FRDGBufferRef LossTileOffsets = TileOffsetsBuffer;
+	if(bCompositeLastFrame)
+	{
+		LossTileOffsets = TrainingImportance.LastTileOffsets.IsValid() ? GraphBuilder.RegisterExternalBuffer(TrainingImportance.LastTileOffsets) : nullptr;
+	}
+	if(LossTileOffsets && NumTrainSamples > 0 && !TrainingImportance.bReadbackPending)
+	{
+		const uint32 NumTiles = TrainTileGridSize.X * TrainTileGridSize.Y;
+		FRDGBufferRef TileLossBuffer = GraphBuilder.CreateBuffer(
+			FRDGBufferDesc::CreateBufferDesc(sizeof(uint32), NumTiles * 2), TEXT("MIGINNTrainTileLoss"));
+		FRDGBufferUAVRef TileLossUAV = GraphBuilder.CreateUAV(TileLossBuffer, PF_R32_UINT);
+		AddClearUAVPass(GraphBuilder, TileLossUAV, 0u);
+
+		auto ComputeShader = ViewInfo.ShaderMap->GetShader<FMIGINNTrainLossShaderCS>();
+		auto PassParameters = GraphBuilder.AllocParameters<FMIGINNTrainLossShaderCS::FParameters>();
+		PassParameters->View = ViewInfo.GetShaderParameters().View;
+		PassParameters->NNInputBuffer = GraphBuilder.CreateUAV(FRDGBufferUAVDesc{NNInputBufferRDG});
+		PassParameters->NNOutputBuffer = GraphBuilder.CreateSRV(NNOutputBufferRDG, PF_R32_FLOAT);
+		PassParameters->NNTrainTileOffsets = GraphBuilder.CreateSRV(LossTileOffsets, PF_R32_UINT);
+		PassParameters->NNTrainTileLoss = TileLossUAV;
+		PassParameters->CommonParameters.NNMaxInferenceSampleSize = NumQueries;
+		PassParameters->CommonParameters.NNTrainSampleSize = NumTrainSamples;
+		PassParameters->CommonParameters.NNTrainTileSize = TrainTileSize;
+		PassParameters->CommonParameters.NNTrainTileGridSize = TrainTileGridSize;
+		PassParameters->CommonParameters.NNQueryCellSize = QueryCellSize;
+		PassParameters->CommonParameters.NNQueryGridSize = QueryGridSize;
+		PassParameters->CommonParameters.NNQueryFrameIndex = OutputFrameNumber;
+		PassParameters->CommonParameters.NNQueryJitter = bQueryJitter;
+		PassParameters->CommonParameters.NNInputSlotOffset = IMIGINNAdapter::GetInputSlotOffset(OutputSlot) / sizeof(float);
+		PassParameters->CommonParameters.NNOutputSlotOffset = IMIGINNAdapter::GetOutputSlotOffset(OutputSlot) / sizeof(float);
+		FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("MIGIRenderDiffuseIndirectNNTrainLoss"), ComputeShader, PassParameters,
+			FComputeShaderUtils::GetGroupCount((int32)NumTrainSamples, C::ThreadGroupSize1D));
+
+		if(!TrainingImportance.LossReadback.IsValid())
+		{
+			TrainingImportance.LossReadback = MakeUnique<FRHIGPUBufferReadback>(TEXT("MIGINNTrainTileLossReadback"));
+		}
+		AddEnqueueCopyPass(GraphBuilder, TrainingImportance.LossReadback.Get(), TileLossBuffer, NumTiles * 2 * sizeof(uint32));
+		TrainingImportance.bReadbackPending = true;
+		TrainingImportance.ReadbackTileGridSize = TrainTileGridSize;
+	}
+	// Composited next frame, the samples of this frame are measured then.
+	TrainingImportance.LastTileOffsets = GraphBuilder.ConvertToExternalBuffer(TileOffsetsBuffer);
 }
@@ -0,0 +1,78 @@
+﻿#include "MIGIDispatchSizeTuner.h"
+
+#include "Async/Async.h"
+#include "Misc/ConfigCacheIni.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "RHIGlobals.h"
+
+// Next to the project's other saved state, so every project keeps its own.
+static FString GetDispatchSizeFilename()
+{
+	return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("MIGI"), TEXT("DispatchSize.ini"));
+}
+
+// One section per GPU and driver, the driver moves the timings as much as the GPU does.
+static FString GetDispatchSizeSection()
+{
+	return FString::Printf(TEXT("%s %04x:%04x %s"), *GRHIAdapterName, GRHIVendorId, GRHIDeviceId, *GRHIAdapterUserDriverVersion);
+}
+
+static FString GetDispatchSizeKey(FIntPoint ViewSize)
+{
+	return FString::Printf(TEXT("%dx%d"), ViewSize.X, ViewSize.Y);
+}
+
+// The sizes of every GPU and view size tuned so far. Only touched by the render thread, the file is read the first time
+// and written back off it.
+struct FDispatchSizeFile
+{
+	FConfigFile File;
+	bool bRead = false;
+	// The last write, the next one waits for it so they land in order.
+	TFuture<void> WriteTask;
+};
+static FDispatchSizeFile GDispatchSizeFile;
+
+static FConfigFile & GetDispatchSizes()
+{
+	if(!GDispatchSizeFile.bRead)
+	{
+		GDispatchSizeFile.File.Read(GetDispatchSizeFilename());
+		GDispatchSizeFile.bRead = true;
+	}
+	return GDispatchSizeFile.File;
+}
+
+int32 MIGILoadDispatchSize(FIntPoint ViewSize)
+{
+	int32 Size = 0;
+	GetDispatchSizes().GetInt(*GetDispatchSizeSection(), *GetDispatchSizeKey(ViewSize), Size);
+	return Size;
+}
+
+void MIGISaveDispatchSize(FIntPoint ViewSize, int32 Size)
+{
+	const FString Filename = GetDispatchSizeFilename();
+	FConfigFile & File = GetDispatchSizes();
+	File.SetInt64(*GetDispatchSizeSection(), *GetDispatchSizeKey(ViewSize), Size);
+	FString Text;
+	File.WriteToString(Text, Filename);
+	GDispatchSizeFile.WriteTask = Async(EAsyncExecution::ThreadPool,
+		[Filename, Text = MoveTemp(Text), PreviousWrite = MoveTemp(GDispatchSizeFile.WriteTask)]()
+		{
+			if(PreviousWrite.IsValid())
+			{
+				PreviousWrite.Wait();
+			}
+			FFileHelper::SaveStringToFile(Text, *Filename);
+		});
+}
+
+void MIGIFlushDispatchSizes()
+{
+	if(GDispatchSizeFile.WriteTask.IsValid())
+	{
+		GDispatchSizeFile.WriteTask.Wait();
+	}
+}
@@ -0,0 +1,128 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+// Tuning of the path tracer's dispatch tile size from the tile timings of FMIGITileScheduler. Small tiles pay the
+// fixed cost of their passes over and over, large ones hitch or trip the GPU watchdog. The tuner fits
+// Ms = Overhead + CostPerPixel * NumPixels to the timings, sizes the tiles so they take TargetMs, and stops once the
+// size settles. The result is saved per GPU and resolution in the project's Saved directory, the next session starts
+// from it. Only depends on the timings it is fed, so synthetic ones exercise it too.
+class FMIGIDispatchSizeTuner
+{
+public:
+	struct FSettings
+	{
+		float TargetMs = 16.f;
+		int32 MinSize = 64;
+		int32 MaxSize = 4096;
+		// Sizes are multiples of it.
+		int32 Granularity = 32;
+		// Timings at the current size before the next one is picked.
+		int32 TimingsPerRound = 4;
+		// Gives up on a size that keeps moving, noisy timings would never settle.
+		int32 MaxRounds = 12;
+	};
+
+	void Start (const FSettings & InSettings, int32 InitialSize)
+	{
+		Settings = InSettings;
+		Size = ClampSize(InitialSize);
+		bConverged = false;
+		NumRounds = NumRoundTimings = NumStableRounds = 0;
+		NumTimings = 0;
+		SumX = SumY = SumXX = SumXY = 0.0;
+	}
+
+	// A tile of NumPixels, from a tiling of TileSize, took Ms. All timings go into the fit, only the ones at the current
+	// size count towards the next round. True on the timing the size converges on.
+	bool AddTiming (int32 TileSize, int32 NumPixels, float Ms)
+	{
+		if(bConverged || NumPixels <= 0 || Ms <= 0.f)
+		{
+			return false;
+		}
+		NumTimings++;
+		SumX += NumPixels;
+		SumY += Ms;
+		SumXX += (double)NumPixels * NumPixels;
+		SumXY += (double)NumPixels * Ms;
+		if(TileSize != Size || ++NumRoundTimings < Settings.TimingsPerRound)
+		{
+			return false;
+		}
+		NumRoundTimings = 0;
+		NumRounds++;
+
+		const int32 NewSize = ClampSize(ComputeSize());
+		// Settled once two rounds in a row land within a step of the size before.
+		NumStableRounds = FMath::Abs(NewSize - Size) <= Settings.Granularity ? NumStableRounds + 1 : 0;
+		Size = NewSize;
+		bConverged = NumStableRounds >= 2 || NumRounds >= Settings.MaxRounds;
+		return bConverged;
+	}
+
+	int32 GetSize () const { return Size; }
+	bool IsConverged () const { return bConverged; }
+	const FSettings & GetSettings () const { return Settings; }
+
+	// Least squares fit of the timings so far. Without enough spread in tile sizes, all of it is per pixel and false
+	// is returned.
+	bool FitCost (float & OutOverheadMs, float & OutCostPerPixelMs) const
+	{
+		// Variance of the pixel counts relative to their squared mean, the edge tiles of a single size barely move it.
+		const double Denominator = NumTimings * SumXX - SumX * SumX;
+		double Overhead = 0.0;
+		double CostPerPixel = SumX > 0.0 ? SumY / SumX : 0.0;
+		bool bSpread = false;
+		if(NumTimings >= 2 && Denominator > 0.1 * SumX * SumX)
+		{
+			const double Slope = (NumTimings * SumXY - SumX * SumY) / Denominator;
+			if(Slope > 0.0)
+			{
+				CostPerPixel = Slope;
+				Overhead = (SumY - Slope * SumX) / NumTimings;
+				bSpread = true;
+			}
+		}
+		// A negative overhead is noise. Past half the target, tiles can only take the rest.
+		OutOverheadMs = (float)FMath::Clamp(Overhead, 0.0, 0.5 * Settings.TargetMs);
+		OutCostPerPixelMs = (float)CostPerPixel;
+		return bSpread;
+	}
+
+private:
+	int32 ComputeSize () const
+	{
+		float Overhead, CostPerPixel;
+		if(!FitCost(Overhead, CostPerPixel))
+		{
+			// All timings from one size: probe another one to tell the overhead from the cost per pixel.
+			return Size * 2 <= Settings.MaxSize ? Size * 2 : Size / 2;
+		}
+		return (int32)FMath::Sqrt((Settings.TargetMs - Overhead) / CostPerPixel);
+	}
+
+	int32 ClampSize (int32 InSize) const
+	{
+		return FMath::Clamp(InSize / Settings.Granularity * Settings.Granularity, Settings.MinSize, Settings.MaxSize);
+	}
+
+	FSettings Settings;
+	int32 Size = 0;
+	bool bConverged = false;
+	int32 NumRounds = 0;
+	int32 NumRoundTimings = 0;
+	int32 NumStableRounds = 0;
+	int32 NumTimings = 0;
+	double SumX = 0.0;
+	double SumY = 0.0;
+	double SumXX = 0.0;
+	double SumXY = 0.0;
+};
+
+// Tuned size saved for this GPU and view size, 0 when there is none. The file is only read by the first call.
+int32 MIGILoadDispatchSize (FIntPoint ViewSize);
+// Written back on the thread pool.
+void MIGISaveDispatchSize (FIntPoint ViewSize, int32 Size);
+// Wait for the pending writes of MIGISaveDispatchSize.
+void MIGIFlushDispatchSizes ();
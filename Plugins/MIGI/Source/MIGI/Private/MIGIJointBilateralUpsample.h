@@ -0,0 +1,87 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+// CPU reference of the joint bilateral upsampling done by NNOutput in NNInterface.usf.
+// Keep both in sync: same query pixels, same weights, same fallback.
+namespace MIGIJointBilateralUpsample
+{
+	// Per full resolution pixel guide, read from the GBuffer on the GPU.
+	struct FGuide
+	{
+		float Depth;
+		FVector3f Normal;
+	};
+
+	// Relative depth difference that drops a query's weight to 1/e.
+	constexpr float DepthSigma = 0.05f;
+	constexpr float NormalPower = 8.f;
+
+	// The pixel queried by an unjittered cell.
+	inline FIntPoint GetQueryPixel (FIntPoint Cell, uint32 CellSize, FIntPoint ViewSize)
+	{
+		return FIntPoint(
+			FMath::Min(Cell.X * (int32)CellSize + (int32)CellSize / 2, ViewSize.X - 1),
+			FMath::Min(Cell.Y * (int32)CellSize + (int32)CellSize / 2, ViewSize.Y - 1));
+	}
+
+	// How much a query taken on Query may stand for Pixel.
+	inline float GetGuideWeight (const FGuide & Pixel, const FGuide & Query)
+	{
+		const float DepthWeight = FMath::Exp(-FMath::Abs(Query.Depth - Pixel.Depth) / FMath::Max(Pixel.Depth * DepthSigma, 1e-3f));
+		const float NormalWeight = FMath::Pow(FMath::Clamp(FVector3f::DotProduct(Query.Normal, Pixel.Normal), 0.f, 1.f), NormalPower);
+		return DepthWeight * NormalWeight;
+	}
+
+	// Bilinear weights of the 2x2 cells around the pixel, times the guide weights.
+	// Falls back to the cell with the largest bilinear weight when every query is on another surface.
+	inline FLinearColor UpsamplePixel (const TArray<FLinearColor> & Queries, FIntPoint GridSize, uint32 CellSize,
+	                                   const TArray<FGuide> & Guides, FIntPoint ViewSize, FIntPoint PixelCoord)
+	{
+		const FGuide & Pixel = Guides[PixelCoord.Y * ViewSize.X + PixelCoord.X];
+		// Query pixels sit at the cell centres.
+		const FVector2f Position = (FVector2f(PixelCoord) + 0.5f) / (float)CellSize - 0.5f;
+		const FIntPoint Base(FMath::FloorToInt(Position.X), FMath::FloorToInt(Position.Y));
+		const FVector2f Fraction = Position - FVector2f(Base);
+		FLinearColor Sum = FLinearColor::Transparent;
+		float WeightSum = 0.f;
+		FLinearColor Nearest = FLinearColor::Transparent;
+		float NearestWeight = -1.f;
+		for(int32 y = 0; y <= 1; y++)
+		{
+			for(int32 x = 0; x <= 1; x++)
+			{
+				const FIntPoint Cell(
+					FMath::Clamp(Base.X + x, 0, GridSize.X - 1),
+					FMath::Clamp(Base.Y + y, 0, GridSize.Y - 1));
+				const float Bilinear = (x ? Fraction.X : 1.f - Fraction.X) * (y ? Fraction.Y : 1.f - Fraction.Y);
+				const FIntPoint QueryPixel = GetQueryPixel(Cell, CellSize, ViewSize);
+				const FLinearColor & Query = Queries[Cell.Y * GridSize.X + Cell.X];
+				const float Weight = Bilinear * GetGuideWeight(Pixel, Guides[QueryPixel.Y * ViewSize.X + QueryPixel.X]);
+				Sum += Query * Weight;
+				WeightSum += Weight;
+				if(Bilinear > NearestWeight)
+				{
+					NearestWeight = Bilinear;
+					Nearest = Query;
+				}
+			}
+		}
+		return WeightSum > 1e-4f ? Sum / WeightSum : Nearest;
+	}
+
+	// Upsample a grid of query results (GridSize, row-major) to the view.
+	inline void Upsample (const TArray<FLinearColor> & Queries, FIntPoint GridSize, uint32 CellSize,
+	                      const TArray<FGuide> & Guides, FIntPoint ViewSize, TArray<FLinearColor> & OutColors)
+	{
+		check(Queries.Num() == GridSize.X * GridSize.Y && Guides.Num() == ViewSize.X * ViewSize.Y);
+		OutColors.SetNumUninitialized(ViewSize.X * ViewSize.Y);
+		for(int32 y = 0; y < ViewSize.Y; y++)
+		{
+			for(int32 x = 0; x < ViewSize.X; x++)
+			{
+				OutColors[y * ViewSize.X + x] = UpsamplePixel(Queries, GridSize, CellSize, Guides, ViewSize, FIntPoint(x, y));
+			}
+		}
+	}
+}
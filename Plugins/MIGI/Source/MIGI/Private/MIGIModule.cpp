@@ -7,7 +7,9 @@
 #include "MIGILogCategory.h"
 #include "MIGINNAdapter.h"
 
+#include "MIGIConfig.h"
 #include "MIGIConstants.h"
+#include "MIGIDispatchSizeTuner.h"
 #include "MIGIPT.h"
 #include "MIGIViewExtension.h"
 #include "MIGIViewUniformBufferExtension.h"
@@ -32,7 +34,7 @@ void FMIGIModule::StartupModule()
 	
 	// Initialize and check for RHI-CUDA synchronization support.
 	IMIGINNAdapter::Clear();
-	IMIGINNAdapter::Install(C::DefaultSharedBufferSize, C::DefaultSharedBufferSize);
+	IMIGINNAdapter::Install(GetMIGISharedBufferSize(), GetMIGISharedBufferSize(), C::NNFramesInFlight);
 	
 	// Callback when the adapter is activated.
 	IMIGINNAdapter::OnAdapterActivated.AddLambda([this](){ActivateMIGI();});
@@ -73,6 +75,8 @@ void FMIGIModule::ShutdownModule()
 	}
 	// Clear adapters
 	IMIGINNAdapter::Clear();
+	// The writes run code of this module.
+	MIGIFlushDispatchSizes();
 
 }
 
@@ -1,5 +1,6 @@
 ﻿#include "MIGINNAdapter.h"
 
+#include "MIGIConfig.h"
 #include "MIGILogCategory.h"
 #include "Adapters/MIGINNAdapterD3D12.h"
 
@@ -10,12 +11,15 @@ static TUniquePtr<IMIGINNAdapter> AdapterSelected;
 FSimpleMulticastDelegate IMIGINNAdapter::OnAdapterActivated;
 size_t IMIGINNAdapter::SharedInputBufferSize;
 size_t IMIGINNAdapter::SharedOutputBufferSize;
+uint32 IMIGINNAdapter::NumSlots {1};
 
 // This function is executed in the PreEarlyStartupScreen phase.
-void IMIGINNAdapter::Install(size_t InSharedInputBufferSize, size_t InSharedOutputBufferSize)
+void IMIGINNAdapter::Install(size_t InSharedInputBufferSize, size_t InSharedOutputBufferSize, uint32 InNumSlots)
 {
+	check(InNumSlots > 0);
 	SharedInputBufferSize = InSharedInputBufferSize;
 	SharedOutputBufferSize = InSharedOutputBufferSize;
+	NumSlots = InNumSlots;
 	// SyncUtilsVulkan = MakeUnique<FMIGICUDAAdapterVulkan>();
 	// SyncUtilsVulkan->InstallRHIConfigurations();
 	AdapterD3D12 = MakeUnique<FMIGICUDAAdapterD3D12>();
@@ -46,6 +50,31 @@ void IMIGINNAdapter::TryActivate()
 }
 
 
+void IMIGINNAdapter::Update_RenderThread(FRHICommandListImmediate& RHICmd, bool bMIGIEnabled)
+{
+	check(IsInRenderingThread());
+	// Users who never turn MIGI on never pay for the CUDA context creation.
+	if(bMIGIEnabled && ActivityState == EMIGINNAdapterState::Inactive)
+	{
+		UE_LOG(MIGI, Display, TEXT("MIGI enabled, initializing MIGINN in the background."));
+		ActivityState = EMIGINNAdapterState::Initializing;
+		Initialize_RenderThread(RHICmd);
+	}
+	// Give the VRAM back while GI is off.
+	else if(!bMIGIEnabled && ActivityState == EMIGINNAdapterState::Ready && IsMIGISuspendWhenDisabled())
+	{
+		if(Suspend_RenderThread(RHICmd))
+		{
+			ActivityState = EMIGINNAdapterState::Suspended;
+		}
+	}
+	else if(bMIGIEnabled && ActivityState == EMIGINNAdapterState::Suspended)
+	{
+		ActivityState = EMIGINNAdapterState::Initializing;
+		Resume_RenderThread(RHICmd);
+	}
+}
+
 IMIGINNAdapter* IMIGINNAdapter::GetInstance ()
 {
 	return AdapterSelected.Get();
@@ -4,10 +4,26 @@
 #define MIGI_SYNC_UTILS_H
 #include "CoreMinimal.h"
 
+#include <atomic>
+
+enum class EMIGINNAdapterState : uint8
+{
+	// Selected, but CUDA and the network are not initialized yet.
+	Inactive,
+	// The initialization task is running.
+	Initializing,
+	Ready,
+	// NN GPU memory released while MIGI is disabled, the weights live in host memory.
+	Suspended,
+	// Initialization failed, don't retry.
+	Failed
+};
+
 class IMIGINNAdapter : public FNoncopyable
 {
 public:
-	static void Install (size_t InSharedInputBufferSize, size_t InSharedOutputBufferSize) ;
+	// The shared buffers are split into InNumSlots ring slots of the given sizes, one per frame in flight.
+	static void Install (size_t InSharedInputBufferSize, size_t InSharedOutputBufferSize, uint32 InNumSlots = 1) ;
 	static IMIGINNAdapter * GetInstance ();
 	// Called when the module shuts down.
 	static void Clear ();
@@ -15,23 +31,50 @@ public:
 	inline bool IsReady () const
 	{
 		check(IsInRenderingThread());
-		return bReady;
+		return ActivityState == EMIGINNAdapterState::Ready;
 	}
+	// Called every frame on the render thread.
+	// Kicks off the CUDA & network initialization the first time MIGI is enabled.
+	// Suspends the adapter when MIGI gets disabled and resumes it when it's enabled again.
+	void Update_RenderThread (FRHICommandListImmediate & RHICmd, bool bMIGIEnabled) ;
 	// Modify RHI configurations to allow fine-grained CUDA synchronization.
 	// Called before the initialization of GDynamicRHI creation, but after the loading phase of RHI module.
 	virtual bool InstallRHIConfigurations () = 0;
 	
+	// Advance to the next ring slot before any NN pass is added. Only the first call of a frame advances,
+	// so every view and every pass of the frame share its slot.
+	virtual void BeginFrame_RenderThread () = 0;
+	// Insert a semaphore to wait for (on GPU) until CUDA is done with the slot, so it can be overwritten.
+	// The slot is the one the pass was recorded for: passes run after the ring may have moved on.
+	virtual void WaitForSlot (FRHICommandList & RHICmdList, uint32 Slot) = 0;
 	// Insert a semaphore here. Signal CUDA when the commands submitted are completed.
 	virtual void SynchronizeToNN (FRHICommandList & RHICmdList) = 0;
-	// Insert a semaphore to wait for (on GPU) for the succeeding commands.
-	virtual void SynchronizeFromNN (FRHICommandList & RHICmdList) = 0;
+	// Insert a semaphore to wait for (on GPU) for the succeeding commands. Marks the end of the NN work queued for the slot.
+	// With bLastFrame set, only wait for the NN work of the slot before it, whose output is then read instead.
+	virtual void SynchronizeFromNN (FRHICommandList & RHICmdList, uint32 Slot, bool bLastFrame = false) = 0;
+	// Marks the end of the NN work queued for the slot after SynchronizeFromNN, like a training step reading its inputs.
+	// Doesn't wait, the next WaitForSlot on the slot does.
+	virtual void ReleaseSlot (uint32 Slot) = 0;
 
 	// Get the shared memory among RHI and CUDA.
 	virtual FRHIBuffer * GetSharedInputBuffer () const = 0;
 	virtual FRHIBuffer * GetSharedOutputBuffer () const = 0;
 
-	inline static size_t GetSharedInputBufferSize () {return SharedInputBufferSize;}
-	inline static size_t GetSharedOutputBufferSize () {return SharedOutputBufferSize;}
+	// Total sizes of the shared buffers, all slots included.
+	inline static size_t GetSharedInputBufferSize () {return SharedInputBufferSize * NumSlots;}
+	inline static size_t GetSharedOutputBufferSize () {return SharedOutputBufferSize * NumSlots;}
+	// Sizes of a single ring slot.
+	inline static size_t GetSharedInputSlotSize () {return SharedInputBufferSize;}
+	inline static size_t GetSharedOutputSlotSize () {return SharedOutputBufferSize;}
+	inline static uint32 GetNumSlots () {return NumSlots;}
+
+	// The slot used by the current frame, and the one used by the previous frame.
+	inline uint32 GetCurrentSlot () const {return CurrentSlot;}
+	inline uint32 GetLastSlot () const {return GetPreviousSlot(CurrentSlot);}
+	inline static uint32 GetPreviousSlot (uint32 Slot) {return (Slot + NumSlots - 1) % NumSlots;}
+	// Byte offsets of a slot inside the shared buffers.
+	inline static size_t GetInputSlotOffset (uint32 Slot) {return Slot * SharedInputBufferSize;}
+	inline static size_t GetOutputSlotOffset (uint32 Slot) {return Slot * SharedOutputBufferSize;}
 
 	// Also disable move semantics.
 	IMIGINNAdapter (IMIGINNAdapter &&) = delete;
@@ -51,10 +94,22 @@ protected:
 	// Activate the RHI-CUDA synchronization utility object for the active RHI.
 	// Ensures that CUDA is loaded and CanActive returns true.
 	virtual void Activate () = 0;
+	// Create the shared resources and launch the asynchronous CUDA initialization.
+	// The implementation sets ActivityState to Ready or Failed when it's done.
+	virtual void Initialize_RenderThread (FRHICommandListImmediate & RHICmd) = 0;
+	// Release the shared buffers and all NN device memory. The weights are kept in host memory.
+	// Returns false, with the adapter left untouched and still ready, if the weights could not be spilled.
+	virtual bool Suspend_RenderThread (FRHICommandListImmediate & RHICmd) = 0;
+	// Re-create the shared buffers and restore the network. Sets ActivityState like the initialization.
+	virtual void Resume_RenderThread (FRHICommandListImmediate & RHICmd) = 0;
 	IMIGINNAdapter () = default;
 
 	static size_t SharedInputBufferSize;
 	static size_t SharedOutputBufferSize;
-	bool bReady {};
+	static uint32 NumSlots;
+	uint32 CurrentSlot {};
+	// GFrameCounterRenderThread when CurrentSlot was last advanced.
+	uint64 CurrentSlotFrame {MAX_uint64};
+	std::atomic<EMIGINNAdapterState> ActivityState {EMIGINNAdapterState::Inactive};
 };
 #endif // MIGI_SYNC_UTILS_H
\ No newline at end of file
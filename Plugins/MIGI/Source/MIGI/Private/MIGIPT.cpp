@@ -28,6 +28,13 @@
 
 // My hack to get internal CVars of the unreal path tracer.
 #include "MIGIPathTracingCVar_Hack.h"
+#include "MIGIAdaptiveSampling.h"
+#include "MIGIDispatchSizeTuner.h"
+#include "MIGIPackedPathState.h"
+#include "MIGIPathCompaction.h"
+#include "MIGIPathTracingFormats.h"
+#include "MIGIRadianceCache.h"
+#include "MIGITileScheduler.h"
 
 BEGIN_SHADER_PARAMETER_STRUCT(FPathTracingData, )
 	SHADER_PARAMETER(float, BlendFactor)
@@ -172,6 +179,11 @@ struct FPathTracingState {
 	TRefCountPtr<IPooledRenderTarget> AlbedoRT;
 	TRefCountPtr<IPooledRenderTarget> NormalRT;
 	TRefCountPtr<FRDGPooledBuffer> VarianceBuffer;
+	FMIGIAdaptiveSamplingState AdaptiveSampling;
+	FMIGITileScheduler TileScheduler;
+	FMIGIDispatchSizeTuner DispatchSizeTuner;
+	// The tuner restarts when it changes.
+	FIntPoint DispatchSizeTuningViewSize = FIntPoint::ZeroValue;
 
 	// Cache to improve the stability when frame denoising (SPP=r.pathtracing.SamplesPerPixel) is used in animation rendering
 	TRefCountPtr<IPooledRenderTarget> LastDenoisedRadianceRT;
@@ -193,6 +205,8 @@ struct FPathTracingState {
 
 	// Current sample index to be rendered by the path tracer - this gets incremented each time the path tracer accumulates a frame of samples
 	uint32 SampleIndex = 0;
+	// Samples per pixel of the iteration in progress, kept until it ends, see r.MIGI.PathTracing.SamplesPerLaunch
+	uint32 LaunchSamples = 1;
 
 	// Path tracer frame index, not reset on invalidation unlike SampleIndex to avoid
 	// the "screen door" effect and reduce temporal aliasing
@@ -505,7 +519,9 @@ class FPathTracingRG : public FGlobalShader
 
 	class FCompactionType : SHADER_PERMUTATION_INT("PATH_TRACER_USE_COMPACTION", 2);
 	class FStrataComplexSpecialMaterial : SHADER_PERMUTATION_BOOL("PATH_TRACER_USE_STRATA_SPECIAL_COMPLEX_MATERIAL");
-	using FPermutationDomain = TShaderPermutationDomain<FCompactionType, FStrataComplexSpecialMaterial>;
+	// Terminate paths into the NN radiance cache, see MIGIRadianceCache.h.
+	class FRadianceCache : SHADER_PERMUTATION_BOOL("MIGI_RADIANCE_CACHE");
+	using FPermutationDomain = TShaderPermutationDomain<FCompactionType, FStrataComplexSpecialMaterial, FRadianceCache>;
 
 	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
 	{
@@ -571,15 +587,20 @@ class FPathTracingRG : public FGlobalShader
 
 		// extra parameters required for path compacting kernel
 		SHADER_PARAMETER(int, Bounce)
-		SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<FPathTracingPackedPathState>, PathStateData)
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<FUintVector4>, PathStateData)
+		SHADER_PARAMETER(uint32, PathStatePlaneSize)
 		SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<int>, ActivePaths)
-		SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<int>, NextActivePaths)
-		SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<int>, NumPathStates)
+		SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<int>, PathSurvivors)
+
+		SHADER_PARAMETER(uint32, SamplesPerLaunch)
 
 		RDG_BUFFER_ACCESS(PathTracingIndirectArgs, ERHIAccess::IndirectArgs | ERHIAccess::SRVCompute)
+
+		SHADER_PARAMETER_STRUCT_INCLUDE(FMIGIRadianceCachePathParameters, RadianceCacheParameters)
+		SHADER_PARAMETER_STRUCT_INCLUDE(FMIGIAdaptiveSamplingPathParameters, AdaptiveSamplingParameters)
 	END_SHADER_PARAMETER_STRUCT()
 };
-IMPLEMENT_GLOBAL_SHADER(FPathTracingRG, "/Engine/Private/PathTracing/PathTracing.usf", "PathTracingMainRG", SF_RayGen);
+IMPLEMENT_GLOBAL_SHADER(FPathTracingRG, "/Plugin/MIGI/Private/MIGISimpleDiffuseRayTracing.usf", "PathTracingMainRG", SF_RayGen);
 
 class FPathTracingInitExtinctionCoefficientRG : public FGlobalShader
 {
@@ -1121,36 +1142,99 @@ FRHIRayTracingShader* GetGPULightmassDefaultHiddenHitShader(const FGlobalShaderM
 	return ShaderMap->GetShader<FGPULightmassDefaultHiddenHitGroup>().GetRayTracingShader();
 }
 
-// TODO use FMIGIViewExtension to track these.
-TArray<TPair<uint32, FPathTracingState*> > GPathTracingStates;
+// Path tracing states of the views, keyed by view key.
+// Views come and go (thumbnails, scene captures, editor viewports), so the states of views not rendered for a while
+// are released, and the least recently used ones go first when all of them take more than the budget.
+struct FPathTracingStateEntry
+{
+	TUniquePtr<FPathTracingState> State;
+	uint32 LastUsedFrame = 0;
+};
+TMap<uint32, FPathTracingStateEntry> GPathTracingStates;
 
 TRefCountPtr<IPooledRenderTarget> GSceneSkylightTexture;
 TRefCountPtr<IPooledRenderTarget> GSceneSkylightPdf;
 
 FLinearColor GSceneSkylightColor;
 
-static bool IsViewHasPathTracingState (const FViewInfo & View) {
-	for(auto & e : GPathTracingStates)
+// GPU memory held by a state between frames.
+static uint64 GetPathTracingStateMemorySize(const FPathTracingState & State)
+{
+	uint64 Size = 0;
+	for (const TRefCountPtr<IPooledRenderTarget>* Target : {
+		&State.RadianceRT, &State.AlbedoRT, &State.NormalRT,
+		&State.LastDenoisedRadianceRT, &State.LastRadianceRT, &State.LastNormalRT, &State.LastAlbedoRT,
+		&State.AtmosphereOpticalDepthLUT })
 	{
-		if(e.Key == View.GetViewKey())
+		if (Target->IsValid())
 		{
-			return true;
+			Size += (*Target)->ComputeMemorySize();
 		}
 	}
-	return false;
+	for (const TRefCountPtr<FRDGPooledBuffer>* Buffer : { &State.VarianceBuffer, &State.LastVarianceBuffer, &State.StartingExtinctionCoefficient })
+	{
+		if (Buffer->IsValid())
+		{
+			Size += (*Buffer)->GetSize();
+		}
+	}
+	return Size + State.AdaptiveSampling.GetMemorySize();
 }
 
-static FPathTracingState * GetViewPathTracingState(const FViewInfo & View) {
-	for(auto & e : GPathTracingStates)
+// States used this frame are never released, the budget may be exceeded by the views being rendered.
+static void TrimPathTracingStates(uint32 FrameNumber)
+{
+	const FMIGIPathTracingStateSettings Settings = GetMIGIPathTracingStateSettings();
+	uint64 TotalSize = 0;
+	TArray<TTuple<uint32, uint32, uint64>> Candidates;
+	for (auto It = GPathTracingStates.CreateIterator(); It; ++It)
 	{
-		if(e.Key == View.GetViewKey())
+		const uint32 Age = FrameNumber - It.Value().LastUsedFrame;
+		if (Settings.MaxAge > 0 && Age > Settings.MaxAge)
+		{
+			It.RemoveCurrent();
+			continue;
+		}
+		const uint64 Size = GetPathTracingStateMemorySize(*It.Value().State);
+		TotalSize += Size;
+		if (Age > 0)
 		{
-			return e.Value;
+			Candidates.Emplace(It.Value().LastUsedFrame, It.Key(), Size);
 		}
 	}
-	auto PathTracingState = new FPathTracingState;
-	GPathTracingStates.Emplace(View.GetViewKey(), PathTracingState);
-	return PathTracingState;
+	if (TotalSize <= Settings.Budget)
+	{
+		return;
+	}
+	Candidates.Sort([](const TTuple<uint32, uint32, uint64>& A, const TTuple<uint32, uint32, uint64>& B) { return A.Get<0>() < B.Get<0>(); });
+	for (int32 i = 0; i < Candidates.Num() && TotalSize > Settings.Budget; i++)
+	{
+		TotalSize -= Candidates[i].Get<2>();
+		GPathTracingStates.Remove(Candidates[i].Get<1>());
+	}
+}
+
+static FPathTracingState * FindViewPathTracingState(const FViewInfo & View)
+{
+	const FPathTracingStateEntry * Entry = GPathTracingStates.Find(View.GetViewKey());
+	return Entry ? Entry->State.Get() : nullptr;
+}
+
+// Creates the state of the view the first time it's path traced, bOutCreated is then set.
+static FPathTracingState * GetViewPathTracingState(const FViewInfo & View, bool & bOutCreated)
+{
+	const uint32 FrameNumber = GFrameNumberRenderThread;
+	FPathTracingStateEntry & Entry = GPathTracingStates.FindOrAdd(View.GetViewKey());
+	bOutCreated = !Entry.State.IsValid();
+	if (bOutCreated)
+	{
+		Entry.State = MakeUnique<FPathTracingState>();
+	}
+	Entry.LastUsedFrame = FrameNumber;
+	FPathTracingState * State = Entry.State.Get();
+	// Entry may move, State doesn't.
+	TrimPathTracingStates(FrameNumber);
+	return State;
 }
 
 
@@ -1829,7 +1913,7 @@ class FPathTracingCompositorPS : public FGlobalShader
 };
 IMPLEMENT_SHADER_TYPE(, FPathTracingCompositorPS, TEXT("/Engine/Private/PathTracing/PathTracingCompositingPixelShader.usf"), TEXT("CompositeMain"), SF_Pixel);
 
-static FPathTracingRG::FPermutationDomain GetPathTracingRGPermutation(const FScene& Scene)
+static FPathTracingRG::FPermutationDomain GetPathTracingRGPermutation(const FScene& Scene, bool bRadianceCache)
 {
 	const int CompactionType = CVarPathTracingCompaction->GetValueOnRenderThread();
 	const bool bHasComplexSpecialRenderPath = Strata::IsStrataEnabled() && Scene.StrataSceneData.bUsesComplexSpecialRenderPath;
@@ -1837,6 +1921,7 @@ static FPathTracingRG::FPermutationDomain GetPathTracingRGPermutation(const FSce
 	FPathTracingRG::FPermutationDomain Out;
 	Out.Set<FPathTracingRG::FCompactionType>(CompactionType);
 	Out.Set<FPathTracingRG::FStrataComplexSpecialMaterial>(bHasComplexSpecialRenderPath);
+	Out.Set<FPathTracingRG::FRadianceCache>(bRadianceCache);
 	return Out;
 }
 
@@ -1851,8 +1936,10 @@ void MIGIPreparePathTracing(const FViewInfo & ViewInfo, TArray<FRHIRayTracingSha
 	{
 		// Declare all RayGen shaders that require material closest hit shaders to be bound
 		const int CompactionType = CVarPathTracingCompaction->GetValueOnRenderThread();
-		FPathTracingRG::FPermutationDomain PermutationVector = GetPathTracingRGPermutation(Scene);
+		// The radiance cache falls back to plain path tracing when its batch doesn't fit, both versions may be used.
+		for (int32 RadianceCache = 0; RadianceCache < (IsMIGIRadianceCache() ? 2 : 1); RadianceCache++)
 		{
+			FPathTracingRG::FPermutationDomain PermutationVector = GetPathTracingRGPermutation(Scene, RadianceCache != 0);
 			auto RayGenShader = GetGlobalShaderMap(ViewFamily.GetShaderPlatform())->GetShader<FPathTracingRG>(PermutationVector);
 			OutRayGenShaders.Add(RayGenShader.GetRayTracingShader());
 		}
@@ -1866,7 +1953,7 @@ void MIGIPreparePathTracing(const FViewInfo & ViewInfo, TArray<FRHIRayTracingSha
 
 void PathTracingInvalidate(const FViewInfo & View, bool InvalidateAnimationStates = true)
 {
-	FPathTracingState* State = GetViewPathTracingState(View);
+	FPathTracingState* State = FindViewPathTracingState(View);
 	if (State)
 	{
 		
@@ -1883,6 +1970,8 @@ void PathTracingInvalidate(const FViewInfo & View, bool InvalidateAnimationState
 		State->AlbedoRT.SafeRelease();
 		State->NormalRT.SafeRelease();
 		State->VarianceBuffer.SafeRelease();
+		State->AdaptiveSampling.Reset();
+		State->TileScheduler.Restart();
 		State->SampleIndex = 0;
 
 		State->AdaptiveFrustumGridParameterCache.TopLevelGridBuffer.SafeRelease();
@@ -1982,18 +2071,15 @@ void MIGIRenderPathTracing(
 
 	Config.PathTracingData.MaxSamples = MaxSPP;
 
+	// Just created: don't bother comparing with the last config.
 	bool FirstTime = false;
-
-	if(!IsViewHasPathTracingState(View)) {
-		FirstTime = true;
-	}
+	FPathTracingState* PathTracingState = GetViewPathTracingState(View, FirstTime);
 	// if (!View.ViewState->PathTracingState.IsValid())
 	// {
 	// 	View.ViewState->PathTracingState = MakePimpl<FPathTracingState>();
 	// 	FirstTime = true; // we just initialized the option state for this view -- don't bother comparing in this case
 	// }
 	// check(View.ViewState->PathTracingState.IsValid());
-	FPathTracingState* PathTracingState = GetViewPathTracingState(View);//View.ViewState->PathTracingState.Get();
 
 	if (FirstTime || Config.UseMISCompensation != PathTracingState->LastConfig.UseMISCompensation)
 	{
@@ -2157,6 +2243,24 @@ void MIGIRenderPathTracing(
 		);
 	}
 
+	// Albedo and normals don't need fp32 to drive the denoiser, radiance does to accumulate.
+	const EPixelFormat AlbedoFormat = MIGIPathTracingFormats::GetPixelFormat((MIGIPathTracingFormats::EAlbedoFormat)GetMIGIPathTracingAlbedoFormat());
+	const EPixelFormat NormalFormat = MIGIPathTracingFormats::GetPixelFormat((MIGIPathTracingFormats::ENormalFormat)GetMIGIPathTracingNormalFormat());
+	if (PathTracingState->RadianceRT &&
+		(PathTracingState->AlbedoRT->GetDesc().Format != AlbedoFormat || PathTracingState->NormalRT->GetDesc().Format != NormalFormat))
+	{
+		// The formats changed, start over. The denoiser history has the old formats too.
+		PathTracingInvalidate(View);
+	}
+	FMIGIAdaptiveSamplingSettings AdaptiveSamplingSettings = GetMIGIAdaptiveSamplingSettings();
+	// Retired tiles only save time when the dispatch can skip them.
+	AdaptiveSamplingSettings.bEnabled &= GRHISupportsRayTracingDispatchIndirect;
+	if (AdaptiveSamplingSettings.bEnabled && PathTracingState->SampleIndex > 0 && !PathTracingState->AdaptiveSampling.HasMoments(View.ViewRect.Size()))
+	{
+		// Turned on mid-accumulation or resized without an invalidation, the luminance moments of the samples so far are missing.
+		PathTracingInvalidate(View);
+	}
+
 	// Prepare radiance buffer (will be shared with display pass)
 	FRDGTexture* RadianceTexture = nullptr;
 	FRDGTexture* AlbedoTexture = nullptr;
@@ -2173,11 +2277,13 @@ void MIGIRenderPathTracing(
 		// First time through, need to make a new texture
 		FRDGTextureDesc Desc = FRDGTextureDesc::Create2D(
 			View.ViewRect.Size(),
-			PF_A32B32G32R32F,
+			MIGIPathTracingFormats::RadianceFormat,
 			FClearValueBinding::None,
 			TexCreate_ShaderResource | TexCreate_UAV | GetExtraTextureCreateFlagsForDenoiser());
 		RadianceTexture = GraphBuilder.CreateTexture(Desc, TEXT("PathTracer.Radiance"), ERDGTextureFlags::MultiFrame);
+		Desc.Format = AlbedoFormat;
 		AlbedoTexture   = GraphBuilder.CreateTexture(Desc, TEXT("PathTracer.Albedo")  , ERDGTextureFlags::MultiFrame);
+		Desc.Format = NormalFormat;
 		NormalTexture   = GraphBuilder.CreateTexture(Desc, TEXT("PathTracer.Normal")  , ERDGTextureFlags::MultiFrame);
 	}
 
@@ -2186,20 +2292,79 @@ void MIGIRenderPathTracing(
 	const int32 NumGPUs = GPUMask.GetNumActive();
 	const int32 DispatchResX = View.ViewRect.Size().X;
 	const int32 DispatchResY = View.ViewRect.Size().Y;
-	const int32 DispatchSize = FMath::Max(CVarPathTracingDispatchSize->GetValueOnRenderThread(), 64);
+	int32 DispatchSize = FMath::Max(CVarPathTracingDispatchSize->GetValueOnRenderThread(), 64);
+	const FMIGIDispatchSizeTuningSettings DispatchSizeTuningSettings = GetMIGIDispatchSizeTuningSettings();
+	// Tuned from the tile timestamps, on one GPU like the frame budget.
+	const bool bTuneDispatchSize = DispatchSizeTuningSettings.bEnabled && GSupportsTimestampRenderQueries && NumGPUs == 1;
+	if (bTuneDispatchSize)
+	{
+		const FIntPoint ViewSize(DispatchResX, DispatchResY);
+		FMIGIDispatchSizeTuner& Tuner = PathTracingState->DispatchSizeTuner;
+		if (PathTracingState->DispatchSizeTuningViewSize != ViewSize || Tuner.GetSettings().TargetMs != DispatchSizeTuningSettings.TargetMs)
+		{
+			FMIGIDispatchSizeTuner::FSettings TunerSettings;
+			TunerSettings.TargetMs = DispatchSizeTuningSettings.TargetMs;
+			// Past the view, every size is a single tile.
+			TunerSettings.MaxSize = FMath::Max(FMath::DivideAndRoundUp(FMath::Max(DispatchResX, DispatchResY), TunerSettings.Granularity) * TunerSettings.Granularity, TunerSettings.MinSize);
+			// The saved size is only a start, the scene may cost more or less than the one it was tuned on.
+			const int32 SavedSize = MIGILoadDispatchSize(ViewSize);
+			Tuner.Start(TunerSettings, SavedSize > 0 ? SavedSize : DispatchSize);
+			PathTracingState->DispatchSizeTuningViewSize = ViewSize;
+		}
+		DispatchSize = Tuner.GetSize();
+	}
 
 	// When running with multiple GPUs, do that number of passes per frame, to keep the GPU work done per frame consistent
 	// (given that each GPU processes a fraction of the pixels), but get the job done in fewer frames.
 
 	// NO support for multi-GPU yet
 
-	const int32 FramePassCount = 1;
+	PathTracingState->AdaptiveSampling.UpdateReadback();
+	if (AdaptiveSamplingSettings.bEnabled && PathTracingState->AdaptiveSampling.IsConverged() && PathTracingState->SampleIndex + 1 < MaxSPP
+		&& PathTracingState->TileScheduler.IsStartingIteration())
+	{
+		// Every tile is retired: skip to the last iteration, it traces nothing and lets the denoiser run.
+		PathTracingState->SampleIndex = MaxSPP - 1;
+	}
+	FMIGITileSchedulerSettings TileSchedulerSettings = GetMIGITileSchedulerSettings();
+	if (NumGPUs > 1)
+	{
+		// The tiles are timed on one GPU.
+		TileSchedulerSettings.BudgetMs = 0.f;
+	}
+	PathTracingState->TileScheduler.BeginFrame(FIntPoint(DispatchResX, DispatchResY), DispatchSize, TileSchedulerSettings,
+		bTuneDispatchSize && !PathTracingState->DispatchSizeTuner.IsConverged());
+	if (bTuneDispatchSize)
+	{
+		for (const FMIGITileTiming& Timing : PathTracingState->TileScheduler.GetTimings())
+		{
+			if (PathTracingState->DispatchSizeTuner.AddTiming(Timing.TileSize, Timing.NumPixels, Timing.Ms))
+			{
+				MIGISaveDispatchSize(FIntPoint(DispatchResX, DispatchResY), PathTracingState->DispatchSizeTuner.GetSize());
+			}
+		}
+	}
+	// The scheduler keeps the tiling of an iteration until it ends, the path pool must fit its tiles.
+	const int32 TileSize = PathTracingState->TileScheduler.GetTileSize();
+	// Adaptive sampling spends the time of the retired tiles on more iterations, the frame budget whatever it has left.
+	int32 FramePassCount = MIGIGetAdaptiveSamplingPassCount(PathTracingState->AdaptiveSampling, AdaptiveSamplingSettings);
+	if (TileSchedulerSettings.BudgetMs > 0.f)
+	{
+		FramePassCount = FMath::Max(FramePassCount, TileSchedulerSettings.MaxIterationsPerFrame);
+	}
 
 	bool bNeedsMoreRays = false;
 	bool bNeedsTextureExtract = false;
+	// The last iteration ended this frame, the denoiser can run.
+	bool bFinishedAccumulation = false;
 
 	for (int32 FramePassIndex = 0; FramePassIndex < FramePassCount; FramePassIndex++)
 	{
+		if (FramePassIndex > 0 && PathTracingState->SampleIndex >= MaxSPP)
+		{
+			// Done, the denoiser runs after the last iteration.
+			break;
+		}
 		// Setup temporal seed _after_ invalidation in case we got reset
 		if (Config.LockedSamplingPattern)
 		{
@@ -2211,16 +2376,38 @@ void MIGIRenderPathTracing(
 			// Count samples from an ever-increasing counter to avoid screen-door effect
 			Config.PathTracingData.TemporalSeed = PathTracingState->FrameIndex;
 		}
+		if (PathTracingState->TileScheduler.IsStartingIteration())
+		{
+			// Never past MaxSPP. The radiance cache queries once per pixel.
+			PathTracingState->LaunchSamples = IsMIGIRadianceCache() ? 1
+				: FMath::Min(GetMIGIPathTracingSamplesPerLaunch(MaxSPP), MaxSPP - FMath::Min(PathTracingState->SampleIndex, MaxSPP - 1));
+		}
+		const uint32 LaunchSamples = PathTracingState->LaunchSamples;
 		Config.PathTracingData.Iteration = PathTracingState->SampleIndex;
-		Config.PathTracingData.BlendFactor = 1.0f / (Config.PathTracingData.Iteration + 1);
+		// The raygen averages the samples of the launch, they weigh as much as LaunchSamples iterations of one.
+		Config.PathTracingData.BlendFactor = float(LaunchSamples) / (Config.PathTracingData.Iteration + LaunchSamples);
 
 		bNeedsMoreRays = Config.PathTracingData.Iteration < MaxSPP;
 
 		if (bNeedsMoreRays)
 		{
+			// An iteration may span several frames under a frame budget, these are the tiles of this pass.
+			const bool bStartsIteration = PathTracingState->TileScheduler.IsStartingIteration();
+			TArray<FIntRect> ScheduledTiles;
+			bool bEndsIteration = false;
+			if (!PathTracingState->TileScheduler.ScheduleTiles(ScheduledTiles, bEndsIteration))
+			{
+				// The frame budget is spent.
+				break;
+			}
+
 			// We are writing to the texture, we'll need to extract it...
 			bNeedsTextureExtract = true;
 
+			FMIGIRadianceCacheFrame RadianceCacheFrame;
+			// Enabled mid-iteration, the cache waits for an iteration of one sample per launch.
+			const bool bRadianceCache = LaunchSamples == 1 && MIGIBeginRadianceCache(GraphBuilder, FIntPoint(DispatchResX, DispatchResY), RadianceCacheFrame);
+
 			// should we use path compaction?
 			const int CompactionType = CVarPathTracingCompaction->GetValueOnRenderThread();
 			const bool bUseIndirectDispatch = GRHISupportsRayTracingDispatchIndirect && CVarPathTracingIndirectDispatch->GetValueOnRenderThread() != 0;
@@ -2229,12 +2416,21 @@ void MIGIRenderPathTracing(
 			FRDGBuffer* ActivePaths[2] = {};
 			FRDGBuffer* NumActivePaths[2] = {};
 			FRDGBuffer* PathStateData = nullptr;
+			FRDGBuffer* PathSurvivors = nullptr;
+			FRDGBuffer* PathCompactionGroupSums = nullptr;
+			// Compacted paths before binning, and their keys.
+			FRDGBuffer* UnsortedActivePaths = nullptr;
+			FRDGBuffer* PathSortKeys = nullptr;
+			const FMIGIPathSortSettings PathSortSettings = GetMIGIPathSortSettings();
+			FRDGBuffer* RadianceCachePathStates = nullptr;
+			// With compaction, every sample of the launch is a path of its own.
+			const int32 PathsPerPixel = CompactionType == 1 ? (int32)LaunchSamples : 1;
+			const int32 NumPaths = FMath::Min(
+				TileSize * FMath::DivideAndRoundUp(TileSize, NumGPUs),
+				DispatchResX * FMath::DivideAndRoundUp(DispatchResY, NumGPUs)
+			) * PathsPerPixel;
 			if (CompactionType == 1)
 			{
-				const int32 NumPaths = FMath::Min(
-					DispatchSize * FMath::DivideAndRoundUp(DispatchSize, NumGPUs),
-					DispatchResX * FMath::DivideAndRoundUp(DispatchResY, NumGPUs)
-				);
 				ActivePaths[0] = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(int32), NumPaths), TEXT("PathTracer.ActivePaths0"));
 				ActivePaths[1] = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(int32), NumPaths), TEXT("PathTracer.ActivePaths1"));
 				if (bUseIndirectDispatch)
@@ -2246,10 +2442,24 @@ void MIGIRenderPathTracing(
 				{
 					NumActivePaths[0] = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(int32), 3), TEXT("PathTracer.NumActivePaths"));
 				}
-				PathStateData = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateStructuredDesc(sizeof(FPathTracingPackedPathState), NumPaths), TEXT("PathTracer.PathStateData"));
+				PathSurvivors = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(int32), NumPaths), TEXT("PathTracer.PathSurvivors"));
+				PathCompactionGroupSums = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(uint32), MIGIGetPathCompactionNumGroups(NumPaths)), TEXT("PathTracer.PathCompactionGroupSums"));
+				if (PathSortSettings.bEnabled)
+				{
+					UnsortedActivePaths = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(int32), NumPaths), TEXT("PathTracer.UnsortedActivePaths"));
+					PathSortKeys = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(uint32), NumPaths), TEXT("PathTracer.PathSortKeys"));
+				}
+				PathStateData = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateStructuredDesc(sizeof(FUintVector4), NumPaths * MIGIPackedPathState::NumPlanes), TEXT("PathTracer.PathStateData"));
+				if (bRadianceCache)
+				{
+					RadianceCachePathStates = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateStructuredDesc(sizeof(FMIGIRadianceCachePathState), NumPaths), TEXT("PathTracer.RadianceCachePathStates"));
+				}
 			}
+			FMIGIAdaptiveSamplingFrame AdaptiveSamplingFrame;
+			const bool bAdaptiveSampling = MIGIBeginAdaptiveSampling(GraphBuilder, View, AdaptiveSamplingSettings, Config.PathTracingData.Iteration,
+				bStartsIteration, NumPaths, PathTracingState->AdaptiveSampling, AdaptiveSamplingFrame);
 
-			TShaderMapRef<FPathTracingRG> RayGenShader(View.ShaderMap, GetPathTracingRGPermutation(*Scene));
+			TShaderMapRef<FPathTracingRG> RayGenShader(View.ShaderMap, GetPathTracingRGPermutation(*Scene, bRadianceCache));
 			FPathTracingRG::FParameters* PreviousPassParameters = nullptr;
 			// Divide each tile among all the active GPUs (interleaving scanlines)
 			// The assumption is that the tiles are as big as possible, hopefully covering the entire screen
@@ -2259,164 +2469,221 @@ void MIGIRenderPathTracing(
 			{
 				RDG_GPU_MASK_SCOPE(GraphBuilder, FRHIGPUMask::FromIndex(GPUIndex));
 				RDG_EVENT_SCOPE_CONDITIONAL(GraphBuilder, NumGPUs > 1, "Path Tracing GPU%d", GPUIndex);
-				for (int32 TileY = 0; TileY < DispatchResY; TileY += DispatchSize)
+				// A single timestamp before the tiles, then one after each, see FMIGITileScheduler.
+				PathTracingState->TileScheduler.AddTimestamp(GraphBuilder);
+				for (const FIntRect& Tile : ScheduledTiles)
 				{
-					for (int32 TileX = 0; TileX < DispatchResX; TileX += DispatchSize)
+					const int32 TileX = Tile.Min.X;
+					const int32 TileY = Tile.Min.Y;
+					const int32 DispatchSizeX = Tile.Width();
+					const int32 DispatchSizeY = Tile.Height();
+
+					const int32 DispatchSizeYSplit = FMath::DivideAndRoundUp(DispatchSizeY, NumGPUs);
+
+					// Compute the dispatch size for just this set of scanlines
+					const int32 DispatchSizeYLocal = FMath::Min(DispatchSizeYSplit, DispatchSizeY - CurrentGPU * DispatchSizeYSplit);
+					if (CompactionType == 1)
+					{
+						AddClearUAVPass(GraphBuilder, GraphBuilder.CreateUAV(ActivePaths[0], PF_R32_UINT), 0);
+						// The compaction passes reset the slots they gather, only the first bounce needs a clear.
+						AddClearUAVPass(GraphBuilder, GraphBuilder.CreateUAV(PathSurvivors, PF_R32_SINT), -1);
+					}
+					if (bAdaptiveSampling)
+					{
+						MIGIAddAdaptiveSamplingTilePasses(GraphBuilder, View, AdaptiveSamplingFrame,
+							FIntPoint(TileX, TileY + CurrentGPU * DispatchSizeYSplit), FIntPoint(DispatchSizeX, DispatchSizeYLocal), PathsPerPixel);
+					}
+					// When using path compaction, we need to run the path tracer once per bounce
+					// otherwise, the path tracer is the one doing the bounces
+					const int MaxBounces = CompactionType == 1 ? Config.PathTracingData.MaxBounces : 0;
+					// The paths of a pixel end apart with several of them, one more dispatch averages them.
+					const int NumDispatches = MaxBounces + (PathsPerPixel > 1 ? 2 : 1);
+					for (int Bounce = 0; Bounce < NumDispatches; Bounce++)
 					{
-						const int32 DispatchSizeX = FMath::Min(DispatchSize, DispatchResX - TileX);
-						const int32 DispatchSizeY = FMath::Min(DispatchSize, DispatchResY - TileY);
+						const bool bResolvePass = Bounce > MaxBounces;
+						FPathTracingRG::FParameters* PassParameters = GraphBuilder.AllocParameters<FPathTracingRG::FParameters>();
+						PassParameters->TLAS = Scene->RayTracingScene.GetLayerView(ERayTracingSceneLayer::Base);
+						PassParameters->DecalTLAS = Scene->RayTracingScene.GetLayerView(ERayTracingSceneLayer::Decals);
+						PassParameters->ViewUniformBuffer = View.ViewUniformBuffer;
+						PassParameters->PathTracingData = Config.PathTracingData;
+						PassParameters->StartingExtinctionCoefficient = GraphBuilder.CreateSRV(StartingExtinctionCoefficient, PF_R32_FLOAT);
+						if (PreviousPassParameters == nullptr)
+						{
+							// upload sky/lights data
+							RDG_GPU_MASK_SCOPE(GraphBuilder, GPUMask); // make sure this happens on all GPUs we will be rendering on
+							SetLightParameters(GraphBuilder, PassParameters, Scene, View, Config.UseMISCompensation);
+						}
+						else
+						{
+							// re-use from last iteration
+							PassParameters->LightGridParameters = PreviousPassParameters->LightGridParameters;
+							PassParameters->SceneLightCount = PreviousPassParameters->SceneLightCount;
+							PassParameters->SceneVisibleLightCount = PreviousPassParameters->SceneVisibleLightCount;
+							PassParameters->SceneLights = PreviousPassParameters->SceneLights;
+							PassParameters->SkylightParameters = PreviousPassParameters->SkylightParameters;
+						}
+						PassParameters->DecalParameters = View.RayTracingDecalUniformBuffer;
 
-						const int32 DispatchSizeYSplit = FMath::DivideAndRoundUp(DispatchSizeY, NumGPUs);
+						PassParameters->RadianceTexture = GraphBuilder.CreateUAV(RadianceTexture);
+						PassParameters->AlbedoTexture = GraphBuilder.CreateUAV(AlbedoTexture);
+						PassParameters->NormalTexture = GraphBuilder.CreateUAV(NormalTexture);
 
-						// Compute the dispatch size for just this set of scanlines
-						const int32 DispatchSizeYLocal = FMath::Min(DispatchSizeYSplit, DispatchSizeY - CurrentGPU * DispatchSizeYSplit);
-						if (CompactionType == 1)
+						if (PreviousPassParameters != nullptr)
 						{
-							AddClearUAVPass(GraphBuilder, GraphBuilder.CreateUAV(ActivePaths[0], PF_R32_UINT), 0);
+							PassParameters->Atmosphere = PreviousPassParameters->Atmosphere;
+							PassParameters->PlanetCenterTranslatedWorldHi = PreviousPassParameters->PlanetCenterTranslatedWorldHi;
+							PassParameters->PlanetCenterTranslatedWorldLo = PreviousPassParameters->PlanetCenterTranslatedWorldLo;
 						}
-						// When using path compaction, we need to run the path tracer once per bounce
-						// otherwise, the path tracer is the one doing the bounces
-						for (int Bounce = 0, MaxBounces = CompactionType == 1 ? Config.PathTracingData.MaxBounces : 0; Bounce <= MaxBounces; Bounce++)
+						else if (Config.PathTracingData.EnableAtmosphere)
 						{
-							FPathTracingRG::FParameters* PassParameters = GraphBuilder.AllocParameters<FPathTracingRG::FParameters>();
-							PassParameters->TLAS = Scene->RayTracingScene.GetLayerView(ERayTracingSceneLayer::Base);
-							PassParameters->DecalTLAS = Scene->RayTracingScene.GetLayerView(ERayTracingSceneLayer::Decals);
-							PassParameters->ViewUniformBuffer = View.ViewUniformBuffer;
-							PassParameters->PathTracingData = Config.PathTracingData;
-							PassParameters->StartingExtinctionCoefficient = GraphBuilder.CreateSRV(StartingExtinctionCoefficient, PF_R32_FLOAT);
-							if (PreviousPassParameters == nullptr)
-							{
-								// upload sky/lights data
-								RDG_GPU_MASK_SCOPE(GraphBuilder, GPUMask); // make sure this happens on all GPUs we will be rendering on
-								SetLightParameters(GraphBuilder, PassParameters, Scene, View, Config.UseMISCompensation);
-							}
-							else
-							{
-								// re-use from last iteration
-								PassParameters->LightGridParameters = PreviousPassParameters->LightGridParameters;
-								PassParameters->SceneLightCount = PreviousPassParameters->SceneLightCount;
-								PassParameters->SceneVisibleLightCount = PreviousPassParameters->SceneVisibleLightCount;
-								PassParameters->SceneLights = PreviousPassParameters->SceneLights;
-								PassParameters->SkylightParameters = PreviousPassParameters->SkylightParameters;
-							}
-							PassParameters->DecalParameters = View.RayTracingDecalUniformBuffer;
+							PassParameters->Atmosphere = Scene->GetSkyAtmosphereSceneInfo()->GetAtmosphereUniformBuffer();
+							FVector PlanetCenterTranslatedWorld = Scene->GetSkyAtmosphereSceneInfo()->GetSkyAtmosphereSceneProxy().GetAtmosphereSetup().PlanetCenterKm * double(FAtmosphereSetup::SkyUnitToCm) + View.ViewMatrices.GetPreViewTranslation();
+							SplitDouble(PlanetCenterTranslatedWorld.X, &PassParameters->PlanetCenterTranslatedWorldHi.X, &PassParameters->PlanetCenterTranslatedWorldLo.X);
+							SplitDouble(PlanetCenterTranslatedWorld.Y, &PassParameters->PlanetCenterTranslatedWorldHi.Y, &PassParameters->PlanetCenterTranslatedWorldLo.Y);
+							SplitDouble(PlanetCenterTranslatedWorld.Z, &PassParameters->PlanetCenterTranslatedWorldHi.Z, &PassParameters->PlanetCenterTranslatedWorldLo.Z);
+						}
+						else
+						{
+							FAtmosphereUniformShaderParameters AtmosphereParams = {};
+							PassParameters->Atmosphere = CreateUniformBufferImmediate(AtmosphereParams, EUniformBufferUsage::UniformBuffer_SingleFrame);
+							PassParameters->PlanetCenterTranslatedWorldHi = FVector3f(0);
+							PassParameters->PlanetCenterTranslatedWorldLo = FVector3f(0);
+						}
+						PassParameters->AtmosphereOpticalDepthLUT = AtmosphereOpticalDepthLUT;
+						PassParameters->AtmosphereOpticalDepthLUTSampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
 
-							PassParameters->RadianceTexture = GraphBuilder.CreateUAV(RadianceTexture);
-							PassParameters->AlbedoTexture = GraphBuilder.CreateUAV(AlbedoTexture);
-							PassParameters->NormalTexture = GraphBuilder.CreateUAV(NormalTexture);
+						if (Config.PathTracingData.EnableFog)
+						{
+							PassParameters->FogParameters = PrepareFogParameters(View, Scene->ExponentialFogs[0]);
+						}
+						else
+						{
+							PassParameters->FogParameters = {};
+						}
 
-							if (PreviousPassParameters != nullptr)
-							{
-								PassParameters->Atmosphere = PreviousPassParameters->Atmosphere;
-								PassParameters->PlanetCenterTranslatedWorldHi = PreviousPassParameters->PlanetCenterTranslatedWorldHi;
-								PassParameters->PlanetCenterTranslatedWorldLo = PreviousPassParameters->PlanetCenterTranslatedWorldLo;
-							}
-							else if (Config.PathTracingData.EnableAtmosphere)
-							{
-								PassParameters->Atmosphere = Scene->GetSkyAtmosphereSceneInfo()->GetAtmosphereUniformBuffer();
-								FVector PlanetCenterTranslatedWorld = Scene->GetSkyAtmosphereSceneInfo()->GetSkyAtmosphereSceneProxy().GetAtmosphereSetup().PlanetCenterKm * double(FAtmosphereSetup::SkyUnitToCm) + View.ViewMatrices.GetPreViewTranslation();
-								SplitDouble(PlanetCenterTranslatedWorld.X, &PassParameters->PlanetCenterTranslatedWorldHi.X, &PassParameters->PlanetCenterTranslatedWorldLo.X);
-								SplitDouble(PlanetCenterTranslatedWorld.Y, &PassParameters->PlanetCenterTranslatedWorldHi.Y, &PassParameters->PlanetCenterTranslatedWorldLo.Y);
-								SplitDouble(PlanetCenterTranslatedWorld.Z, &PassParameters->PlanetCenterTranslatedWorldHi.Z, &PassParameters->PlanetCenterTranslatedWorldLo.Z);
-							}
-							else
-							{
-								FAtmosphereUniformShaderParameters AtmosphereParams = {};
-								PassParameters->Atmosphere = CreateUniformBufferImmediate(AtmosphereParams, EUniformBufferUsage::UniformBuffer_SingleFrame);
-								PassParameters->PlanetCenterTranslatedWorldHi = FVector3f(0);
-								PassParameters->PlanetCenterTranslatedWorldLo = FVector3f(0);
-							}
-							PassParameters->AtmosphereOpticalDepthLUT = AtmosphereOpticalDepthLUT;
-							PassParameters->AtmosphereOpticalDepthLUTSampler = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
+						// Heterogeneous volume bindings
+						PassParameters->OrthoGridUniformBuffer = OrthoGridUniformBuffer;
+						PassParameters->FrustumGridUniformBuffer = FrustumGridUniformBuffer;
+
+						PassParameters->TilePixelOffset.X = TileX;
+						PassParameters->TilePixelOffset.Y = TileY + CurrentGPU;
+						PassParameters->TileTextureOffset.X = TileX;
+						PassParameters->TileTextureOffset.Y = TileY + CurrentGPU * DispatchSizeYSplit;
+						PassParameters->ScanlineStride = NumGPUs;
+						PassParameters->ScanlineWidth = DispatchSizeX;
 
-							if (Config.PathTracingData.EnableFog)
+						PassParameters->Bounce = bResolvePass ? -1 : Bounce;
+						PassParameters->SamplesPerLaunch = LaunchSamples;
+						if (CompactionType == 1)
+						{
+							PassParameters->ActivePaths = GraphBuilder.CreateSRV(ActivePaths[Bounce & 1], PF_R32_SINT);
+							PassParameters->PathSurvivors = GraphBuilder.CreateUAV(PathSurvivors, PF_R32_SINT);
+							PassParameters->PathStateData = GraphBuilder.CreateUAV(PathStateData);
+							PassParameters->PathStatePlaneSize = NumPaths;
+							if (bUseIndirectDispatch)
 							{
-								PassParameters->FogParameters = PrepareFogParameters(View, Scene->ExponentialFogs[0]);
+								PassParameters->PathTracingIndirectArgs = NumActivePaths[(Bounce & 1) ^ 1];
 							}
-							else
+						}
+						// The first bounce and the resolve only run over the pixels adaptive sampling left, the other bounces over the paths still active.
+						const bool bPixelDispatch = Bounce == 0 || bResolvePass;
+						const bool bIndirectDispatch = bPixelDispatch ? bAdaptiveSampling : bUseIndirectDispatch;
+						// Direct dispatches of the bounces cover every path of the tile.
+						const int32 DispatchSizeYPaths = bResolvePass ? DispatchSizeYLocal : DispatchSizeYLocal * PathsPerPixel;
+						if (bAdaptiveSampling && bPixelDispatch)
+						{
+							PassParameters->PathTracingIndirectArgs = AdaptiveSamplingFrame.DispatchArgs;
+						}
+						AdaptiveSamplingFrame.SetPathParameters(GraphBuilder, PassParameters->AdaptiveSamplingParameters);
+						if (bRadianceCache)
+						{
+							RadianceCacheFrame.SetPathParameters(GraphBuilder, RadianceCachePathStates, PassParameters->RadianceCacheParameters);
+						}
+						ClearUnusedGraphResources(RayGenShader, PassParameters);
+						const bool bFlushRenderingCommands = FlushRenderingCommands == 1 || (FlushRenderingCommands == 2 && Bounce == NumDispatches - 1);
+						GraphBuilder.AddPass(
+							CompactionType == 1
+							? RDG_EVENT_NAME("Path Tracer Compute (%d x %d) Tile=(%d,%d - %dx%d) Sample=%d/%d NumLights=%d (Bounce=%d%s)", DispatchResX, DispatchResY, TileX, TileY, DispatchSizeX, DispatchSizeYLocal, PathTracingState->SampleIndex, MaxSPP, PassParameters->SceneLightCount, PassParameters->Bounce, bIndirectDispatch ? TEXT(" indirect") : TEXT(""))
+							: RDG_EVENT_NAME("Path Tracer Compute (%d x %d) Tile=(%d,%d - %dx%d) Sample=%d/%d NumLights=%d%s", DispatchResX, DispatchResY, TileX, TileY, DispatchSizeX, DispatchSizeYLocal, PathTracingState->SampleIndex, MaxSPP, PassParameters->SceneLightCount, bIndirectDispatch ? TEXT(" indirect") : TEXT("")),
+							PassParameters,
+							ERDGPassFlags::Compute,
+							[PassParameters, RayGenShader, DispatchSizeX, DispatchSizeYPaths, bIndirectDispatch, bFlushRenderingCommands, GPUIndex, &View](FRHIRayTracingCommandList& RHICmdList)
 							{
-								PassParameters->FogParameters = {};
-							}
-
-							// Heterogeneous volume bindings
-							PassParameters->OrthoGridUniformBuffer = OrthoGridUniformBuffer;
-							PassParameters->FrustumGridUniformBuffer = FrustumGridUniformBuffer;
+								FRHIRayTracingScene* RayTracingSceneRHI = View.GetRayTracingSceneChecked();
 
-							PassParameters->TilePixelOffset.X = TileX;
-							PassParameters->TilePixelOffset.Y = TileY + CurrentGPU;
-							PassParameters->TileTextureOffset.X = TileX;
-							PassParameters->TileTextureOffset.Y = TileY + CurrentGPU * DispatchSizeYSplit;
-							PassParameters->ScanlineStride = NumGPUs;
-							PassParameters->ScanlineWidth = DispatchSizeX;
-
-							PassParameters->Bounce = Bounce;
-							if (CompactionType == 1)
-							{
-								PassParameters->ActivePaths = GraphBuilder.CreateSRV(ActivePaths[Bounce & 1], PF_R32_SINT);
-								PassParameters->NextActivePaths = GraphBuilder.CreateUAV(ActivePaths[(Bounce & 1) ^ 1], PF_R32_SINT);
-								PassParameters->PathStateData = GraphBuilder.CreateUAV(PathStateData);
-								if (bUseIndirectDispatch)
+								FRayTracingShaderBindingsWriter GlobalResources;
+								SetShaderParameters(GlobalResources, RayGenShader, *PassParameters);
+								if (bIndirectDispatch)
 								{
-									PassParameters->NumPathStates = GraphBuilder.CreateUAV(NumActivePaths[Bounce & 1], PF_R32_UINT);
-									PassParameters->PathTracingIndirectArgs = NumActivePaths[(Bounce & 1) ^ 1];
+									PassParameters->PathTracingIndirectArgs->MarkResourceAsUsed();
+									RHICmdList.RayTraceDispatchIndirect(
+										View.RayTracingMaterialPipeline,
+										RayGenShader.GetRayTracingShader(),
+										RayTracingSceneRHI, GlobalResources,
+										PassParameters->PathTracingIndirectArgs->GetIndirectRHICallBuffer(), 0
+									);
 								}
 								else
 								{
-									PassParameters->NumPathStates = GraphBuilder.CreateUAV(NumActivePaths[0], PF_R32_UINT);
-									AddClearUAVPass(GraphBuilder, PassParameters->NextActivePaths, -1); // make sure everything is initialized to -1 since paths that go inactive don't write anything
+									RHICmdList.RayTraceDispatch(
+										View.RayTracingMaterialPipeline,
+										RayGenShader.GetRayTracingShader(),
+										RayTracingSceneRHI, GlobalResources,
+										DispatchSizeX, DispatchSizeYPaths
+									);
 								}
-								AddClearUAVPass(GraphBuilder, PassParameters->NumPathStates, 0);
-							}
-							ClearUnusedGraphResources(RayGenShader, PassParameters);
-							const bool bFlushRenderingCommands = FlushRenderingCommands == 1 || (FlushRenderingCommands == 2 && Bounce == MaxBounces);
-							GraphBuilder.AddPass(
-								CompactionType == 1
-								? RDG_EVENT_NAME("Path Tracer Compute (%d x %d) Tile=(%d,%d - %dx%d) Sample=%d/%d NumLights=%d (Bounce=%d%s)", DispatchResX, DispatchResY, TileX, TileY, DispatchSizeX, DispatchSizeYLocal, PathTracingState->SampleIndex, MaxSPP, PassParameters->SceneLightCount, Bounce, bUseIndirectDispatch && Bounce > 0 ? TEXT(" indirect") : TEXT(""))
-								: RDG_EVENT_NAME("Path Tracer Compute (%d x %d) Tile=(%d,%d - %dx%d) Sample=%d/%d NumLights=%d", DispatchResX, DispatchResY, TileX, TileY, DispatchSizeX, DispatchSizeYLocal, PathTracingState->SampleIndex, MaxSPP, PassParameters->SceneLightCount),
-								PassParameters,
-								ERDGPassFlags::Compute,
-								[PassParameters, RayGenShader, DispatchSizeX, DispatchSizeYLocal, bUseIndirectDispatch, bFlushRenderingCommands, GPUIndex, &View](FRHIRayTracingCommandList& RHICmdList)
+								if (bFlushRenderingCommands)
 								{
-									FRHIRayTracingScene* RayTracingSceneRHI = View.GetRayTracingSceneChecked();
-
-									FRayTracingShaderBindingsWriter GlobalResources;
-									SetShaderParameters(GlobalResources, RayGenShader, *PassParameters);
-									if (bUseIndirectDispatch && PassParameters->Bounce > 0)
-									{
-										PassParameters->PathTracingIndirectArgs->MarkResourceAsUsed();
-										RHICmdList.RayTraceDispatchIndirect(
-											View.RayTracingMaterialPipeline,
-											RayGenShader.GetRayTracingShader(),
-											RayTracingSceneRHI, GlobalResources,
-											PassParameters->PathTracingIndirectArgs->GetIndirectRHICallBuffer(), 0
-										);
-									}
-									else
-									{
-										RHICmdList.RayTraceDispatch(
-											View.RayTracingMaterialPipeline,
-											RayGenShader.GetRayTracingShader(),
-											RayTracingSceneRHI, GlobalResources,
-											DispatchSizeX, DispatchSizeYLocal
-										);
-									}
-									if (bFlushRenderingCommands)
-									{
-										RHICmdList.SubmitCommandsHint();
-									}
-								});
-							if (PreviousPassParameters == nullptr)
+									RHICmdList.SubmitCommandsHint();
+								}
+							});
+						if (CompactionType == 1 && Bounce < MaxBounces)
+						{
+							// Gather the paths still alive into the active paths of the next bounce, in slot order.
+							FRDGBuffer* NextActivePaths = ActivePaths[(Bounce & 1) ^ 1];
+							if (!bUseIndirectDispatch)
+							{
+								// The full dispatch runs again, the slots past the active paths must read -1.
+								AddClearUAVPass(GraphBuilder, GraphBuilder.CreateUAV(NextActivePaths, PF_R32_SINT), -1);
+							}
+							FRDGBuffer* NextNumActivePaths = bUseIndirectDispatch ? NumActivePaths[Bounce & 1] : NumActivePaths[0];
+							const uint32 NumSlots = DispatchSizeX * DispatchSizeYPaths;
+							if (PathSortSettings.bEnabled)
+							{
+								// Bin the rays of the next bounce by direction, origin and shading class. Costs a few passes, pays off
+								// once paths have scattered off diffuse surfaces and left their pixel order meaningless.
+								MIGIAddPathCompactionPasses(GraphBuilder, View, NumSlots, PathSurvivors, PathCompactionGroupSums, UnsortedActivePaths, NextNumActivePaths);
+								MIGIAddPathSortPasses(GraphBuilder, View, NumSlots, PathSortSettings.CellSize, PathStateData, NumPaths,
+									UnsortedActivePaths, NextNumActivePaths, PathSortKeys, NextActivePaths);
+							}
+							else
 							{
-								PreviousPassParameters = PassParameters;
+								MIGIAddPathCompactionPasses(GraphBuilder, View, NumSlots, PathSurvivors, PathCompactionGroupSums, NextActivePaths, NextNumActivePaths);
 							}
 						}
+						if (PreviousPassParameters == nullptr)
+						{
+							PreviousPassParameters = PassParameters;
+						}
 					}
+					PathTracingState->TileScheduler.AddTimestamp(GraphBuilder);
 				}
 				++CurrentGPU;
 			}
 
+			if (bRadianceCache)
+			{
+				MIGIResolveRadianceCache(GraphBuilder, View, RadianceCacheFrame, RadianceTexture, Config.PathTracingData.BlendFactor,
+					Config.PathTracingData.Iteration, AdaptiveSamplingFrame);
+			}
+			MIGIEndAdaptiveSampling(GraphBuilder, AdaptiveSamplingFrame, PathTracingState->AdaptiveSampling);
+
 			// Bump counters for next frame pass
-			++PathTracingState->SampleIndex;
+			if (bEndsIteration)
+			{
+				bFinishedAccumulation = Config.PathTracingData.Iteration + LaunchSamples == MaxSPP;
+				PathTracingState->SampleIndex += LaunchSamples;
+			}
 			++PathTracingState->FrameIndex;
 		}
 	}
@@ -2445,7 +2712,7 @@ void MIGIRenderPathTracing(
 
 	// Request denoise if this is the last sample OR allow turning on the denoiser after the image has stopped accumulating samples
 	const bool NeedsDenoise = IsDenoiserEnabled &&
-		(((Config.PathTracingData.Iteration + 1) == MaxSPP) ||
+		(bFinishedAccumulation ||
 		 (!bNeedsMoreRays && DenoiserMode != PathTracingState->LastConfig.DenoiserMode));
 	
 
@@ -0,0 +1,163 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "MIGIPathTracingFormats.h"
+
+// CPU mirror of the path state packing of MIGIPackedPathState.ush, used between the bounces of the wavefront path tracer.
+// Keep both in sync: same planes, same bit layout, same rounding.
+namespace MIGIPackedPathState
+{
+	// Structure of arrays: plane p of path i is element p * NumPaths + i of a uint4 buffer, so loads coalesce.
+	// 48 bytes per path instead of the 80 of FPathTracingPackedPathState.
+	constexpr uint32 NumPlanes = 3;
+
+	// Exponent biases of the shared exponent encodings: values from 2^-(Bias+1) to 2^(31-Bias) keep 9 bits relative to
+	// the largest channel, smaller ones flush to steps of 2^-(Bias+9). Radiance trades small values for range, up to about 2e6.
+	constexpr int32 RadianceExponentBias = 10;
+	constexpr int32 DefaultExponentBias = 15;
+
+	// Unpacked, what FPathState holds between bounces.
+	struct FPathState
+	{
+		uint32 RandSeqSampleIndex;
+		uint32 RandSeqSampleSeed;
+		FVector3f Radiance;
+		float BackgroundVisibility;
+		FVector3f Albedo;
+		FVector3f Normal;
+		FVector3f RayOrigin;
+		FVector3f RayDirection;
+		FVector3f PathThroughput;
+		float PathRoughness;
+		FVector3f SigmaT;
+		uint32 FirstScatterType;
+	};
+
+	struct FPacked
+	{
+		uint32 Planes[NumPlanes][4];
+	};
+
+	// Three 9 bit mantissas and a 5 bit exponent, like RGB9E5 with a configurable bias. Negative values and NaNs become 0.
+	inline uint32 PackSharedExponent (const FVector3f & Value, int32 Bias)
+	{
+		const float MaxValue = 511.f / 512.f * FMath::Exp2((float)(31 - Bias));
+		// Max first, so NaNs go to 0 like on the GPU. FMath::Clamp would take them to MaxValue.
+		const float R = FMath::Min(FMath::Max(Value.X, 0.f), MaxValue);
+		const float G = FMath::Min(FMath::Max(Value.Y, 0.f), MaxValue);
+		const float B = FMath::Min(FMath::Max(Value.Z, 0.f), MaxValue);
+		const float MaxChannel = FMath::Max(FMath::Max(R, G), FMath::Max(B, FMath::Exp2((float)(-Bias - 1))));
+		int32 Exponent = FMath::FloorToInt(FMath::Log2(MaxChannel)) + 1 + Bias;
+		float Scale = FMath::Exp2((float)(Exponent - Bias - 9));
+		if(FMath::FloorToFloat(MaxChannel / Scale + 0.5f) >= 512.f)
+		{
+			Scale *= 2.f;
+			Exponent++;
+		}
+		const uint32 MR = (uint32)FMath::FloorToFloat(R / Scale + 0.5f);
+		const uint32 MG = (uint32)FMath::FloorToFloat(G / Scale + 0.5f);
+		const uint32 MB = (uint32)FMath::FloorToFloat(B / Scale + 0.5f);
+		return MR | (MG << 9) | (MB << 18) | ((uint32)Exponent << 27);
+	}
+
+	inline FVector3f UnpackSharedExponent (uint32 Packed, int32 Bias)
+	{
+		const float Scale = FMath::Exp2((float)((int32)(Packed >> 27) - Bias - 9));
+		return FVector3f((float)(Packed & 511) * Scale, (float)((Packed >> 9) & 511) * Scale, (float)((Packed >> 18) & 511) * Scale);
+	}
+
+	inline uint32 PackUnorm (float Value, uint32 NumBits)
+	{
+		return (uint32)FMath::RoundToFloat(FMath::Clamp(Value, 0.f, 1.f) * (float)((1u << NumBits) - 1));
+	}
+
+	inline float UnpackUnorm (uint32 Packed, uint32 NumBits)
+	{
+		const uint32 MaxValue = (1u << NumBits) - 1;
+		return (float)(Packed & MaxValue) / (float)MaxValue;
+	}
+
+	// Octahedral unit vector, two 16 bit SNORMs.
+	inline uint32 PackDirection (const FVector3f & Direction)
+	{
+		const FVector2f E = MIGIPathTracingFormats::EncodeOctahedral(Direction);
+		const int32 X = FMath::RoundToInt(FMath::Clamp(E.X, -1.f, 1.f) * 32767.f);
+		const int32 Y = FMath::RoundToInt(FMath::Clamp(E.Y, -1.f, 1.f) * 32767.f);
+		return ((uint32)X & 0xFFFF) | ((uint32)Y << 16);
+	}
+
+	inline FVector3f UnpackDirection (uint32 Packed)
+	{
+		const int32 X = (int32)(Packed << 16) >> 16;
+		const int32 Y = (int32)Packed >> 16;
+		return MIGIPathTracingFormats::DecodeOctahedral(FVector2f((float)X / 32767.f, (float)Y / 32767.f));
+	}
+
+	// The normal is a blend of the normals seen through the first transparent layers: octahedral direction
+	// in 2x12 bits and its length, at most 1, in 8 bits.
+	inline uint32 PackNormal (const FVector3f & Normal)
+	{
+		const float Length = FMath::Sqrt(Normal.X * Normal.X + Normal.Y * Normal.Y + Normal.Z * Normal.Z);
+		FVector2f E(0.f, 0.f);
+		if(Length > 0.f)
+		{
+			E = MIGIPathTracingFormats::EncodeOctahedral(FVector3f(Normal.X / Length, Normal.Y / Length, Normal.Z / Length));
+		}
+		return PackUnorm(E.X * 0.5f + 0.5f, 12) | (PackUnorm(E.Y * 0.5f + 0.5f, 12) << 12) | (PackUnorm(Length, 8) << 24);
+	}
+
+	inline FVector3f UnpackNormal (uint32 Packed)
+	{
+		const FVector2f E(UnpackUnorm(Packed, 12) * 2.f - 1.f, UnpackUnorm(Packed >> 12, 12) * 2.f - 1.f);
+		const float Length = UnpackUnorm(Packed >> 24, 8);
+		const FVector3f N = MIGIPathTracingFormats::DecodeOctahedral(E);
+		return FVector3f(N.X * Length, N.Y * Length, N.Z * Length);
+	}
+
+	// Plane 0: random sequence, radiance, throughput.
+	// Plane 1: ray origin (fp32, self intersection offsets need it), ray direction.
+	// Plane 2: albedo, normal, extinction, roughness | background visibility | first scatter type.
+	inline FPacked Pack (const FPathState & State)
+	{
+		FPacked Packed;
+		Packed.Planes[0][0] = State.RandSeqSampleIndex;
+		Packed.Planes[0][1] = State.RandSeqSampleSeed;
+		Packed.Planes[0][2] = PackSharedExponent(State.Radiance, RadianceExponentBias);
+		Packed.Planes[0][3] = PackSharedExponent(State.PathThroughput, DefaultExponentBias);
+		FMemory::Memcpy(&Packed.Planes[1][0], &State.RayOrigin.X, sizeof(float));
+		FMemory::Memcpy(&Packed.Planes[1][1], &State.RayOrigin.Y, sizeof(float));
+		FMemory::Memcpy(&Packed.Planes[1][2], &State.RayOrigin.Z, sizeof(float));
+		Packed.Planes[1][3] = PackDirection(State.RayDirection);
+		Packed.Planes[2][0] = PackSharedExponent(State.Albedo, DefaultExponentBias);
+		Packed.Planes[2][1] = PackNormal(State.Normal);
+		Packed.Planes[2][2] = PackSharedExponent(State.SigmaT, DefaultExponentBias);
+		Packed.Planes[2][3] = PackUnorm(State.PathRoughness, 16) | (PackUnorm(State.BackgroundVisibility, 13) << 16) | ((State.FirstScatterType & 7) << 29);
+		return Packed;
+	}
+
+	inline FPathState Unpack (const FPacked & Packed)
+	{
+		FPathState State;
+		State.RandSeqSampleIndex = Packed.Planes[0][0];
+		State.RandSeqSampleSeed = Packed.Planes[0][1];
+		State.Radiance = UnpackSharedExponent(Packed.Planes[0][2], RadianceExponentBias);
+		State.PathThroughput = UnpackSharedExponent(Packed.Planes[0][3], DefaultExponentBias);
+		FMemory::Memcpy(&State.RayOrigin.X, &Packed.Planes[1][0], sizeof(float));
+		FMemory::Memcpy(&State.RayOrigin.Y, &Packed.Planes[1][1], sizeof(float));
+		FMemory::Memcpy(&State.RayOrigin.Z, &Packed.Planes[1][2], sizeof(float));
+		State.RayDirection = UnpackDirection(Packed.Planes[1][3]);
+		State.Albedo = UnpackSharedExponent(Packed.Planes[2][0], DefaultExponentBias);
+		State.Normal = UnpackNormal(Packed.Planes[2][1]);
+		State.SigmaT = UnpackSharedExponent(Packed.Planes[2][2], DefaultExponentBias);
+		State.PathRoughness = UnpackUnorm(Packed.Planes[2][3], 16);
+		State.BackgroundVisibility = UnpackUnorm(Packed.Planes[2][3] >> 16, 13);
+		State.FirstScatterType = Packed.Planes[2][3] >> 29;
+		return State;
+	}
+
+	// Largest error of a shared exponent channel, above the smallest value the bias allows: half a mantissa step of the largest channel.
+	inline float GetSharedExponentErrorBound (const FVector3f & Value)
+	{
+		return FMath::Max(FMath::Max(Value.X, Value.Y), Value.Z) / 256.f;
+	}
+}
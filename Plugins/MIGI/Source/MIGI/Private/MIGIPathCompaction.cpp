@@ -0,0 +1,269 @@
+﻿#include "MIGIPathCompaction.h"
+
+#include "PathTracing.h"
+#include "RenderGraphBuilder.h"
+#include "RenderGraphUtils.h"
+#include "ScenePrivate.h"
+
+#include "MIGIConstants.h"
+
+BEGIN_SHADER_PARAMETER_STRUCT(FMIGIPathCompactionParameters, )
+	SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<int>, PathSurvivors)
+	SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<uint>, GroupSums)
+	SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<int>, NextActivePaths)
+	SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<uint>, NumPathStates)
+	SHADER_PARAMETER(uint32, NumSlots)
+	SHADER_PARAMETER(uint32, NumGroups)
+	SHADER_PARAMETER(uint32, NumDispatchRows)
+END_SHADER_PARAMETER_STRUCT()
+
+BEGIN_SHADER_PARAMETER_STRUCT(FMIGIPathSortParameters, )
+	SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<int>, UnsortedPaths)
+	SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<int>, SortedPaths)
+	SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<uint>, SortKeys)
+	SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<uint>, BinOffsets)
+	SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<uint>, NumPathStates)
+	SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<FUintVector4>, PathStateData)
+	SHADER_PARAMETER(uint32, PathStatePlaneSize)
+	SHADER_PARAMETER(float, InvSortCellSize)
+END_SHADER_PARAMETER_STRUCT()
+
+class FMIGIPathCompactionShaderDefines final
+{
+public:
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		// Only used by the path tracer, whose platforms all have wave operations.
+		return ShouldCompilePathTracingShadersForProject(Parameters.Platform);
+	}
+
+	static void ModifyCompilationEnvironment(FShaderCompilerEnvironment& OutEnvironment)
+	{
+		OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE_1D"), C::ThreadGroupSize1D);
+		OutEnvironment.CompilerFlags.Add(CFLAG_WaveOperations);
+	}
+};
+
+class FMIGIPathCompactionCountCS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FMIGIPathCompactionCountCS);
+	SHADER_USE_PARAMETER_STRUCT(FMIGIPathCompactionCountCS, FGlobalShader);
+	using FParameters = FMIGIPathCompactionParameters;
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return FMIGIPathCompactionShaderDefines::ShouldCompilePermutation(Parameters);
+	}
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		FMIGIPathCompactionShaderDefines::ModifyCompilationEnvironment(OutEnvironment);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FMIGIPathCompactionCountCS,
+	"/Plugin/MIGI/Private/MIGIPathCompaction.usf", "PathCompactionCountCS",
+	EShaderFrequency::SF_Compute);
+
+class FMIGIPathCompactionScanGroupsCS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FMIGIPathCompactionScanGroupsCS);
+	SHADER_USE_PARAMETER_STRUCT(FMIGIPathCompactionScanGroupsCS, FGlobalShader);
+	using FParameters = FMIGIPathCompactionParameters;
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return FMIGIPathCompactionShaderDefines::ShouldCompilePermutation(Parameters);
+	}
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		FMIGIPathCompactionShaderDefines::ModifyCompilationEnvironment(OutEnvironment);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FMIGIPathCompactionScanGroupsCS,
+	"/Plugin/MIGI/Private/MIGIPathCompaction.usf", "PathCompactionScanGroupsCS",
+	EShaderFrequency::SF_Compute);
+
+class FMIGIPathCompactionScatterCS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FMIGIPathCompactionScatterCS);
+	SHADER_USE_PARAMETER_STRUCT(FMIGIPathCompactionScatterCS, FGlobalShader);
+	using FParameters = FMIGIPathCompactionParameters;
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return FMIGIPathCompactionShaderDefines::ShouldCompilePermutation(Parameters);
+	}
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		FMIGIPathCompactionShaderDefines::ModifyCompilationEnvironment(OutEnvironment);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FMIGIPathCompactionScatterCS,
+	"/Plugin/MIGI/Private/MIGIPathCompaction.usf", "PathCompactionScatterCS",
+	EShaderFrequency::SF_Compute);
+
+class FMIGIPathSortHistogramCS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FMIGIPathSortHistogramCS);
+	SHADER_USE_PARAMETER_STRUCT(FMIGIPathSortHistogramCS, FGlobalShader);
+	using FParameters = FMIGIPathSortParameters;
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return FMIGIPathCompactionShaderDefines::ShouldCompilePermutation(Parameters);
+	}
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		FMIGIPathCompactionShaderDefines::ModifyCompilationEnvironment(OutEnvironment);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FMIGIPathSortHistogramCS,
+	"/Plugin/MIGI/Private/MIGIPathCompaction.usf", "PathSortHistogramCS",
+	EShaderFrequency::SF_Compute);
+
+class FMIGIPathSortScanBinsCS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FMIGIPathSortScanBinsCS);
+	SHADER_USE_PARAMETER_STRUCT(FMIGIPathSortScanBinsCS, FGlobalShader);
+	using FParameters = FMIGIPathSortParameters;
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return FMIGIPathCompactionShaderDefines::ShouldCompilePermutation(Parameters);
+	}
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		FMIGIPathCompactionShaderDefines::ModifyCompilationEnvironment(OutEnvironment);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FMIGIPathSortScanBinsCS,
+	"/Plugin/MIGI/Private/MIGIPathCompaction.usf", "PathSortScanBinsCS",
+	EShaderFrequency::SF_Compute);
+
+class FMIGIPathSortScatterCS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FMIGIPathSortScatterCS);
+	SHADER_USE_PARAMETER_STRUCT(FMIGIPathSortScatterCS, FGlobalShader);
+	using FParameters = FMIGIPathSortParameters;
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return FMIGIPathCompactionShaderDefines::ShouldCompilePermutation(Parameters);
+	}
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		FMIGIPathCompactionShaderDefines::ModifyCompilationEnvironment(OutEnvironment);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FMIGIPathSortScatterCS,
+	"/Plugin/MIGI/Private/MIGIPathCompaction.usf", "PathSortScatterCS",
+	EShaderFrequency::SF_Compute);
+
+uint32 MIGIGetPathCompactionNumGroups(uint32 NumSlots)
+{
+	return FMath::DivideAndRoundUp<uint32>(NumSlots, C::ThreadGroupSize1D);
+}
+
+void MIGIAddPathCompactionPasses(FRDGBuilder& GraphBuilder, const FViewInfo& View, uint32 NumSlots,
+	FRDGBuffer* PathSurvivors, FRDGBuffer* GroupSums, FRDGBuffer* NextActivePaths, FRDGBuffer* NumPathStates, uint32 NumDispatchRows)
+{
+	RDG_EVENT_SCOPE(GraphBuilder, "MIGIPathCompaction");
+	const uint32 NumGroups = MIGIGetPathCompactionNumGroups(NumSlots);
+	auto MakeParameters = [&]()
+	{
+		auto PassParameters = GraphBuilder.AllocParameters<FMIGIPathCompactionParameters>();
+		PassParameters->PathSurvivors = GraphBuilder.CreateUAV(PathSurvivors, PF_R32_SINT);
+		PassParameters->GroupSums = GraphBuilder.CreateUAV(GroupSums, PF_R32_UINT);
+		PassParameters->NextActivePaths = GraphBuilder.CreateUAV(NextActivePaths, PF_R32_SINT);
+		PassParameters->NumPathStates = GraphBuilder.CreateUAV(NumPathStates, PF_R32_UINT);
+		PassParameters->NumSlots = NumSlots;
+		PassParameters->NumGroups = NumGroups;
+		PassParameters->NumDispatchRows = NumDispatchRows;
+		return PassParameters;
+	};
+
+	{
+		auto ComputeShader = View.ShaderMap->GetShader<FMIGIPathCompactionCountCS>();
+		auto PassParameters = MakeParameters();
+		ClearUnusedGraphResources(ComputeShader, PassParameters);
+		FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("Count"), ComputeShader, PassParameters, FIntVector(NumGroups, 1, 1));
+	}
+	{
+		auto ComputeShader = View.ShaderMap->GetShader<FMIGIPathCompactionScanGroupsCS>();
+		auto PassParameters = MakeParameters();
+		ClearUnusedGraphResources(ComputeShader, PassParameters);
+		FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("ScanGroups"), ComputeShader, PassParameters, FIntVector(1, 1, 1));
+	}
+	{
+		auto ComputeShader = View.ShaderMap->GetShader<FMIGIPathCompactionScatterCS>();
+		auto PassParameters = MakeParameters();
+		ClearUnusedGraphResources(ComputeShader, PassParameters);
+		FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("Scatter"), ComputeShader, PassParameters, FIntVector(NumGroups, 1, 1));
+	}
+}
+
+void MIGIAddPathSortPasses(FRDGBuilder& GraphBuilder, const FViewInfo& View, uint32 NumSlots, float CellSize,
+	FRDGBuffer* PathStateData, uint32 PathStatePlaneSize, FRDGBuffer* UnsortedPaths, FRDGBuffer* NumPathStates,
+	FRDGBuffer* SortKeys, FRDGBuffer* SortedPaths)
+{
+	RDG_EVENT_SCOPE(GraphBuilder, "MIGIPathSort");
+	const uint32 NumGroups = MIGIGetPathCompactionNumGroups(NumSlots);
+	FRDGBuffer* BinOffsets = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(uint32), MIGIPathCompaction::NumSortBins), TEXT("MIGI.PathSortBinOffsets"));
+	AddClearUAVPass(GraphBuilder, GraphBuilder.CreateUAV(BinOffsets, PF_R32_UINT), 0);
+	auto MakeParameters = [&]()
+	{
+		auto PassParameters = GraphBuilder.AllocParameters<FMIGIPathSortParameters>();
+		PassParameters->UnsortedPaths = GraphBuilder.CreateSRV(UnsortedPaths, PF_R32_SINT);
+		PassParameters->SortedPaths = GraphBuilder.CreateUAV(SortedPaths, PF_R32_SINT);
+		PassParameters->SortKeys = GraphBuilder.CreateUAV(SortKeys, PF_R32_UINT);
+		PassParameters->BinOffsets = GraphBuilder.CreateUAV(BinOffsets, PF_R32_UINT);
+		PassParameters->NumPathStates = GraphBuilder.CreateUAV(NumPathStates, PF_R32_UINT);
+		PassParameters->PathStateData = GraphBuilder.CreateSRV(PathStateData);
+		PassParameters->PathStatePlaneSize = PathStatePlaneSize;
+		PassParameters->InvSortCellSize = 1.f / CellSize;
+		return PassParameters;
+	};
+
+	{
+		auto ComputeShader = View.ShaderMap->GetShader<FMIGIPathSortHistogramCS>();
+		auto PassParameters = MakeParameters();
+		ClearUnusedGraphResources(ComputeShader, PassParameters);
+		FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("Histogram"), ComputeShader, PassParameters, FIntVector(NumGroups, 1, 1));
+	}
+	{
+		auto ComputeShader = View.ShaderMap->GetShader<FMIGIPathSortScanBinsCS>();
+		auto PassParameters = MakeParameters();
+		ClearUnusedGraphResources(ComputeShader, PassParameters);
+		FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("ScanBins"), ComputeShader, PassParameters, FIntVector(1, 1, 1));
+	}
+	{
+		auto ComputeShader = View.ShaderMap->GetShader<FMIGIPathSortScatterCS>();
+		auto PassParameters = MakeParameters();
+		ClearUnusedGraphResources(ComputeShader, PassParameters);
+		FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("Scatter"), ComputeShader, PassParameters, FIntVector(NumGroups, 1, 1));
+	}
+}
@@ -0,0 +1,163 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+class FRDGBuilder;
+class FRDGBuffer;
+class FViewInfo;
+
+// Stream compaction of the paths surviving a bounce of the wavefront path tracer. See MIGIPathCompaction.usf.
+// The path tracer writes the pixel index of each surviving path, or -1, to the slot it ran on. The passes gather
+// the survivors into the active path list of the next bounce and write its size and indirect dispatch arguments.
+// Survivors keep their slot order, so paths that were neighbours on screen stay neighbours in the next dispatch.
+
+// Size of the group sums buffer for NumSlots slots.
+uint32 MIGIGetPathCompactionNumGroups (uint32 NumSlots);
+
+// PathSurvivors: int per slot, reset to -1 once compacted. NextActivePaths: int per slot. GroupSums: uint per group.
+// NumPathStates: 3 uints, the number of active paths then NumDispatchRows, 1.
+void MIGIAddPathCompactionPasses (FRDGBuilder & GraphBuilder, const FViewInfo & View, uint32 NumSlots,
+	FRDGBuffer * PathSurvivors, FRDGBuffer * GroupSums, FRDGBuffer * NextActivePaths, FRDGBuffer * NumPathStates,
+	uint32 NumDispatchRows = 1);
+
+// Optional binning of the compacted paths, so the rays of the next bounce that go the same way from the same region
+// and shade alike are dispatched together. Reads UnsortedPaths[0, NumPathStates[0]) and writes SortedPaths.
+// PathStateData is the packed path state, see MIGIPackedPathState.h. SortKeys: uint per slot.
+void MIGIAddPathSortPasses (FRDGBuilder & GraphBuilder, const FViewInfo & View, uint32 NumSlots, float CellSize,
+	FRDGBuffer * PathStateData, uint32 PathStatePlaneSize, FRDGBuffer * UnsortedPaths, FRDGBuffer * NumPathStates,
+	FRDGBuffer * SortKeys, FRDGBuffer * SortedPaths);
+
+// CPU reference of the passes, same groups, same waves, same order.
+namespace MIGIPathCompaction
+{
+	// Exclusive prefix sum over one thread group, the way GroupPrefixSum of the shader builds it:
+	// a prefix within each wave, plus the totals of the waves before it. Returns the group total.
+	inline uint32 GroupPrefixSum (TConstArrayView<uint32> Values, uint32 WaveSize, TArray<uint32> & OutPrefix)
+	{
+		const int32 NumWaves = FMath::DivideAndRoundUp(Values.Num(), (int32)WaveSize);
+		TArray<uint32> WaveSums;
+		WaveSums.SetNumZeroed(NumWaves);
+		OutPrefix.SetNumZeroed(Values.Num());
+		for(int32 Index = 0; Index < Values.Num(); Index++)
+		{
+			const int32 Wave = Index / (int32)WaveSize;
+			// WavePrefixSum
+			OutPrefix[Index] = WaveSums[Wave];
+			// WaveActiveSum
+			WaveSums[Wave] += Values[Index];
+		}
+		uint32 Total = 0;
+		for(int32 Wave = 0; Wave < NumWaves; Wave++)
+		{
+			const int32 End = FMath::Min((Wave + 1) * (int32)WaveSize, Values.Num());
+			for(int32 Index = Wave * (int32)WaveSize; Index < End; Index++)
+			{
+				OutPrefix[Index] += Total;
+			}
+			Total += WaveSums[Wave];
+		}
+		return Total;
+	}
+
+	// Count, scan the group counts, scatter. Survivors are reset to -1, OutActivePaths has the same size, -1 past the
+	// active paths. Returns the number of active paths.
+	inline uint32 Compact (TArray<int32> & Survivors, uint32 GroupSize, uint32 WaveSize, TArray<int32> & OutActivePaths)
+	{
+		const int32 NumSlots = Survivors.Num();
+		const int32 NumGroups = FMath::DivideAndRoundUp(NumSlots, (int32)GroupSize);
+		TArray<uint32> Flags;
+		Flags.SetNumZeroed(NumGroups * (int32)GroupSize);
+		for(int32 Slot = 0; Slot < NumSlots; Slot++)
+		{
+			Flags[Slot] = Survivors[Slot] >= 0 ? 1 : 0;
+		}
+
+		TArray<uint32> Ranks, GroupRanks, GroupSums;
+		GroupSums.SetNumZeroed(NumGroups);
+		for(int32 Group = 0; Group < NumGroups; Group++)
+		{
+			GroupSums[Group] = GroupPrefixSum(TConstArrayView<uint32>(Flags.GetData() + Group * GroupSize, GroupSize), WaveSize, GroupRanks);
+		}
+
+		// The scan pass is a single group walking over the counts, one group sized chunk at a time.
+		uint32 Carry = 0;
+		for(int32 Base = 0; Base < NumGroups; Base += (int32)GroupSize)
+		{
+			const int32 ChunkSize = FMath::Min((int32)GroupSize, NumGroups - Base);
+			TArray<uint32> Chunk;
+			Chunk.SetNumZeroed(GroupSize);
+			for(int32 Index = 0; Index < ChunkSize; Index++)
+			{
+				Chunk[Index] = GroupSums[Base + Index];
+			}
+			const uint32 ChunkTotal = GroupPrefixSum(Chunk, WaveSize, Ranks);
+			for(int32 Index = 0; Index < ChunkSize; Index++)
+			{
+				GroupSums[Base + Index] = Carry + Ranks[Index];
+			}
+			Carry += ChunkTotal;
+		}
+
+		OutActivePaths.Init(-1, NumSlots);
+		for(int32 Group = 0; Group < NumGroups; Group++)
+		{
+			GroupPrefixSum(TConstArrayView<uint32>(Flags.GetData() + Group * GroupSize, GroupSize), WaveSize, GroupRanks);
+			for(int32 Thread = 0; Thread < (int32)GroupSize; Thread++)
+			{
+				const int32 Slot = Group * (int32)GroupSize + Thread;
+				if(Slot < NumSlots && Survivors[Slot] >= 0)
+				{
+					OutActivePaths[GroupSums[Group] + GroupRanks[Thread]] = Survivors[Slot];
+					Survivors[Slot] = -1;
+				}
+			}
+		}
+		return Carry;
+	}
+
+	// Sort key of a path: shading class, then ray direction octant, then the Morton code of the origin cell.
+	// Paths within a key trace and shade alike, nearby keys are nearby regions of the same octant.
+	constexpr uint32 NumSortBins = 1024;
+	// Cells per axis, centered on the camera. The outer cells take everything beyond.
+	constexpr int32 NumSortCells = 4;
+	// Above it, a path samples its lobes like a diffuse one. PathRoughness only grows along a path.
+	constexpr float SortRoughClassThreshold = 0.5f;
+
+	inline uint32 ComputeSortKey (const FVector3f & TranslatedOrigin, const FVector3f & Direction, float PathRoughness, float CellSize)
+	{
+		const uint32 Octant = (Direction.X < 0.f ? 1 : 0) | (Direction.Y < 0.f ? 2 : 0) | (Direction.Z < 0.f ? 4 : 0);
+		const float Origin[3] = {TranslatedOrigin.X, TranslatedOrigin.Y, TranslatedOrigin.Z};
+		uint32 Morton = 0;
+		for(int32 Axis = 0; Axis < 3; Axis++)
+		{
+			const uint32 Cell = (uint32)FMath::Clamp(FMath::FloorToInt(Origin[Axis] / CellSize) + NumSortCells / 2, 0, NumSortCells - 1);
+			Morton |= ((Cell & 1) << Axis) | ((Cell >> 1) << (Axis + 3));
+		}
+		const uint32 ShadingClass = PathRoughness >= SortRoughClassThreshold ? 1 : 0;
+		return (ShadingClass << 9) | (Octant << 6) | Morton;
+	}
+
+	// Counting sort of Paths by Keys: histogram, exclusive scan of the bins, scatter. The GPU groups reserve their
+	// ranges of a bin in any order, so only the order of the bins is the same there.
+	inline void SortByKey (TConstArrayView<int32> Paths, TConstArrayView<uint32> Keys, TArray<int32> & OutSortedPaths)
+	{
+		TArray<uint32> BinOffsets;
+		BinOffsets.SetNumZeroed(NumSortBins);
+		for(int32 Index = 0; Index < Keys.Num(); Index++)
+		{
+			BinOffsets[Keys[Index]]++;
+		}
+		uint32 Total = 0;
+		for(uint32 Bin = 0; Bin < NumSortBins; Bin++)
+		{
+			const uint32 Count = BinOffsets[Bin];
+			BinOffsets[Bin] = Total;
+			Total += Count;
+		}
+		OutSortedPaths.SetNumZeroed(Paths.Num());
+		for(int32 Index = 0; Index < Paths.Num(); Index++)
+		{
+			OutSortedPaths[BinOffsets[Keys[Index]]++] = Paths[Index];
+		}
+	}
+}
@@ -0,0 +1,93 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "PixelFormat.h"
+
+// Formats of the path tracer accumulation targets, and CPU references of what storing into them does to the data.
+namespace MIGIPathTracingFormats
+{
+	// r.MIGI.PathTracing.AlbedoFormat
+	enum class EAlbedoFormat : int32
+	{
+		Float32,
+		Float16,
+		// Albedo is in [0, 1], 10 bits per channel are plenty for the denoiser. The alpha channel keeps 2 bits.
+		Unorm10
+	};
+
+	// r.MIGI.PathTracing.NormalFormat
+	enum class ENormalFormat : int32
+	{
+		// The alpha channel holds the depth, fp32 keeps it exact.
+		Float32,
+		Float16
+	};
+
+	// Radiance keeps fp32, a running mean over thousands of samples stalls in fp16.
+	constexpr EPixelFormat RadianceFormat = PF_A32B32G32R32F;
+
+	inline EPixelFormat GetPixelFormat (EAlbedoFormat Format)
+	{
+		switch(Format)
+		{
+			case EAlbedoFormat::Float16: return PF_FloatRGBA;
+			case EAlbedoFormat::Unorm10: return PF_A2B10G10R10;
+			default: return PF_A32B32G32R32F;
+		}
+	}
+
+	inline EPixelFormat GetPixelFormat (ENormalFormat Format)
+	{
+		return Format == ENormalFormat::Float16 ? PF_FloatRGBA : PF_A32B32G32R32F;
+	}
+
+	// What a UNORM channel of NumBits stores for Value.
+	inline float QuantizeUnorm (float Value, uint32 NumBits)
+	{
+		const float MaxValue = (float)((1u << NumBits) - 1);
+		return FMath::RoundToFloat(FMath::Clamp(Value, 0.f, 1.f) * MaxValue) / MaxValue;
+	}
+
+	// What a half float channel stores for Value.
+	inline float QuantizeHalf (float Value)
+	{
+		return FFloat16(Value).GetFloat();
+	}
+
+	inline FVector4f Quantize (EAlbedoFormat Format, const FVector4f & Albedo)
+	{
+		switch(Format)
+		{
+			case EAlbedoFormat::Float16:
+				return FVector4f(QuantizeHalf(Albedo.X), QuantizeHalf(Albedo.Y), QuantizeHalf(Albedo.Z), QuantizeHalf(Albedo.W));
+			case EAlbedoFormat::Unorm10:
+				return FVector4f(QuantizeUnorm(Albedo.X, 10), QuantizeUnorm(Albedo.Y, 10), QuantizeUnorm(Albedo.Z, 10), QuantizeUnorm(Albedo.W, 2));
+			default:
+				return Albedo;
+		}
+	}
+
+	// Octahedral mapping of a unit vector to [-1, 1]^2: project on the octahedron, fold the lower half over the upper one.
+	// Two channels instead of three, with an error spread evenly over the sphere.
+	inline FVector2f EncodeOctahedral (const FVector3f & N)
+	{
+		const float L1 = FMath::Abs(N.X) + FMath::Abs(N.Y) + FMath::Abs(N.Z);
+		FVector2f E(N.X / L1, N.Y / L1);
+		if(N.Z < 0.f)
+		{
+			E = FVector2f(
+				(1.f - FMath::Abs(E.Y)) * (E.X >= 0.f ? 1.f : -1.f),
+				(1.f - FMath::Abs(E.X)) * (E.Y >= 0.f ? 1.f : -1.f));
+		}
+		return E;
+	}
+
+	inline FVector3f DecodeOctahedral (const FVector2f & E)
+	{
+		FVector3f N(E.X, E.Y, 1.f - FMath::Abs(E.X) - FMath::Abs(E.Y));
+		const float T = FMath::Max(-N.Z, 0.f);
+		N.X += N.X >= 0.f ? -T : T;
+		N.Y += N.Y >= 0.f ? -T : T;
+		return N.GetSafeNormal();
+	}
+}
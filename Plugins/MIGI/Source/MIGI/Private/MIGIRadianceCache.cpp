@@ -0,0 +1,345 @@
+﻿#include "MIGIRadianceCache.h"
+
+#include "RenderGraphBuilder.h"
+#include "RenderGraphUtils.h"
+#include "RHIGPUReadback.h"
+#include "ScenePrivate.h"
+
+#include "MIGIAdaptiveSampling.h"
+#include "MIGIConstants.h"
+#include "MIGILogCategory.h"
+#include "MIGINN.h"
+#include "MIGINNAdapter.h"
+#include "MIGIRendering.h"
+
+BEGIN_SHADER_PARAMETER_STRUCT(FMIGIRadianceCachePassParameters, )
+	SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<FMIGIRadianceCacheQuery>, RadianceCacheQueries)
+	SHADER_PARAMETER_RDG_BUFFER_SRV(Buffer<float>, RadianceCacheQueryLuminance)
+	SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<FMIGIRadianceCacheTrainingPath>, RadianceCacheTrainingPaths)
+	SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<FMIGIRadianceCacheTrainingVertex>, RadianceCacheTrainingVertices)
+	SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<FMIGIRadianceCacheTrainingSample>, RadianceCacheTrainingSamples)
+	SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<uint>, RadianceCacheCounters)
+	SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<float>, NNInputBuffer)
+	SHADER_PARAMETER_RDG_BUFFER_SRV(StructuredBuffer<float>, NNOutputBuffer)
+	SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float4>, RadianceTexture)
+	SHADER_PARAMETER_RDG_TEXTURE_UAV(RWTexture2D<float2>, LuminanceMoments)
+	SHADER_PARAMETER(uint32, AdaptiveSampling)
+	SHADER_PARAMETER(uint32, Iteration)
+	// Offsets (in floats) of the ring slots used by this frame inside the shared buffers.
+	SHADER_PARAMETER(uint32, NNInputSlotOffset)
+	SHADER_PARAMETER(uint32, NNOutputSlotOffset)
+	SHADER_PARAMETER(uint32, NumPixelQueries)
+	SHADER_PARAMETER(uint32, MaxTrainingPaths)
+	SHADER_PARAMETER(uint32, NumQueries)
+	SHADER_PARAMETER(uint32, NumTrainingSamples)
+	SHADER_PARAMETER(float, BlendFactor)
+	SHADER_PARAMETER(FVector3f, TranslatedOrigin)
+	SHADER_PARAMETER(float, InvSceneExtent)
+END_SHADER_PARAMETER_STRUCT()
+
+class FMIGIRadianceCacheShaderDefines final
+{
+public:
+
+	static void ModifyCompilationEnvironment(FShaderCompilerEnvironment& OutEnvironment)
+	{
+		OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE_1D"), C::ThreadGroupSize1D);
+		OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE_2D"), C::ThreadGroupSize2D);
+		OutEnvironment.SetDefine(TEXT("NN_INPUT_WIDTH"), C::NNInputWidth);
+		OutEnvironment.SetDefine(TEXT("NN_OUTPUT_WIDTH"), C::NNOutputWidth);
+	}
+};
+
+class FMIGIRadianceCacheEncodeCS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FMIGIRadianceCacheEncodeCS);
+	SHADER_USE_PARAMETER_STRUCT(FMIGIRadianceCacheEncodeCS, FGlobalShader);
+	using FParameters = FMIGIRadianceCachePassParameters;
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		FMIGIRadianceCacheShaderDefines::ModifyCompilationEnvironment(OutEnvironment);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FMIGIRadianceCacheEncodeCS,
+	"/Plugin/MIGI/Private/MIGIRadianceCache.usf", "RadianceCacheEncodeCS",
+	EShaderFrequency::SF_Compute);
+
+class FMIGIRadianceCacheResolveCS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FMIGIRadianceCacheResolveCS);
+	SHADER_USE_PARAMETER_STRUCT(FMIGIRadianceCacheResolveCS, FGlobalShader);
+	using FParameters = FMIGIRadianceCachePassParameters;
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		FMIGIRadianceCacheShaderDefines::ModifyCompilationEnvironment(OutEnvironment);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FMIGIRadianceCacheResolveCS,
+	"/Plugin/MIGI/Private/MIGIRadianceCache.usf", "RadianceCacheResolveCS",
+	EShaderFrequency::SF_Compute);
+
+class FMIGIRadianceCacheBuildTrainingCS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FMIGIRadianceCacheBuildTrainingCS);
+	SHADER_USE_PARAMETER_STRUCT(FMIGIRadianceCacheBuildTrainingCS, FGlobalShader);
+	using FParameters = FMIGIRadianceCachePassParameters;
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		FMIGIRadianceCacheShaderDefines::ModifyCompilationEnvironment(OutEnvironment);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FMIGIRadianceCacheBuildTrainingCS,
+	"/Plugin/MIGI/Private/MIGIRadianceCache.usf", "RadianceCacheBuildTrainingCS",
+	EShaderFrequency::SF_Compute);
+
+class FMIGIRadianceCacheFillTrainingCS : public FGlobalShader
+{
+public:
+	DECLARE_GLOBAL_SHADER(FMIGIRadianceCacheFillTrainingCS);
+	SHADER_USE_PARAMETER_STRUCT(FMIGIRadianceCacheFillTrainingCS, FGlobalShader);
+	using FParameters = FMIGIRadianceCachePassParameters;
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		FMIGIRadianceCacheShaderDefines::ModifyCompilationEnvironment(OutEnvironment);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FMIGIRadianceCacheFillTrainingCS,
+	"/Plugin/MIGI/Private/MIGIRadianceCache.usf", "RadianceCacheFillTrainingCS",
+	EShaderFrequency::SF_Compute);
+
+void FMIGIRadianceCacheFrame::SetPathParameters(FRDGBuilder& GraphBuilder, FRDGBufferRef PathStates, FMIGIRadianceCachePathParameters& OutParameters) const
+{
+	OutParameters.RadianceCacheQueries = GraphBuilder.CreateUAV(Queries);
+	OutParameters.RadianceCacheTrainingPaths = GraphBuilder.CreateUAV(TrainingPaths);
+	OutParameters.RadianceCacheTrainingVertices = GraphBuilder.CreateUAV(TrainingVertices);
+	OutParameters.RadianceCacheCounters = GraphBuilder.CreateUAV(Counters, PF_R32_UINT);
+	OutParameters.RadianceCacheQueryLuminance = GraphBuilder.CreateUAV(QueryLuminance, PF_R32_FLOAT);
+	OutParameters.RadianceCachePathStates = PathStates ? GraphBuilder.CreateUAV(PathStates) : nullptr;
+	OutParameters.RadianceCacheSpreadThreshold = Settings.SpreadThreshold;
+	OutParameters.RadianceCacheTrainingPathRatio = Settings.TrainingPathRatio;
+	OutParameters.RadianceCacheMaxTrainingPaths = MaxTrainingPaths;
+	OutParameters.RadianceCacheMaxPixelQueries = NumPixelQueries;
+	OutParameters.RadianceCacheTrainingBounces = Settings.TrainingBounces;
+}
+
+// Size the batches of the frame for NumPixelQueries pixel queries. Returns false when they don't fit in a ring slot.
+static bool SizeRadianceCacheFrame(uint32 NumPixelQueries, uint32 NumTrainingVertices, FMIGIRadianceCacheFrame& Frame)
+{
+	Frame.NumPixelQueries = NumPixelQueries;
+	Frame.MaxTrainingPaths = FMath::Max(FMath::CeilToInt((float)NumPixelQueries * Frame.Settings.TrainingPathRatio), 1);
+	Frame.NumQueries = Align(NumPixelQueries + Frame.MaxTrainingPaths, C::NNBatchGranularity);
+	Frame.NumTrainingSamples = Align(Frame.MaxTrainingPaths * NumTrainingVertices, C::NNBatchGranularity);
+
+	// Inference of the pixel queries and the training path tails, then the training batch, in a single ring slot.
+	const size_t InputSize = (size_t)Frame.NumQueries * C::NNInputWidth * sizeof(float)
+		+ (size_t)Frame.NumTrainingSamples * (C::NNInputWidth + C::NNOutputWidth) * sizeof(float);
+	const size_t OutputSize = (size_t)Frame.NumQueries * C::NNOutputWidth * sizeof(float);
+	return InputSize <= IMIGINNAdapter::GetSharedInputSlotSize() && OutputSize <= IMIGINNAdapter::GetSharedOutputSlotSize();
+}
+
+bool MIGIBeginRadianceCache(FRDGBuilder& GraphBuilder, FIntPoint ViewSize, FMIGIRadianceCacheFrame& OutFrame)
+{
+	if(!IsMIGIRadianceCache()) return false;
+	OutFrame.Settings = GetMIGIRadianceCacheSettings();
+	// A training path records up to TrainingBounces + 1 vertices, the batch is sized for all of them.
+	const uint32 NumTrainingVertices = FMath::Min<uint32>(OutFrame.Settings.TrainingBounces + 1, MIGIRadianceCacheMaxTrainingVertices);
+
+	// Every pixel query brings TrainingPathRatio training paths along, with their tail and their vertices.
+	// The estimate ignores the padding to C::NNBatchGranularity, it's taken off a batch at a time below.
+	const uint32 NumViewPixels = ViewSize.X * ViewSize.Y;
+	const double Ratio = OutFrame.Settings.TrainingPathRatio;
+	const double InputFloatsPerQuery = (1.0 + Ratio) * C::NNInputWidth + Ratio * NumTrainingVertices * (C::NNInputWidth + C::NNOutputWidth);
+	const double OutputFloatsPerQuery = (1.0 + Ratio) * C::NNOutputWidth;
+	uint32 NumPixelQueries = (uint32)FMath::Min<double>(NumViewPixels, FMath::Min(
+		(double)(IMIGINNAdapter::GetSharedInputSlotSize() / sizeof(float)) / InputFloatsPerQuery,
+		(double)(IMIGINNAdapter::GetSharedOutputSlotSize() / sizeof(float)) / OutputFloatsPerQuery));
+	while(NumPixelQueries > 0 && !SizeRadianceCacheFrame(NumPixelQueries, NumTrainingVertices, OutFrame))
+	{
+		NumPixelQueries -= FMath::Min(NumPixelQueries, C::NNBatchGranularity);
+	}
+	if(NumPixelQueries == 0)
+	{
+		static bool bWarned = false;
+		if(!bWarned)
+		{
+			UE_LOG(MIGI, Warning, TEXT("The radiance cache doesn't fit in a ring slot of %llu KiB, raise r.MIGI.SharedBufferSize. Disabled."),
+				(uint64)(IMIGINNAdapter::GetSharedInputSlotSize() / 1024));
+			bWarned = true;
+		}
+		return false;
+	}
+	// The paths past the cap are traced to the end, see ContinueRadianceCachePath.
+	if(NumPixelQueries < NumViewPixels)
+	{
+		static bool bWarnedCapped = false;
+		if(!bWarnedCapped)
+		{
+			UE_LOG(MIGI, Warning, TEXT("Only %u of the %u pixels at %dx%d can terminate into the radiance cache per frame, raise r.MIGI.SharedBufferSize for the rest."),
+				NumPixelQueries, NumViewPixels, ViewSize.X, ViewSize.Y);
+			bWarnedCapped = true;
+		}
+	}
+
+	OutFrame.Queries = GraphBuilder.CreateBuffer(
+		FRDGBufferDesc::CreateStructuredDesc(sizeof(FMIGIRadianceCacheQuery), OutFrame.NumPixelQueries), TEXT("MIGI.RadianceCache.Queries"));
+	OutFrame.QueryLuminance = GraphBuilder.CreateBuffer(
+		FRDGBufferDesc::CreateBufferDesc(sizeof(float), OutFrame.NumPixelQueries), TEXT("MIGI.RadianceCache.QueryLuminance"));
+	OutFrame.TrainingPaths = GraphBuilder.CreateBuffer(
+		FRDGBufferDesc::CreateStructuredDesc(sizeof(FMIGIRadianceCacheTrainingPath), OutFrame.MaxTrainingPaths), TEXT("MIGI.RadianceCache.TrainingPaths"));
+	OutFrame.TrainingVertices = GraphBuilder.CreateBuffer(
+		FRDGBufferDesc::CreateStructuredDesc(sizeof(FMIGIRadianceCacheTrainingVertex), OutFrame.MaxTrainingPaths * MIGIRadianceCacheMaxTrainingVertices),
+		TEXT("MIGI.RadianceCache.TrainingVertices"));
+	OutFrame.TrainingSamples = GraphBuilder.CreateBuffer(
+		FRDGBufferDesc::CreateStructuredDesc(sizeof(FMIGIRadianceCacheTrainingSample), OutFrame.MaxTrainingPaths * MIGIRadianceCacheMaxTrainingVertices),
+		TEXT("MIGI.RadianceCache.TrainingSamples"));
+	OutFrame.Counters = GraphBuilder.CreateBuffer(FRDGBufferDesc::CreateBufferDesc(sizeof(uint32), 3), TEXT("MIGI.RadianceCache.Counters"));
+	AddClearUAVPass(GraphBuilder, GraphBuilder.CreateUAV(OutFrame.Counters, PF_R32_UINT), 0);
+	// Training paths that are not allocated this frame are never read, but the encoding pass reads their tails.
+	AddClearUAVPass(GraphBuilder, GraphBuilder.CreateUAV(OutFrame.TrainingPaths), 0);
+	return true;
+}
+
+void MIGIResolveRadianceCache(FRDGBuilder& GraphBuilder, const FViewInfo& View, const FMIGIRadianceCacheFrame& Frame,
+	FRDGTextureRef RadianceTexture, float BlendFactor, uint32 Iteration, const FMIGIAdaptiveSamplingFrame & AdaptiveSampling)
+{
+	RDG_EVENT_SCOPE(GraphBuilder, "MIGI Radiance Cache");
+	auto Adapter = IMIGINNAdapter::GetInstance();
+	FRDGBufferRef NNInputBufferRDG = GraphBuilder.RegisterExternalBuffer(
+		MIGIRenderingContext::Get().GetNNInputBufferRDG(), TEXT("MIGINNInputBuffer"));
+	FRDGBufferRef NNOutputBufferRDG = GraphBuilder.RegisterExternalBuffer(
+		MIGIRenderingContext::Get().GetNNOutputBufferRDG(), TEXT("MIGINNOutputBuffer"));
+
+	// The ring advanced in MIGIRenderDiffuseIndirect, every frame pass of the path tracer shares the slot of the frame.
+	const uint32 Slot = Adapter->GetCurrentSlot();
+	const uint32 NumQueries = Frame.NumQueries;
+	// Nothing to train on: skip the step instead of training on an empty batch. Only known a few frames late,
+	// the batch is then filled so the step doesn't move the predictions, see RadianceCacheFillTrainingCS.
+	FMIGIRadianceCacheSampleCount & SampleCount = MIGIRenderingContext::Get().GetRadianceCacheSampleCount(View);
+	SampleCount.UpdateReadback();
+	const bool bTrain = SampleCount.NumTrainingSamples > 0;
+
+	auto MakeParameters = [&]()
+	{
+		auto PassParameters = GraphBuilder.AllocParameters<FMIGIRadianceCachePassParameters>();
+		PassParameters->RadianceCacheQueries = GraphBuilder.CreateSRV(Frame.Queries);
+		PassParameters->RadianceCacheQueryLuminance = GraphBuilder.CreateSRV(Frame.QueryLuminance, PF_R32_FLOAT);
+		PassParameters->RadianceCacheTrainingPaths = GraphBuilder.CreateSRV(Frame.TrainingPaths);
+		PassParameters->RadianceCacheTrainingVertices = GraphBuilder.CreateSRV(Frame.TrainingVertices);
+		PassParameters->RadianceCacheTrainingSamples = GraphBuilder.CreateUAV(Frame.TrainingSamples);
+		PassParameters->RadianceCacheCounters = GraphBuilder.CreateUAV(Frame.Counters, PF_R32_UINT);
+		PassParameters->NNInputBuffer = GraphBuilder.CreateUAV(FRDGBufferUAVDesc{NNInputBufferRDG});
+		PassParameters->NNOutputBuffer = GraphBuilder.CreateSRV(FRDGBufferSRVDesc{NNOutputBufferRDG});
+		PassParameters->RadianceTexture = GraphBuilder.CreateUAV(RadianceTexture);
+		// A placeholder when adaptive sampling is off, never written then.
+		PassParameters->LuminanceMoments = GraphBuilder.CreateUAV(AdaptiveSampling.LuminanceMoments);
+		PassParameters->AdaptiveSampling = AdaptiveSampling.bEnabled ? 1 : 0;
+		PassParameters->Iteration = Iteration;
+		PassParameters->NNInputSlotOffset = IMIGINNAdapter::GetInputSlotOffset(Slot) / sizeof(float);
+		PassParameters->NNOutputSlotOffset = IMIGINNAdapter::GetOutputSlotOffset(Slot) / sizeof(float);
+		PassParameters->NumPixelQueries = Frame.NumPixelQueries;
+		PassParameters->MaxTrainingPaths = Frame.MaxTrainingPaths;
+		PassParameters->NumQueries = NumQueries;
+		PassParameters->NumTrainingSamples = Frame.NumTrainingSamples;
+		PassParameters->BlendFactor = BlendFactor;
+		PassParameters->TranslatedOrigin = FVector3f(View.ViewMatrices.GetPreViewTranslation());
+		PassParameters->InvSceneExtent = 1.f / Frame.Settings.SceneExtent;
+		return PassParameters;
+	};
+
+	// Encode the queries and run a single inference over all of them.
+	{
+		auto ComputeShader = View.ShaderMap->GetShader<FMIGIRadianceCacheEncodeCS>();
+		auto PassParameters = MakeParameters();
+		ClearUnusedGraphResources(ComputeShader, PassParameters);
+		GraphBuilder.AddPass(RDG_EVENT_NAME("MIGIRadianceCacheEncode"), PassParameters,
+			ERDGPassFlags::Compute | ERDGPassFlags::NeverCull,
+			[ComputeShader, PassParameters, NumQueries, Slot](FRHICommandListImmediate& RHICmdList)
+			{
+				auto Adapter = IMIGINNAdapter::GetInstance();
+				// Don't overwrite the slot until CUDA is done with the frame that used it last.
+				Adapter->WaitForSlot(RHICmdList, Slot);
+				FComputeShaderUtils::Dispatch(RHICmdList, ComputeShader, *PassParameters,
+					FComputeShaderUtils::GetGroupCount(NumQueries, C::ThreadGroupSize1D));
+				Adapter->SynchronizeToNN(RHICmdList);
+				// MIGINNInference() may allocate and wait for the device, flush the signal first. See MIGIRenderDiffuseIndirect.
+				RHICmdList.SubmitCommandsHint();
+				MIGINNInference(MIGINNInferenceParams {
+					.InInputBufferOffset = IMIGINNAdapter::GetInputSlotOffset(Slot),
+					.InOutputBufferOffset = IMIGINNAdapter::GetOutputSlotOffset(Slot),
+					.InNumElements = NumQueries
+				});
+			});
+	}
+	// Add the predictions to the pixels that terminated into the cache.
+	{
+		auto ComputeShader = View.ShaderMap->GetShader<FMIGIRadianceCacheResolveCS>();
+		auto PassParameters = MakeParameters();
+		ClearUnusedGraphResources(ComputeShader, PassParameters);
+		GraphBuilder.AddPass(RDG_EVENT_NAME("MIGIRadianceCacheResolve"), PassParameters,
+			ERDGPassFlags::Compute | ERDGPassFlags::NeverCull,
+			[ComputeShader, PassParameters, NumPixelQueries = Frame.NumPixelQueries, Slot](FRHICommandListImmediate& RHICmdList)
+			{
+				IMIGINNAdapter::GetInstance()->SynchronizeFromNN(RHICmdList, Slot);
+				FComputeShaderUtils::Dispatch(RHICmdList, ComputeShader, *PassParameters,
+					FComputeShaderUtils::GetGroupCount(NumPixelQueries, C::ThreadGroupSize1D));
+			});
+	}
+	// Turn the training vertices into samples, their targets need the predictions at the tails.
+	{
+		auto ComputeShader = View.ShaderMap->GetShader<FMIGIRadianceCacheBuildTrainingCS>();
+		auto PassParameters = MakeParameters();
+		ClearUnusedGraphResources(ComputeShader, PassParameters);
+		FComputeShaderUtils::AddPass(GraphBuilder, RDG_EVENT_NAME("MIGIRadianceCacheBuildTraining"), ComputeShader, PassParameters,
+			FComputeShaderUtils::GetGroupCount(Frame.MaxTrainingPaths * MIGIRadianceCacheMaxTrainingVertices, C::ThreadGroupSize1D));
+	}
+	if(!SampleCount.bReadbackPending)
+	{
+		if(!SampleCount.Readback.IsValid())
+		{
+			SampleCount.Readback = MakeUnique<FRHIGPUBufferReadback>(TEXT("MIGI.RadianceCache.SampleCountReadback"));
+		}
+		// Counters[1] is the number of training samples built.
+		AddEnqueueCopyPass(GraphBuilder, SampleCount.Readback.Get(), Frame.Counters, 2 * sizeof(uint32));
+		SampleCount.bReadbackPending = true;
+	}
+	// Fill the training batch after the inference rows of the same slot and train on it.
+	// Other frame passes of this frame reuse the slot, they wait for the training through ReleaseSlot.
+	if(bTrain)
+	{
+		auto ComputeShader = View.ShaderMap->GetShader<FMIGIRadianceCacheFillTrainingCS>();
+		auto PassParameters = MakeParameters();
+		ClearUnusedGraphResources(ComputeShader, PassParameters);
+		GraphBuilder.AddPass(RDG_EVENT_NAME("MIGIRadianceCacheTrain"), PassParameters,
+			ERDGPassFlags::Compute | ERDGPassFlags::NeverCull,
+			[ComputeShader, PassParameters, NumQueries, NumTrainingSamples = Frame.NumTrainingSamples, Slot](FRHICommandListImmediate& RHICmdList)
+			{
+				auto Adapter = IMIGINNAdapter::GetInstance();
+				FComputeShaderUtils::Dispatch(RHICmdList, ComputeShader, *PassParameters,
+					FComputeShaderUtils::GetGroupCount(NumTrainingSamples, C::ThreadGroupSize1D));
+				Adapter->SynchronizeToNN(RHICmdList);
+				RHICmdList.SubmitCommandsHint();
+				const size_t InputOffset = IMIGINNAdapter::GetInputSlotOffset(Slot) + (size_t)NumQueries * C::NNInputWidth * sizeof(float);
+				MIGINNTrainNetwork(MIGINNTrainNetworkParams {
+					.InInputBufferOffset = InputOffset,
+					.InInputBufferTargetOffset = InputOffset + (size_t)NumTrainingSamples * C::NNInputWidth * sizeof(float),
+					.InNumElements = NumTrainingSamples
+				});
+				Adapter->ReleaseSlot(Slot);
+			});
+	}
+}
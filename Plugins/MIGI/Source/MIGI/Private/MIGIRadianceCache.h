@@ -0,0 +1,113 @@
+﻿#pragma once
+#include "CoreMinimal.h"
+#include "RenderGraphResources.h"
+#include "ShaderParameterMacros.h"
+#include "MIGIConfig.h"
+
+class FRDGBuilder;
+class FViewInfo;
+struct FMIGIAdaptiveSamplingFrame;
+
+// NN radiance cache for the path tracer: paths terminate into the cache once their footprint is large enough,
+// a few of them keep going to train it. See MIGISimpleDiffuseRayTracing.usf and MIGIRadianceCache.usf.
+// The structs mirror MIGIRadianceCacheCommon.ush.
+
+constexpr uint32 MIGIRadianceCacheMaxTrainingVertices = 8;
+
+struct FMIGIRadianceCacheQuery
+{
+	FVector3f Position;
+	float Roughness;
+	FVector3f Direction;
+	uint32 bValid;
+	FVector3f Throughput;
+	uint32 PixelCoord;
+};
+static_assert(sizeof(FMIGIRadianceCacheQuery) == 48, "Must match MIGIRadianceCacheCommon.ush");
+
+struct FMIGIRadianceCacheTrainingVertex
+{
+	FMIGIRadianceCacheQuery Query;
+	FVector3f Radiance;
+	float Padding;
+};
+static_assert(sizeof(FMIGIRadianceCacheTrainingVertex) == 64, "Must match MIGIRadianceCacheCommon.ush");
+
+struct FMIGIRadianceCacheTrainingPath
+{
+	FMIGIRadianceCacheQuery Tail;
+	FVector3f Radiance;
+	uint32 NumVertices;
+};
+static_assert(sizeof(FMIGIRadianceCacheTrainingPath) == 64, "Must match MIGIRadianceCacheCommon.ush");
+
+struct FMIGIRadianceCachePathState
+{
+	FVector3f TerminationRadiance;
+	float PrimarySpread;
+	float SpreadSqrtSum;
+	int32 TrainingPath;
+	uint32 PixelCoord;
+	uint32 bTerminated;
+	uint32 NumTrainingVertices;
+	uint32 NumSuffixBounces;
+	uint32 Padding[2];
+};
+static_assert(sizeof(FMIGIRadianceCachePathState) == 48, "Must match MIGIRadianceCacheCommon.ush");
+
+struct FMIGIRadianceCacheTrainingSample
+{
+	FVector4f Input0;
+	FVector4f Input1;
+	FVector4f Target;
+};
+static_assert(sizeof(FMIGIRadianceCacheTrainingSample) == 48, "Must match MIGIRadianceCacheCommon.ush");
+
+// Bound to the path tracer's ray generation shader.
+BEGIN_SHADER_PARAMETER_STRUCT(FMIGIRadianceCachePathParameters, )
+	SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<FMIGIRadianceCacheQuery>, RadianceCacheQueries)
+	SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<FMIGIRadianceCacheTrainingPath>, RadianceCacheTrainingPaths)
+	SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<FMIGIRadianceCacheTrainingVertex>, RadianceCacheTrainingVertices)
+	SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<uint>, RadianceCacheCounters)
+	// Per query, the luminance the path gathered before it terminated into the cache.
+	SHADER_PARAMETER_RDG_BUFFER_UAV(RWBuffer<float>, RadianceCacheQueryLuminance)
+	// Only with path compaction, one per path in flight.
+	SHADER_PARAMETER_RDG_BUFFER_UAV(RWStructuredBuffer<FMIGIRadianceCachePathState>, RadianceCachePathStates)
+	SHADER_PARAMETER(float, RadianceCacheSpreadThreshold)
+	SHADER_PARAMETER(float, RadianceCacheTrainingPathRatio)
+	SHADER_PARAMETER(uint32, RadianceCacheMaxTrainingPaths)
+	SHADER_PARAMETER(uint32, RadianceCacheMaxPixelQueries)
+	SHADER_PARAMETER(uint32, RadianceCacheTrainingBounces)
+END_SHADER_PARAMETER_STRUCT()
+
+// Buffers of the radiance cache for one frame of the path tracer.
+struct FMIGIRadianceCacheFrame
+{
+	FRDGBufferRef Queries {};
+	FRDGBufferRef QueryLuminance {};
+	FRDGBufferRef TrainingPaths {};
+	FRDGBufferRef TrainingVertices {};
+	FRDGBufferRef TrainingSamples {};
+	FRDGBufferRef Counters {};
+	// One query per pixel, capped to what fits in a ring slot. The path tracer appends them in any order.
+	uint32 NumPixelQueries {};
+	uint32 MaxTrainingPaths {};
+	// Rows of the inference batch: the pixel queries and the training path tails, padded to C::NNBatchGranularity.
+	uint32 NumQueries {};
+	// Size of the training batch, the same every frame. A multiple of C::NNBatchGranularity too.
+	uint32 NumTrainingSamples {};
+	FMIGIRadianceCacheSettings Settings {};
+
+	// PathStates is only needed by the wavefront path tracer, it may be null otherwise.
+	void SetPathParameters (FRDGBuilder & GraphBuilder, FRDGBufferRef PathStates, FMIGIRadianceCachePathParameters & OutParameters) const;
+};
+
+// Allocate this frame's buffers. Returns false when the cache is disabled or not even one batch fits in a ring slot.
+bool MIGIBeginRadianceCache (FRDGBuilder & GraphBuilder, FIntPoint ViewSize, FMIGIRadianceCacheFrame & OutFrame);
+
+// Query the cache for the paths traced this frame in one batch, add the predictions to RadianceTexture and train on the training paths.
+// BlendFactor is the weight of this frame's sample in the accumulated radiance, Iteration the index of the sample.
+// The path tracer leaves the luminance moments of the paths terminated into the cache to this pass, so adaptive sampling
+// sees the predicted radiance too.
+void MIGIResolveRadianceCache (FRDGBuilder & GraphBuilder, const FViewInfo & View, const FMIGIRadianceCacheFrame & Frame,
+	FRDGTextureRef RadianceTexture, float BlendFactor, uint32 Iteration, const FMIGIAdaptiveSamplingFrame & AdaptiveSampling);
@@ -2,6 +2,54 @@
 #include "CoreMinimal.h"
 #include "DeferredShadingRenderer.h"
 
+class FRHIGPUBufferReadback;
+
+// Training loss of the screen space NN passes per tile of MIGITrainingSampleSelector, it steers where the next
+// training samples go. Measured on the NN output that gets composited and read back a few frames late.
+struct FMIGINNTrainingImportance
+{
+	FIntPoint TileGridSize {};
+	// Mean loss of the training samples of every tile, smoothed over the readbacks.
+	TArray<float> TileLoss;
+	// The summed loss (fixed point, see NNTrainLoss) and the number of samples of every tile.
+	TUniquePtr<FRHIGPUBufferReadback> LossReadback;
+	bool bReadbackPending = false;
+	// A readback of another tile grid is dropped.
+	FIntPoint ReadbackTileGridSize {};
+	// The sample layout of the last frame, whose output is composited with r.MIGI.CompositeLastFrameNN.
+	TRefCountPtr<FRDGPooledBuffer> LastTileOffsets;
+	// GFrameNumberRenderThread of the last frame the view was rendered.
+	uint32 LastUsedFrame = 0;
+
+	FMIGINNTrainingImportance ();
+	~FMIGINNTrainingImportance ();
+
+	// Start over with uniform importance when the tile grid changes.
+	void Resize (FIntPoint InTileGridSize);
+	// Poll the readback. Call once per frame before reading TileLoss.
+	void UpdateReadback ();
+	void Reset ();
+};
+
+// Number of training samples the radiance cache built, read back a few frames late. The training step is skipped
+// while it's zero, instead of training on an empty batch.
+struct FMIGIRadianceCacheSampleCount
+{
+	TUniquePtr<FRHIGPUBufferReadback> Readback;
+	bool bReadbackPending = false;
+	// None until the first readback.
+	uint32 NumTrainingSamples = 0;
+	// GFrameNumberRenderThread of the last frame the view was rendered.
+	uint32 LastUsedFrame = 0;
+
+	FMIGIRadianceCacheSampleCount ();
+	~FMIGIRadianceCacheSampleCount ();
+
+	// Poll the readback. Call once per frame before reading NumTrainingSamples.
+	void UpdateReadback ();
+	void Reset ();
+};
+
 class MIGIRenderingContext
 {
 public:
@@ -11,10 +59,16 @@ public:
 	static MIGIRenderingContext & Get();
 	inline TRefCountPtr<FRDGPooledBuffer> GetNNInputBufferRDG () const {return NNInputBufferRDG;}
 	inline TRefCountPtr<FRDGPooledBuffer> GetNNOutputBufferRDG () const {return NNOutputBufferRDG;}
+	// Created the first time the view is rendered.
+	FMIGINNTrainingImportance & GetTrainingImportance (const FViewInfo & View);
+	FMIGIRadianceCacheSampleCount & GetRadianceCacheSampleCount (const FViewInfo & View);
 protected:
 	MIGIRenderingContext () = default;
 	TRefCountPtr<FRDGPooledBuffer> NNInputBufferRDG;
 	TRefCountPtr<FRDGPooledBuffer> NNOutputBufferRDG;
+	// Keyed by FSceneView::GetViewKey.
+	TMap<uint32, TUniquePtr<FMIGINNTrainingImportance>> TrainingImportances;
+	TMap<uint32, TUniquePtr<FMIGIRadianceCacheSampleCount>> RadianceCacheSampleCounts;
 	bool bInitialized {};
 };
 
@@ -1,5 +1,69 @@
 ﻿#include "MIGINNAdapter.h"
+#include "MIGIConstants.h"
 #include "MIGIRendering.h"
+#include "MIGITrainingSampleSelector.h"
+
+#include "RHIGPUReadback.h"
+
+FMIGINNTrainingImportance::FMIGINNTrainingImportance() = default;
+FMIGINNTrainingImportance::~FMIGINNTrainingImportance() = default;
+
+void FMIGINNTrainingImportance::Resize(FIntPoint InTileGridSize)
+{
+	if(TileGridSize == InTileGridSize) return ;
+	TileGridSize = InTileGridSize;
+	// No loss anywhere: uniform.
+	TileLoss.Init(0.f, TileGridSize.X * TileGridSize.Y);
+	LastTileOffsets = nullptr;
+}
+
+void FMIGINNTrainingImportance::UpdateReadback()
+{
+	if(!bReadbackPending || !LossReadback->IsReady()) return ;
+	bReadbackPending = false;
+	const int32 NumTiles = ReadbackTileGridSize.X * ReadbackTileGridSize.Y;
+	const uint32 * Loss = static_cast<const uint32*>(LossReadback->Lock(NumTiles * 2 * sizeof(uint32)));
+	if(ReadbackTileGridSize == TileGridSize)
+	{
+		TArray<float> LossSums;
+		TArray<uint32> SampleCounts;
+		LossSums.SetNumUninitialized(NumTiles);
+		SampleCounts.SetNumUninitialized(NumTiles);
+		for(int32 t = 0; t < NumTiles; t++)
+		{
+			LossSums[t] = (float)Loss[t * 2] * (1.f / C::NNTrainLossScale);
+			SampleCounts[t] = Loss[t * 2 + 1];
+		}
+		MIGITrainingSampleSelector::AccumulateTileLoss(LossSums, SampleCounts, 0.5f, TileLoss);
+	}
+	LossReadback->Unlock();
+}
+
+void FMIGINNTrainingImportance::Reset()
+{
+	TileGridSize = FIntPoint::ZeroValue;
+	TileLoss.Empty();
+	// A pending copy may still target the readback, it's only polled again once it's done.
+	LastTileOffsets = nullptr;
+}
+
+FMIGIRadianceCacheSampleCount::FMIGIRadianceCacheSampleCount() = default;
+FMIGIRadianceCacheSampleCount::~FMIGIRadianceCacheSampleCount() = default;
+
+void FMIGIRadianceCacheSampleCount::UpdateReadback()
+{
+	if(!bReadbackPending || !Readback->IsReady()) return ;
+	bReadbackPending = false;
+	// The first two counters of the radiance cache, the samples are the second.
+	NumTrainingSamples = static_cast<const uint32*>(Readback->Lock(2 * sizeof(uint32)))[1];
+	Readback->Unlock();
+}
+
+void FMIGIRadianceCacheSampleCount::Reset()
+{
+	// A pending copy may still target the readback, it's only polled again once it's done.
+	NumTrainingSamples = 0;
+}
 
 void MIGIRenderingContext::Initialze_RenderThread ()
 {
@@ -18,9 +82,36 @@ void MIGIRenderingContext::Initialze_RenderThread ()
 void MIGIRenderingContext::Destroy_RenderThread ()
 {
 	NNInputBufferRDG = NNOutputBufferRDG = nullptr;
+	for(auto & Entry : TrainingImportances) Entry.Value->Reset();
+	for(auto & Entry : RadianceCacheSampleCounts) Entry.Value->Reset();
 	bInitialized = false;
 }
 
+// Also drops the entries of views not rendered for C::ViewStateMaxAge frames, their readbacks have long completed.
+template <typename T>
+static T & GetViewEntry (TMap<uint32, TUniquePtr<T>> & Entries, const FViewInfo & View)
+{
+	const uint32 FrameNumber = GFrameNumberRenderThread;
+	for(auto It = Entries.CreateIterator(); It; ++It)
+	{
+		if(FrameNumber - It.Value()->LastUsedFrame > C::ViewStateMaxAge) It.RemoveCurrent();
+	}
+	TUniquePtr<T> & Entry = Entries.FindOrAdd(View.GetViewKey());
+	if(!Entry) Entry = MakeUnique<T>();
+	Entry->LastUsedFrame = FrameNumber;
+	return *Entry;
+}
+
+FMIGINNTrainingImportance & MIGIRenderingContext::GetTrainingImportance (const FViewInfo & View)
+{
+	return GetViewEntry(TrainingImportances, View);
+}
+
+FMIGIRadianceCacheSampleCount & MIGIRenderingContext::GetRadianceCacheSampleCount (const FViewInfo & View)
+{
+	return GetViewEntry(RadianceCacheSampleCounts, View);
+}
+
 MIGIRenderingContext & MIGIRenderingContext::Get ()
 {
 	static MIGIRenderingContext Context;
@@ -0,0 +1,148 @@
+﻿#include "MIGITileScheduler.h"
+
+#include "RenderGraphBuilder.h"
+
+// Batches past it are not timed, the queries would pile up while the GPU is behind.
+static constexpr int32 MaxPendingTimingBatches = 16;
+// Weight of a new measurement in the cost estimates.
+static constexpr float TileCostBlend = 0.25f;
+
+FMIGITileScheduler::FMIGITileScheduler() = default;
+FMIGITileScheduler::~FMIGITileScheduler() = default;
+
+void FMIGITileScheduler::BeginFrame(FIntPoint InViewSize, int32 InTileSize, const FMIGITileSchedulerSettings & Settings, bool bInTimeTiles)
+{
+	Timings.Reset();
+	ReadTimings();
+	if (Cursor == 0 && (InViewSize != ViewSize || InTileSize != TileSize || Settings.TileOrder != TileOrder || Settings.Focus != Focus))
+	{
+		if (InViewSize != ViewSize || InTileSize != TileSize)
+		{
+			NumTiles = FIntPoint::DivideAndRoundUp(InViewSize, InTileSize);
+			TileCosts.Init(-1.f, NumTiles.X * NumTiles.Y);
+			// Their tile indices are of the old tiling. The cost per pixel still holds.
+			PendingBatches.Reset();
+		}
+		ViewSize = InViewSize;
+		TileSize = InTileSize;
+		TileOrder = Settings.TileOrder;
+		Focus = Settings.Focus;
+		const FVector2f FocusInTiles = Focus * FVector2f(ViewSize) / (float)TileSize;
+		MIGITileScheduler::OrderTiles(NumTiles, (MIGITileScheduler::ETileOrder)TileOrder, FocusInTiles, Order);
+	}
+	BudgetMs = GSupportsTimestampRenderQueries ? Settings.BudgetMs : 0.f;
+	bTimeTiles = GSupportsTimestampRenderQueries && (BudgetMs > 0.f || bInTimeTiles);
+	RemainingBudget = BudgetMs;
+	bScheduledThisFrame = false;
+}
+
+void FMIGITileScheduler::Restart()
+{
+	Cursor = 0;
+}
+
+bool FMIGITileScheduler::ScheduleTiles(TArray<FIntRect> & OutTiles, bool & bOutEndsIteration)
+{
+	OutTiles.Reset();
+	bTimingBatch = false;
+	int32 Count = Order.Num() - Cursor;
+	if (BudgetMs > 0.f)
+	{
+		if (bScheduledThisFrame && RemainingBudget <= 0.f)
+		{
+			return false;
+		}
+		TArray<float> Costs;
+		Costs.Reserve(Count);
+		for (int32 Index = Cursor; Index < Order.Num(); Index++)
+		{
+			Costs.Add(GetTileCostEstimate(Order[Index]));
+		}
+		Count = MIGITileScheduler::CountTilesWithinBudget(Costs, RemainingBudget, !bScheduledThisFrame);
+		if (Count == 0)
+		{
+			return false;
+		}
+		for (int32 Index = 0; Index < Count; Index++)
+		{
+			RemainingBudget -= Costs[Index];
+		}
+	}
+	if (bTimeTiles && PendingBatches.Num() < MaxPendingTimingBatches)
+	{
+		bTimingBatch = true;
+		PendingBatches.AddDefaulted_GetRef().Tiles = TArray<int32>(Order.GetData() + Cursor, Count);
+	}
+	bScheduledThisFrame = true;
+	for (int32 Index = 0; Index < Count; Index++)
+	{
+		OutTiles.Add(GetTileRect(Order[Cursor + Index]));
+	}
+	Cursor += Count;
+	bOutEndsIteration = Cursor == Order.Num();
+	if (bOutEndsIteration)
+	{
+		Cursor = 0;
+	}
+	return true;
+}
+
+void FMIGITileScheduler::AddTimestamp(FRDGBuilder & GraphBuilder)
+{
+	if (!bTimingBatch) return;
+	if (!QueryPool.IsValid())
+	{
+		QueryPool = RHICreateRenderQueryPool(RQT_AbsoluteTime);
+	}
+	FRHIRenderQuery* Query = PendingBatches.Last().Queries.Add_GetRef(QueryPool->AllocateQuery()).GetQuery();
+	GraphBuilder.AddPass(RDG_EVENT_NAME("MIGITileTimestamp"), ERDGPassFlags::NeverCull,
+		[Query](FRHICommandListImmediate & RHICmdList)
+		{
+			RHICmdList.EndRenderQuery(Query);
+		});
+}
+
+void FMIGITileScheduler::ReadTimings()
+{
+	TArray<uint64> Timestamps;
+	while (PendingBatches.Num() > 0)
+	{
+		FTimingBatch & Batch = PendingBatches[0];
+		// Batches are timed in order, an unfinished one means the later ones are too.
+		Timestamps.SetNumUninitialized(Batch.Queries.Num());
+		for (int32 Index = 0; Index < Batch.Queries.Num(); Index++)
+		{
+			if (!RHIGetRenderQueryResult(Batch.Queries[Index].GetQuery(), Timestamps[Index], false))
+			{
+				return;
+			}
+		}
+		// In microseconds.
+		for (int32 Index = 0; Index + 1 < Batch.Queries.Num() && Index < Batch.Tiles.Num(); Index++)
+		{
+			if (Timestamps[Index + 1] < Timestamps[Index]) continue;
+			const int32 Tile = Batch.Tiles[Index];
+			const float Cost = (Timestamps[Index + 1] - Timestamps[Index]) / 1000.f;
+			TileCosts[Tile] = TileCosts[Tile] < 0.f ? Cost : FMath::Lerp(TileCosts[Tile], Cost, TileCostBlend);
+			const int32 NumPixels = GetTileRect(Tile).Area();
+			Timings.Add({ TileSize, NumPixels, Cost });
+			const float PixelCost = Cost / NumPixels;
+			CostPerPixel = CostPerPixel < 0.f ? PixelCost : FMath::Lerp(CostPerPixel, PixelCost, TileCostBlend);
+		}
+		PendingBatches.RemoveAt(0);
+	}
+}
+
+FIntRect FMIGITileScheduler::GetTileRect(int32 Tile) const
+{
+	const FIntPoint Min(Tile % NumTiles.X * TileSize, Tile / NumTiles.X * TileSize);
+	return FIntRect(Min, FIntPoint(FMath::Min(Min.X + TileSize, ViewSize.X), FMath::Min(Min.Y + TileSize, ViewSize.Y)));
+}
+
+float FMIGITileScheduler::GetTileCostEstimate(int32 Tile) const
+{
+	if (TileCosts[Tile] >= 0.f) return TileCosts[Tile];
+	if (CostPerPixel >= 0.f) return CostPerPixel * GetTileRect(Tile).Area();
+	// Nothing measured yet: one tile per frame until the first timings come back.
+	return BudgetMs;
+}
@@ -0,0 +1,146 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "RHI.h"
+#include "MIGIConfig.h"
+
+class FRDGBuilder;
+
+// Progressive tile scheduling of the path tracer. An iteration (one sample per pixel) may span several frames: each
+// frame issues the tiles that fit in r.MIGI.PathTracing.FrameBudgetMs, in Hilbert order or nearest to a focus point
+// first, and the iteration ends once its last tile is traced. Tiles are timed with timestamp queries, read back a few
+// frames later, and the costs estimate how many tiles fit the next frames. Every pixel is traced once per iteration,
+// so the accumulation's blend factor stays the same for all of them.
+
+namespace MIGITileScheduler
+{
+	enum class ETileOrder : int32
+	{
+		Hilbert = 0,
+		Focus = 1,
+	};
+
+	// Position of (X, Y) along the Hilbert curve over a Size x Size grid, Size a power of two.
+	inline uint32 HilbertIndex (uint32 Size, uint32 X, uint32 Y)
+	{
+		uint32 Index = 0;
+		for(uint32 S = Size / 2; S > 0; S /= 2)
+		{
+			const uint32 Rx = (X & S) ? 1 : 0;
+			const uint32 Ry = (Y & S) ? 1 : 0;
+			Index += S * S * ((3 * Rx) ^ Ry);
+			if(Ry == 0)
+			{
+				if(Rx == 1)
+				{
+					X = Size - 1 - X;
+					Y = Size - 1 - Y;
+				}
+				Swap(X, Y);
+			}
+		}
+		return Index;
+	}
+
+	// Tiles in the order they are traced, as indices into the NumTiles.X x NumTiles.Y grid.
+	// Focus is the point the focus order starts from, in tiles.
+	inline void OrderTiles (FIntPoint NumTiles, ETileOrder Order, FVector2f Focus, TArray<int32> & OutOrder)
+	{
+		const int32 Count = NumTiles.X * NumTiles.Y;
+		TArray<float> Keys;
+		Keys.SetNumZeroed(Count);
+		OutOrder.SetNumUninitialized(Count);
+		const uint32 Size = FMath::RoundUpToPowerOfTwo((uint32)FMath::Max(NumTiles.X, NumTiles.Y));
+		for(int32 Tile = 0; Tile < Count; Tile++)
+		{
+			const int32 X = Tile % NumTiles.X;
+			const int32 Y = Tile / NumTiles.X;
+			// Squared distance of the tile center, or the Hilbert index, exact in a float up to 4096^2 tiles.
+			Keys[Tile] = Order == ETileOrder::Focus
+				? FMath::Square(X + 0.5f - Focus.X) + FMath::Square(Y + 0.5f - Focus.Y)
+				: (float)HilbertIndex(Size, X, Y);
+			OutOrder[Tile] = Tile;
+		}
+		// Ties in tile order.
+		OutOrder.Sort([&Keys](int32 A, int32 B) { return Keys[A] < Keys[B] || (Keys[A] == Keys[B] && A < B); });
+	}
+
+	// Number of tiles from the start of Costs that fit in BudgetMs. At least one when bForceOne, so every frame makes
+	// progress however expensive a tile is.
+	inline int32 CountTilesWithinBudget (TConstArrayView<float> Costs, float BudgetMs, bool bForceOne)
+	{
+		int32 Count = 0;
+		float Total = 0.f;
+		while(Count < Costs.Num() && (Total + Costs[Count] <= BudgetMs || (bForceOne && Count == 0)))
+		{
+			Total += Costs[Count++];
+		}
+		return Count;
+	}
+}
+
+// A tile read back from the timestamps.
+struct FMIGITileTiming
+{
+	int32 TileSize;
+	int32 NumPixels;
+	float Ms;
+};
+
+class FMIGITileScheduler
+{
+public:
+	FMIGITileScheduler ();
+	~FMIGITileScheduler ();
+
+	// Read back the timings that are ready, and start the budget of a frame. The tiling only changes between
+	// iterations, a tile traced this iteration must not be traced again. bTimeTiles times the tiles without a budget.
+	void BeginFrame (FIntPoint ViewSize, int32 TileSize, const FMIGITileSchedulerSettings & Settings, bool bTimeTiles);
+	// The accumulation restarted, start the next iteration from the first tile.
+	void Restart ();
+	bool IsStartingIteration () const { return Cursor == 0; }
+	// Of the tiling in use, which may lag the one asked for until the iteration ends.
+	int32 GetTileSize () const { return TileSize; }
+	// Read back by the last BeginFrame.
+	TConstArrayView<FMIGITileTiming> GetTimings () const { return Timings; }
+	// Tiles of the next pass, in pixels, and whether they end the iteration. Without a budget, the rest of the iteration.
+	// False when the budget of the frame is spent.
+	bool ScheduleTiles (TArray<FIntRect> & OutTiles, bool & bOutEndsIteration);
+	// Timestamp the tiles of the last ScheduleTiles: once before the first tile, then after each.
+	void AddTimestamp (FRDGBuilder & GraphBuilder);
+
+private:
+	struct FTimingBatch
+	{
+		TArray<int32> Tiles;
+		TArray<FRHIPooledRenderQuery> Queries;
+	};
+
+	void ReadTimings ();
+	FIntRect GetTileRect (int32 Tile) const;
+	float GetTileCostEstimate (int32 Tile) const;
+
+	// 0 without a budget, also when the RHI has no timestamps.
+	float BudgetMs = 0.f;
+	bool bTimeTiles = false;
+	// Of the current Order.
+	FIntPoint ViewSize = FIntPoint::ZeroValue;
+	int32 TileSize = 0;
+	int32 TileOrder = -1;
+	FVector2f Focus = FVector2f::ZeroVector;
+	FIntPoint NumTiles = FIntPoint::ZeroValue;
+	TArray<int32> Order;
+	// Next tile of the iteration in Order.
+	int32 Cursor = 0;
+	// Per tile in ms, negative until measured.
+	TArray<float> TileCosts;
+	// Over the tiles measured, for the ones that are not yet. Negative until the first measurement.
+	float CostPerPixel = -1.f;
+	float RemainingBudget = 0.f;
+	bool bScheduledThisFrame = false;
+	FRenderQueryPoolRHIRef QueryPool;
+	// Oldest first.
+	TArray<FTimingBatch> PendingBatches;
+	bool bTimingBatch = false;
+	TArray<FMIGITileTiming> Timings;
+};
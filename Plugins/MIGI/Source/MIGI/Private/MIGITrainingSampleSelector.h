@@ -0,0 +1,109 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+// Picks the pixels the NN trains on this frame. The view is cut into square tiles, every tile gets a share of the
+// training samples proportional to its importance, and the samples of a tile follow a rank-1 lattice (the R2 sequence)
+// rotated per tile and per frame. Samples stay spread over the view and over time, with no two samples of a tile clumped.
+// The importance of a tile is its training loss, measured by NNTrainLoss and read back a few frames late.
+// NNInput in NNInterface.usf mirrors GetSamplePixel, keep both in sync.
+namespace MIGITrainingSampleSelector
+{
+	// Generators of the R2 sequence, the 2D rank-1 lattice built on the plastic number.
+	constexpr float LatticeX = 0.7548776662f;
+	constexpr float LatticeY = 0.5698402910f;
+
+	inline FIntPoint GetTileGridSize (FIntPoint ViewSize, uint32 TileSize)
+	{
+		return FIntPoint(FMath::DivideAndRoundUp(ViewSize.X, (int32)TileSize), FMath::DivideAndRoundUp(ViewSize.Y, (int32)TileSize));
+	}
+
+	// Integer hash with the same result in HLSL.
+	inline uint32 Hash (uint32 X)
+	{
+		X ^= X >> 16;
+		X *= 0x7feb352du;
+		X ^= X >> 15;
+		X *= 0x846ca68bu;
+		X ^= X >> 16;
+		return X;
+	}
+
+	// The rounding phase of AllocateSamples for a frame: the golden ratio sequence, in 32-bit fixed point so it stays
+	// exact however large FrameIndex gets. Always in [0, 1).
+	inline float GetFramePhase (uint32 FrameIndex)
+	{
+		// 2^32 / golden ratio, the product wraps modulo 2^32 like the fractional part.
+		return (float)((FrameIndex * 0x9E3779B9u) >> 8) * (1.f / 16777216.f);
+	}
+
+	// Distributes NumSamples over the tiles, in proportion to their importance. OutTileOffsets gets NumTiles + 1
+	// entries, the samples of tile t are [OutTileOffsets[t], OutTileOffsets[t + 1]).
+	// Rounding follows the importance CDF, so the counts sum to exactly NumSamples and every tile gets its share rounded
+	// up or down. Phase in [0, 1) moves the rounding every frame, so fractional shares are honoured over time.
+	inline void AllocateSamples (TConstArrayView<float> TileImportance, uint32 NumSamples, float Phase, TArray<uint32> & OutTileOffsets)
+	{
+		const int32 NumTiles = TileImportance.Num();
+		OutTileOffsets.SetNumUninitialized(NumTiles + 1);
+		double TotalImportance = 0.;
+		for(float Importance : TileImportance)
+		{
+			TotalImportance += FMath::Max(Importance, 0.f);
+		}
+		double Cumulative = 0.;
+		OutTileOffsets[0] = 0;
+		for(int32 t = 0; t < NumTiles; t++)
+		{
+			// No importance at all: uniform.
+			Cumulative += TotalImportance > 0. ? FMath::Max(TileImportance[t], 0.f) / TotalImportance : 1. / NumTiles;
+			OutTileOffsets[t + 1] = FMath::Min((uint32)FMath::FloorToDouble(FMath::Min(Cumulative, 1.) * NumSamples + Phase), NumSamples);
+		}
+		OutTileOffsets[NumTiles] = NumSamples;
+	}
+
+	// Fold the training loss measured over the tiles into their smoothed loss. LossSums and SampleCounts hold the summed
+	// loss and the number of samples of every tile, tiles that had no sample keep their loss.
+	inline void AccumulateTileLoss (TConstArrayView<float> LossSums, TConstArrayView<uint32> SampleCounts, float BlendFactor, TArrayView<float> InOutTileLoss)
+	{
+		check(LossSums.Num() == InOutTileLoss.Num() && SampleCounts.Num() == InOutTileLoss.Num());
+		for(int32 t = 0; t < InOutTileLoss.Num(); t++)
+		{
+			if(SampleCounts[t] == 0) continue;
+			InOutTileLoss[t] = FMath::Lerp(InOutTileLoss[t], LossSums[t] / (float)SampleCounts[t], BlendFactor);
+		}
+	}
+
+	// The importance of the tiles for AllocateSamples: their loss, but at least MinShare of the mean loss,
+	// so the tiles the NN has learned are still revisited and notice when their loss grows again.
+	inline void GetTileImportance (TConstArrayView<float> TileLoss, float MinShare, TArray<float> & OutTileImportance)
+	{
+		double TotalLoss = 0.;
+		for(float Loss : TileLoss)
+		{
+			TotalLoss += FMath::Max(Loss, 0.f);
+		}
+		const float Floor = TileLoss.Num() ? (float)(TotalLoss / TileLoss.Num()) * MinShare : 0.f;
+		OutTileImportance.SetNumUninitialized(TileLoss.Num());
+		for(int32 t = 0; t < TileLoss.Num(); t++)
+		{
+			OutTileImportance[t] = FMath::Max(TileLoss[t], Floor);
+		}
+	}
+
+	// The pixel of the SampleInTile-th sample of a tile.
+	inline FIntPoint GetSamplePixel (FIntPoint Tile, uint32 SampleInTile, uint32 TileSize, FIntPoint TileGridSize, uint32 FrameIndex, FIntPoint ViewSize)
+	{
+		// Cranley-Patterson rotation of the lattice, decorrelated per tile and per frame.
+		const uint32 Seed = Hash((uint32)(Tile.Y * TileGridSize.X + Tile.X) ^ Hash(FrameIndex));
+		const float RotationX = (float)(Seed >> 8) * (1.f / 16777216.f);
+		const float RotationY = (float)(Hash(Seed) >> 8) * (1.f / 16777216.f);
+		const float X = FMath::Frac(RotationX + LatticeX * SampleInTile);
+		const float Y = FMath::Frac(RotationY + LatticeY * SampleInTile);
+		// Tiles on the right and bottom edges may be cut by the view.
+		const FIntPoint Origin(Tile.X * (int32)TileSize, Tile.Y * (int32)TileSize);
+		const FIntPoint Extent(FMath::Min((int32)TileSize, ViewSize.X - Origin.X), FMath::Min((int32)TileSize, ViewSize.Y - Origin.Y));
+		return FIntPoint(
+			Origin.X + FMath::Min((int32)(X * Extent.X), Extent.X - 1),
+			Origin.Y + FMath::Min((int32)(Y * Extent.Y), Extent.Y - 1));
+	}
+}
@@ -0,0 +1,108 @@
+﻿#include "Misc/AutomationTest.h"
+#include "MIGIDispatchSizeTuner.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace MIGIDispatchSizeTunerTests
+{
+	// Feeds the tuner the timings of a GPU where a tile takes Overhead + CostPerPixel * NumPixels, with relative Noise,
+	// until it converges. Every round has an edge tile cut by the view. Returns the number of timings it took.
+	int32 RunTuner (FMIGIDispatchSizeTuner & Tuner, float OverheadMs, float CostPerPixelMs, float Noise, FRandomStream & Random)
+	{
+		int32 NumTimings = 0;
+		// Far more than MaxRounds rounds take.
+		while(!Tuner.IsConverged() && NumTimings < 1000)
+		{
+			const int32 TileSize = Tuner.GetSize();
+			const int32 NumPixels = NumTimings % 4 == 3 ? TileSize * TileSize / 3 : TileSize * TileSize;
+			const float Ms = (OverheadMs + CostPerPixelMs * NumPixels) * (1.f + Random.FRandRange(-Noise, Noise));
+			Tuner.AddTiming(TileSize, NumPixels, Ms);
+			NumTimings++;
+		}
+		return NumTimings;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMIGIDispatchSizeTunerTest, "MIGI.DispatchSizeTuner.Convergence",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMIGIDispatchSizeTunerTest::RunTest (const FString & Parameters)
+{
+	using namespace MIGIDispatchSizeTunerTests;
+
+	FRandomStream Random(1234);
+	const FMIGIDispatchSizeTuner::FSettings Settings;
+	constexpr float OverheadMs = 0.5f, CostPerPixelMs = 1e-5f;
+	// The size whose tiles take the target.
+	const float IdealSize = FMath::Sqrt((Settings.TargetMs - OverheadMs) / CostPerPixelMs);
+
+	// From below and from above the ideal size, without and with noise.
+	for(int32 InitialSize : {64, 4096})
+	{
+		for(float Noise : {0.f, 0.05f})
+		{
+			FMIGIDispatchSizeTuner Tuner;
+			Tuner.Start(Settings, InitialSize);
+			const int32 NumTimings = RunTuner(Tuner, OverheadMs, CostPerPixelMs, Noise, Random);
+			const FString Case = FString::Printf(TEXT("Initial size %d, noise %.2f"), InitialSize, Noise);
+			TestTrue(*(Case + TEXT(": converges within MaxRounds")), Tuner.IsConverged() && NumTimings <= Settings.MaxRounds * Settings.TimingsPerRound);
+			TestTrue(*(Case + TEXT(": size is a multiple of the granularity")), Tuner.GetSize() % Settings.Granularity == 0);
+			TestTrue(*(Case + TEXT(": tiles take the target")), FMath::Abs(Tuner.GetSize() - IdealSize) <= 2.f * Settings.Granularity);
+			float FitOverheadMs, FitCostPerPixelMs;
+			TestTrue(*(Case + TEXT(": probed more than one size")), Tuner.FitCost(FitOverheadMs, FitCostPerPixelMs));
+			TestTrue(*(Case + TEXT(": fits the cost per pixel")), FMath::Abs(FitCostPerPixelMs / CostPerPixelMs - 1.f) <= 0.1f);
+		}
+	}
+
+	// Costs out of the range clamp the size, and a clamped size settles at once.
+	for(const float CostMs : {1e-9f, 1e-2f})
+	{
+		FMIGIDispatchSizeTuner Tuner;
+		Tuner.Start(Settings, 1024);
+		RunTuner(Tuner, OverheadMs, CostMs, 0.f, Random);
+		TestEqual(TEXT("Size clamps to the range"), Tuner.GetSize(), CostMs < CostPerPixelMs ? Settings.MaxSize : Settings.MinSize);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMIGIDispatchSizeTunerTimingsTest, "MIGI.DispatchSizeTuner.Timings",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMIGIDispatchSizeTunerTimingsTest::RunTest (const FString & Parameters)
+{
+	FMIGIDispatchSizeTuner::FSettings Settings;
+	Settings.TimingsPerRound = 2;
+	FMIGIDispatchSizeTuner Tuner;
+	Tuner.Start(Settings, 100);
+	TestEqual(TEXT("Initial size snaps to the granularity"), Tuner.GetSize(), 96);
+
+	// Empty tiles, failed queries and tiles of another size don't make a round.
+	Tuner.AddTiming(96, 0, 1.f);
+	Tuner.AddTiming(96, 96 * 96, 0.f);
+	Tuner.AddTiming(128, 128 * 128, 1.f);
+	Tuner.AddTiming(128, 128 * 128, 1.f);
+	TestEqual(TEXT("Only timings at the current size count"), Tuner.GetSize(), 96);
+	Tuner.AddTiming(96, 96 * 96, 1.f);
+	Tuner.AddTiming(96, 96 * 96, 1.f);
+	TestTrue(TEXT("A round moves the size"), Tuner.GetSize() != 96);
+
+	// Noise that never settles still stops after MaxRounds.
+	FRandomStream Random(1234);
+	Tuner.Start(Settings, 1024);
+	int32 NumRounds = 0;
+	while(!Tuner.IsConverged() && NumRounds < 100)
+	{
+		for(int32 i = 0; i < Settings.TimingsPerRound; i++)
+		{
+			Tuner.AddTiming(Tuner.GetSize(), Tuner.GetSize() * Tuner.GetSize(), Random.FRandRange(0.1f, 100.f));
+		}
+		NumRounds++;
+	}
+	TestTrue(TEXT("Gives up after MaxRounds"), Tuner.IsConverged() && NumRounds <= Settings.MaxRounds);
+	const int32 ConvergedSize = Tuner.GetSize();
+	TestFalse(TEXT("No timing counts once converged"), Tuner.AddTiming(ConvergedSize, ConvergedSize * ConvergedSize, 1.f));
+	TestEqual(TEXT("Converged size stays"), Tuner.GetSize(), ConvergedSize);
+	return true;
+}
+
+#endif
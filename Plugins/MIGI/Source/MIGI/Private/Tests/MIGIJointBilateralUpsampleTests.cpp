@@ -0,0 +1,116 @@
+﻿#include "Misc/AutomationTest.h"
+#include "MIGIJointBilateralUpsample.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace MIGIJointBilateralUpsampleTests
+{
+	TArray<MIGIJointBilateralUpsample::FGuide> MakeGuides (FIntPoint ViewSize, TFunctionRef<float(int32, int32)> Depth)
+	{
+		TArray<MIGIJointBilateralUpsample::FGuide> Guides;
+		Guides.SetNumUninitialized(ViewSize.X * ViewSize.Y);
+		for(int32 y = 0; y < ViewSize.Y; y++)
+		{
+			for(int32 x = 0; x < ViewSize.X; x++)
+			{
+				Guides[y * ViewSize.X + x] = {Depth(x, y), FVector3f(0.f, 0.f, 1.f)};
+			}
+		}
+		return Guides;
+	}
+
+	FIntPoint GetGridSize (FIntPoint ViewSize, uint32 CellSize)
+	{
+		return FIntPoint(FMath::DivideAndRoundUp(ViewSize.X, (int32)CellSize), FMath::DivideAndRoundUp(ViewSize.Y, (int32)CellSize));
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMIGIJointBilateralUpsampleTest, "MIGI.JointBilateralUpsample",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMIGIJointBilateralUpsampleTest::RunTest (const FString & Parameters)
+{
+	using namespace MIGIJointBilateralUpsample;
+	using namespace MIGIJointBilateralUpsampleTests;
+
+	// Edge cells query the last pixel of the view.
+	TestEqual(TEXT("Query pixel of an inner cell"), GetQueryPixel(FIntPoint(1, 2), 4, FIntPoint(13, 13)), FIntPoint(6, 10));
+	TestEqual(TEXT("Query pixel of an edge cell"), GetQueryPixel(FIntPoint(3, 2), 4, FIntPoint(13, 13)), FIntPoint(12, 10));
+
+	// Full resolution: every pixel is its own query.
+	{
+		const FIntPoint ViewSize(7, 5);
+		const auto Guides = MakeGuides(ViewSize, [](int32 x, int32 y) { return 100.f + 10.f * x + y; });
+		TArray<FLinearColor> Queries, Colors;
+		for(int32 i = 0; i < ViewSize.X * ViewSize.Y; i++)
+		{
+			Queries.Add(FLinearColor((float)i, 1.f, 2.f, 1.f));
+		}
+		Upsample(Queries, ViewSize, 1, Guides, ViewSize, Colors);
+		bool bExact = true;
+		for(int32 i = 0; i < Colors.Num(); i++)
+		{
+			bExact &= Colors[i].Equals(Queries[i], 1e-5f);
+		}
+		TestTrue(TEXT("Cell size 1 returns the queries"), bExact);
+	}
+
+	// A flat surface and a constant signal stay constant, views that are not a multiple of the cell size included.
+	for(uint32 CellSize : {2u, 4u})
+	{
+		const FIntPoint ViewSize(13, 9), GridSize = GetGridSize(ViewSize, CellSize);
+		const auto Guides = MakeGuides(ViewSize, [](int32, int32) { return 500.f; });
+		TArray<FLinearColor> Queries, Colors;
+		Queries.Init(FLinearColor(0.25f, 0.5f, 0.75f, 1.f), GridSize.X * GridSize.Y);
+		Upsample(Queries, GridSize, CellSize, Guides, ViewSize, Colors);
+		bool bConstant = true;
+		for(const FLinearColor & Color : Colors)
+		{
+			bConstant &= Color.Equals(Queries[0], 1e-5f);
+		}
+		TestTrue(TEXT("Constant signal on a flat surface"), bConstant);
+	}
+
+	// Two surfaces far apart in depth, split on a cell boundary: no pixel takes the other surface's radiance.
+	{
+		constexpr uint32 CellSize = 4;
+		const FIntPoint ViewSize(32, 8), GridSize = GetGridSize(ViewSize, CellSize);
+		const auto Guides = MakeGuides(ViewSize, [](int32 x, int32) { return x < 16 ? 100.f : 1000.f; });
+		const FLinearColor Near(1.f, 0.f, 0.f, 1.f), Far(0.f, 0.f, 1.f, 1.f);
+		TArray<FLinearColor> Queries, Colors;
+		for(int32 y = 0; y < GridSize.Y; y++)
+		{
+			for(int32 x = 0; x < GridSize.X; x++)
+			{
+				Queries.Add(GetQueryPixel(FIntPoint(x, y), CellSize, ViewSize).X < 16 ? Near : Far);
+			}
+		}
+		Upsample(Queries, GridSize, CellSize, Guides, ViewSize, Colors);
+		bool bSeparated = true;
+		for(int32 y = 0; y < ViewSize.Y; y++)
+		{
+			for(int32 x = 0; x < ViewSize.X; x++)
+			{
+				bSeparated &= Colors[y * ViewSize.X + x].Equals(x < 16 ? Near : Far, 1e-3f);
+			}
+		}
+		TestTrue(TEXT("Depth edges are kept"), bSeparated);
+	}
+
+	// A pixel on a surface no query saw falls back to the nearest query.
+	{
+		constexpr uint32 CellSize = 4;
+		const FIntPoint ViewSize(16, 16), GridSize = GetGridSize(ViewSize, CellSize);
+		const auto Guides = MakeGuides(ViewSize, [](int32 x, int32 y) { return x == 1 && y == 1 ? 10.f : 100.f; });
+		TArray<FLinearColor> Queries, Colors;
+		for(int32 i = 0; i < GridSize.X * GridSize.Y; i++)
+		{
+			Queries.Add(FLinearColor((float)i, 0.f, 0.f, 1.f));
+		}
+		Upsample(Queries, GridSize, CellSize, Guides, ViewSize, Colors);
+		TestTrue(TEXT("Fallback to the nearest query"), Colors[1 * ViewSize.X + 1].Equals(Queries[0], 1e-5f));
+	}
+	return true;
+}
+
+#endif
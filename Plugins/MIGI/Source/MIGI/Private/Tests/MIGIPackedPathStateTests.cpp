@@ -0,0 +1,104 @@
+﻿#include "Misc/AutomationTest.h"
+#include "MIGIPackedPathState.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace MIGIPackedPathStateTests
+{
+	FVector3f RandomVector (FRandomStream & Random, float MaxValue)
+	{
+		return FVector3f(Random.FRandRange(0.f, MaxValue), Random.FRandRange(0.f, MaxValue), Random.FRandRange(0.f, MaxValue));
+	}
+
+	FVector3f RandomDirection (FRandomStream & Random)
+	{
+		const float Z = Random.FRandRange(-1.f, 1.f);
+		const float Phi = Random.FRandRange(0.f, 2.f * PI);
+		const float R = FMath::Sqrt(FMath::Max(1.f - Z * Z, 0.f));
+		return FVector3f(R * FMath::Cos(Phi), R * FMath::Sin(Phi), Z);
+	}
+
+	// Largest channel error relative to the bound of the shared exponent encoding.
+	float GetSharedExponentError (const FVector3f & Value, const FVector3f & Decoded)
+	{
+		return (Decoded - Value).GetAbsMax() / MIGIPackedPathState::GetSharedExponentErrorBound(Value);
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMIGIPackedPathStateTest, "MIGI.PackedPathState.RoundTrip",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMIGIPackedPathStateTest::RunTest (const FString & Parameters)
+{
+	using namespace MIGIPackedPathState;
+	using namespace MIGIPackedPathStateTests;
+
+	FRandomStream Random(1234);
+	bool bExact = true;
+	float MaxSharedExponentError = 0.f, MaxDirectionError = 0.f, MaxNormalError = 0.f, MaxRoughnessError = 0.f, MaxVisibilityError = 0.f;
+	for(int32 i = 0; i < 4096; i++)
+	{
+		FPathState State;
+		State.RandSeqSampleIndex = (uint32)Random.RandRange(0, MAX_int32);
+		State.RandSeqSampleSeed = (uint32)Random.RandRange(0, MAX_int32) ^ 0x80000000u;
+		// Radiance goes well past 1, the other shared exponent fields mostly stay below.
+		State.Radiance = RandomVector(Random, 1000.f);
+		State.BackgroundVisibility = Random.GetFraction();
+		State.Albedo = RandomVector(Random, 1.f);
+		// A blend of normals is shorter than 1.
+		State.Normal = RandomDirection(Random) * Random.FRandRange(0.1f, 1.f);
+		State.RayOrigin = FVector3f(Random.FRandRange(-1e5f, 1e5f), Random.FRandRange(-1e5f, 1e5f), Random.FRandRange(-1e5f, 1e5f));
+		State.RayDirection = RandomDirection(Random);
+		State.PathThroughput = RandomVector(Random, 1.f);
+		State.PathRoughness = Random.GetFraction();
+		State.SigmaT = RandomVector(Random, 10.f);
+		State.FirstScatterType = (uint32)Random.RandRange(0, 7);
+
+		const FPathState Unpacked = Unpack(Pack(State));
+		bExact &= Unpacked.RandSeqSampleIndex == State.RandSeqSampleIndex && Unpacked.RandSeqSampleSeed == State.RandSeqSampleSeed
+			&& Unpacked.RayOrigin == State.RayOrigin && Unpacked.FirstScatterType == State.FirstScatterType;
+		MaxSharedExponentError = FMath::Max(MaxSharedExponentError, FMath::Max(
+			FMath::Max(GetSharedExponentError(State.Radiance, Unpacked.Radiance), GetSharedExponentError(State.Albedo, Unpacked.Albedo)),
+			FMath::Max(GetSharedExponentError(State.PathThroughput, Unpacked.PathThroughput), GetSharedExponentError(State.SigmaT, Unpacked.SigmaT))));
+		MaxDirectionError = FMath::Max(MaxDirectionError, (Unpacked.RayDirection - State.RayDirection).GetAbsMax());
+		MaxNormalError = FMath::Max(MaxNormalError, (Unpacked.Normal - State.Normal).GetAbsMax());
+		MaxRoughnessError = FMath::Max(MaxRoughnessError, FMath::Abs(Unpacked.PathRoughness - State.PathRoughness));
+		MaxVisibilityError = FMath::Max(MaxVisibilityError, FMath::Abs(Unpacked.BackgroundVisibility - State.BackgroundVisibility));
+	}
+	TestTrue(TEXT("Random sequence, ray origin and scatter type are exact"), bExact);
+	TestTrue(TEXT("Shared exponent fields are within their bound"), MaxSharedExponentError <= 1.f);
+	// 16 bit octahedral coordinates.
+	TestTrue(TEXT("Ray direction"), MaxDirectionError <= 1e-4f);
+	// 12 bit octahedral coordinates and an 8 bit length.
+	TestTrue(TEXT("Normal"), MaxNormalError <= 4e-3f);
+	TestTrue(TEXT("Path roughness keeps 16 bits"), MaxRoughnessError <= 0.5f / 65535.f + 1e-7f);
+	TestTrue(TEXT("Background visibility keeps 13 bits"), MaxVisibilityError <= 0.5f / 8191.f + 1e-7f);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMIGISharedExponentTest, "MIGI.PackedPathState.SharedExponent",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMIGISharedExponentTest::RunTest (const FString & Parameters)
+{
+	using namespace MIGIPackedPathState;
+	using namespace MIGIPackedPathStateTests;
+
+	const auto RoundTrip = [](const FVector3f & Value, int32 Bias) { return UnpackSharedExponent(PackSharedExponent(Value, Bias), Bias); };
+	TestTrue(TEXT("Zero stays zero"), RoundTrip(FVector3f::ZeroVector, DefaultExponentBias) == FVector3f::ZeroVector);
+	TestTrue(TEXT("Negative values become 0"), RoundTrip(FVector3f(-1.f, 0.5f, -1e10f), DefaultExponentBias) == FVector3f(0.f, 0.5f, 0.f));
+	const float NaN = FMath::Sqrt(-1.f);
+	TestTrue(TEXT("NaNs become 0, as on the GPU"), RoundTrip(FVector3f(NaN, 0.5f, NaN), DefaultExponentBias) == FVector3f(0.f, 0.5f, 0.f));
+
+	// Values past the range clamp to the largest one.
+	const float MaxRadiance = 511.f / 512.f * FMath::Exp2((float)(31 - RadianceExponentBias));
+	TestEqual(TEXT("Radiance clamps to its range"), RoundTrip(FVector3f(1e30f, 0.f, 0.f), RadianceExponentBias).X, MaxRadiance, 0.f);
+	TestTrue(TEXT("Radiance keeps 2e6"), MaxRadiance > 2e6f);
+
+	// Rounding the largest channel up to the next power of two moves the exponent.
+	const FVector3f JustBelowTwo(2.f - 1e-4f, 1.f, 0.f);
+	TestTrue(TEXT("Mantissa overflow carries into the exponent"), GetSharedExponentError(JustBelowTwo, RoundTrip(JustBelowTwo, DefaultExponentBias)) <= 1.f);
+	return true;
+}
+
+#endif
@@ -0,0 +1,88 @@
+﻿#include "Misc/AutomationTest.h"
+#include "MIGIPathCompaction.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMIGIGroupPrefixSumTest, "MIGI.PathCompaction.GroupPrefixSum",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMIGIGroupPrefixSumTest::RunTest (const FString & Parameters)
+{
+	FRandomStream Random(1234);
+	bool bMatches = true;
+	// Groups of whole waves, and a partial last wave.
+	for(int32 NumValues : {1, 31, 32, 128, 200})
+	{
+		for(uint32 WaveSize : {32u, 64u})
+		{
+			TArray<uint32> Values, Prefix;
+			for(int32 Index = 0; Index < NumValues; Index++)
+			{
+				Values.Add((uint32)Random.RandRange(0, 5));
+			}
+			const uint32 Total = MIGIPathCompaction::GroupPrefixSum(Values, WaveSize, Prefix);
+			uint32 Sum = 0;
+			for(int32 Index = 0; Index < NumValues; Index++)
+			{
+				bMatches &= Prefix[Index] == Sum;
+				Sum += Values[Index];
+			}
+			bMatches &= Total == Sum;
+		}
+	}
+	TestTrue(TEXT("Exclusive prefix sum and total"), bMatches);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMIGIPathCompactionTest, "MIGI.PathCompaction.Compact",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMIGIPathCompactionTest::RunTest (const FString & Parameters)
+{
+	FRandomStream Random(1234);
+	// Survival rates from none to all. Past GroupSize^2 slots the scan pass walks over more than one chunk of group counts.
+	for(float SurvivalRate : {0.f, 0.3f, 1.f})
+	{
+		for(int32 NumSlots : {0, 1, 127, 128, 1000, 20000})
+		{
+			for(uint32 GroupSize : {64u, 128u})
+			{
+				for(uint32 WaveSize : {32u, 64u})
+				{
+					TArray<int32> Survivors, Expected, ActivePaths;
+					for(int32 Slot = 0; Slot < NumSlots; Slot++)
+					{
+						// Survivors carry their pixel index, the dead paths -1.
+						const bool bSurvives = Random.GetFraction() < SurvivalRate;
+						Survivors.Add(bSurvives ? Slot * 3 + 1 : -1);
+						if(bSurvives)
+						{
+							Expected.Add(Slot * 3 + 1);
+						}
+					}
+					const uint32 NumActivePaths = MIGIPathCompaction::Compact(Survivors, GroupSize, WaveSize, ActivePaths);
+
+					// Same survivors, same slot order, -1 after them.
+					bool bCompacted = NumActivePaths == (uint32)Expected.Num() && ActivePaths.Num() == NumSlots;
+					for(int32 Slot = 0; bCompacted && Slot < NumSlots; Slot++)
+					{
+						bCompacted &= ActivePaths[Slot] == (Slot < Expected.Num() ? Expected[Slot] : -1);
+					}
+					bool bReset = true;
+					for(int32 Survivor : Survivors)
+					{
+						bReset &= Survivor == -1;
+					}
+					if(!bCompacted || !bReset)
+					{
+						AddError(FString::Printf(TEXT("%d slots, survival rate %.1f, group size %u, wave size %u: %s"),
+							NumSlots, SurvivalRate, GroupSize, WaveSize, bCompacted ? TEXT("survivors are not reset") : TEXT("wrong active paths")));
+					}
+				}
+			}
+		}
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,90 @@
+﻿#include "Misc/AutomationTest.h"
+#include "MIGIPathCompaction.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMIGIPathSortKeyTest, "MIGI.PathSort.SortKey",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMIGIPathSortKeyTest::RunTest (const FString & Parameters)
+{
+	using namespace MIGIPathCompaction;
+
+	constexpr float CellSize = 100.f;
+	FRandomStream Random(1234);
+	bool bInRange = true, bOctant = true, bClass = true, bCell = true;
+	for(int32 i = 0; i < 4096; i++)
+	{
+		// Origins past the outer cells too.
+		const FVector3f Origin(Random.FRandRange(-400.f, 400.f), Random.FRandRange(-400.f, 400.f), Random.FRandRange(-400.f, 400.f));
+		const FVector3f Direction(Random.FRandRange(-1.f, 1.f), Random.FRandRange(-1.f, 1.f), Random.FRandRange(-1.f, 1.f));
+		const float Roughness = Random.GetFraction();
+		const uint32 Key = ComputeSortKey(Origin, Direction, Roughness, CellSize);
+		bInRange &= Key < NumSortBins;
+		const uint32 Octant = (Key >> 6) & 7;
+		bOctant &= ((Octant & 1) != 0) == (Direction.X < 0.f) && ((Octant & 2) != 0) == (Direction.Y < 0.f) && ((Octant & 4) != 0) == (Direction.Z < 0.f);
+		bClass &= ((Key >> 9) & 1) == (Roughness >= SortRoughClassThreshold ? 1u : 0u);
+		// De-interleave the Morton code, the cells are centered on the camera and clamped.
+		const float Coordinates[3] = {Origin.X, Origin.Y, Origin.Z};
+		for(uint32 Axis = 0; Axis < 3; Axis++)
+		{
+			const uint32 Cell = ((Key >> Axis) & 1) | (((Key >> (Axis + 3)) & 1) << 1);
+			const int32 Expected = FMath::Clamp(FMath::FloorToInt(Coordinates[Axis] / CellSize) + NumSortCells / 2, 0, NumSortCells - 1);
+			bCell &= Cell == (uint32)Expected;
+		}
+	}
+	TestTrue(TEXT("Keys fit the bins"), bInRange);
+	TestTrue(TEXT("Keys hold the direction octant"), bOctant);
+	TestTrue(TEXT("Keys hold the shading class"), bClass);
+	TestTrue(TEXT("Keys hold the origin cell"), bCell);
+	TestEqual(TEXT("Largest key"), ComputeSortKey(FVector3f(1e9f, 1e9f, 1e9f), FVector3f(-1.f, -1.f, -1.f), 1.f, CellSize), NumSortBins - 1);
+	TestEqual(TEXT("Smallest key"), ComputeSortKey(FVector3f(-1e9f, -1e9f, -1e9f), FVector3f(1.f, 1.f, 1.f), 0.f, CellSize), 0u);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMIGIPathSortTest, "MIGI.PathSort.SortByKey",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMIGIPathSortTest::RunTest (const FString & Parameters)
+{
+	using namespace MIGIPathCompaction;
+
+	FRandomStream Random(1234);
+	// Few bins in use, so the bins hold many paths each.
+	TArray<int32> Paths;
+	TArray<uint32> Keys;
+	for(int32 Index = 0; Index < 5000; Index++)
+	{
+		Paths.Add(Index);
+		Keys.Add((uint32)Random.RandRange(0, 15) * 61);
+	}
+	TArray<int32> SortedPaths;
+	SortByKey(Paths, Keys, SortedPaths);
+
+	// A permutation of the paths, bins in order, and on the CPU the paths keep their order within a bin.
+	bool bPermutation = SortedPaths.Num() == Paths.Num(), bSorted = true, bStable = true;
+	TArray<bool> bSeen;
+	bSeen.Init(false, Paths.Num());
+	for(int32 Index = 0; bPermutation && Index < SortedPaths.Num(); Index++)
+	{
+		const int32 Path = SortedPaths[Index];
+		bPermutation &= Path >= 0 && Path < Paths.Num() && !bSeen[Path];
+		if(!bPermutation)
+		{
+			break;
+		}
+		bSeen[Path] = true;
+		if(Index > 0)
+		{
+			const int32 Previous = SortedPaths[Index - 1];
+			bSorted &= Keys[Previous] <= Keys[Path];
+			bStable &= Keys[Previous] != Keys[Path] || Previous < Path;
+		}
+	}
+	TestTrue(TEXT("Sorted paths are a permutation"), bPermutation);
+	TestTrue(TEXT("Paths are sorted by key"), bSorted);
+	TestTrue(TEXT("Paths keep their order within a bin"), bStable);
+	return true;
+}
+
+#endif
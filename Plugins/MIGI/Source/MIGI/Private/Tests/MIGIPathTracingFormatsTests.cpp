@@ -0,0 +1,76 @@
+﻿#include "Misc/AutomationTest.h"
+#include "MIGIPathTracingFormats.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMIGIPathTracingFormatsTest, "MIGI.PathTracingFormats.Quantize",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMIGIPathTracingFormatsTest::RunTest (const FString & Parameters)
+{
+	using namespace MIGIPathTracingFormats;
+
+	TestTrue(TEXT("Albedo pixel formats"), GetPixelFormat(EAlbedoFormat::Float32) == PF_A32B32G32R32F
+		&& GetPixelFormat(EAlbedoFormat::Float16) == PF_FloatRGBA && GetPixelFormat(EAlbedoFormat::Unorm10) == PF_A2B10G10R10);
+	TestTrue(TEXT("Normal pixel formats"), GetPixelFormat(ENormalFormat::Float32) == PF_A32B32G32R32F
+		&& GetPixelFormat(ENormalFormat::Float16) == PF_FloatRGBA);
+
+	FRandomStream Random(1234);
+	float MaxUnormError = 0.f, MaxAlphaError = 0.f, MaxHalfError = 0.f;
+	bool bFloat32Exact = true;
+	for(int32 i = 0; i < 4096; i++)
+	{
+		const FVector4f Albedo(Random.GetFraction(), Random.GetFraction(), Random.GetFraction(), Random.GetFraction());
+		const FVector4f Float32 = Quantize(EAlbedoFormat::Float32, Albedo);
+		bFloat32Exact &= Float32.X == Albedo.X && Float32.Y == Albedo.Y && Float32.Z == Albedo.Z && Float32.W == Albedo.W;
+		const FVector4f Unorm = Quantize(EAlbedoFormat::Unorm10, Albedo);
+		MaxUnormError = FMath::Max(MaxUnormError, FMath::Max3(FMath::Abs(Unorm.X - Albedo.X), FMath::Abs(Unorm.Y - Albedo.Y), FMath::Abs(Unorm.Z - Albedo.Z)));
+		MaxAlphaError = FMath::Max(MaxAlphaError, FMath::Abs(Unorm.W - Albedo.W));
+		// Albedo is at least 2^-14 here, the normal range of half floats.
+		const float Value = FMath::Max(Albedo.X, 1e-4f);
+		MaxHalfError = FMath::Max(MaxHalfError, FMath::Abs(QuantizeHalf(Value) - Value) / Value);
+	}
+	TestTrue(TEXT("Float32 stores the albedo as is"), bFloat32Exact);
+	// Half a step of the channel.
+	TestTrue(TEXT("Unorm10 rounds to the nearest step"), MaxUnormError <= 0.5f / 1023.f + 1e-6f);
+	TestTrue(TEXT("Unorm alpha keeps 2 bits"), MaxAlphaError <= 0.5f / 3.f + 1e-6f);
+	TestTrue(TEXT("Half floats keep 11 significant bits"), MaxHalfError <= 1.f / 2048.f);
+	TestEqual(TEXT("Unorm clamps below 0"), QuantizeUnorm(-0.5f, 10), 0.f, 0.f);
+	TestEqual(TEXT("Unorm clamps above 1"), QuantizeUnorm(1.5f, 10), 1.f, 0.f);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMIGIOctahedralTest, "MIGI.PathTracingFormats.Octahedral",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMIGIOctahedralTest::RunTest (const FString & Parameters)
+{
+	using namespace MIGIPathTracingFormats;
+
+	// The axes, the poles and the folded lower hemisphere included.
+	TArray<FVector3f> Directions = {
+		FVector3f(1.f, 0.f, 0.f), FVector3f(-1.f, 0.f, 0.f), FVector3f(0.f, 1.f, 0.f), FVector3f(0.f, -1.f, 0.f),
+		FVector3f(0.f, 0.f, 1.f), FVector3f(0.f, 0.f, -1.f), FVector3f(1.f, -1.f, -1.f).GetSafeNormal()};
+	FRandomStream Random(1234);
+	for(int32 i = 0; i < 4096; i++)
+	{
+		// Uniform on the sphere.
+		const float Z = Random.GetFraction() * 2.f - 1.f;
+		const float Phi = Random.GetFraction() * 2.f * PI;
+		const float R = FMath::Sqrt(FMath::Max(1.f - Z * Z, 0.f));
+		Directions.Add(FVector3f(R * FMath::Cos(Phi), R * FMath::Sin(Phi), Z));
+	}
+	bool bInSquare = true;
+	float MaxError = 0.f;
+	for(const FVector3f & Direction : Directions)
+	{
+		const FVector2f E = EncodeOctahedral(Direction);
+		bInSquare &= FMath::Abs(E.X) <= 1.f && FMath::Abs(E.Y) <= 1.f;
+		MaxError = FMath::Max(MaxError, (DecodeOctahedral(E) - Direction).GetAbsMax());
+	}
+	TestTrue(TEXT("Encoded directions are in [-1, 1]^2"), bInSquare);
+	TestTrue(TEXT("Octahedral round trip"), MaxError <= 1e-5f);
+	return true;
+}
+
+#endif
@@ -0,0 +1,155 @@
+﻿#include "Misc/AutomationTest.h"
+#include "MIGITrainingSampleSelector.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMIGITrainingSampleAllocationTest, "MIGI.TrainingSampleSelector.Allocation",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMIGITrainingSampleAllocationTest::RunTest (const FString & Parameters)
+{
+	using namespace MIGITrainingSampleSelector;
+
+	// Zeros and a negative importance among them, which counts as zero.
+	const TArray<float> Importance = {3.f, 0.f, 1.f, 0.5f, -2.f, 7.25f, 0.125f, 2.f};
+	double TotalImportance = 0.;
+	for(float Value : Importance)
+	{
+		TotalImportance += FMath::Max(Value, 0.f);
+	}
+
+	constexpr uint32 NumSamples = 1001;
+	constexpr uint32 NumFrames = 4096;
+	TArray<uint32> Offsets;
+	TArray<double> MeanCounts;
+	MeanCounts.SetNumZeroed(Importance.Num());
+	bool bSums = true, bRounded = true;
+	for(uint32 Frame = 0; Frame < NumFrames; Frame++)
+	{
+		AllocateSamples(Importance, NumSamples, GetFramePhase(Frame), Offsets);
+		bSums &= Offsets.Num() == Importance.Num() + 1 && Offsets[0] == 0 && Offsets.Last() == NumSamples;
+		for(int32 t = 0; t < Importance.Num(); t++)
+		{
+			// Every tile gets its share rounded up or down.
+			const double Share = FMath::Max(Importance[t], 0.f) / TotalImportance * NumSamples;
+			const uint32 Count = Offsets[t + 1] - Offsets[t];
+			bRounded &= Offsets[t + 1] >= Offsets[t] && Count >= FMath::FloorToDouble(Share - 1e-6) && Count <= FMath::CeilToDouble(Share + 1e-6);
+			MeanCounts[t] += (double)Count / NumFrames;
+		}
+	}
+	TestTrue(TEXT("Counts sum to the number of samples"), bSums);
+	TestTrue(TEXT("Counts are the shares rounded"), bRounded);
+
+	// The phase moves the rounding every frame, over time the fractional shares are honoured.
+	double MaxMeanError = 0.;
+	for(int32 t = 0; t < Importance.Num(); t++)
+	{
+		MaxMeanError = FMath::Max(MaxMeanError, FMath::Abs(MeanCounts[t] - FMath::Max(Importance[t], 0.f) / TotalImportance * NumSamples));
+	}
+	TestTrue(TEXT("Mean counts converge to the shares"), MaxMeanError < 0.01);
+
+	// No importance at all: uniform.
+	const TArray<float> NoImportance = {0.f, 0.f, 0.f, 0.f};
+	AllocateSamples(NoImportance, 256, GetFramePhase(17), Offsets);
+	TestTrue(TEXT("Uniform without importance"), Offsets == TArray<uint32>({0, 64, 128, 192, 256}));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMIGITrainingSamplePhaseTest, "MIGI.TrainingSampleSelector.FramePhase",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMIGITrainingSamplePhaseTest::RunTest (const FString & Parameters)
+{
+	using namespace MIGITrainingSampleSelector;
+
+	TestEqual(TEXT("Phase of the first frame"), GetFramePhase(0), 0.f, 0.f);
+	// Consecutive frames spread over [0, 1) however late in the session, a float phase would collapse them.
+	for(uint32 FirstFrame : {0u, 1u << 24, 1u << 30, 0xFFFFFFF0u})
+	{
+		TArray<float> Phases;
+		for(uint32 i = 0; i < 16; i++)
+		{
+			// Wraps around past the last frame index, so does the frame counter.
+			Phases.Add(GetFramePhase(FirstFrame + i));
+		}
+		Phases.Sort();
+		bool bInRange = Phases[0] >= 0.f && Phases.Last() < 1.f;
+		float MinGap = 1.f;
+		for(int32 i = 1; i < Phases.Num(); i++)
+		{
+			MinGap = FMath::Min(MinGap, Phases[i] - Phases[i - 1]);
+		}
+		TestTrue(TEXT("Phases are in [0, 1)"), bInRange);
+		TestTrue(TEXT("Phases of consecutive frames are spread"), MinGap > 0.02f);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMIGITrainingSampleImportanceTest, "MIGI.TrainingSampleSelector.Importance",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMIGITrainingSampleImportanceTest::RunTest (const FString & Parameters)
+{
+	using namespace MIGITrainingSampleSelector;
+
+	// Tiles without samples keep their loss, the others blend towards their mean loss.
+	TArray<float> TileLoss = {1.f, 2.f, 4.f};
+	const TArray<float> LossSums = {6.f, 5.f, 0.f};
+	const TArray<uint32> SampleCounts = {2, 0, 0};
+	AccumulateTileLoss(LossSums, SampleCounts, 0.25f, TileLoss);
+	TestEqual(TEXT("Blended tile loss"), TileLoss[0], 1.5f);
+	TestEqual(TEXT("Tile loss without samples"), TileLoss[1], 2.f);
+	TestEqual(TEXT("Tile loss without samples"), TileLoss[2], 4.f);
+
+	// Learned tiles keep MinShare of the mean loss.
+	TArray<float> TileImportance;
+	GetTileImportance(TArray<float>({0.f, 1.f, 5.f, 10.f}), 0.25f, TileImportance);
+	TestEqual(TEXT("Importance of a learned tile"), TileImportance[0], 1.f);
+	TestEqual(TEXT("Importance below the floor"), TileImportance[1], 1.f);
+	TestEqual(TEXT("Importance above the floor"), TileImportance[2], 5.f);
+	TestEqual(TEXT("Importance above the floor"), TileImportance[3], 10.f);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FMIGITrainingSamplePixelTest, "MIGI.TrainingSampleSelector.SamplePixel",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FMIGITrainingSamplePixelTest::RunTest (const FString & Parameters)
+{
+	using namespace MIGITrainingSampleSelector;
+
+	// The right and bottom tiles are cut by the view.
+	constexpr uint32 TileSize = 16;
+	const FIntPoint ViewSize(70, 37);
+	const FIntPoint TileGridSize = GetTileGridSize(ViewSize, TileSize);
+	TestEqual(TEXT("Tile grid size"), TileGridSize, FIntPoint(5, 3));
+
+	bool bInTile = true, bDistinct = true;
+	for(uint32 Frame : {0u, 1u, 12345u})
+	{
+		for(int32 TileY = 0; TileY < TileGridSize.Y; TileY++)
+		{
+			for(int32 TileX = 0; TileX < TileGridSize.X; TileX++)
+			{
+				const FIntPoint Tile(TileX, TileY);
+				const FIntPoint Origin(TileX * (int32)TileSize, TileY * (int32)TileSize);
+				const FIntPoint End(FMath::Min(Origin.X + (int32)TileSize, ViewSize.X), FMath::Min(Origin.Y + (int32)TileSize, ViewSize.Y));
+				const bool bFullTile = End.X - Origin.X == TileSize && End.Y - Origin.Y == TileSize;
+				TArray<FIntPoint> Pixels;
+				for(uint32 Sample = 0; Sample < 8; Sample++)
+				{
+					const FIntPoint Pixel = GetSamplePixel(Tile, Sample, TileSize, TileGridSize, Frame, ViewSize);
+					bInTile &= Pixel.X >= Origin.X && Pixel.X < End.X && Pixel.Y >= Origin.Y && Pixel.Y < End.Y;
+					// The lattice keeps the first samples of a full tile apart.
+					bDistinct &= !bFullTile || !Pixels.Contains(Pixel);
+					Pixels.Add(Pixel);
+				}
+			}
+		}
+	}
+	TestTrue(TEXT("Samples stay in their tile and the view"), bInTile);
+	TestTrue(TEXT("Samples of a tile are distinct pixels"), bDistinct);
+	return true;
+}
+
+#endif
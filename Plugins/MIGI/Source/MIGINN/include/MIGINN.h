@@ -1,8 +1,10 @@
 // The public library header file for MIGINN
+#pragma once
 
 #include <string>
 
 constexpr size_t MIGINN_DETAILS_JSON_STRING_SIZE = 16384;
+constexpr uint32_t MIGINN_HASH_GRID_MAX_OUTPUT_DIMENSIONS = 4;
 
 enum class MIGINNResultType {
     eSuccess = 0,
@@ -19,6 +21,8 @@ enum class MIGIPlatformType {
 
 enum class MIGINNNetworkType {
     eMLP = 0,
+    // Non-neural world space radiance cache, see MIGINNDetailsHashGrid.
+    eHashGrid = 1,
     eNum
 };
 
@@ -47,6 +51,22 @@ struct MIGINNInitializeParams {
 struct MIGINNDetailsMLP {
     uint32_t InNumInputDimensions {};
     uint32_t InNumOutputDimensions {};
+    // Serve inference from an INT8 copy of the network. Requires a ReLU MLP without output activation.
+    uint32_t InQuantizedInference {};
+    // Re-quantize from the training weights every this many training steps.
+    uint32_t InQuantizationRefreshInterval {};
+    // Snap every input dimension to a grid of this step and run the network once per distinct snapped query.
+    // 0 disables the deduplication.
+    float InDeduplicationQuantum {};
+    // Keep the results of the deduplicated queries across frames in a table of 2^this entries.
+    // 0 disables the result cache, it needs InDeduplicationQuantum.
+    uint32_t InLog2ResultCacheSize {};
+    // Cached results produced this many training steps ago are always refreshed.
+    uint32_t InResultCacheMaxAge {};
+    // A cached result that moved this much at its last refresh is refreshed every frame, steadier ones proportionally less often.
+    float InResultCacheTolerance {};
+    // Refresh probability of cached results that did not move at all.
+    float InResultCacheMinRefreshProbability {};
     char InExtraOptionsJson[MIGINN_DETAILS_JSON_STRING_SIZE];
 //    char * InEncodingOptionsJson[MIGINN_DETAILS_JSON_STRING_SIZE];
 //    char * InNetworkOptionsJson[MIGINN_DETAILS_JSON_STRING_SIZE];
@@ -54,9 +74,34 @@ struct MIGINNDetailsMLP {
 //    char * InOptimizerOptionsJson[MIGINN_DETAILS_JSON_STRING_SIZE];
 };
 
+// A spatially hashed, direction-binned radiance store.
+// Training samples are averaged per cell and blended into the cache with an exponential moving average,
+// inference returns the cached value of the cell (zero for cells never trained).
+struct MIGINNDetailsHashGrid {
+    uint32_t InNumInputDimensions {};
+    // At most MIGINN_HASH_GRID_MAX_OUTPUT_DIMENSIONS.
+    uint32_t InNumOutputDimensions {};
+    // Offset of the world position (3 floats) inside an input element.
+    uint32_t InPositionOffset {};
+    // Offset of the unit direction (3 floats) inside an input element.
+    uint32_t InDirectionOffset {};
+    // Bins per side of the octahedral direction map (squared for the total). 0 disables direction binning.
+    uint32_t InNumDirectionBins {};
+    // Log2 of the number of table entries.
+    uint32_t InLog2TableSize {};
+    // World space edge length of a grid cell.
+    float InCellSize {};
+    // Weight of a new frame's samples in the moving average, once a cell has seen enough samples.
+    float InBlendFactor {};
+    // Entries not trained for this many training steps are replaced by new cells whose probe sequence is full.
+    // 0 never replaces an entry.
+    uint32_t InMaxAge {};
+};
+
 struct MIGINNNetworkConfig {
     union {
         MIGINNDetailsMLP MLP;
+        MIGINNDetailsHashGrid HashGrid;
     } Details {};
     MIGINNNetworkType Type {};
 };
@@ -70,6 +115,14 @@ MIGINNResultType MIGINNInitializeNeuralNetwork (const MIGINNNetworkConfig & Conf
 
 MIGINNResultType MIGINNDestroy ();
 
+// Spill the network weights (and optimizer state) to host memory, then release every device allocation:
+// the network, the GPU memory arenas and the imported input & output buffers.
+// The CUDA stream and the imported fence stay alive. On failure the network is left running.
+MIGINNResultType MIGINNSuspend ();
+// Import the (re-created) input & output buffers and restore the network spilled by MIGINNSuspend without retraining.
+// The fence handle in Params is ignored.
+MIGINNResultType MIGINNResume (const MIGINNInitializeParams & Params);
+
 // Queue a barrier in the CUDA stream waiting for a certain fence value.
 MIGINNResultType MIGINNWaitFenceValue (uint64_t InWaitFenceValue) ;
 // Queue a fence value signal in the CUDA stream, this signal should be waited on by other processes.
@@ -27,6 +27,69 @@ CUdeviceptr GOutputBufferAddress;
 
 std::unique_ptr<MIGINNCacheNetwork> GNetwork;
 
+// Import the D3D input & output buffers into CUDA and map them. Throws on CUDA errors.
+static void ImportSharedBuffers (const MIGINNInitializeParams &Params) {
+//    cudaExternalMemoryHandleDesc InExternalInputMemoryHandleDesc{
+//            .type = cudaExternalMemoryHandleTypeD3D12Resource,
+//            .handle = {.win32 = {.handle = Params.Platform.Win_D3D12.InD3D12InputBufferResourceHandle}},
+//            .size = Params.InInputBufferSize,
+//            .flags = cudaExternalMemoryDedicated
+//    };
+    cudaExternalMemoryHandleDesc InExternalInputMemoryHandleDesc{};
+    InExternalInputMemoryHandleDesc.type = cudaExternalMemoryHandleTypeD3D12Resource;
+    InExternalInputMemoryHandleDesc.handle.win32.handle = Params.Platform.Win_D3D12.InD3D12InputBufferResourceHandle;
+    InExternalInputMemoryHandleDesc.size = Params.InInputBufferSize;
+    InExternalInputMemoryHandleDesc.flags = cudaExternalMemoryDedicated;
+    checkCUDA(cudaImportExternalMemory(&GExternalInputMemoryHandle, &InExternalInputMemoryHandleDesc));
+//    cudaExternalMemoryHandleDesc InExternalOutputMemoryHandleDesc{
+//            .type = cudaExternalMemoryHandleTypeD3D12Resource,
+//            .handle = {.win32 = {.handle = Params.Platform.Win_D3D12.InD3D12OutputBufferResourceHandle}},
+//            .size = Params.InOutputBufferSize,
+//            .flags = cudaExternalMemoryDedicated
+//    };
+    cudaExternalMemoryHandleDesc InExternalOutputMemoryHandleDesc{};
+    InExternalOutputMemoryHandleDesc.type = cudaExternalMemoryHandleTypeD3D12Resource;
+    InExternalOutputMemoryHandleDesc.handle.win32.handle = Params.Platform.Win_D3D12.InD3D12OutputBufferResourceHandle;
+    InExternalOutputMemoryHandleDesc.size = Params.InOutputBufferSize;
+    InExternalOutputMemoryHandleDesc.flags = cudaExternalMemoryDedicated;
+
+    checkCUDA(cudaImportExternalMemory(&GExternalOutputMemoryHandle, &InExternalOutputMemoryHandleDesc));
+    // Get the GPU memory address of the input and output buffers.
+//    auto InputBufferDesc = cudaExternalMemoryBufferDesc {
+//            .offset = Params.InInputBufferOffset,
+//            .size = Params.InInputBufferSize,
+//            .flags = 0
+//    };
+    auto InputBufferDesc = cudaExternalMemoryBufferDesc{};
+    InputBufferDesc.offset = Params.InInputBufferOffset;
+    InputBufferDesc.size = Params.InInputBufferSize;
+    InputBufferDesc.flags = 0;
+    checkCUDA(cudaExternalMemoryGetMappedBuffer((void**)&GInputBufferAddress, GExternalInputMemoryHandle, &InputBufferDesc));
+//    auto OutputBufferDesc = cudaExternalMemoryBufferDesc {
+//            .offset = Params.InOutputBufferOffset,
+//            .size = Params.InOutputBufferSize,
+//            .flags = 0
+//    };
+    auto OutputBufferDesc = cudaExternalMemoryBufferDesc{};
+    OutputBufferDesc.offset = Params.InOutputBufferOffset;
+    OutputBufferDesc.size = Params.InOutputBufferSize;
+    OutputBufferDesc.flags = 0;
+    checkCUDA(cudaExternalMemoryGetMappedBuffer((void**)&GOutputBufferAddress, GExternalOutputMemoryHandle, &OutputBufferDesc));
+}
+
+// Unmap and release the imported input & output buffers. Throws on CUDA errors.
+static void ReleaseSharedBuffers () {
+    // Mapped buffers of external memory must be freed with cudaFree.
+    checkCUDA(cudaFree((void*)GInputBufferAddress));
+    GInputBufferAddress = 0;
+    checkCUDA(cudaFree((void*)GOutputBufferAddress));
+    GOutputBufferAddress = 0;
+    checkCUDA(cudaDestroyExternalMemory(GExternalInputMemoryHandle));
+    GExternalInputMemoryHandle = nullptr;
+    checkCUDA(cudaDestroyExternalMemory(GExternalOutputMemoryHandle));
+    GExternalOutputMemoryHandle = nullptr;
+}
+
 MIGINNResultType MIGINNInitialize (const MIGINNInitializeParams &Params) {
     // Initialize CUDA context.
     try {
@@ -49,52 +112,7 @@ MIGINNResultType MIGINNInitialize (const MIGINNInitializeParams &Params) {
         InExternalSemaphoreHandleDesc.handle.win32.handle = Params.Platform.Win_D3D12.InD3D12FenceHandle;
         InExternalSemaphoreHandleDesc.flags = 0;
         checkCUDA(cudaImportExternalSemaphore(&GExternalSemaphoreHandle, &InExternalSemaphoreHandleDesc));
-//        cudaExternalMemoryHandleDesc InExternalInputMemoryHandleDesc{
-//                .type = cudaExternalMemoryHandleTypeD3D12Resource,
-//                .handle = {.win32 = {.handle = Params.Platform.Win_D3D12.InD3D12InputBufferResourceHandle}},
-//                .size = Params.InInputBufferSize,
-//                .flags = cudaExternalMemoryDedicated
-//        };
-        cudaExternalMemoryHandleDesc InExternalInputMemoryHandleDesc{};
-        InExternalInputMemoryHandleDesc.type = cudaExternalMemoryHandleTypeD3D12Resource;
-        InExternalInputMemoryHandleDesc.handle.win32.handle = Params.Platform.Win_D3D12.InD3D12InputBufferResourceHandle;
-        InExternalInputMemoryHandleDesc.size = Params.InInputBufferSize;
-        InExternalInputMemoryHandleDesc.flags = cudaExternalMemoryDedicated;
-        checkCUDA(cudaImportExternalMemory(&GExternalInputMemoryHandle, &InExternalInputMemoryHandleDesc));
-//        cudaExternalMemoryHandleDesc InExternalOutputMemoryHandleDesc{
-//                .type = cudaExternalMemoryHandleTypeD3D12Resource,
-//                .handle = {.win32 = {.handle = Params.Platform.Win_D3D12.InD3D12OutputBufferResourceHandle}},
-//                .size = Params.InOutputBufferSize,
-//                .flags = cudaExternalMemoryDedicated
-//        };
-        cudaExternalMemoryHandleDesc InExternalOutputMemoryHandleDesc{};
-        InExternalOutputMemoryHandleDesc.type = cudaExternalMemoryHandleTypeD3D12Resource;
-        InExternalOutputMemoryHandleDesc.handle.win32.handle = Params.Platform.Win_D3D12.InD3D12OutputBufferResourceHandle;
-        InExternalOutputMemoryHandleDesc.size = Params.InOutputBufferSize;
-        InExternalOutputMemoryHandleDesc.flags = cudaExternalMemoryDedicated;
-
-        checkCUDA(cudaImportExternalMemory(&GExternalOutputMemoryHandle, &InExternalOutputMemoryHandleDesc));
-        // Get the GPU memory address of the input and output buffers.
-//        auto InputBufferDesc = cudaExternalMemoryBufferDesc {
-//                .offset = Params.InInputBufferOffset,
-//                .size = Params.InInputBufferSize,
-//                .flags = 0
-//        };
-        auto InputBufferDesc = cudaExternalMemoryBufferDesc{};
-        InputBufferDesc.offset = Params.InInputBufferOffset;
-        InputBufferDesc.size = Params.InInputBufferSize;
-        InputBufferDesc.flags = 0;
-        checkCUDA(cudaExternalMemoryGetMappedBuffer((void**)&GInputBufferAddress, GExternalInputMemoryHandle, &InputBufferDesc));
-//        auto OutputBufferDesc = cudaExternalMemoryBufferDesc {
-//                .offset = Params.InOutputBufferOffset,
-//                .size = Params.InOutputBufferSize,
-//                .flags = 0
-//        };
-        auto OutputBufferDesc = cudaExternalMemoryBufferDesc{};
-        OutputBufferDesc.offset = Params.InOutputBufferOffset;
-        OutputBufferDesc.size = Params.InOutputBufferSize;
-        OutputBufferDesc.flags = 0;
-        checkCUDA(cudaExternalMemoryGetMappedBuffer((void**)&GOutputBufferAddress, GExternalOutputMemoryHandle, &OutputBufferDesc));
+        ImportSharedBuffers(Params);
     } catch(std::runtime_error & e) {
         return MIGINNResultType::eCUDAError;
     }
@@ -110,16 +128,11 @@ MIGINNResultType MIGINNDestroy() {
     }
     // Destroy the CUDA context and release all resources.
     try {
-        // Clear pointers
-        GInputBufferAddress = 0;
-        GOutputBufferAddress = 0;
         // Destroy CUDA context
         checkCUDA(cudaStreamDestroy(GCUDAStream));
         GCUDAStream = nullptr;
-        checkCUDA(cudaDestroyExternalMemory(GExternalInputMemoryHandle));
-        GExternalInputMemoryHandle = nullptr;
-        checkCUDA(cudaDestroyExternalMemory(GExternalOutputMemoryHandle));
-        GExternalOutputMemoryHandle = nullptr;
+        // Already released if suspended.
+        if(GExternalInputMemoryHandle) ReleaseSharedBuffers();
         checkCUDA(cudaDestroyExternalSemaphore(GExternalSemaphoreHandle));
         GExternalSemaphoreHandle = nullptr;
         checkCUDA(cudaDeviceReset());
@@ -129,6 +142,38 @@ MIGINNResultType MIGINNDestroy() {
     return MIGINNResultType::eSuccess;
 }
 
+MIGINNResultType MIGINNSuspend() {
+    if(!GNetwork) return MIGINNResultType::eError;
+    try {
+        // Everything queued may still read the shared buffers or the network.
+        checkCUDA(cudaStreamSynchronize(GCUDAStream));
+    } catch(std::runtime_error & e) {
+        return MIGINNResultType::eCUDAError;
+    }
+    auto Result = GNetwork->Suspend();
+    if(Result != MIGINNResultType::eSuccess) return Result;
+    try {
+        ReleaseSharedBuffers();
+    } catch(std::runtime_error & e) {
+        // The caller keeps running on a failed suspend, bring the network back so it matches the buffers still imported.
+        GNetwork->Resume();
+        return MIGINNResultType::eCUDAError;
+    }
+    return MIGINNResultType::eSuccess;
+}
+
+MIGINNResultType MIGINNResume(const MIGINNInitializeParams &Params) {
+    if(!GNetwork) return MIGINNResultType::eError;
+    try {
+        // Resume may run on another host thread than the initialization.
+        checkCUDA(cudaSetDevice(Params.InDeviceIndex));
+        ImportSharedBuffers(Params);
+    } catch(std::runtime_error & e) {
+        return MIGINNResultType::eCUDAError;
+    }
+    return GNetwork->Resume();
+}
+
 MIGINNResultType MIGINNWaitFenceValue(uint64_t InWaitFenceValue) {
     // Queue a fence wait in the CUDA stream.
     try {
@@ -158,6 +203,8 @@ MIGINNResultType MIGINNSignalFenceValue(uint64_t InSignalFenceValue) {
 MIGINNResultType MIGINNInitializeNeuralNetwork(const MIGINNNetworkConfig &Config) {
     if(Config.Type == MIGINNNetworkType::eMLP) {
         return (GNetwork = MIGINNMLPCacheNetwork::Create(Config)) ? MIGINNResultType::eSuccess : MIGINNResultType::eError;
+    } else if(Config.Type == MIGINNNetworkType::eHashGrid) {
+        return (GNetwork = MIGINNHashGridCacheNetwork::Create(Config)) ? MIGINNResultType::eSuccess : MIGINNResultType::eError;
     } else return MIGINNResultType::eError;
 }
 
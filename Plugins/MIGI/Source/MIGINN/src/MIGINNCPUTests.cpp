@@ -0,0 +1,286 @@
+/*
+ * Project MIGINN : MIGINNCPUTests.cpp
+ * Created: 2024/03/20
+ * This program is unlicensed. See LICENSE for more.
+ */
+// Host only tests of the CPU paths: the MLPs against a plain float reference, the encodings against their definitions
+// and the hash grid cache. Returns non-zero if any test fails, prints the measured errors either way.
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "MIGINNEncodingCPU.h"
+#include "MIGINNHashEncodingCPU.h"
+#include "MIGINNHashGridCPU.h"
+#include "MIGINNMLPCPU.h"
+#include "MIGINNQuantizedMLPCPU.h"
+
+namespace {
+
+constexpr uint32_t NumElements = 1024;
+constexpr double Pi = 3.14159265358979323846;
+// The float MLP only reorders the sums.
+constexpr float MLPTolerance = 1e-4f;
+// INT8 weights and activations, the RMS error relative to the RMS of the outputs. Measured 1.3% to 3.4% on these shapes.
+constexpr float QuantizedRelativeRMSTolerance = 0.1f;
+
+std::vector<MIGINNFloatLayer> MakeRandomLayers (uint32_t NumInputs, uint32_t Width, uint32_t NumHiddenLayers, uint32_t NumOutputs, uint32_t Seed) {
+    std::mt19937 Generator{Seed};
+    std::vector<MIGINNFloatLayer> Layers;
+    Layers.push_back({NumInputs, Width, {}, true});
+    for(uint32_t i = 1; i < NumHiddenLayers; i++) Layers.push_back({Width, Width, {}, true});
+    Layers.push_back({Width, NumOutputs, {}, false});
+    for(auto & Layer : Layers) {
+        std::normal_distribution<float> Distribution{0.f, std::sqrt(2.f / (float)Layer.NumInputs)};
+        Layer.Weights.resize((size_t)Layer.NumInputs * Layer.NumOutputs);
+        for(auto & Weight : Layer.Weights) Weight = Distribution(Generator);
+    }
+    return Layers;
+}
+
+std::vector<float> MakeRandomInputs (uint32_t NumDimensions, uint32_t Count, uint32_t Seed) {
+    std::mt19937 Generator{Seed};
+    std::uniform_real_distribution<float> Distribution{0.f, 1.f};
+    std::vector<float> Inputs((size_t)NumDimensions * Count);
+    for(auto & Input : Inputs) Input = Distribution(Generator);
+    return Inputs;
+}
+
+std::vector<float> InferenceReference (const std::vector<MIGINNFloatLayer> & Layers, const std::vector<float> & Inputs, uint32_t Count) {
+    const uint32_t NumInputs = Layers.front().NumInputs, NumOutputs = Layers.back().NumOutputs;
+    std::vector<float> Outputs((size_t)NumOutputs * Count);
+    for(uint32_t Idx = 0; Idx < Count; Idx++) {
+        MIGINNQuantizedMLPCPU::InferenceFloat(Layers, Inputs.data() + (size_t)Idx * NumInputs, Outputs.data() + (size_t)Idx * NumOutputs);
+    }
+    return Outputs;
+}
+
+// The shapes the fully fused MLP instantiates, and a few it doesn't.
+struct FShape {
+    uint32_t NumInputs, Width, NumHiddenLayers, NumOutputs;
+};
+const FShape Shapes[] = {
+    {8, 64, 4, 4}, {32, 64, 2, 4}, {16, 128, 3, 3}, {8, 16, 1, 4}, {13, 48, 3, 5}, {7, 20, 2, 1},
+};
+
+bool TestMLP () {
+    bool bPassed = true;
+    for(const auto & Shape : Shapes) {
+        const auto Layers = MakeRandomLayers(Shape.NumInputs, Shape.Width, Shape.NumHiddenLayers, Shape.NumOutputs, 1234);
+        // Not a multiple of the tile, the tail elements take the same path.
+        const uint32_t Count = NumElements + 3;
+        const auto Inputs = MakeRandomInputs(Shape.NumInputs, Count, 42);
+        const auto Reference = InferenceReference(Layers, Inputs, Count);
+        const MIGINNMLPCPU Network{Layers};
+        std::vector<float> Outputs((size_t)Shape.NumOutputs * Count);
+        Network.Inference(Inputs.data(), Shape.NumInputs, Outputs.data(), Shape.NumOutputs, Count);
+        float MaxError = 0.f;
+        for(size_t i = 0; i < Outputs.size(); i++) {
+            MaxError = std::max(MaxError, std::fabs(Outputs[i] - Reference[i]) / std::max(1.f, std::fabs(Reference[i])));
+        }
+        std::cout << "  MLP " << Shape.NumInputs << "-" << Shape.Width << "x" << Shape.NumHiddenLayers << "-" << Shape.NumOutputs
+                  << (Network.IsSpecialized() ? " (specialized)" : "") << ": max error " << MaxError << std::endl;
+        bPassed &= MaxError <= MLPTolerance;
+    }
+    return bPassed;
+}
+
+bool TestQuantizedMLP () {
+    bool bPassed = true;
+    for(const auto & Shape : Shapes) {
+        const auto Layers = MakeRandomLayers(Shape.NumInputs, Shape.Width, Shape.NumHiddenLayers, Shape.NumOutputs, 1234);
+        // Calibrated on other inputs than the ones measured.
+        const auto Calibration = MakeRandomInputs(Shape.NumInputs, NumElements, 7);
+        const auto Inputs = MakeRandomInputs(Shape.NumInputs, NumElements, 42);
+        const auto Reference = InferenceReference(Layers, Inputs, NumElements);
+        MIGINNQuantizedMLPCPU Network;
+        Network.Quantize(Layers, Calibration.data(), NumElements);
+        std::vector<float> Outputs((size_t)Shape.NumOutputs * NumElements);
+        Network.Inference(Inputs.data(), Shape.NumInputs, Outputs.data(), Shape.NumOutputs, NumElements);
+        double ErrorSquares = 0., ReferenceSquares = 0.;
+        for(size_t i = 0; i < Outputs.size(); i++) {
+            ErrorSquares += (double)(Outputs[i] - Reference[i]) * (Outputs[i] - Reference[i]);
+            ReferenceSquares += (double)Reference[i] * Reference[i];
+        }
+        const auto RelativeRMS = (float)std::sqrt(ErrorSquares / std::max(ReferenceSquares, 1e-30));
+        std::cout << "  Quantized MLP " << Shape.NumInputs << "-" << Shape.Width << "x" << Shape.NumHiddenLayers << "-" << Shape.NumOutputs
+                  << ": relative RMS error " << RelativeRMS << std::endl;
+        bPassed &= RelativeRMS <= QuantizedRelativeRMSTolerance;
+    }
+    return bPassed;
+}
+
+bool TestFrequency () {
+    constexpr uint32_t NumDimensions = 3, NumFrequencies = 8;
+    const auto Inputs = MakeRandomInputs(NumDimensions, NumElements, 42);
+    const uint32_t NumOutputs = MIGINNEncodingCPU::GetFrequencyOutputDimensions(NumDimensions, NumFrequencies);
+    std::vector<float> Outputs((size_t)NumOutputs * NumElements);
+    MIGINNEncodingCPU::Frequency(Inputs.data(), NumDimensions, NumDimensions, NumFrequencies, Outputs.data(), NumOutputs, NumElements);
+    // The double angle formulas double the error per octave, compare relative to the octave.
+    float MaxError = 0.f;
+    for(uint32_t Idx = 0; Idx < NumElements; Idx++) {
+        for(uint32_t d = 0; d < NumDimensions; d++) {
+            for(uint32_t k = 0; k < NumFrequencies; k++) {
+                const double Angle = std::ldexp(Pi, (int)k) * Inputs[(size_t)Idx * NumDimensions + d];
+                const float * Output = Outputs.data() + (size_t)Idx * NumOutputs + (d * NumFrequencies + k) * 2;
+                const float Error = (float)std::max(std::fabs(Output[0] - std::sin(Angle)), std::fabs(Output[1] - std::cos(Angle)));
+                MaxError = std::max(MaxError, Error / (float)(1u << k));
+            }
+        }
+    }
+    std::cout << "  Frequency: max error per octave " << MaxError << std::endl;
+    return MaxError <= 1e-5f;
+}
+
+bool TestOneBlob () {
+    constexpr uint32_t NumBins = 16;
+    auto Inputs = MakeRandomInputs(1, NumElements, 42);
+    // The edges, the kernel wraps around them.
+    Inputs[0] = 0.f;
+    Inputs[1] = 1.f;
+    Inputs[2] = 0.999f;
+    std::vector<float> Outputs((size_t)NumBins * NumElements);
+    MIGINNEncodingCPU::OneBlob(Inputs.data(), 1, 1, NumBins, Outputs.data(), NumBins, NumElements);
+    float MaxSumError = 0.f;
+    bool bPeaks = true;
+    for(uint32_t Idx = 0; Idx < NumElements; Idx++) {
+        const float * Output = Outputs.data() + (size_t)Idx * NumBins;
+        float Sum = 0.f;
+        for(uint32_t b = 0; b < NumBins; b++) Sum += Output[b];
+        MaxSumError = std::max(MaxSumError, std::fabs(Sum - 1.f));
+        // The bin holding x gets the most.
+        const auto Bin = std::min((uint32_t)(Inputs[Idx] * NumBins), NumBins - 1);
+        bPeaks &= *std::max_element(Output, Output + NumBins) <= Output[Bin] + 1e-6f;
+    }
+    // Periodic: x = 1 is x = 0.
+    float MaxWrapError = 0.f;
+    for(uint32_t b = 0; b < NumBins; b++) MaxWrapError = std::max(MaxWrapError, std::fabs(Outputs[b] - Outputs[NumBins + b]));
+    std::cout << "  OneBlob: max sum error " << MaxSumError << ", max wrap error " << MaxWrapError << std::endl;
+    return MaxSumError <= 1e-5f && MaxWrapError <= 1e-5f && bPeaks;
+}
+
+bool TestHashEncodingGradients () {
+    MIGINNHashEncodingOptions Options;
+    Options.NumLevels = 4;
+    Options.Log2HashmapSize = 12;
+    MIGINNHashEncodingCPU Encoding{Options};
+    Encoding.InitializeParams(1);
+    constexpr uint32_t Count = 16;
+    const auto Inputs = MakeRandomInputs(Options.NumDimensions, Count, 42);
+    const auto OutputGradients = MakeRandomInputs(Encoding.GetNumOutputDimensions(), Count, 43);
+    std::vector<float> Gradients(Encoding.GetNumParams(), 0.f);
+    Encoding.Backward(Inputs.data(), OutputGradients.data(), Gradients.data(), Count);
+
+    // The encoding is linear in its parameters: a unit step of one parameter moves sum(OutputGradients * Outputs) by its gradient.
+    std::vector<float> Outputs((size_t)Encoding.GetNumOutputDimensions() * Count);
+    auto Objective = [&] {
+        Encoding.Forward(Inputs.data(), Outputs.data(), Count);
+        double Sum = 0.;
+        for(size_t i = 0; i < Outputs.size(); i++) Sum += (double)Outputs[i] * OutputGradients[i];
+        return Sum;
+    };
+    const double Base = Objective();
+    float MaxError = 0.f;
+    uint32_t NumChecked = 0;
+    for(size_t p = 0; p < Encoding.GetNumParams() && NumChecked < 64; p++) {
+        if(Gradients[p] == 0.f) continue;
+        Encoding.GetParams()[p] += 1.f;
+        const double Moved = Objective();
+        Encoding.GetParams()[p] -= 1.f;
+        MaxError = std::max(MaxError, (float)std::fabs(Moved - Base - Gradients[p]));
+        NumChecked++;
+    }
+    std::cout << "  Hash encoding: " << NumChecked << " gradients, max error " << MaxError << std::endl;
+    return NumChecked > 0 && MaxError <= 1e-4f;
+}
+
+bool TestHashGridCache () {
+    MIGINNDetailsHashGrid Details;
+    Details.InNumInputDimensions = 8;
+    Details.InNumOutputDimensions = 3;
+    Details.InPositionOffset = 0;
+    Details.InDirectionOffset = 3;
+    Details.InNumDirectionBins = 4;
+    Details.InLog2TableSize = 12;
+    Details.InCellSize = 1.f;
+    Details.InBlendFactor = 0.1f;
+    MIGINNHashGridCPU Cache{Details};
+    // One cell, seen from above and from below.
+    const float Inputs[2][8] = {{0.5f, 0.5f, 0.5f, 0.f, 0.f, 1.f, 0.f, 0.f}, {0.5f, 0.5f, 0.5f, 0.f, 0.f, -1.f, 0.f, 0.f}};
+    const float Targets[2][3] = {{1.f, 2.f, 3.f}, {4.f, 5.f, 6.f}};
+    Cache.Accumulate(&Inputs[0][0], &Targets[0][0], 2);
+    Cache.Resolve();
+    // Another position in the same cell and bins, and a cell never trained.
+    const float Queries[3][8] = {
+        {0.1f, 0.9f, 0.2f, 0.f, 0.1f, 1.f, 0.f, 0.f}, {0.9f, 0.1f, 0.7f, 0.1f, 0.f, -1.f, 0.f, 0.f}, {5.5f, 0.5f, 0.5f, 0.f, 0.f, 1.f, 0.f, 0.f}};
+    float Outputs[3][3] = {};
+    Cache.Inference(&Queries[0][0], &Outputs[0][0], 3);
+    const float Expected[3][3] = {{1.f, 2.f, 3.f}, {4.f, 5.f, 6.f}, {0.f, 0.f, 0.f}};
+    float MaxError = 0.f;
+    for(int q = 0; q < 3; q++) {
+        for(int i = 0; i < 3; i++) MaxError = std::max(MaxError, std::fabs(Outputs[q][i] - Expected[q][i]));
+    }
+    std::cout << "  Hash grid cache: " << Cache.GetNumOccupiedEntries() << " entries, max error " << MaxError << std::endl;
+    return Cache.GetNumOccupiedEntries() == 2 && MaxError <= 1e-6f;
+}
+
+bool TestHashGridReplacement () {
+    MIGINNDetailsHashGrid Details;
+    Details.InNumInputDimensions = 3;
+    Details.InNumOutputDimensions = 1;
+    Details.InPositionOffset = 0;
+    // As many entries as probes: every probe sequence covers the whole table.
+    Details.InLog2TableSize = 3;
+    Details.InCellSize = 1.f;
+    Details.InBlendFactor = 0.1f;
+    Details.InMaxAge = 2;
+    MIGINNHashGridCPU Cache{Details};
+    // Fill the table with cells 0 to 7 at step 0.
+    float Inputs[8][3] = {};
+    float Targets[8] = {};
+    for(int c = 0; c < 8; c++) {
+        Inputs[c][0] = (float)c + 0.5f;
+        Targets[c] = (float)c + 1.f;
+    }
+    Cache.Accumulate(&Inputs[0][0], Targets, 8);
+    Cache.Resolve();
+    // Cell 0 keeps being trained, cell 8 is dropped until the others are stale.
+    const float NewInputs[2][3] = {{0.5f, 0.f, 0.f}, {8.5f, 0.f, 0.f}};
+    const float NewTargets[2] = {1.f, 9.f};
+    bool bPassed = true;
+    for(uint32_t Step = 1; Step <= Details.InMaxAge + 1; Step++) {
+        Cache.Accumulate(&NewInputs[0][0], NewTargets, 2);
+        Cache.Resolve();
+        float Outputs[2] = {};
+        Cache.Inference(&NewInputs[0][0], Outputs, 2);
+        const bool bReplaced = Step > Details.InMaxAge;
+        bPassed = bPassed && std::fabs(Outputs[0] - 1.f) <= 1e-6f && std::fabs(Outputs[1] - (bReplaced ? 9.f : 0.f)) <= 1e-6f;
+    }
+    std::cout << "  Hash grid replacement: " << Cache.GetNumOccupiedEntries() << " entries" << std::endl;
+    return bPassed && Cache.GetNumOccupiedEntries() == 8;
+}
+
+}
+
+int main () {
+    const std::pair<std::string, std::function<bool()>> Tests[] = {
+        {"MLP", TestMLP},
+        {"QuantizedMLP", TestQuantizedMLP},
+        {"Frequency", TestFrequency},
+        {"OneBlob", TestOneBlob},
+        {"HashEncodingGradients", TestHashEncodingGradients},
+        {"HashGridCache", TestHashGridCache},
+        {"HashGridReplacement", TestHashGridReplacement},
+    };
+    int NumFailed = 0;
+    for(const auto & [Name, Test] : Tests) {
+        std::cout << Name << std::endl;
+        const bool bPassed = Test();
+        std::cout << (bPassed ? "  passed" : "  FAILED") << std::endl;
+        NumFailed += bPassed ? 0 : 1;
+    }
+    return NumFailed;
+}
@@ -0,0 +1,143 @@
+/*
+ * Project MIGINN : MIGINNDedupBenchmark.cpp
+ * Created: 2024/03/17
+ * This program is unlicensed. See LICENSE for more.
+ */
+// Reports how many inference queries the deduplication removes on captured frames,
+// and what it saves on the host MLP of the cache's shape.
+// Frames are then replayed in order through the result cache, one training step apart, reporting how many of the
+// unique queries still get evaluated. The weights do not change here, so only the age and the minimum probability refresh.
+// A frame is a raw dump of the NN input buffer: NumInputDimensions little endian floats per query.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "MIGINNMLPCPU.h"
+#include "MIGINNQueryDedupCPU.h"
+#include "MIGINNResultCacheCPU.h"
+
+constexpr uint32_t NumOutputDimensions = 4;
+constexpr uint32_t NetworkWidth = 64;
+constexpr uint32_t NumHiddenLayers = 4;
+constexpr int NumRepeats = 5;
+constexpr uint32_t Log2ResultCacheSize = 20;
+constexpr MIGINNResultCache::FPolicy ResultCachePolicy {16, 0.05f, 0.05f};
+
+static std::vector<float> LoadFrame (const std::string & Path) {
+    std::ifstream File{Path, std::ios::binary | std::ios::ate};
+    if(!File) return {};
+    const auto Size = (size_t)File.tellg();
+    std::vector<float> Frame(Size / sizeof(float));
+    File.seekg(0);
+    File.read((char*)Frame.data(), (std::streamsize)(Frame.size() * sizeof(float)));
+    return Frame;
+}
+
+// Best of NumRepeats, in milliseconds.
+template <typename F>
+static double Measure (F && Function) {
+    double Best = 1e30;
+    for(int i = 0; i < NumRepeats; i++) {
+        auto Begin = std::chrono::steady_clock::now();
+        Function();
+        auto End = std::chrono::steady_clock::now();
+        Best = std::min(Best, std::chrono::duration<double, std::milli>(End - Begin).count());
+    }
+    return Best;
+}
+
+static std::vector<MIGINNFloatLayer> MakeRandomLayers (uint32_t NumInputDimensions) {
+    std::mt19937 Generator{1234};
+    std::vector<MIGINNFloatLayer> Layers;
+    Layers.push_back({NumInputDimensions, NetworkWidth, {}, true});
+    for(uint32_t i = 1; i < NumHiddenLayers; i++) Layers.push_back({NetworkWidth, NetworkWidth, {}, true});
+    Layers.push_back({NetworkWidth, NumOutputDimensions, {}, false});
+    for(auto & Layer : Layers) {
+        std::normal_distribution<float> Distribution{0.f, std::sqrt(2.f / (float)Layer.NumInputs)};
+        Layer.Weights.resize((size_t)Layer.NumInputs * Layer.NumOutputs);
+        for(auto & Weight : Layer.Weights) Weight = Distribution(Generator);
+    }
+    return Layers;
+}
+
+int main (int argc, char * argv[]) {
+    if(argc < 4) {
+        std::cout << "USAGE: " << argv[0] << " NumInputDimensions Quantum frame.bin [frame.bin ...]" << std::endl;
+        std::cout << "A frame is a raw float dump of the NN input buffer, e.g. saved from a GPU capture." << std::endl;
+        return 1;
+    }
+    const auto NumInputDimensions = (uint32_t)std::atoi(argv[1]);
+    const auto Quantum = (float)std::atof(argv[2]);
+    if(NumInputDimensions == 0 || !(Quantum > 0.f)) {
+        std::cout << "Invalid number of input dimensions or quantum." << std::endl;
+        return 1;
+    }
+
+    // The real network encodes its inputs first, a plain MLP of the same width and depth is close enough for timing.
+    const MIGINNMLPCPU Network{MakeRandomLayers(NumInputDimensions)};
+    MIGINNQueryDedupCPU Deduplicator{Quantum};
+    MIGINNResultCacheCPU ResultCache{Log2ResultCacheSize, NumOutputDimensions, Quantum, ResultCachePolicy};
+    uint64_t TotalQueries = 0, TotalUnique = 0, TotalRefresh = 0;
+    double TotalFullTime = 0., TotalDeduplicatedTime = 0.;
+
+    std::cout << std::fixed << std::setprecision(3);
+    for(int i = 3; i < argc; i++) {
+        const auto Frame = LoadFrame(argv[i]);
+        const auto NumElements = (uint32_t)(Frame.size() / NumInputDimensions);
+        if(NumElements == 0) {
+            std::cout << argv[i] << ": empty or unreadable, skipped." << std::endl;
+            continue;
+        }
+        std::vector<float> FullOutputs((size_t)NumElements * NumOutputDimensions);
+        std::vector<float> UniqueOutputs((size_t)NumElements * NumOutputDimensions);
+        std::vector<float> DeduplicatedOutputs((size_t)NumElements * NumOutputDimensions);
+
+        const double FullTime = Measure([&] {
+            Network.Inference(Frame.data(), NumInputDimensions, FullOutputs.data(), NumOutputDimensions, NumElements);
+        });
+        uint32_t NumUnique = 0;
+        const double DedupTime = Measure([&] {
+            NumUnique = Deduplicator.Deduplicate(Frame.data(), NumInputDimensions, NumElements);
+        });
+        const double UniqueTime = Measure([&] {
+            Network.Inference(Deduplicator.GetUniqueInputs().data(), NumInputDimensions, UniqueOutputs.data(), NumOutputDimensions, NumUnique);
+        });
+        const double ScatterTime = Measure([&] {
+            Deduplicator.Scatter(UniqueOutputs.data(), NumOutputDimensions, DeduplicatedOutputs.data());
+        });
+        // What snapping the queries costs in accuracy.
+        float MaxError = 0.f;
+        for(size_t j = 0; j < FullOutputs.size(); j++) MaxError = std::max(MaxError, std::fabs(FullOutputs[j] - DeduplicatedOutputs[j]));
+
+        // Replayed once, the cache is stateful.
+        const uint32_t NumRefresh = ResultCache.Lookup(Deduplicator.GetUniqueInputs().data(), NumInputDimensions, NumUnique, UniqueOutputs.data());
+        std::vector<float> RefreshOutputs((size_t)NumRefresh * NumOutputDimensions);
+        Network.Inference(ResultCache.GetRefreshInputs().data(), NumInputDimensions, RefreshOutputs.data(), NumOutputDimensions, NumRefresh);
+        ResultCache.Store(RefreshOutputs.data(), UniqueOutputs.data());
+        ResultCache.AdvanceWeightVersion();
+
+        const double DeduplicatedTime = DedupTime + UniqueTime + ScatterTime;
+        std::cout << argv[i] << ": " << NumElements << " queries, " << NumUnique << " unique ("
+                  << 100. * NumUnique / NumElements << "%), inference " << FullTime << " ms -> " << DeduplicatedTime
+                  << " ms (dedup " << DedupTime << ", unique " << UniqueTime << ", scatter " << ScatterTime
+                  << "), max error " << MaxError << ", result cache evaluates " << NumRefresh << " ("
+                  << 100. * NumRefresh / NumElements << "%)" << std::endl;
+        TotalQueries += NumElements;
+        TotalUnique += NumUnique;
+        TotalRefresh += NumRefresh;
+        TotalFullTime += FullTime;
+        TotalDeduplicatedTime += DeduplicatedTime;
+    }
+    if(TotalQueries == 0) return 1;
+    std::cout << "Total: " << TotalQueries << " queries, " << TotalUnique << " unique, dedup ratio "
+              << (double)TotalQueries / (double)TotalUnique << "x, inference " << TotalFullTime << " ms -> "
+              << TotalDeduplicatedTime << " ms, result cache evaluates " << TotalRefresh << " ("
+              << 100. * (double)TotalRefresh / (double)TotalQueries << "%)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,199 @@
+/*
+ * Project MIGINN : MIGINNEncodingCPU.cpp
+ * Created: 2024/03/07
+ * This program is unlicensed. See LICENSE for more.
+ */
+#include <cmath>
+#include <stdexcept>
+#include "MIGINNEncodingCPU.h"
+#include "MIGINNSIMD.h"
+
+namespace {
+
+constexpr float Pi = 3.14159265358979323846f;
+
+#if MIGINN_SSE2
+// Four lanes, one element each. Lets the scalar and the vector paths share their math.
+struct FFloat4 {
+    __m128 V;
+    FFloat4 (__m128 InV) : V(InV) {}
+    FFloat4 (float InX) : V(_mm_set1_ps(InX)) {}
+    friend FFloat4 operator + (FFloat4 A, FFloat4 B) { return _mm_add_ps(A.V, B.V); }
+    friend FFloat4 operator - (FFloat4 A, FFloat4 B) { return _mm_sub_ps(A.V, B.V); }
+    friend FFloat4 operator * (FFloat4 A, FFloat4 B) { return _mm_mul_ps(A.V, B.V); }
+};
+inline FFloat4 Min (FFloat4 A, FFloat4 B) { return _mm_min_ps(A.V, B.V); }
+inline FFloat4 Max (FFloat4 A, FFloat4 B) { return _mm_max_ps(A.V, B.V); }
+
+// Load one dimension of four consecutive elements.
+inline FFloat4 LoadStrided (const float * Inputs, uint32_t Stride) {
+    return _mm_set_ps(Inputs[Stride * 3], Inputs[Stride * 2], Inputs[Stride], Inputs[0]);
+}
+#endif
+inline float Min (float A, float B) { return A < B ? A : B; }
+inline float Max (float A, float B) { return A > B ? A : B; }
+
+// Same polynomial and clamping as tiny-cuda-nn.
+template <typename T>
+inline T QuarticCDF (T X, float InvRadius) {
+    T U = X * InvRadius;
+    T U2 = U * U;
+    T U4 = U2 * U2;
+    return Max(Min(T(15.f / 16.f) * U * (T(1.f) - T(2.f / 3.f) * U2 + T(1.f / 5.f) * U4) + T(0.5f), T(1.f)), T(0.f));
+}
+
+// The kernel wraps around [0, 1] like in tiny-cuda-nn: the copies one period away cover what spills over an edge.
+template <typename T>
+inline T PeriodicQuarticCDF (T X, float InvRadius) {
+    return QuarticCDF(X, InvRadius) + QuarticCDF(X - T(1.f), InvRadius) + QuarticCDF(X + T(1.f), InvRadius);
+}
+
+// Coefficients in the tiny-cuda-nn order.
+template <typename T>
+inline void EvaluateSphericalHarmonics (T X, T Y, T Z, uint32_t Degree, T * Out) {
+    Out[0] = T(0.28209479177387814f);
+    if(Degree <= 1) return;
+    Out[1] = T(-0.48860251190291987f) * Y;
+    Out[2] = T(0.48860251190291987f) * Z;
+    Out[3] = T(-0.48860251190291987f) * X;
+    if(Degree <= 2) return;
+    T X2 = X * X, Y2 = Y * Y, Z2 = Z * Z;
+    T XY = X * Y, YZ = Y * Z, XZ = X * Z;
+    Out[4] = T(1.0925484305920792f) * XY;
+    Out[5] = T(-1.0925484305920792f) * YZ;
+    Out[6] = T(0.94617469575755997f) * Z2 - T(0.31539156525251999f);
+    Out[7] = T(-1.0925484305920792f) * XZ;
+    Out[8] = T(0.54627421529603959f) * X2 - T(0.54627421529603959f) * Y2;
+    if(Degree <= 3) return;
+    Out[9] = T(0.59004358992664352f) * Y * (T(-3.f) * X2 + Y2);
+    Out[10] = T(2.8906114426405538f) * XY * Z;
+    Out[11] = T(0.45704579946446572f) * Y * (T(1.f) - T(5.f) * Z2);
+    Out[12] = T(0.3731763325901154f) * Z * (T(5.f) * Z2 - T(3.f));
+    Out[13] = T(0.45704579946446572f) * X * (T(1.f) - T(5.f) * Z2);
+    Out[14] = T(1.4453057213202769f) * Z * (X2 - Y2);
+    Out[15] = T(0.59004358992664352f) * X * (T(3.f) * Y2 - X2);
+}
+
+}
+
+void MIGINNEncodingCPU::Frequency(const float *Inputs, uint32_t InputStride, uint32_t NumDimensions, uint32_t NumFrequencies,
+                                  float *Outputs, uint32_t OutputStride, uint32_t NumElements) {
+    uint32_t Idx = 0;
+#if MIGINN_SSE2
+    for(; Idx + 4 <= NumElements; Idx += 4) {
+        const float * Element = Inputs + (size_t)Idx * InputStride;
+        float * Output = Outputs + (size_t)Idx * OutputStride;
+        for(uint32_t d = 0; d < NumDimensions; d++) {
+            float Sin[4], Cos[4];
+            for(uint32_t Lane = 0; Lane < 4; Lane++) {
+                float Angle = Element[Lane * InputStride + d] * Pi;
+                Sin[Lane] = std::sin(Angle);
+                Cos[Lane] = std::cos(Angle);
+            }
+            __m128 S = _mm_loadu_ps(Sin), C = _mm_loadu_ps(Cos);
+            float * DimensionOutput = Output + d * NumFrequencies * 2;
+            for(uint32_t k = 0; k < NumFrequencies; k++) {
+                // (sin, cos) pairs of lanes 0 & 1, then of lanes 2 & 3.
+                __m128 Low = _mm_unpacklo_ps(S, C), High = _mm_unpackhi_ps(S, C);
+                _mm_storel_pi((__m64*)(DimensionOutput + k * 2), Low);
+                _mm_storeh_pi((__m64*)(DimensionOutput + OutputStride + k * 2), Low);
+                _mm_storel_pi((__m64*)(DimensionOutput + OutputStride * 2 + k * 2), High);
+                _mm_storeh_pi((__m64*)(DimensionOutput + OutputStride * 3 + k * 2), High);
+                // sin 2a = 2 sin a cos a, cos 2a = (cos a - sin a)(cos a + sin a).
+                __m128 NextS = _mm_mul_ps(_mm_set1_ps(2.f), _mm_mul_ps(S, C));
+                C = _mm_mul_ps(_mm_sub_ps(C, S), _mm_add_ps(C, S));
+                S = NextS;
+            }
+        }
+    }
+#endif
+    for(; Idx < NumElements; Idx++) {
+        const float * Element = Inputs + (size_t)Idx * InputStride;
+        float * Output = Outputs + (size_t)Idx * OutputStride;
+        for(uint32_t d = 0; d < NumDimensions; d++) {
+            float S = std::sin(Element[d] * Pi), C = std::cos(Element[d] * Pi);
+            float * DimensionOutput = Output + d * NumFrequencies * 2;
+            for(uint32_t k = 0; k < NumFrequencies; k++) {
+                DimensionOutput[k * 2] = S;
+                DimensionOutput[k * 2 + 1] = C;
+                float NextS = 2.f * (S * C);
+                C = (C - S) * (C + S);
+                S = NextS;
+            }
+        }
+    }
+}
+
+void MIGINNEncodingCPU::OneBlob(const float *Inputs, uint32_t InputStride, uint32_t NumDimensions, uint32_t NumBins,
+                                float *Outputs, uint32_t OutputStride, uint32_t NumElements) {
+    if(NumBins == 0) throw std::invalid_argument{"OneBlob needs at least one bin"};
+    const float InvRadius = (float)NumBins;
+    const float BinSize = 1.f / (float)NumBins;
+    for(uint32_t Idx = 0; Idx < NumElements; Idx++) {
+        const float * Element = Inputs + (size_t)Idx * InputStride;
+        float * Output = Outputs + (size_t)Idx * OutputStride;
+        for(uint32_t d = 0; d < NumDimensions; d++) {
+            const float X = Element[d];
+            float * DimensionOutput = Output + d * NumBins;
+            float LeftCDF = PeriodicQuarticCDF(-X, InvRadius);
+            uint32_t k = 0;
+#if MIGINN_SSE2
+            // Four bins at a time, each bin's left CDF is the right CDF of the previous lane.
+            for(; k + 4 <= NumBins; k += 4) {
+                FFloat4 RightBoundary = _mm_mul_ps(
+                        _mm_set_ps((float)(k + 4), (float)(k + 3), (float)(k + 2), (float)(k + 1)), _mm_set1_ps(BinSize));
+                FFloat4 RightCDF = PeriodicQuarticCDF(RightBoundary - FFloat4(X), InvRadius);
+                __m128 Shifted = _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(RightCDF.V), 4));
+                __m128 Left = _mm_move_ss(Shifted, _mm_set_ss(LeftCDF));
+                _mm_storeu_ps(DimensionOutput + k, _mm_sub_ps(RightCDF.V, Left));
+                LeftCDF = _mm_cvtss_f32(_mm_shuffle_ps(RightCDF.V, RightCDF.V, _MM_SHUFFLE(3, 3, 3, 3)));
+            }
+#endif
+            for(; k < NumBins; k++) {
+                float RightCDF = PeriodicQuarticCDF((float)(k + 1) * BinSize - X, InvRadius);
+                DimensionOutput[k] = RightCDF - LeftCDF;
+                LeftCDF = RightCDF;
+            }
+        }
+    }
+}
+
+void MIGINNEncodingCPU::SphericalHarmonics(const float *Inputs, uint32_t InputStride, uint32_t Degree,
+                                           float *Outputs, uint32_t OutputStride, uint32_t NumElements) {
+    if(Degree == 0 || Degree > 4) throw std::invalid_argument{"Spherical harmonics degree must be 1 to 4"};
+    const uint32_t NumCoefficients = Degree * Degree;
+    uint32_t Idx = 0;
+#if MIGINN_SSE2
+    for(; Idx + 4 <= NumElements; Idx += 4) {
+        const float * Element = Inputs + (size_t)Idx * InputStride;
+        float * Output = Outputs + (size_t)Idx * OutputStride;
+        FFloat4 X = LoadStrided(Element, InputStride) * FFloat4(2.f) - FFloat4(1.f);
+        FFloat4 Y = LoadStrided(Element + 1, InputStride) * FFloat4(2.f) - FFloat4(1.f);
+        FFloat4 Z = LoadStrided(Element + 2, InputStride) * FFloat4(2.f) - FFloat4(1.f);
+        FFloat4 Coefficients[16] = {
+                0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f
+        };
+        EvaluateSphericalHarmonics(X, Y, Z, Degree, Coefficients);
+        // Transpose blocks of four coefficients, so each element gets contiguous stores.
+        uint32_t c = 0;
+        for(; c + 4 <= NumCoefficients; c += 4) {
+            __m128 C0 = Coefficients[c].V, C1 = Coefficients[c + 1].V, C2 = Coefficients[c + 2].V, C3 = Coefficients[c + 3].V;
+            _MM_TRANSPOSE4_PS(C0, C1, C2, C3);
+            _mm_storeu_ps(Output + c, C0);
+            _mm_storeu_ps(Output + OutputStride + c, C1);
+            _mm_storeu_ps(Output + OutputStride * 2 + c, C2);
+            _mm_storeu_ps(Output + OutputStride * 3 + c, C3);
+        }
+        for(; c < NumCoefficients; c++) {
+            float Lanes[4];
+            _mm_storeu_ps(Lanes, Coefficients[c].V);
+            for(uint32_t Lane = 0; Lane < 4; Lane++) Output[OutputStride * Lane + c] = Lanes[Lane];
+        }
+    }
+#endif
+    for(; Idx < NumElements; Idx++) {
+        const float * Element = Inputs + (size_t)Idx * InputStride;
+        EvaluateSphericalHarmonics(Element[0] * 2.f - 1.f, Element[1] * 2.f - 1.f, Element[2] * 2.f - 1.f, Degree,
+                                   Outputs + (size_t)Idx * OutputStride);
+    }
+}
@@ -0,0 +1,44 @@
+/*
+ * Project MIGINN : MIGINNEncodingCPU.h
+ * Created: 2024/03/07
+ * This program is unlicensed. See LICENSE for more.
+ */
+
+#ifndef MIGINN_MIGINNENCODINGCPU_H
+#define MIGINN_MIGINNENCODINGCPU_H
+
+#include <cstdint>
+
+// Batched host versions of the tiny-cuda-nn input encodings MIGI configures.
+// Output layouts match tiny-cuda-nn, values agree within float tolerance.
+// Each function reads NumDimensions floats per element at Inputs + i * InputStride and writes its encoding at
+// Outputs + i * OutputStride, so several encodings can be written side by side like a "Composite" encoding.
+namespace MIGINNEncodingCPU {
+
+inline uint32_t GetFrequencyOutputDimensions (uint32_t NumDimensions, uint32_t NumFrequencies) {
+    return NumDimensions * NumFrequencies * 2;
+}
+// Per dimension: sin(2^k pi x), cos(2^k pi x) for k = 0 .. NumFrequencies - 1.
+// Only the first octave is evaluated with sin/cos, the others follow from the double angle formulas.
+// The error grows by 2x per octave, like the error of the fp32 argument 2^k pi x does in tiny-cuda-nn.
+void Frequency (const float * Inputs, uint32_t InputStride, uint32_t NumDimensions, uint32_t NumFrequencies,
+                float * Outputs, uint32_t OutputStride, uint32_t NumElements);
+
+inline uint32_t GetOneBlobOutputDimensions (uint32_t NumDimensions, uint32_t NumBins) {
+    return NumDimensions * NumBins;
+}
+// Per dimension: the integral of a quartic kernel of radius 1 / NumBins centered at x over each bin of [0, 1].
+// The kernel wraps around periodically, so the bins sum to 1 and x near 1 also lands in the first bin.
+void OneBlob (const float * Inputs, uint32_t InputStride, uint32_t NumDimensions, uint32_t NumBins,
+              float * Outputs, uint32_t OutputStride, uint32_t NumElements);
+
+inline uint32_t GetSphericalHarmonicsOutputDimensions (uint32_t Degree) {
+    return Degree * Degree;
+}
+// Real spherical harmonics of a direction given in [0, 1]^3 (mapped to [-1, 1]^3 like tiny-cuda-nn). Degree 1 to 4.
+void SphericalHarmonics (const float * Inputs, uint32_t InputStride, uint32_t Degree,
+                         float * Outputs, uint32_t OutputStride, uint32_t NumElements);
+
+}
+
+#endif //MIGINN_MIGINNENCODINGCPU_H
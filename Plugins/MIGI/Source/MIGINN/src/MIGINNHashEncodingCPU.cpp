@@ -0,0 +1,151 @@
+/*
+ * Project MIGINN : MIGINNHashEncodingCPU.cpp
+ * Created: 2024/03/05
+ * This program is unlicensed. See LICENSE for more.
+ */
+#include <cmath>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include "MIGINNHashEncodingCPU.h"
+#include "MIGINNSIMD.h"
+
+// Same factors as the tiny-cuda-nn coherent prime hash.
+static constexpr uint32_t HashFactors[4] = {1u, 2654435761u, 805459861u, 3674653429u};
+
+MIGINNHashEncodingCPU::MIGINNHashEncodingCPU(const MIGINNHashEncodingOptions &InOptions) : Options(InOptions) {
+    if(Options.NumDimensions == 0 || Options.NumDimensions > 4 || Options.NumLevels == 0
+        || Options.NumFeaturesPerLevel == 0 || Options.Log2HashmapSize > 30) {
+        throw std::invalid_argument{"Invalid hash encoding options"};
+    }
+    const float Log2PerLevelScale = std::log2(Options.PerLevelScale);
+    const uint32_t MaxLevelSize = std::numeric_limits<uint32_t>::max() / 2;
+    size_t Offset = 0;
+    for(uint32_t i = 0; i < Options.NumLevels; i++) {
+        FLevel Level {};
+        Level.Scale = std::exp2((float)i * Log2PerLevelScale) * (float)Options.BaseResolution - 1.f;
+        Level.Resolution = (uint32_t)std::ceil(Level.Scale) + 1;
+        float DenseSize = std::pow((float)Level.Resolution, (float)Options.NumDimensions);
+        uint32_t Size = MaxLevelSize;
+        if(DenseSize <= (float)MaxLevelSize) {
+            Size = 1;
+            for(uint32_t d = 0; d < Options.NumDimensions; d++) Size *= Level.Resolution;
+        }
+        // Aligned like tiny-cuda-nn, then capped at the hashmap size.
+        Size = (Size + 7u) / 8u * 8u;
+        Level.Size = Size < (1u << Options.Log2HashmapSize) ? Size : (1u << Options.Log2HashmapSize);
+        Level.Offset = Offset * Options.NumFeaturesPerLevel;
+        Offset += Level.Size;
+        Levels.push_back(Level);
+    }
+    Params.assign(Offset * Options.NumFeaturesPerLevel, 0.f);
+}
+
+void MIGINNHashEncodingCPU::InitializeParams(uint32_t Seed) {
+    std::mt19937 Generator(Seed);
+    std::uniform_real_distribution<float> Distribution(-1e-4f, 1e-4f);
+    for(auto & Param : Params) Param = Distribution(Generator);
+}
+
+void MIGINNHashEncodingCPU::GatherCorners(const float *Element, const FLevel &Level, FCorners &Corners) const {
+    const uint32_t NumDimensions = Options.NumDimensions;
+    uint32_t GridPosition[4];
+    float Fraction[4];
+    for(uint32_t d = 0; d < NumDimensions; d++) {
+        float Position = std::fma(Level.Scale, Element[d], 0.5f);
+        float Floor = std::floor(Position);
+        GridPosition[d] = (uint32_t)(int32_t)Floor;
+        Fraction[d] = Position - Floor;
+    }
+    for(uint32_t Corner = 0; Corner < (1u << NumDimensions); Corner++) {
+        float Weight = 1.f;
+        uint32_t CornerPosition[4];
+        for(uint32_t d = 0; d < NumDimensions; d++) {
+            const bool bUpper = Corner & (1u << d);
+            CornerPosition[d] = GridPosition[d] + (bUpper ? 1u : 0u);
+            Weight *= bUpper ? Fraction[d] : 1.f - Fraction[d];
+        }
+        // Dense indexing while the level fits into the table, hashing otherwise.
+        uint32_t Stride = 1, Index = 0;
+        for(uint32_t d = 0; d < NumDimensions && Stride <= Level.Size; d++) {
+            Index += CornerPosition[d] * Stride;
+            Stride *= Level.Resolution;
+        }
+        if(Level.Size < Stride) {
+            Index = 0;
+            for(uint32_t d = 0; d < NumDimensions; d++) Index ^= CornerPosition[d] * HashFactors[d];
+        }
+        Corners.Indices[Corner] = Index % Level.Size;
+        Corners.Weights[Corner] = Weight;
+    }
+}
+
+void MIGINNHashEncodingCPU::Forward(const float *Inputs, float *Outputs, uint32_t NumElements) const {
+    const uint32_t NumDimensions = Options.NumDimensions;
+    const uint32_t NumFeatures = Options.NumFeaturesPerLevel;
+    const uint32_t NumCorners = 1u << NumDimensions;
+    FCorners Corners;
+    for(uint32_t Idx = 0; Idx < NumElements; Idx++) {
+        const float * Element = Inputs + (size_t)Idx * NumDimensions;
+        float * Output = Outputs + (size_t)Idx * GetNumOutputDimensions();
+        for(uint32_t l = 0; l < Options.NumLevels; l++) {
+            const FLevel & Level = Levels[l];
+            const float * Table = Params.data() + Level.Offset;
+            float * LevelOutput = Output + l * NumFeatures;
+            GatherCorners(Element, Level, Corners);
+#if MIGINN_SSE2
+            if(NumFeatures == 2) {
+                // Two corners per register, their features are 8 bytes each.
+                __m128 Sum = _mm_setzero_ps();
+                for(uint32_t Corner = 0; Corner < NumCorners; Corner += 2) {
+                    __m128 Features = _mm_castpd_ps(_mm_loadh_pd(
+                            _mm_load_sd((const double*)(Table + (size_t)Corners.Indices[Corner] * 2)),
+                            (const double*)(Table + (size_t)Corners.Indices[Corner + 1] * 2)));
+                    __m128 Weights = _mm_set_ps(Corners.Weights[Corner + 1], Corners.Weights[Corner + 1],
+                                                Corners.Weights[Corner], Corners.Weights[Corner]);
+                    Sum = _mm_add_ps(Sum, _mm_mul_ps(Features, Weights));
+                }
+                Sum = _mm_add_ps(Sum, _mm_movehl_ps(Sum, Sum));
+                _mm_storel_pi((__m64*)LevelOutput, Sum);
+                continue;
+            }
+            if(NumFeatures % 4 == 0) {
+                for(uint32_t f = 0; f < NumFeatures; f += 4) {
+                    __m128 Sum = _mm_setzero_ps();
+                    for(uint32_t Corner = 0; Corner < NumCorners; Corner++) {
+                        __m128 Features = _mm_loadu_ps(Table + (size_t)Corners.Indices[Corner] * NumFeatures + f);
+                        Sum = _mm_add_ps(Sum, _mm_mul_ps(Features, _mm_set1_ps(Corners.Weights[Corner])));
+                    }
+                    _mm_storeu_ps(LevelOutput + f, Sum);
+                }
+                continue;
+            }
+#endif
+            for(uint32_t f = 0; f < NumFeatures; f++) LevelOutput[f] = 0.f;
+            for(uint32_t Corner = 0; Corner < NumCorners; Corner++) {
+                const float * Features = Table + (size_t)Corners.Indices[Corner] * NumFeatures;
+                for(uint32_t f = 0; f < NumFeatures; f++) LevelOutput[f] += Features[f] * Corners.Weights[Corner];
+            }
+        }
+    }
+}
+
+void MIGINNHashEncodingCPU::Backward(const float *Inputs, const float *OutputGradients, float *ParamGradients, uint32_t NumElements) const {
+    const uint32_t NumDimensions = Options.NumDimensions;
+    const uint32_t NumFeatures = Options.NumFeaturesPerLevel;
+    FCorners Corners;
+    for(uint32_t Idx = 0; Idx < NumElements; Idx++) {
+        const float * Element = Inputs + (size_t)Idx * NumDimensions;
+        const float * OutputGradient = OutputGradients + (size_t)Idx * GetNumOutputDimensions();
+        for(uint32_t l = 0; l < Options.NumLevels; l++) {
+            const FLevel & Level = Levels[l];
+            GatherCorners(Element, Level, Corners);
+            for(uint32_t Corner = 0; Corner < (1u << NumDimensions); Corner++) {
+                float * Gradient = ParamGradients + Level.Offset + (size_t)Corners.Indices[Corner] * NumFeatures;
+                for(uint32_t f = 0; f < NumFeatures; f++) {
+                    Gradient[f] += OutputGradient[l * NumFeatures + f] * Corners.Weights[Corner];
+                }
+            }
+        }
+    }
+}
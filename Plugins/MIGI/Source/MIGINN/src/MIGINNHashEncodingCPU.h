@@ -0,0 +1,70 @@
+/*
+ * Project MIGINN : MIGINNHashEncodingCPU.h
+ * Created: 2024/03/05
+ * This program is unlicensed. See LICENSE for more.
+ */
+
+#ifndef MIGINN_MIGINNHASHENCODINGCPU_H
+#define MIGINN_MIGINNHASHENCODINGCPU_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Options of the multiresolution hash encoding, named after the tiny-cuda-nn "HashGrid" json options.
+struct MIGINNHashEncodingOptions {
+    // Number of input dimensions, 1 to 4.
+    uint32_t NumDimensions {3};
+    uint32_t NumLevels {16};
+    uint32_t NumFeaturesPerLevel {2};
+    uint32_t Log2HashmapSize {19};
+    uint32_t BaseResolution {16};
+    float PerLevelScale {2.f};
+};
+
+// Host implementation of the trainable multiresolution hash encoding (Müller et al. 2022).
+// The parameter layout, the level resolutions and the hash match tiny-cuda-nn, so parameters can be copied over
+// from a trained GPU network and the outputs agree up to float rounding.
+// Inputs are expected in [0, 1], one element is NumDimensions consecutive floats,
+// its encoding is NumLevels * NumFeaturesPerLevel consecutive floats, level-major.
+class MIGINNHashEncodingCPU {
+public:
+    explicit MIGINNHashEncodingCPU (const MIGINNHashEncodingOptions & InOptions);
+
+    // Uniform in [-1e-4, 1e-4], the tiny-cuda-nn default.
+    void InitializeParams (uint32_t Seed);
+
+    void Forward (const float * Inputs, float * Outputs, uint32_t NumElements) const;
+    // Accumulate the parameter gradients of a batch into ParamGradients (GetNumParams() floats).
+    void Backward (const float * Inputs, const float * OutputGradients, float * ParamGradients, uint32_t NumElements) const;
+
+    [[nodiscard]] uint32_t GetNumOutputDimensions () const { return Options.NumLevels * Options.NumFeaturesPerLevel; }
+    [[nodiscard]] size_t GetNumParams () const { return Params.size(); }
+    [[nodiscard]] float * GetParams () { return Params.data(); }
+    [[nodiscard]] const float * GetParams () const { return Params.data(); }
+    [[nodiscard]] const MIGINNHashEncodingOptions & GetOptions () const { return Options; }
+
+protected:
+    struct FLevel {
+        float Scale;
+        uint32_t Resolution;
+        // Number of entries of the level, NumFeaturesPerLevel floats each.
+        uint32_t Size;
+        // Offset of the level in Params, in floats.
+        size_t Offset;
+    };
+
+    // The table entries touched by one element on one level and their interpolation weights.
+    struct FCorners {
+        uint32_t Indices[16];
+        float Weights[16];
+    };
+    void GatherCorners (const float * Element, const FLevel & Level, FCorners & Corners) const;
+
+    MIGINNHashEncodingOptions Options {};
+    std::vector<FLevel> Levels {};
+    // Entries of a level are contiguous, the features of an entry are contiguous.
+    std::vector<float> Params {};
+};
+
+#endif //MIGINN_MIGINNHASHENCODINGCPU_H
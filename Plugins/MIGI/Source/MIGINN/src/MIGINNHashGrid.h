@@ -0,0 +1,92 @@
+/*
+ * Project MIGINN : MIGINNHashGrid.h
+ * Created: 2024/03/02
+ * This program is unlicensed. See LICENSE for more.
+ */
+
+#ifndef MIGINN_MIGINNHASHGRID_H
+#define MIGINN_MIGINNHASHGRID_H
+
+#include <cmath>
+#include <cstdint>
+#include "MIGINN.h"
+
+// Shared by the CUDA and the host implementations of the hash grid cache.
+#ifdef __CUDACC__
+#define MIGINN_HOST_DEVICE __host__ __device__
+#else
+#define MIGINN_HOST_DEVICE
+#endif
+
+namespace MIGINNHashGrid {
+
+// Keys are fingerprints of the cell coordinates, 0 marks an empty entry.
+constexpr uint32_t EmptyKey = 0;
+// Linear probing gives up after this many entries, the sample is dropped (or the query misses) unless one of them is stale.
+constexpr uint32_t MaxProbes = 8;
+// Per entry: the cached value followed by the number of samples blended into it so far.
+constexpr uint32_t EntryStride = MIGINN_HASH_GRID_MAX_OUTPUT_DIMENSIONS + 1;
+
+// PCG hash.
+MIGINN_HOST_DEVICE inline uint32_t Hash (uint32_t X) {
+    uint32_t State = X * 747796405u + 2891336453u;
+    uint32_t Word = ((State >> ((State >> 28u) + 4u)) ^ State) * 277803737u;
+    return (Word >> 22u) ^ Word;
+}
+
+// Bin a unit direction with the octahedral map.
+MIGINN_HOST_DEVICE inline uint32_t DirectionBin (float X, float Y, float Z, uint32_t NumBins) {
+    if(NumBins == 0) return 0;
+    float L1 = fabsf(X) + fabsf(Y) + fabsf(Z);
+    if(!(L1 > 0.f)) return 0;
+    float U = X / L1, V = Y / L1;
+    if(Z < 0.f) {
+        float FoldedU = (1.f - fabsf(V)) * (U >= 0.f ? 1.f : -1.f);
+        V = (1.f - fabsf(U)) * (V >= 0.f ? 1.f : -1.f);
+        U = FoldedU;
+    }
+    auto BinU = (uint32_t)fmaxf((U * 0.5f + 0.5f) * (float)NumBins, 0.f);
+    auto BinV = (uint32_t)fmaxf((V * 0.5f + 0.5f) * (float)NumBins, 0.f);
+    BinU = BinU < NumBins ? BinU : NumBins - 1;
+    BinV = BinV < NumBins ? BinV : NumBins - 1;
+    return BinV * NumBins + BinU;
+}
+
+// Compute the home slot and the key of an input element.
+MIGINN_HOST_DEVICE inline void ComputeKey (const float * Element, const MIGINNDetailsHashGrid & Details, uint32_t & OutSlot, uint32_t & OutKey) {
+    const float * Position = Element + Details.InPositionOffset;
+    const float InvCellSize = 1.f / Details.InCellSize;
+    auto CellX = (uint32_t)(int32_t)floorf(Position[0] * InvCellSize);
+    auto CellY = (uint32_t)(int32_t)floorf(Position[1] * InvCellSize);
+    auto CellZ = (uint32_t)(int32_t)floorf(Position[2] * InvCellSize);
+    uint32_t Bin = 0;
+    if(Details.InNumDirectionBins) {
+        const float * Direction = Element + Details.InDirectionOffset;
+        Bin = DirectionBin(Direction[0], Direction[1], Direction[2], Details.InNumDirectionBins);
+    }
+    uint32_t H = Hash(CellX ^ Hash(CellY ^ Hash(CellZ ^ Hash(Bin))));
+    OutSlot = H & ((1u << Details.InLog2TableSize) - 1u);
+    // A second hash, so entries sharing a home slot are told apart.
+    OutKey = Hash(H ^ 0x9e3779b9u);
+    if(OutKey == EmptyKey) OutKey = 1;
+}
+
+// Step is the current training step, Stamp the last one the entry was trained on.
+MIGINN_HOST_DEVICE inline bool IsStale (uint32_t Step, uint32_t Stamp, uint32_t MaxAge) {
+    return MaxAge > 0 && Step - Stamp > MaxAge;
+}
+
+// Blend the averaged samples of one entry into its cached value.
+// Starts as a plain running average and settles at the blend factor, so fresh cells converge quickly.
+MIGINN_HOST_DEVICE inline void BlendEntry (float * Entry, const float * SampleSum, float SampleCount, uint32_t NumOutputDimensions, float BlendFactor) {
+    float & NumSeen = Entry[MIGINN_HASH_GRID_MAX_OUTPUT_DIMENSIONS];
+    float Alpha = fmaxf(BlendFactor, SampleCount / (NumSeen + SampleCount));
+    for(uint32_t i = 0; i < NumOutputDimensions; i++) {
+        Entry[i] += (SampleSum[i] / SampleCount - Entry[i]) * Alpha;
+    }
+    NumSeen += SampleCount;
+}
+
+}
+
+#endif //MIGINN_MIGINNHASHGRID_H
@@ -0,0 +1,118 @@
+/*
+ * Project MIGINN : MIGINNHashGridCPU.cpp
+ * Created: 2024/03/02
+ * This program is unlicensed. See LICENSE for more.
+ */
+#include <stdexcept>
+#include "MIGINNHashGridCPU.h"
+#include "MIGINNHashGrid.h"
+
+// std::atomic<float>::fetch_add is C++20.
+static void AtomicAdd (std::atomic<float> & Target, float Value) {
+    float Current = Target.load(std::memory_order_relaxed);
+    while(!Target.compare_exchange_weak(Current, Current + Value, std::memory_order_relaxed)) {}
+}
+
+MIGINNHashGridCPU::MIGINNHashGridCPU(const MIGINNDetailsHashGrid &InDetails) : Details(InDetails) {
+    if(Details.InNumOutputDimensions == 0 || Details.InNumOutputDimensions > MIGINN_HASH_GRID_MAX_OUTPUT_DIMENSIONS
+        || Details.InLog2TableSize == 0 || Details.InLog2TableSize > 30 || !(Details.InCellSize > 0.f)) {
+        throw std::invalid_argument{"Invalid hash grid details"};
+    }
+    TableSize = 1u << Details.InLog2TableSize;
+    const size_t NumValues = (size_t)TableSize * MIGINNHashGrid::EntryStride;
+    Keys = std::make_unique<std::atomic<uint32_t>[]>(TableSize);
+    Stamps = std::make_unique<std::atomic<uint32_t>[]>(TableSize);
+    Accumulators = std::make_unique<std::atomic<float>[]>(NumValues);
+    Entries = std::make_unique<float[]>(NumValues);
+    for(uint32_t i = 0; i < TableSize; i++) {
+        Keys[i].store(MIGINNHashGrid::EmptyKey, std::memory_order_relaxed);
+        Stamps[i].store(0, std::memory_order_relaxed);
+    }
+    for(size_t i = 0; i < NumValues; i++) {
+        Accumulators[i].store(0.f, std::memory_order_relaxed);
+        Entries[i] = 0.f;
+    }
+}
+
+uint32_t MIGINNHashGridCPU::Find(uint32_t Slot, uint32_t Key, bool bInsert) const {
+    const uint32_t TableMask = TableSize - 1;
+    for(uint32_t Probe = 0; Probe < MIGINNHashGrid::MaxProbes; Probe++) {
+        uint32_t Index = (Slot + Probe) & TableMask;
+        uint32_t Current = Keys[Index].load(std::memory_order_acquire);
+        if(Current == MIGINNHashGrid::EmptyKey) {
+            if(!bInsert) break;
+            // On failure Current receives the key another thread inserted first.
+            if(Keys[Index].compare_exchange_strong(Current, Key, std::memory_order_acq_rel)) return Index;
+        }
+        if(Current == Key) return Index;
+    }
+    return TableSize;
+}
+
+// Claimed through the stamp, so an entry trained again in the meantime is kept. Samples another thread adds for the old
+// key go to the new one.
+uint32_t MIGINNHashGridCPU::ReplaceStale(uint32_t Slot, uint32_t Key) {
+    const uint32_t TableMask = TableSize - 1;
+    for(uint32_t Probe = 0; Probe < MIGINNHashGrid::MaxProbes; Probe++) {
+        uint32_t Index = (Slot + Probe) & TableMask;
+        uint32_t Stamp = Stamps[Index].load(std::memory_order_relaxed);
+        if(!MIGINNHashGrid::IsStale(Step, Stamp, Details.InMaxAge)) continue;
+        if(!Stamps[Index].compare_exchange_strong(Stamp, Step, std::memory_order_acq_rel)) continue;
+        Keys[Index].store(Key, std::memory_order_release);
+        // Nothing seen yet: the first samples of the new cell replace the old value, see BlendEntry.
+        Entries[(size_t)Index * MIGINNHashGrid::EntryStride + MIGINN_HASH_GRID_MAX_OUTPUT_DIMENSIONS] = 0.f;
+        return Index;
+    }
+    return TableSize;
+}
+
+void MIGINNHashGridCPU::Accumulate(const float *Inputs, const float *Targets, uint32_t NumElements) {
+    for(uint32_t Idx = 0; Idx < NumElements; Idx++) {
+        uint32_t Slot, Key;
+        MIGINNHashGrid::ComputeKey(Inputs + (size_t)Idx * Details.InNumInputDimensions, Details, Slot, Key);
+        uint32_t Index = Find(Slot, Key, true);
+        if(Index == TableSize) Index = ReplaceStale(Slot, Key);
+        if(Index == TableSize) continue;
+        Stamps[Index].store(Step, std::memory_order_relaxed);
+        std::atomic<float> * Accumulator = &Accumulators[(size_t)Index * MIGINNHashGrid::EntryStride];
+        for(uint32_t i = 0; i < Details.InNumOutputDimensions; i++) {
+            AtomicAdd(Accumulator[i], Targets[(size_t)Idx * Details.InNumOutputDimensions + i]);
+        }
+        AtomicAdd(Accumulator[MIGINN_HASH_GRID_MAX_OUTPUT_DIMENSIONS], 1.f);
+    }
+}
+
+void MIGINNHashGridCPU::Resolve() {
+    for(uint32_t Idx = 0; Idx < TableSize; Idx++) {
+        std::atomic<float> * Accumulator = &Accumulators[(size_t)Idx * MIGINNHashGrid::EntryStride];
+        float SampleCount = Accumulator[MIGINN_HASH_GRID_MAX_OUTPUT_DIMENSIONS].load(std::memory_order_relaxed);
+        if(SampleCount == 0.f) continue;
+        float SampleSum[MIGINNHashGrid::EntryStride];
+        for(uint32_t i = 0; i < MIGINNHashGrid::EntryStride; i++) {
+            SampleSum[i] = Accumulator[i].exchange(0.f, std::memory_order_relaxed);
+        }
+        MIGINNHashGrid::BlendEntry(&Entries[(size_t)Idx * MIGINNHashGrid::EntryStride], SampleSum, SampleCount,
+                                   Details.InNumOutputDimensions, Details.InBlendFactor);
+    }
+    Step++;
+}
+
+void MIGINNHashGridCPU::Inference(const float *Inputs, float *Outputs, uint32_t NumElements) const {
+    for(uint32_t Idx = 0; Idx < NumElements; Idx++) {
+        uint32_t Slot, Key;
+        MIGINNHashGrid::ComputeKey(Inputs + (size_t)Idx * Details.InNumInputDimensions, Details, Slot, Key);
+        uint32_t Index = Find(Slot, Key, false);
+        float * Output = Outputs + (size_t)Idx * Details.InNumOutputDimensions;
+        for(uint32_t i = 0; i < Details.InNumOutputDimensions; i++) {
+            Output[i] = Index == TableSize ? 0.f : Entries[(size_t)Index * MIGINNHashGrid::EntryStride + i];
+        }
+    }
+}
+
+uint32_t MIGINNHashGridCPU::GetNumOccupiedEntries() const {
+    uint32_t NumOccupied = 0;
+    for(uint32_t i = 0; i < TableSize; i++) {
+        if(Keys[i].load(std::memory_order_relaxed) != MIGINNHashGrid::EmptyKey) NumOccupied++;
+    }
+    return NumOccupied;
+}
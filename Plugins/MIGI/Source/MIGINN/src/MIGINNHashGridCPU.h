@@ -0,0 +1,50 @@
+/*
+ * Project MIGINN : MIGINNHashGridCPU.h
+ * Created: 2024/03/02
+ * This program is unlicensed. See LICENSE for more.
+ */
+
+#ifndef MIGINN_MIGINNHASHGRIDCPU_H
+#define MIGINN_MIGINNHASHGRIDCPU_H
+
+#include <atomic>
+#include <memory>
+#include "MIGINN.h"
+
+// Host implementation of the hash grid cache, a baseline to compare the networks against.
+// The table is lock-free open addressing: Accumulate and Inference may be called from any number of threads at once,
+// Resolve must not overlap with either of them.
+class MIGINNHashGridCPU {
+public:
+    explicit MIGINNHashGridCPU (const MIGINNDetailsHashGrid & InDetails);
+    MIGINNHashGridCPU (const MIGINNHashGridCPU &) = delete;
+    MIGINNHashGridCPU & operator = (const MIGINNHashGridCPU &) = delete;
+
+    // Scatter training samples (InNumInputDimensions floats per input, InNumOutputDimensions floats per target).
+    void Accumulate (const float * Inputs, const float * Targets, uint32_t NumElements);
+    // Blend everything accumulated since the last resolve into the cache, ends the training step.
+    void Resolve ();
+    // Look up the cached values, cells never trained return zeros.
+    void Inference (const float * Inputs, float * Outputs, uint32_t NumElements) const;
+
+    [[nodiscard]] uint32_t GetNumOccupiedEntries () const;
+    [[nodiscard]] const MIGINNDetailsHashGrid & GetDetails () const { return Details; }
+protected:
+    // Returns the table size if the probe sequence is full.
+    uint32_t Find (uint32_t Slot, uint32_t Key, bool bInsert) const;
+    // Take over the first stale entry of a full probe sequence. Returns the table size if there is none.
+    uint32_t ReplaceStale (uint32_t Slot, uint32_t Key);
+
+    MIGINNDetailsHashGrid Details {};
+    uint32_t TableSize {};
+    // Incremented by every Resolve.
+    uint32_t Step {};
+    std::unique_ptr<std::atomic<uint32_t>[]> Keys {};
+    // Training step each entry was last trained on.
+    std::unique_ptr<std::atomic<uint32_t>[]> Stamps {};
+    std::unique_ptr<std::atomic<float>[]> Accumulators {};
+    // Only touched by Resolve, read concurrently by Inference. ReplaceStale clears the sample count of the entries it takes over.
+    std::unique_ptr<float[]> Entries {};
+};
+
+#endif //MIGINN_MIGINNHASHGRIDCPU_H
@@ -30,6 +30,10 @@ public:
 
     virtual MIGINNResultType Train (const MIGINNTrainNetworkParams &Params) = 0;
     virtual MIGINNResultType Inference (const MIGINNInferenceParams &Params) const = 0;
+    // Move the network state to host memory and free all of its device memory.
+    virtual MIGINNResultType Suspend () = 0;
+    // Re-create the network on the device from the state kept by Suspend.
+    virtual MIGINNResultType Resume () = 0;
 
     // The virtual destructor.
     virtual ~MIGINNCacheNetwork () = default;
@@ -42,6 +46,8 @@ class MIGINNMLPCacheNetwork : public MIGINNCacheNetwork {
 public:
     MIGINNResultType Train (const MIGINNTrainNetworkParams &Params) override;
     MIGINNResultType Inference (const MIGINNInferenceParams &Params) const override;
+    MIGINNResultType Suspend () override;
+    MIGINNResultType Resume () override;
 
     MIGINNMLPCacheNetwork () ;
     // The virtual destructor.
@@ -51,4 +57,20 @@ protected:
     std::unique_ptr<MIGINNMLPCacheNetworkImpl> Impl {};
 };
 
+class MIGINNHashGridCacheNetworkImpl;
+class MIGINNHashGridCacheNetwork : public MIGINNCacheNetwork {
+public:
+    MIGINNResultType Train (const MIGINNTrainNetworkParams &Params) override;
+    MIGINNResultType Inference (const MIGINNInferenceParams &Params) const override;
+    MIGINNResultType Suspend () override;
+    MIGINNResultType Resume () override;
+
+    MIGINNHashGridCacheNetwork () ;
+    // The virtual destructor.
+    ~MIGINNHashGridCacheNetwork () ;
+    static std::unique_ptr<MIGINNCacheNetwork> Create (const MIGINNNetworkConfig &Params);
+protected:
+    std::unique_ptr<MIGINNHashGridCacheNetworkImpl> Impl {};
+};
+
 #endif //MIGINN_MIGINNINTERNAL_CUH
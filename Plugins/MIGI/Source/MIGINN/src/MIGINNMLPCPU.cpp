@@ -0,0 +1,196 @@
+/*
+ * Project MIGINN : MIGINNMLPCPU.cpp
+ * Created: 2024/03/14
+ * This program is unlicensed. See LICENSE for more.
+ */
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include "MIGINNMLPCPU.h"
+#include "MIGINNSIMD.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Elements per tile, each weight row loaded is reused for all of them. DenseLayer is unrolled for exactly four.
+constexpr uint32_t Tile = 4;
+
+#if defined(__AVX__)
+typedef __m256 FVector;
+constexpr uint32_t VectorWidth = 8;
+inline FVector Zero () { return _mm256_setzero_ps(); }
+inline FVector Load (const float * P) { return _mm256_loadu_ps(P); }
+inline void Store (float * P, FVector V) { _mm256_storeu_ps(P, V); }
+inline FVector Broadcast (float X) { return _mm256_set1_ps(X); }
+inline FVector ReLU (FVector V) { return _mm256_max_ps(V, _mm256_setzero_ps()); }
+#if defined(__FMA__)
+inline FVector MulAdd (FVector A, FVector B, FVector C) { return _mm256_fmadd_ps(A, B, C); }
+#else
+inline FVector MulAdd (FVector A, FVector B, FVector C) { return _mm256_add_ps(_mm256_mul_ps(A, B), C); }
+#endif
+#elif MIGINN_SSE2
+typedef __m128 FVector;
+constexpr uint32_t VectorWidth = 4;
+inline FVector Zero () { return _mm_setzero_ps(); }
+inline FVector Load (const float * P) { return _mm_loadu_ps(P); }
+inline void Store (float * P, FVector V) { _mm_storeu_ps(P, V); }
+inline FVector Broadcast (float X) { return _mm_set1_ps(X); }
+inline FVector ReLU (FVector V) { return _mm_max_ps(V, _mm_setzero_ps()); }
+inline FVector MulAdd (FVector A, FVector B, FVector C) { return _mm_add_ps(_mm_mul_ps(A, B), C); }
+#else
+typedef float FVector;
+constexpr uint32_t VectorWidth = 1;
+inline FVector Zero () { return 0.f; }
+inline FVector Load (const float * P) { return *P; }
+inline void Store (float * P, FVector V) { *P = V; }
+inline FVector Broadcast (float X) { return X; }
+inline FVector ReLU (FVector V) { return std::max(V, 0.f); }
+inline FVector MulAdd (FVector A, FVector B, FVector C) { return A * B + C; }
+#endif
+
+// Outputs per register block: Tile x 2 accumulators.
+constexpr uint32_t BlockOutputs = VectorWidth * 2;
+
+// One layer for one tile. Non-zero InWidth / OutWidth fix the sizes at compile time, so the loops unroll.
+template <uint32_t InWidth, uint32_t OutWidth>
+inline void DenseLayer (const MIGINNMLPCPU::FLayer & Layer, const float * In, uint32_t InStride, float * Out, uint32_t OutStride) {
+    const uint32_t NumInputs = InWidth ? InWidth : Layer.NumInputs;
+    const uint32_t NumOutputs = OutWidth ? OutWidth : Layer.PaddedOutputs;
+    const float * Weights = Layer.Weights.data();
+    for(uint32_t o = 0; o < NumOutputs; o += BlockOutputs) {
+        // Unrolled by hand, compilers keep all eight accumulators in registers this way.
+        FVector Accumulator00 = Zero(), Accumulator01 = Zero(), Accumulator10 = Zero(), Accumulator11 = Zero();
+        FVector Accumulator20 = Zero(), Accumulator21 = Zero(), Accumulator30 = Zero(), Accumulator31 = Zero();
+        for(uint32_t i = 0; i < NumInputs; i++) {
+            const FVector Weight0 = Load(Weights + (size_t)i * NumOutputs + o);
+            const FVector Weight1 = Load(Weights + (size_t)i * NumOutputs + o + VectorWidth);
+            const FVector Activation0 = Broadcast(In[i]);
+            const FVector Activation1 = Broadcast(In[InStride + i]);
+            const FVector Activation2 = Broadcast(In[InStride * 2 + i]);
+            const FVector Activation3 = Broadcast(In[InStride * 3 + i]);
+            Accumulator00 = MulAdd(Activation0, Weight0, Accumulator00);
+            Accumulator01 = MulAdd(Activation0, Weight1, Accumulator01);
+            Accumulator10 = MulAdd(Activation1, Weight0, Accumulator10);
+            Accumulator11 = MulAdd(Activation1, Weight1, Accumulator11);
+            Accumulator20 = MulAdd(Activation2, Weight0, Accumulator20);
+            Accumulator21 = MulAdd(Activation2, Weight1, Accumulator21);
+            Accumulator30 = MulAdd(Activation3, Weight0, Accumulator30);
+            Accumulator31 = MulAdd(Activation3, Weight1, Accumulator31);
+        }
+        const FVector Results[Tile][2] = {
+                {Accumulator00, Accumulator01}, {Accumulator10, Accumulator11},
+                {Accumulator20, Accumulator21}, {Accumulator30, Accumulator31}
+        };
+        for(uint32_t e = 0; e < Tile; e++) {
+            Store(Out + e * OutStride + o, Layer.bReLU ? ReLU(Results[e][0]) : Results[e][0]);
+            Store(Out + e * OutStride + o + VectorWidth, Layer.bReLU ? ReLU(Results[e][1]) : Results[e][1]);
+        }
+    }
+}
+
+template <uint32_t Width, uint32_t NumHiddenLayers>
+const float * SpecializedForward (const std::vector<MIGINNMLPCPU::FLayer> & Layers, const float * Inputs, uint32_t InputStride,
+                                  float * Scratch, uint32_t ScratchStride) {
+    float * Ping = Scratch, * Pong = Scratch + Tile * ScratchStride;
+    DenseLayer<0, Width>(Layers[0], Inputs, InputStride, Ping, ScratchStride);
+    for(uint32_t l = 1; l < NumHiddenLayers; l++) {
+        DenseLayer<Width, Width>(Layers[l], Ping, ScratchStride, Pong, ScratchStride);
+        std::swap(Ping, Pong);
+    }
+    DenseLayer<Width, 0>(Layers[NumHiddenLayers], Ping, ScratchStride, Pong, ScratchStride);
+    return Pong;
+}
+
+const float * GenericForward (const std::vector<MIGINNMLPCPU::FLayer> & Layers, const float * Inputs, uint32_t InputStride,
+                              float * Scratch, uint32_t ScratchStride) {
+    float * Ping = Scratch, * Pong = Scratch + Tile * ScratchStride;
+    DenseLayer<0, 0>(Layers[0], Inputs, InputStride, Ping, ScratchStride);
+    for(size_t l = 1; l < Layers.size(); l++) {
+        DenseLayer<0, 0>(Layers[l], Ping, ScratchStride, Pong, ScratchStride);
+        std::swap(Ping, Pong);
+    }
+    return Ping;
+}
+
+template <uint32_t Width>
+MIGINNMLPCPU::FForwardFunction SelectDepth (uint32_t NumHiddenLayers) {
+    switch(NumHiddenLayers) {
+        case 1: return &SpecializedForward<Width, 1>;
+        case 2: return &SpecializedForward<Width, 2>;
+        case 3: return &SpecializedForward<Width, 3>;
+        case 4: return &SpecializedForward<Width, 4>;
+        default: return nullptr;
+    }
+}
+
+MIGINNMLPCPU::FForwardFunction SelectSpecialization (uint32_t Width, uint32_t NumHiddenLayers) {
+    switch(Width) {
+        case 16: return SelectDepth<16>(NumHiddenLayers);
+        case 32: return SelectDepth<32>(NumHiddenLayers);
+        case 64: return SelectDepth<64>(NumHiddenLayers);
+        case 128: return SelectDepth<128>(NumHiddenLayers);
+        default: return nullptr;
+    }
+}
+
+}
+
+MIGINNMLPCPU::MIGINNMLPCPU(const std::vector<MIGINNFloatLayer> &InLayers) {
+    if(InLayers.empty()) throw std::invalid_argument{"An MLP needs at least one layer"};
+    for(size_t l = 1; l < InLayers.size(); l++) {
+        if(InLayers[l].NumInputs != InLayers[l - 1].NumOutputs) throw std::invalid_argument{"Layer sizes do not chain"};
+    }
+    for(const auto & InLayer : InLayers) {
+        FLayer Layer {};
+        Layer.NumInputs = InLayer.NumInputs;
+        Layer.NumOutputs = InLayer.NumOutputs;
+        Layer.PaddedOutputs = (InLayer.NumOutputs + BlockOutputs - 1) / BlockOutputs * BlockOutputs;
+        Layer.bReLU = InLayer.bReLU;
+        Layer.Weights.assign((size_t)Layer.NumInputs * Layer.PaddedOutputs, 0.f);
+        for(uint32_t o = 0; o < Layer.NumOutputs; o++) {
+            for(uint32_t i = 0; i < Layer.NumInputs; i++) {
+                Layer.Weights[(size_t)i * Layer.PaddedOutputs + o] = InLayer.Weights[(size_t)o * InLayer.NumInputs + i];
+            }
+        }
+        ScratchStride = std::max(ScratchStride, Layer.PaddedOutputs);
+        Layers.push_back(std::move(Layer));
+    }
+
+    // Specialize the fully fused MLP shape: ReLU hidden layers of one width and a linear output layer.
+    const uint32_t Width = Layers.front().NumOutputs;
+    const uint32_t NumHiddenLayers = (uint32_t)Layers.size() - 1;
+    bool bFullyFusedShape = NumHiddenLayers > 0 && !Layers.back().bReLU;
+    for(uint32_t l = 0; l < NumHiddenLayers; l++) {
+        bFullyFusedShape = bFullyFusedShape && Layers[l].bReLU && Layers[l].NumOutputs == Width;
+    }
+    if(bFullyFusedShape) SpecializedForward = SelectSpecialization(Width, NumHiddenLayers);
+}
+
+void MIGINNMLPCPU::Inference(const float *Inputs, uint32_t InputStride, float *Outputs, uint32_t OutputStride, uint32_t NumElements) const {
+    const FForwardFunction Forward = SpecializedForward ? SpecializedForward : &GenericForward;
+    const uint32_t NumInputs = GetNumInputDimensions();
+    const uint32_t NumOutputs = GetNumOutputDimensions();
+    std::vector<float> Scratch((size_t)2 * Tile * ScratchStride);
+    std::vector<float> TailInputs;
+    for(uint32_t Idx = 0; Idx < NumElements; Idx += Tile) {
+        const uint32_t NumValid = std::min(Tile, NumElements - Idx);
+        const float * TileInputs = Inputs + (size_t)Idx * InputStride;
+        uint32_t TileInputStride = InputStride;
+        if(NumValid < Tile) {
+            // Pad the last tile instead of reading past the inputs.
+            TailInputs.assign((size_t)Tile * NumInputs, 0.f);
+            for(uint32_t e = 0; e < NumValid; e++) {
+                std::copy(TileInputs + (size_t)e * InputStride, TileInputs + (size_t)e * InputStride + NumInputs, TailInputs.begin() + (size_t)e * NumInputs);
+            }
+            TileInputs = TailInputs.data();
+            TileInputStride = NumInputs;
+        }
+        const float * Result = Forward(Layers, TileInputs, TileInputStride, Scratch.data(), ScratchStride);
+        for(uint32_t e = 0; e < NumValid; e++) {
+            std::copy(Result + (size_t)e * ScratchStride, Result + (size_t)e * ScratchStride + NumOutputs, Outputs + (size_t)(Idx + e) * OutputStride);
+        }
+    }
+}
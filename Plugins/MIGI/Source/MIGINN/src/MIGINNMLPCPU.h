@@ -0,0 +1,52 @@
+/*
+ * Project MIGINN : MIGINNMLPCPU.h
+ * Created: 2024/03/14
+ * This program is unlicensed. See LICENSE for more.
+ */
+
+#ifndef MIGINN_MIGINNMLPCPU_H
+#define MIGINN_MIGINNMLPCPU_H
+
+#include <cstdint>
+#include <vector>
+
+// A dense layer without bias, the layout tiny-cuda-nn's MLPs use: NumOutputs x NumInputs floats, row-major.
+struct MIGINNFloatLayer {
+    uint32_t NumInputs {};
+    uint32_t NumOutputs {};
+    std::vector<float> Weights {};
+    bool bReLU {};
+};
+
+// Float inference of a small MLP on the host.
+// The shape of tiny-cuda-nn's fully fused MLP (ReLU hidden layers of one width, a linear output layer) with a width of
+// 16, 32, 64 or 128 and 1 to 4 hidden layers runs a kernel instantiated for exactly that width and depth.
+// Every other shape runs the same register-blocked layers with runtime sizes.
+class MIGINNMLPCPU {
+public:
+    explicit MIGINNMLPCPU (const std::vector<MIGINNFloatLayer> & InLayers);
+
+    void Inference (const float * Inputs, uint32_t InputStride, float * Outputs, uint32_t OutputStride, uint32_t NumElements) const;
+
+    [[nodiscard]] bool IsSpecialized () const { return SpecializedForward != nullptr; }
+    [[nodiscard]] uint32_t GetNumInputDimensions () const { return Layers.front().NumInputs; }
+    [[nodiscard]] uint32_t GetNumOutputDimensions () const { return Layers.back().NumOutputs; }
+
+    // Weights transposed to NumInputs x PaddedOutputs, so a row of outputs is contiguous.
+    struct FLayer {
+        uint32_t NumInputs;
+        uint32_t NumOutputs;
+        uint32_t PaddedOutputs;
+        bool bReLU;
+        std::vector<float> Weights;
+    };
+    // Runs one tile of elements through all layers, returns the rows of the last layer inside Scratch.
+    typedef const float * (*FForwardFunction) (const std::vector<FLayer> & Layers, const float * Inputs, uint32_t InputStride,
+                                               float * Scratch, uint32_t ScratchStride);
+protected:
+    std::vector<FLayer> Layers {};
+    uint32_t ScratchStride {};
+    FForwardFunction SpecializedForward {};
+};
+
+#endif //MIGINN_MIGINNMLPCPU_H
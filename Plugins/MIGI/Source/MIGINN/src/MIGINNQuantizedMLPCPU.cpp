@@ -0,0 +1,178 @@
+/*
+ * Project MIGINN : MIGINNQuantizedMLPCPU.cpp
+ * Created: 2024/03/10
+ * This program is unlicensed. See LICENSE for more.
+ */
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include "MIGINNQuantizedMLPCPU.h"
+#include "MIGINNSIMD.h"
+
+#if (defined(__AVX512VNNI__) && defined(__AVX512VL__)) || defined(__AVXVNNI__)
+#include <immintrin.h>
+#define MIGINN_QUANTIZED_VNNI 1
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define MIGINN_QUANTIZED_AVX2 1
+#endif
+
+namespace {
+
+int8_t QuantizeValue (float Value, float InvScale) {
+    float Quantized = std::round(Value * InvScale);
+    return (int8_t)std::clamp(Quantized, -127.f, 127.f);
+}
+
+#if MIGINN_QUANTIZED_VNNI || MIGINN_QUANTIZED_AVX2
+int32_t HorizontalSum (__m256i V) {
+    __m128i Sum = _mm_add_epi32(_mm256_castsi256_si128(V), _mm256_extracti128_si256(V, 1));
+    Sum = _mm_add_epi32(Sum, _mm_shuffle_epi32(Sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    Sum = _mm_add_epi32(Sum, _mm_shuffle_epi32(Sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(Sum);
+}
+#elif MIGINN_SSE2
+int32_t HorizontalSum (__m128i Sum) {
+    Sum = _mm_add_epi32(Sum, _mm_shuffle_epi32(Sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    Sum = _mm_add_epi32(Sum, _mm_shuffle_epi32(Sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(Sum);
+}
+#endif
+
+// Dot product of the quantized inputs and one weight row, Length is a multiple of InputAlignment.
+// The VNNI kernel multiplies unsigned by signed bytes, so it reads the inputs offset by +128 from UnsignedInputs.
+int32_t Dot ([[maybe_unused]] const int8_t * Inputs, [[maybe_unused]] const uint8_t * UnsignedInputs, const int8_t * Weights,
+            [[maybe_unused]] int32_t WeightSum, uint32_t Length) {
+#if MIGINN_QUANTIZED_VNNI
+    __m256i Sum = _mm256_setzero_si256();
+    for(uint32_t i = 0; i < Length; i += 32) {
+        __m256i A = _mm256_loadu_si256((const __m256i*)(UnsignedInputs + i));
+        __m256i B = _mm256_loadu_si256((const __m256i*)(Weights + i));
+#if defined(__AVX512VNNI__) && defined(__AVX512VL__)
+        Sum = _mm256_dpbusd_epi32(Sum, A, B);
+#else
+        Sum = _mm256_dpbusd_avx_epi32(Sum, A, B);
+#endif
+    }
+    return HorizontalSum(Sum) - 128 * WeightSum;
+#elif MIGINN_QUANTIZED_AVX2
+    __m256i Sum = _mm256_setzero_si256();
+    for(uint32_t i = 0; i < Length; i += 16) {
+        __m256i A = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(Inputs + i)));
+        __m256i B = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(Weights + i)));
+        Sum = _mm256_add_epi32(Sum, _mm256_madd_epi16(A, B));
+    }
+    return HorizontalSum(Sum);
+#elif MIGINN_SSE2
+    __m128i Sum = _mm_setzero_si128();
+    for(uint32_t i = 0; i < Length; i += 16) {
+        __m128i A = _mm_loadu_si128((const __m128i*)(Inputs + i));
+        __m128i B = _mm_loadu_si128((const __m128i*)(Weights + i));
+        // Sign extend bytes to 16 bit: duplicate each byte into both halves, then shift arithmetically.
+        __m128i ALow = _mm_srai_epi16(_mm_unpacklo_epi8(A, A), 8), AHigh = _mm_srai_epi16(_mm_unpackhi_epi8(A, A), 8);
+        __m128i BLow = _mm_srai_epi16(_mm_unpacklo_epi8(B, B), 8), BHigh = _mm_srai_epi16(_mm_unpackhi_epi8(B, B), 8);
+        Sum = _mm_add_epi32(Sum, _mm_add_epi32(_mm_madd_epi16(ALow, BLow), _mm_madd_epi16(AHigh, BHigh)));
+    }
+    return HorizontalSum(Sum);
+#else
+    int32_t Sum = 0;
+    for(uint32_t i = 0; i < Length; i++) Sum += (int32_t)Inputs[i] * (int32_t)Weights[i];
+    return Sum;
+#endif
+}
+
+// Float forward pass recording the largest magnitude seen at the input of each layer.
+void ForwardFloat (const std::vector<MIGINNFloatLayer> & Layers, const float * Input, float * Output, float * InputMaxima) {
+    std::vector<float> Current(Input, Input + Layers.front().NumInputs), Next;
+    for(size_t l = 0; l < Layers.size(); l++) {
+        const auto & Layer = Layers[l];
+        if(InputMaxima) {
+            for(float Value : Current) InputMaxima[l] = std::max(InputMaxima[l], std::fabs(Value));
+        }
+        Next.assign(Layer.NumOutputs, 0.f);
+        for(uint32_t o = 0; o < Layer.NumOutputs; o++) {
+            const float * Row = Layer.Weights.data() + (size_t)o * Layer.NumInputs;
+            float Sum = 0.f;
+            for(uint32_t i = 0; i < Layer.NumInputs; i++) Sum += Row[i] * Current[i];
+            Next[o] = Layer.bReLU ? std::max(Sum, 0.f) : Sum;
+        }
+        std::swap(Current, Next);
+    }
+    std::copy(Current.begin(), Current.end(), Output);
+}
+
+}
+
+void MIGINNQuantizedMLPCPU::InferenceFloat(const std::vector<MIGINNFloatLayer> &InLayers, const float *Input, float *Output) {
+    ForwardFloat(InLayers, Input, Output, nullptr);
+}
+
+void MIGINNQuantizedMLPCPU::Quantize(const std::vector<MIGINNFloatLayer> &InLayers, const float *CalibrationInputs, uint32_t NumCalibrationElements) {
+    if(InLayers.empty()) throw std::invalid_argument{"Nothing to quantize"};
+    for(size_t l = 1; l < InLayers.size(); l++) {
+        if(InLayers[l].NumInputs != InLayers[l - 1].NumOutputs) throw std::invalid_argument{"Layer sizes do not chain"};
+    }
+    // Measure the activation ranges.
+    std::vector<float> InputMaxima(InLayers.size(), 0.f);
+    std::vector<float> Output(InLayers.back().NumOutputs);
+    for(uint32_t Idx = 0; Idx < NumCalibrationElements; Idx++) {
+        ForwardFloat(InLayers, CalibrationInputs + (size_t)Idx * InLayers.front().NumInputs, Output.data(), InputMaxima.data());
+    }
+
+    Layers.clear();
+    NumInputDimensions = InLayers.front().NumInputs;
+    MaxWidth = 0;
+    for(size_t l = 0; l < InLayers.size(); l++) {
+        const auto & InLayer = InLayers[l];
+        MIGINNQuantizedLayer Layer {};
+        Layer.NumInputs = (InLayer.NumInputs + InputAlignment - 1) / InputAlignment * InputAlignment;
+        Layer.NumOutputs = InLayer.NumOutputs;
+        Layer.bReLU = InLayer.bReLU;
+        Layer.InputScale = InputMaxima[l] > 0.f ? InputMaxima[l] / 127.f : 1.f;
+        Layer.Weights.assign((size_t)Layer.NumOutputs * Layer.NumInputs, 0);
+        Layer.WeightScales.resize(Layer.NumOutputs);
+        Layer.WeightSums.resize(Layer.NumOutputs);
+        for(uint32_t o = 0; o < Layer.NumOutputs; o++) {
+            const float * Row = InLayer.Weights.data() + (size_t)o * InLayer.NumInputs;
+            float MaxWeight = 0.f;
+            for(uint32_t i = 0; i < InLayer.NumInputs; i++) MaxWeight = std::max(MaxWeight, std::fabs(Row[i]));
+            Layer.WeightScales[o] = MaxWeight > 0.f ? MaxWeight / 127.f : 1.f;
+            int32_t Sum = 0;
+            for(uint32_t i = 0; i < InLayer.NumInputs; i++) {
+                int8_t Weight = QuantizeValue(Row[i], 1.f / Layer.WeightScales[o]);
+                Layer.Weights[(size_t)o * Layer.NumInputs + i] = Weight;
+                Sum += Weight;
+            }
+            Layer.WeightSums[o] = Sum;
+        }
+        MaxWidth = std::max({MaxWidth, Layer.NumInputs, Layer.NumOutputs});
+        Layers.push_back(std::move(Layer));
+    }
+}
+
+void MIGINNQuantizedMLPCPU::Inference(const float *Inputs, uint32_t InputStride, float *Outputs, uint32_t OutputStride, uint32_t NumElements) const {
+    std::vector<int8_t> Quantized(MaxWidth);
+    std::vector<uint8_t> UnsignedQuantized(MaxWidth);
+    std::vector<float> Activations(MaxWidth);
+    for(uint32_t Idx = 0; Idx < NumElements; Idx++) {
+        const float * Input = Inputs + (size_t)Idx * InputStride;
+        std::copy(Input, Input + NumInputDimensions, Activations.begin());
+        // The padding was never part of the float network.
+        uint32_t NumValid = NumInputDimensions;
+        for(const auto & Layer : Layers) {
+            const float InvScale = 1.f / Layer.InputScale;
+            for(uint32_t i = 0; i < Layer.NumInputs; i++) {
+                Quantized[i] = i < NumValid ? QuantizeValue(Activations[i], InvScale) : 0;
+                UnsignedQuantized[i] = (uint8_t)(Quantized[i] + 128);
+            }
+            for(uint32_t o = 0; o < Layer.NumOutputs; o++) {
+                int32_t Sum = Dot(Quantized.data(), UnsignedQuantized.data(), Layer.Weights.data() + (size_t)o * Layer.NumInputs,
+                                  Layer.WeightSums[o], Layer.NumInputs);
+                float Value = (float)Sum * Layer.InputScale * Layer.WeightScales[o];
+                Activations[o] = Layer.bReLU ? std::max(Value, 0.f) : Value;
+            }
+            NumValid = Layer.NumOutputs;
+        }
+        std::copy(Activations.begin(), Activations.begin() + Layers.back().NumOutputs, Outputs + (size_t)Idx * OutputStride);
+    }
+}
@@ -0,0 +1,51 @@
+/*
+ * Project MIGINN : MIGINNQuantizedMLPCPU.h
+ * Created: 2024/03/10
+ * This program is unlicensed. See LICENSE for more.
+ */
+
+#ifndef MIGINN_MIGINNQUANTIZEDMLPCPU_H
+#define MIGINN_MIGINNQUANTIZEDMLPCPU_H
+
+#include <cstdint>
+#include <vector>
+#include "MIGINNMLPCPU.h"
+
+// A layer quantized to INT8: symmetric per output channel weight scales and a symmetric per layer input scale.
+struct MIGINNQuantizedLayer {
+    // Padded to a multiple of MIGINNQuantizedMLPCPU::InputAlignment with zero weights.
+    uint32_t NumInputs {};
+    uint32_t NumOutputs {};
+    std::vector<int8_t> Weights {};
+    std::vector<float> WeightScales {};
+    // Row sums of the weights, removes the +128 offset of unsigned activations in the VNNI kernel.
+    std::vector<int32_t> WeightSums {};
+    // Real value of one step of the quantized layer inputs.
+    float InputScale {};
+    bool bReLU {};
+};
+
+// INT8 inference of a small MLP, calibrated from its float weights and a batch of representative inputs.
+// Inference uses VNNI dot products when the compiler targets them, AVX2 or SSE2 16 bit multiply-adds otherwise.
+class MIGINNQuantizedMLPCPU {
+public:
+    static constexpr uint32_t InputAlignment = 32;
+
+    // Quantize the layers. The activation ranges are measured by running CalibrationInputs through the float network.
+    void Quantize (const std::vector<MIGINNFloatLayer> & Layers, const float * CalibrationInputs, uint32_t NumCalibrationElements);
+    // Inputs hold Layers[0].NumInputs floats per element, Outputs get the last layer's NumOutputs floats per element.
+    void Inference (const float * Inputs, uint32_t InputStride, float * Outputs, uint32_t OutputStride, uint32_t NumElements) const;
+
+    // Float forward pass of one element, used for calibration and as a reference.
+    static void InferenceFloat (const std::vector<MIGINNFloatLayer> & Layers, const float * Input, float * Output);
+
+    [[nodiscard]] bool IsValid () const { return !Layers.empty(); }
+    [[nodiscard]] const std::vector<MIGINNQuantizedLayer> & GetLayers () const { return Layers; }
+protected:
+    std::vector<MIGINNQuantizedLayer> Layers {};
+    // Before padding.
+    uint32_t NumInputDimensions {};
+    uint32_t MaxWidth {};
+};
+
+#endif //MIGINN_MIGINNQUANTIZEDMLPCPU_H
@@ -0,0 +1,55 @@
+/*
+ * Project MIGINN : MIGINNQueryDedup.cuh
+ * Created: 2024/03/17
+ * This program is unlicensed. See LICENSE for more.
+ */
+
+#ifndef MIGINN_MIGINNQUERYDEDUP_CUH
+#define MIGINN_MIGINNQUERYDEDUP_CUH
+
+#include <cstdint>
+
+// Deduplication of the inference queries on the device, see MIGINNQueryDedupCPU for the host version.
+// Everything runs in GCUDAStream. All functions throw on CUDA errors.
+class MIGINNQueryDeduplicator {
+public:
+    MIGINNQueryDeduplicator () = default;
+    MIGINNQueryDeduplicator (const MIGINNQueryDeduplicator &) = delete;
+    MIGINNQueryDeduplicator & operator = (const MIGINNQueryDeduplicator &) = delete;
+    ~MIGINNQueryDeduplicator ();
+
+    // Pack one input per distinct quantized query into GetUniqueInputs() and return their number.
+    // Synchronizes the stream to read the number back. The unique inputs are allocated for
+    // the returned number rounded up to Granularity, the padding holds stale inputs.
+    uint32_t Deduplicate (const float * Inputs, uint32_t NumInputDimensions, uint32_t NumElements, float Quantum, uint32_t Granularity);
+    // Copy the results of the unique queries of the last Deduplicate back to every query.
+    void Scatter (const float * UniqueOutputs, uint32_t NumOutputDimensions, float * Outputs) const;
+
+    // Room for NumOutputDimensions floats per (padded) unique query of the last Deduplicate.
+    float * GetUniqueOutputs (uint32_t NumOutputDimensions);
+    [[nodiscard]] const float * GetUniqueInputs () const { return UniqueInputs; }
+    // Free all device memory, the next Deduplicate allocates again.
+    void Release ();
+protected:
+    uint32_t NumElements {};
+    // Rounded up to the granularity of the last Deduplicate.
+    uint32_t PaddedNumElements {};
+    uint32_t TableSize {};
+    // Capacities of the allocations, in elements.
+    uint32_t ElementCapacity {};
+    uint32_t TableCapacity {};
+    size_t UniqueInputsCapacity {};
+    size_t UniqueOutputsCapacity {};
+    unsigned long long * Keys {};
+    // Element that inserted each table entry.
+    uint32_t * Owners {};
+    // Unique query index of each table entry, followed by one entry per element for the queries that found no room.
+    uint32_t * Slots {};
+    // Entry in Slots of each element.
+    uint32_t * ElementEntries {};
+    uint32_t * Counter {};
+    float * UniqueInputs {};
+    float * UniqueOutputs {};
+};
+
+#endif //MIGINN_MIGINNQUERYDEDUP_CUH
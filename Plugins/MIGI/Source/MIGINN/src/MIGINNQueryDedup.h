@@ -0,0 +1,56 @@
+/*
+ * Project MIGINN : MIGINNQueryDedup.h
+ * Created: 2024/03/17
+ * This program is unlicensed. See LICENSE for more.
+ */
+
+#ifndef MIGINN_MIGINNQUERYDEDUP_H
+#define MIGINN_MIGINNQUERYDEDUP_H
+
+#include <cmath>
+#include <cstdint>
+
+// Shared by the CUDA and the host implementations of the query deduplication.
+#ifndef MIGINN_HOST_DEVICE
+#ifdef __CUDACC__
+#define MIGINN_HOST_DEVICE __host__ __device__
+#else
+#define MIGINN_HOST_DEVICE
+#endif
+#endif
+
+namespace MIGINNQueryDedup {
+
+// Keys are 64 bit fingerprints of the quantized inputs, all ones marks an empty entry.
+constexpr uint64_t EmptyKey = ~0ull;
+// Linear probing gives up after this many entries, the query is then evaluated on its own.
+constexpr uint32_t MaxProbes = 16;
+
+// SplitMix64 finalizer.
+MIGINN_HOST_DEVICE inline uint64_t Mix (uint64_t X) {
+    X = (X ^ (X >> 30)) * 0xbf58476d1ce4e5b9ull;
+    X = (X ^ (X >> 27)) * 0x94d049bb133111ebull;
+    return X ^ (X >> 31);
+}
+
+// Fingerprint of an input element, every dimension snapped to a grid of InvQuantum steps per unit.
+// Queries with the same fingerprint share one inference.
+MIGINN_HOST_DEVICE inline uint64_t ComputeKey (const float * Element, uint32_t NumInputDimensions, float InvQuantum) {
+    uint64_t Key = NumInputDimensions;
+    for(uint32_t i = 0; i < NumInputDimensions; i++) {
+        auto Cell = (uint32_t)(int32_t)floorf(Element[i] * InvQuantum);
+        Key = Mix(Key ^ Cell);
+    }
+    return Key == EmptyKey ? 0 : Key;
+}
+
+// Table size for a batch: a power of two at least twice the number of elements, so probe sequences stay short.
+MIGINN_HOST_DEVICE inline uint32_t GetTableSize (uint32_t NumElements) {
+    uint32_t TableSize = 64;
+    while(TableSize < NumElements * 2) TableSize <<= 1;
+    return TableSize;
+}
+
+}
+
+#endif //MIGINN_MIGINNQUERYDEDUP_H
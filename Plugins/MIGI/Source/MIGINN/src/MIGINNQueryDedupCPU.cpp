@@ -0,0 +1,56 @@
+/*
+ * Project MIGINN : MIGINNQueryDedupCPU.cpp
+ * Created: 2024/03/17
+ * This program is unlicensed. See LICENSE for more.
+ */
+#include <algorithm>
+#include <stdexcept>
+#include "MIGINNQueryDedupCPU.h"
+#include "MIGINNQueryDedup.h"
+
+MIGINNQueryDedupCPU::MIGINNQueryDedupCPU(float InQuantum) : Quantum(InQuantum) {
+    if(!(Quantum > 0.f)) throw std::invalid_argument{"Invalid deduplication quantum"};
+}
+
+uint32_t MIGINNQueryDedupCPU::Deduplicate(const float *Inputs, uint32_t NumInputDimensions, uint32_t NumElements) {
+    const uint32_t TableSize = MIGINNQueryDedup::GetTableSize(NumElements);
+    const uint32_t TableMask = TableSize - 1;
+    const float InvQuantum = 1.f / Quantum;
+    Keys.assign(TableSize, MIGINNQueryDedup::EmptyKey);
+    Slots.resize(TableSize);
+    ElementSlots.resize(NumElements);
+    UniqueInputs.resize((size_t)NumElements * NumInputDimensions);
+    NumUniqueElements = 0;
+    for(uint32_t Idx = 0; Idx < NumElements; Idx++) {
+        const float * Input = Inputs + (size_t)Idx * NumInputDimensions;
+        const uint64_t Key = MIGINNQueryDedup::ComputeKey(Input, NumInputDimensions, InvQuantum);
+        uint32_t Index = TableSize;
+        for(uint32_t Probe = 0; Probe < MIGINNQueryDedup::MaxProbes; Probe++) {
+            uint32_t Candidate = ((uint32_t)Key + Probe) & TableMask;
+            if(Keys[Candidate] == Key || Keys[Candidate] == MIGINNQueryDedup::EmptyKey) {
+                Index = Candidate;
+                break;
+            }
+        }
+        if(Index < TableSize && Keys[Index] == Key) {
+            ElementSlots[Idx] = Slots[Index];
+            continue;
+        }
+        // A new query, or one that found no room and is evaluated on its own.
+        if(Index < TableSize) {
+            Keys[Index] = Key;
+            Slots[Index] = NumUniqueElements;
+        }
+        ElementSlots[Idx] = NumUniqueElements;
+        std::copy(Input, Input + NumInputDimensions, UniqueInputs.begin() + (size_t)NumUniqueElements * NumInputDimensions);
+        NumUniqueElements++;
+    }
+    return NumUniqueElements;
+}
+
+void MIGINNQueryDedupCPU::Scatter(const float *UniqueOutputs, uint32_t NumOutputDimensions, float *Outputs) const {
+    for(size_t Idx = 0; Idx < ElementSlots.size(); Idx++) {
+        const float * UniqueOutput = UniqueOutputs + (size_t)ElementSlots[Idx] * NumOutputDimensions;
+        std::copy(UniqueOutput, UniqueOutput + NumOutputDimensions, Outputs + Idx * NumOutputDimensions);
+    }
+}
@@ -0,0 +1,39 @@
+/*
+ * Project MIGINN : MIGINNQueryDedupCPU.h
+ * Created: 2024/03/17
+ * This program is unlicensed. See LICENSE for more.
+ */
+
+#ifndef MIGINN_MIGINNQUERYDEDUPCPU_H
+#define MIGINN_MIGINNQUERYDEDUPCPU_H
+
+#include <cstdint>
+#include <vector>
+
+// Host implementation of the query deduplication in front of the cache networks.
+// Deduplicate packs one input per distinct quantized query, the caller runs inference on those
+// and Scatter copies every unique result back to all the queries that share it.
+class MIGINNQueryDedupCPU {
+public:
+    // Edge length of the quantization grid, in input units.
+    explicit MIGINNQueryDedupCPU (float InQuantum);
+
+    // Returns the number of unique queries, their inputs are packed in GetUniqueInputs().
+    uint32_t Deduplicate (const float * Inputs, uint32_t NumInputDimensions, uint32_t NumElements);
+    // UniqueOutputs holds NumOutputDimensions floats per unique query of the last Deduplicate.
+    void Scatter (const float * UniqueOutputs, uint32_t NumOutputDimensions, float * Outputs) const;
+
+    [[nodiscard]] const std::vector<float> & GetUniqueInputs () const { return UniqueInputs; }
+    [[nodiscard]] uint32_t GetNumUniqueElements () const { return NumUniqueElements; }
+protected:
+    float Quantum {};
+    std::vector<uint64_t> Keys {};
+    // Unique query index of every table entry.
+    std::vector<uint32_t> Slots {};
+    // Unique query index of every element of the last batch.
+    std::vector<uint32_t> ElementSlots {};
+    std::vector<float> UniqueInputs {};
+    uint32_t NumUniqueElements {};
+};
+
+#endif //MIGINN_MIGINNQUERYDEDUPCPU_H
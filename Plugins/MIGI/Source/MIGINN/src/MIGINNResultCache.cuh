@@ -0,0 +1,63 @@
+/*
+ * Project MIGINN : MIGINNResultCache.cuh
+ * Created: 2024/03/19
+ * This program is unlicensed. See LICENSE for more.
+ */
+
+#ifndef MIGINN_MIGINNRESULTCACHE_CUH
+#define MIGINN_MIGINNRESULTCACHE_CUH
+
+#include <cstdint>
+#include "MIGINNResultCache.h"
+
+// The inference result cache on the device, see MIGINNResultCacheCPU for the host version.
+// Everything runs in GCUDAStream. All functions but Configure throw on CUDA errors.
+class MIGINNInferenceResultCache {
+public:
+    MIGINNInferenceResultCache () = default;
+    MIGINNInferenceResultCache (const MIGINNInferenceResultCache &) = delete;
+    MIGINNInferenceResultCache & operator = (const MIGINNInferenceResultCache &) = delete;
+    ~MIGINNInferenceResultCache ();
+
+    // A zero Log2TableSize disables the cache. The table is allocated on first use.
+    void Configure (uint32_t InLog2TableSize, uint32_t InNumOutputDimensions, float InQuantum, const MIGINNResultCache::FPolicy & InPolicy);
+    [[nodiscard]] bool IsEnabled () const { return Log2TableSize != 0; }
+
+    // Write the reused results to Outputs and pack the queries to evaluate into GetRefreshInputs(), returns their number.
+    // Synchronizes the stream to read the number back. The refresh buffers hold NumElements rounded up to Granularity.
+    uint32_t Lookup (const float * Inputs, uint32_t NumInputDimensions, uint32_t NumElements, float * Outputs, uint32_t Granularity);
+    // Cache the results in GetRefreshOutputs() and write them to the Outputs of the last Lookup.
+    void Store (float * Outputs) const;
+    // Call after every weight update, drops the entries not refreshed for a long time.
+    void AdvanceWeightVersion ();
+
+    [[nodiscard]] const float * GetRefreshInputs () const { return RefreshInputs; }
+    [[nodiscard]] float * GetRefreshOutputs () const { return RefreshOutputs; }
+    // Free all device memory, the cached results are lost.
+    void Release ();
+protected:
+    uint32_t Log2TableSize {};
+    uint32_t NumOutputDimensions {};
+    float Quantum {};
+    MIGINNResultCache::FPolicy Policy {};
+    uint32_t WeightVersion {};
+    uint32_t Frame {};
+    uint32_t NumRefresh {};
+    // Capacity of the refresh buffers, in elements.
+    uint32_t RefreshCapacity {};
+    uint32_t RefreshInputDimensions {};
+
+    unsigned long long * Keys {};
+    uint32_t * Versions {};
+    float * ErrorBounds {};
+    float * Values {};
+    // Per packed query: its element and its entry (the table size when it is not cached).
+    uint32_t * RefreshElements {};
+    uint32_t * RefreshEntries {};
+    unsigned long long * RefreshKeys {};
+    uint32_t * Counter {};
+    float * RefreshInputs {};
+    float * RefreshOutputs {};
+};
+
+#endif //MIGINN_MIGINNRESULTCACHE_CUH
@@ -0,0 +1,56 @@
+/*
+ * Project MIGINN : MIGINNResultCache.h
+ * Created: 2024/03/19
+ * This program is unlicensed. See LICENSE for more.
+ */
+
+#ifndef MIGINN_MIGINNRESULTCACHE_H
+#define MIGINN_MIGINNRESULTCACHE_H
+
+#include <cmath>
+#include <cstdint>
+#include "MIGINNQueryDedup.h"
+
+// Shared by the CUDA and the host implementations of the inference result cache.
+// Entries are keyed by the fingerprints of the deduplicated queries and survive across frames.
+// Each one remembers the weight version that produced it and how much its result moved at its last refresh.
+namespace MIGINNResultCache {
+
+// Version of entries holding no result yet.
+constexpr uint32_t InvalidVersion = ~0u;
+constexpr uint32_t MaxProbes = 8;
+
+struct FPolicy {
+    // Entries produced this many weight versions ago are always refreshed.
+    uint32_t MaxAge;
+    // An entry whose result moved this much at its last refresh is refreshed every frame.
+    float Tolerance;
+    // Refresh probability of entries that did not move at all.
+    float MinRefreshProbability;
+};
+
+// Decide whether the cached result of Key is evaluated again this frame.
+MIGINN_HOST_DEVICE inline bool NeedsRefresh (uint64_t Key, uint32_t EntryVersion, float ErrorBound, uint32_t CurrentVersion,
+                                             uint32_t Frame, const FPolicy & Policy) {
+    if(EntryVersion == InvalidVersion || CurrentVersion - EntryVersion >= Policy.MaxAge) return true;
+    const float Probability = fmaxf(Policy.MinRefreshProbability, ErrorBound / Policy.Tolerance);
+    // Decorrelated per entry and per frame, so refreshes spread over frames.
+    const float Random = (float)(MIGINNQueryDedup::Mix(Key ^ ((uint64_t)Frame << 32)) >> 40) * (1.f / 16777216.f);
+    return Random < Probability;
+}
+
+// Entries of results not refreshed for this long are dropped.
+MIGINN_HOST_DEVICE inline bool IsExpired (uint32_t EntryVersion, uint32_t CurrentVersion, const FPolicy & Policy) {
+    return EntryVersion != InvalidVersion && CurrentVersion - EntryVersion > Policy.MaxAge * 2;
+}
+
+// Largest change of any channel between the cached and the refreshed result.
+MIGINN_HOST_DEVICE inline float ComputeErrorBound (const float * Cached, const float * Refreshed, uint32_t NumOutputDimensions) {
+    float Error = 0.f;
+    for(uint32_t i = 0; i < NumOutputDimensions; i++) Error = fmaxf(Error, fabsf(Refreshed[i] - Cached[i]));
+    return Error;
+}
+
+}
+
+#endif //MIGINN_MIGINNRESULTCACHE_H
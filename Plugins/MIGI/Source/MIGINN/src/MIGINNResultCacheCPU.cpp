@@ -0,0 +1,89 @@
+/*
+ * Project MIGINN : MIGINNResultCacheCPU.cpp
+ * Created: 2024/03/19
+ * This program is unlicensed. See LICENSE for more.
+ */
+#include <algorithm>
+#include <stdexcept>
+#include "MIGINNResultCacheCPU.h"
+
+MIGINNResultCacheCPU::MIGINNResultCacheCPU(uint32_t Log2TableSize, uint32_t InNumOutputDimensions, float InQuantum,
+                                           const MIGINNResultCache::FPolicy &InPolicy)
+        : Policy(InPolicy), Quantum(InQuantum), NumOutputDimensions(InNumOutputDimensions) {
+    if(Log2TableSize == 0 || Log2TableSize > 30 || NumOutputDimensions == 0 || !(Quantum > 0.f) || !(Policy.Tolerance > 0.f)) {
+        throw std::invalid_argument{"Invalid result cache configuration"};
+    }
+    TableSize = 1u << Log2TableSize;
+    Keys.assign(TableSize, MIGINNQueryDedup::EmptyKey);
+    Versions.assign(TableSize, MIGINNResultCache::InvalidVersion);
+    ErrorBounds.assign(TableSize, 0.f);
+    Values.assign((size_t)TableSize * NumOutputDimensions, 0.f);
+}
+
+uint32_t MIGINNResultCacheCPU::Lookup(const float *Inputs, uint32_t NumInputDimensions, uint32_t NumElements, float *Outputs) {
+    const float InvQuantum = 1.f / Quantum;
+    RefreshElements.clear();
+    RefreshKeys.clear();
+    RefreshEntries.clear();
+    RefreshInputs.clear();
+    for(uint32_t Idx = 0; Idx < NumElements; Idx++) {
+        const float * Input = Inputs + (size_t)Idx * NumInputDimensions;
+        const uint64_t Key = MIGINNQueryDedup::ComputeKey(Input, NumInputDimensions, InvQuantum);
+        // The entry of the key, else the first free one, else the first one stale enough to be replaced.
+        uint32_t Entry = TableSize, Free = TableSize;
+        for(uint32_t Probe = 0; Probe < MIGINNResultCache::MaxProbes; Probe++) {
+            uint32_t Index = ((uint32_t)Key + Probe) & (TableSize - 1);
+            if(Keys[Index] == Key) {
+                Entry = Index;
+                break;
+            }
+            const bool bStale = Versions[Index] != MIGINNResultCache::InvalidVersion && WeightVersion - Versions[Index] >= Policy.MaxAge;
+            if(Free == TableSize && (Keys[Index] == MIGINNQueryDedup::EmptyKey || bStale)) Free = Index;
+        }
+        if(Entry < TableSize && !MIGINNResultCache::NeedsRefresh(Key, Versions[Entry], ErrorBounds[Entry], WeightVersion, Frame, Policy)) {
+            std::copy(&Values[(size_t)Entry * NumOutputDimensions], &Values[(size_t)Entry * NumOutputDimensions] + NumOutputDimensions,
+                      Outputs + (size_t)Idx * NumOutputDimensions);
+            continue;
+        }
+        if(Entry == TableSize && Free < TableSize) {
+            Entry = Free;
+            Keys[Entry] = Key;
+            Versions[Entry] = MIGINNResultCache::InvalidVersion;
+        }
+        RefreshElements.push_back(Idx);
+        RefreshKeys.push_back(Key);
+        RefreshEntries.push_back(Entry);
+        RefreshInputs.insert(RefreshInputs.end(), Input, Input + NumInputDimensions);
+    }
+    Frame++;
+    return (uint32_t)RefreshElements.size();
+}
+
+void MIGINNResultCacheCPU::Store(const float *RefreshOutputs, float *Outputs) {
+    for(size_t i = 0; i < RefreshElements.size(); i++) {
+        const float * Result = RefreshOutputs + i * NumOutputDimensions;
+        std::copy(Result, Result + NumOutputDimensions, Outputs + (size_t)RefreshElements[i] * NumOutputDimensions);
+        const uint32_t Entry = RefreshEntries[i];
+        // The entry may have been replaced by a later query of the same batch.
+        if(Entry == TableSize || Keys[Entry] != RefreshKeys[i]) continue;
+        float * Cached = &Values[(size_t)Entry * NumOutputDimensions];
+        ErrorBounds[Entry] = Versions[Entry] == MIGINNResultCache::InvalidVersion
+                ? 0.f : MIGINNResultCache::ComputeErrorBound(Cached, Result, NumOutputDimensions);
+        Versions[Entry] = WeightVersion;
+        std::copy(Result, Result + NumOutputDimensions, Cached);
+    }
+}
+
+void MIGINNResultCacheCPU::AdvanceWeightVersion() {
+    WeightVersion++;
+    for(uint32_t Index = 0; Index < TableSize; Index++) {
+        if(MIGINNResultCache::IsExpired(Versions[Index], WeightVersion, Policy)) {
+            Keys[Index] = MIGINNQueryDedup::EmptyKey;
+            Versions[Index] = MIGINNResultCache::InvalidVersion;
+        }
+    }
+}
+
+uint32_t MIGINNResultCacheCPU::GetNumOccupiedEntries() const {
+    return (uint32_t)std::count_if(Keys.begin(), Keys.end(), [](uint64_t Key) { return Key != MIGINNQueryDedup::EmptyKey; });
+}
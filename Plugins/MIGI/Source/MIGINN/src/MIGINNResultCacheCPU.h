@@ -0,0 +1,47 @@
+/*
+ * Project MIGINN : MIGINNResultCacheCPU.h
+ * Created: 2024/03/19
+ * This program is unlicensed. See LICENSE for more.
+ */
+
+#ifndef MIGINN_MIGINNRESULTCACHECPU_H
+#define MIGINN_MIGINNRESULTCACHECPU_H
+
+#include <cstdint>
+#include <vector>
+#include "MIGINNResultCache.h"
+
+// Host implementation of the inference result cache, queries are expected to be deduplicated already.
+// Lookup serves what the cache may reuse and packs the rest, the caller evaluates those and hands them to Store.
+class MIGINNResultCacheCPU {
+public:
+    MIGINNResultCacheCPU (uint32_t Log2TableSize, uint32_t InNumOutputDimensions, float InQuantum, const MIGINNResultCache::FPolicy & InPolicy);
+
+    // Write the reused results to Outputs and pack the queries to evaluate into GetRefreshInputs(), returns their number.
+    uint32_t Lookup (const float * Inputs, uint32_t NumInputDimensions, uint32_t NumElements, float * Outputs);
+    // RefreshOutputs holds the results of the queries packed by the last Lookup. They are cached and written to Outputs.
+    void Store (const float * RefreshOutputs, float * Outputs);
+    // Call after every weight update, drops the entries not refreshed for a long time.
+    void AdvanceWeightVersion ();
+
+    [[nodiscard]] const std::vector<float> & GetRefreshInputs () const { return RefreshInputs; }
+    [[nodiscard]] uint32_t GetNumOccupiedEntries () const;
+protected:
+    MIGINNResultCache::FPolicy Policy {};
+    float Quantum {};
+    uint32_t NumOutputDimensions {};
+    uint32_t TableSize {};
+    uint32_t WeightVersion {};
+    uint32_t Frame {};
+    std::vector<uint64_t> Keys {};
+    std::vector<uint32_t> Versions {};
+    std::vector<float> ErrorBounds {};
+    std::vector<float> Values {};
+    // Per query packed by the last Lookup: its element, key and entry (TableSize when it is not cached).
+    std::vector<uint32_t> RefreshElements {};
+    std::vector<uint64_t> RefreshKeys {};
+    std::vector<uint32_t> RefreshEntries {};
+    std::vector<float> RefreshInputs {};
+};
+
+#endif //MIGINN_MIGINNRESULTCACHECPU_H
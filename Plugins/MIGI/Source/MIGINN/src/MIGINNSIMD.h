@@ -0,0 +1,18 @@
+/*
+ * Project MIGINN : MIGINNSIMD.h
+ * Created: 2024/03/07
+ * This program is unlicensed. See LICENSE for more.
+ */
+
+#ifndef MIGINN_MIGINNSIMD_H
+#define MIGINN_MIGINNSIMD_H
+
+// SSE2 is part of every x64 target. Host kernels fall back to scalar loops elsewhere.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIGINN_SSE2 1
+#else
+#define MIGINN_SSE2 0
+#endif
+
+#endif //MIGINN_MIGINNSIMD_H
@@ -0,0 +1,238 @@
+/*
+ * Project MIGINN : MIGINN_HashGrid.cu
+ * Created: 2024/03/02
+ * This program is unlicensed. See LICENSE for more.
+ */
+#include <cstddef>
+#include <vector>
+#include "MIGINN.h"
+#include "MIGINNCUDAHelper.cuh"
+#include "MIGINNInternal.cuh"
+#include "MIGINNHashGrid.h"
+
+constexpr uint32_t HashGridBlockSize = 128;
+
+// Find the entry of a key, inserting it when bInsert is set. Returns the table size if the probe sequence is full.
+__device__ uint32_t HashGridFind (uint32_t * Keys, uint32_t Slot, uint32_t Key, uint32_t TableMask, bool bInsert) {
+    for(uint32_t Probe = 0; Probe < MIGINNHashGrid::MaxProbes; Probe++) {
+        uint32_t Index = (Slot + Probe) & TableMask;
+        uint32_t Current = Keys[Index];
+        if(Current == MIGINNHashGrid::EmptyKey) {
+            if(!bInsert) break;
+            Current = atomicCAS(&Keys[Index], MIGINNHashGrid::EmptyKey, Key);
+            if(Current == MIGINNHashGrid::EmptyKey) return Index;
+        }
+        if(Current == Key) return Index;
+    }
+    return TableMask + 1;
+}
+
+// The probe sequence is full: take over its first entry not trained for MaxAge steps. The entry is claimed through its
+// stamp, so one trained again in the meantime is kept. Samples another thread adds for the old key go to the new one.
+__device__ uint32_t HashGridReplaceStale (
+        uint32_t * Keys, uint32_t * Stamps, float * Entries, uint32_t Slot, uint32_t Key, uint32_t TableMask,
+        uint32_t Step, uint32_t MaxAge) {
+    for(uint32_t Probe = 0; Probe < MIGINNHashGrid::MaxProbes; Probe++) {
+        uint32_t Index = (Slot + Probe) & TableMask;
+        uint32_t Stamp = Stamps[Index];
+        if(!MIGINNHashGrid::IsStale(Step, Stamp, MaxAge)) continue;
+        if(atomicCAS(&Stamps[Index], Stamp, Step) != Stamp) continue;
+        atomicExch(&Keys[Index], Key);
+        // Nothing seen yet: the first samples of the new cell replace the old value, see BlendEntry.
+        Entries[(size_t)Index * MIGINNHashGrid::EntryStride + MIGINN_HASH_GRID_MAX_OUTPUT_DIMENSIONS] = 0.f;
+        return Index;
+    }
+    return TableMask + 1;
+}
+
+// Scatter the training samples into the per entry accumulators.
+__global__ void HashGridAccumulate (
+        uint32_t NumElements, const float * Inputs, const float * Targets, MIGINNDetailsHashGrid Details,
+        uint32_t * Keys, uint32_t * Stamps, float * Entries, float * Accumulators, uint32_t Step) {
+    uint32_t Idx = threadIdx.x + blockIdx.x * blockDim.x;
+    if(Idx >= NumElements) return;
+    uint32_t Slot, Key;
+    MIGINNHashGrid::ComputeKey(Inputs + (size_t)Idx * Details.InNumInputDimensions, Details, Slot, Key);
+    uint32_t TableMask = (1u << Details.InLog2TableSize) - 1u;
+    uint32_t Index = HashGridFind(Keys, Slot, Key, TableMask, true);
+    if(Index > TableMask) Index = HashGridReplaceStale(Keys, Stamps, Entries, Slot, Key, TableMask, Step, Details.InMaxAge);
+    if(Index > TableMask) return;
+    Stamps[Index] = Step;
+    float * Accumulator = Accumulators + (size_t)Index * MIGINNHashGrid::EntryStride;
+    for(uint32_t i = 0; i < Details.InNumOutputDimensions; i++) {
+        atomicAdd(&Accumulator[i], Targets[(size_t)Idx * Details.InNumOutputDimensions + i]);
+    }
+    atomicAdd(&Accumulator[MIGINN_HASH_GRID_MAX_OUTPUT_DIMENSIONS], 1.f);
+}
+
+// Blend the accumulated samples into the cache and clear the accumulators for the next step.
+__global__ void HashGridResolve (uint32_t TableSize, MIGINNDetailsHashGrid Details, float * Entries, float * Accumulators) {
+    uint32_t Idx = threadIdx.x + blockIdx.x * blockDim.x;
+    if(Idx >= TableSize) return;
+    float * Accumulator = Accumulators + (size_t)Idx * MIGINNHashGrid::EntryStride;
+    float SampleCount = Accumulator[MIGINN_HASH_GRID_MAX_OUTPUT_DIMENSIONS];
+    if(SampleCount == 0.f) return;
+    MIGINNHashGrid::BlendEntry(Entries + (size_t)Idx * MIGINNHashGrid::EntryStride, Accumulator, SampleCount,
+                               Details.InNumOutputDimensions, Details.InBlendFactor);
+    for(uint32_t i = 0; i < MIGINNHashGrid::EntryStride; i++) Accumulator[i] = 0.f;
+}
+
+__global__ void HashGridQuery (
+        uint32_t NumElements, const float * Inputs, float * Outputs, MIGINNDetailsHashGrid Details,
+        uint32_t * Keys, const float * Entries) {
+    uint32_t Idx = threadIdx.x + blockIdx.x * blockDim.x;
+    if(Idx >= NumElements) return;
+    uint32_t Slot, Key;
+    MIGINNHashGrid::ComputeKey(Inputs + (size_t)Idx * Details.InNumInputDimensions, Details, Slot, Key);
+    uint32_t TableMask = (1u << Details.InLog2TableSize) - 1u;
+    uint32_t Index = HashGridFind(Keys, Slot, Key, TableMask, false);
+    float * Output = Outputs + (size_t)Idx * Details.InNumOutputDimensions;
+    for(uint32_t i = 0; i < Details.InNumOutputDimensions; i++) {
+        Output[i] = Index > TableMask ? 0.f : Entries[(size_t)Index * MIGINNHashGrid::EntryStride + i];
+    }
+}
+
+
+class MIGINNHashGridCacheNetworkImpl {
+public:
+    MIGINNHashGridCacheNetworkImpl () = default;
+    ~MIGINNHashGridCacheNetworkImpl () {
+        // Nothing useful can be done about failures here.
+        try {
+            Release();
+        } catch(std::runtime_error & e) {}
+    }
+
+    MIGINNResultType Initialize (const MIGINNNetworkConfig &Params) {
+        Details = Params.Details.HashGrid;
+        if(Details.InNumOutputDimensions == 0 || Details.InNumOutputDimensions > MIGINN_HASH_GRID_MAX_OUTPUT_DIMENSIONS
+            || Details.InLog2TableSize == 0 || Details.InLog2TableSize > 30 || !(Details.InCellSize > 0.f)) {
+            return MIGINNResultType::eError;
+        }
+        TableSize = 1u << Details.InLog2TableSize;
+        try {
+            Allocate();
+            checkCUDA(cudaMemsetAsync(Keys, 0, TableSize * sizeof(uint32_t), GCUDAStream));
+            checkCUDA(cudaMemsetAsync(Stamps, 0, TableSize * sizeof(uint32_t), GCUDAStream));
+            checkCUDA(cudaMemsetAsync(Entries, 0, GetEntriesSize(), GCUDAStream));
+        } catch(std::runtime_error & e) {
+            return MIGINNResultType::eCUDAError;
+        }
+        return MIGINNResultType::eSuccess;
+    }
+
+    [[nodiscard]] MIGINNResultType Inference (const MIGINNInferenceParams & Params) const {
+        if(Params.InNumElements == 0) return MIGINNResultType::eSuccess;
+        HashGridQuery<<<(Params.InNumElements + HashGridBlockSize - 1) / HashGridBlockSize, HashGridBlockSize, 0, GCUDAStream>>>(
+                Params.InNumElements,
+                (const float*)((std::byte*)GInputBufferAddress + Params.InInputBufferOffset),
+                (float*)((std::byte*)GOutputBufferAddress + Params.InOutputBufferOffset),
+                Details, Keys, Entries
+        );
+        return cudaGetLastError() == cudaSuccess ? MIGINNResultType::eSuccess : MIGINNResultType::eCUDAError;
+    }
+
+    MIGINNResultType Train (const MIGINNTrainNetworkParams & Params) {
+        if(Params.InNumElements == 0) return MIGINNResultType::eSuccess;
+        HashGridAccumulate<<<(Params.InNumElements + HashGridBlockSize - 1) / HashGridBlockSize, HashGridBlockSize, 0, GCUDAStream>>>(
+                Params.InNumElements,
+                (const float*)((std::byte*)GInputBufferAddress + Params.InInputBufferOffset),
+                (const float*)((std::byte*)GInputBufferAddress + Params.InInputBufferTargetOffset),
+                Details, Keys, Stamps, Entries, Accumulators, Step
+        );
+        HashGridResolve<<<(TableSize + HashGridBlockSize - 1) / HashGridBlockSize, HashGridBlockSize, 0, GCUDAStream>>>(
+                TableSize, Details, Entries, Accumulators
+        );
+        Step++;
+        return cudaGetLastError() == cudaSuccess ? MIGINNResultType::eSuccess : MIGINNResultType::eCUDAError;
+    }
+
+    MIGINNResultType Suspend () {
+        // The accumulators are always clear between training steps, only the keys, stamps and entries are kept.
+        try {
+            HostKeys.resize(TableSize);
+            HostStamps.resize(TableSize);
+            HostEntries.resize((size_t)TableSize * MIGINNHashGrid::EntryStride);
+            checkCUDA(cudaMemcpyAsync(HostKeys.data(), Keys, TableSize * sizeof(uint32_t), cudaMemcpyDeviceToHost, GCUDAStream));
+            checkCUDA(cudaMemcpyAsync(HostStamps.data(), Stamps, TableSize * sizeof(uint32_t), cudaMemcpyDeviceToHost, GCUDAStream));
+            checkCUDA(cudaMemcpyAsync(HostEntries.data(), Entries, GetEntriesSize(), cudaMemcpyDeviceToHost, GCUDAStream));
+            checkCUDA(cudaStreamSynchronize(GCUDAStream));
+            Release();
+        } catch(std::runtime_error & e) {
+            return MIGINNResultType::eCUDAError;
+        }
+        return MIGINNResultType::eSuccess;
+    }
+
+    MIGINNResultType Resume () {
+        try {
+            Allocate();
+            checkCUDA(cudaMemcpyAsync(Keys, HostKeys.data(), TableSize * sizeof(uint32_t), cudaMemcpyHostToDevice, GCUDAStream));
+            checkCUDA(cudaMemcpyAsync(Stamps, HostStamps.data(), TableSize * sizeof(uint32_t), cudaMemcpyHostToDevice, GCUDAStream));
+            checkCUDA(cudaMemcpyAsync(Entries, HostEntries.data(), GetEntriesSize(), cudaMemcpyHostToDevice, GCUDAStream));
+            // Pageable host copies are staged, but wait anyway before dropping the host memory.
+            checkCUDA(cudaStreamSynchronize(GCUDAStream));
+        } catch(std::runtime_error & e) {
+            return MIGINNResultType::eCUDAError;
+        }
+        HostKeys = {};
+        HostStamps = {};
+        HostEntries = {};
+        return MIGINNResultType::eSuccess;
+    }
+
+protected:
+    [[nodiscard]] size_t GetEntriesSize () const {
+        return (size_t)TableSize * MIGINNHashGrid::EntryStride * sizeof(float);
+    }
+
+    // Throws on CUDA errors.
+    void Allocate () {
+        checkCUDA(cudaMalloc(&Keys, TableSize * sizeof(uint32_t)));
+        checkCUDA(cudaMalloc(&Stamps, TableSize * sizeof(uint32_t)));
+        checkCUDA(cudaMalloc(&Entries, GetEntriesSize()));
+        checkCUDA(cudaMalloc(&Accumulators, GetEntriesSize()));
+        checkCUDA(cudaMemsetAsync(Accumulators, 0, GetEntriesSize(), GCUDAStream));
+    }
+    void Release () {
+        if(Keys) checkCUDA(cudaFree(Keys));
+        Keys = nullptr;
+        if(Stamps) checkCUDA(cudaFree(Stamps));
+        Stamps = nullptr;
+        if(Entries) checkCUDA(cudaFree(Entries));
+        Entries = nullptr;
+        if(Accumulators) checkCUDA(cudaFree(Accumulators));
+        Accumulators = nullptr;
+    }
+
+    MIGINNDetailsHashGrid Details {};
+    uint32_t TableSize {};
+    // Incremented by every training step.
+    uint32_t Step {};
+    uint32_t * Keys {};
+    // Training step each entry was last trained on.
+    uint32_t * Stamps {};
+    float * Entries {};
+    float * Accumulators {};
+    // Host copies of the table while suspended.
+    std::vector<uint32_t> HostKeys {};
+    std::vector<uint32_t> HostStamps {};
+    std::vector<float> HostEntries {};
+};
+
+// Make sure the unique_ptr is compilable.
+MIGINNHashGridCacheNetwork::MIGINNHashGridCacheNetwork() {}
+MIGINNHashGridCacheNetwork::~MIGINNHashGridCacheNetwork() = default;
+
+MIGINNResultType MIGINNHashGridCacheNetwork::Inference(const MIGINNInferenceParams &Params) const {return Impl->Inference(Params);}
+MIGINNResultType MIGINNHashGridCacheNetwork::Train(const MIGINNTrainNetworkParams &Params) {return Impl->Train(Params);}
+MIGINNResultType MIGINNHashGridCacheNetwork::Suspend() {return Impl->Suspend();}
+MIGINNResultType MIGINNHashGridCacheNetwork::Resume() {return Impl->Resume();}
+
+
+std::unique_ptr<MIGINNCacheNetwork> MIGINNHashGridCacheNetwork::Create (const MIGINNNetworkConfig &Params) {
+    auto Network = std::make_unique<MIGINNHashGridCacheNetwork>();
+    Network->Impl = std::make_unique<MIGINNHashGridCacheNetworkImpl>();
+    if(Network->Impl->Initialize(Params) != MIGINNResultType::eSuccess) return nullptr;
+    return Network;
+}
@@ -4,7 +4,11 @@
  * This program is unlicensed. See LICENSE for more.
  */
 #include "MIGINN.h"
+#include "MIGINNCUDAHelper.cuh"
 #include "MIGINNInternal.cuh"
+#include "MIGINNQuantizedMLPCPU.h"
+#include "MIGINNQueryDedup.cuh"
+#include "MIGINNResultCache.cuh"
 
 #include "tiny-cuda-nn/network_with_input_encoding.h"
 #include "tiny-cuda-nn/loss.h"
@@ -19,11 +23,88 @@ __global__ void identity (const float * In, float * Out) {
     Out[Idx] = (sin(In[Idx]*12.f) + 1.f) / 2.f;
 }
 
+constexpr uint32_t QuantizedMaxLayers = 16;
+constexpr uint32_t QuantizedMaxWidth = 128;
+constexpr uint32_t QuantizedBlockSize = 128;
+// Inputs encoded for calibration at most.
+constexpr uint32_t QuantizationCalibrationSize = 1024;
+
+struct FQuantizedLayerDevice {
+    uint32_t NumInputs;
+    uint32_t NumOutputs;
+    // In bytes into the weights buffer.
+    uint32_t WeightOffset;
+    // In floats into the weight scales buffer.
+    uint32_t ScaleOffset;
+    float InputScale;
+    uint32_t bReLU;
+};
+// Passed by value as a kernel parameter.
+struct FQuantizedNetworkDevice {
+    FQuantizedLayerDevice Layers[QuantizedMaxLayers];
+    uint32_t NumLayers;
+    uint32_t NumInputDimensions;
+    uint32_t NumOutputDimensions;
+};
+
+__device__ inline int32_t QuantizeActivation (float Value, float InvScale) {
+    return max(-127, min(127, __float2int_rn(Value * InvScale)));
+}
+
+// One thread per element, activations stay packed four per register and are multiplied with __dp4a.
+// The block stages the weights of one layer at a time in shared memory.
+template <typename T>
+__global__ void QuantizedMLPInference (
+        uint32_t NumElements, const T * EncodedInputs, uint32_t EncodedStride, float * Outputs,
+        FQuantizedNetworkDevice Network, const int8_t * Weights, const float * WeightScales) {
+    extern __shared__ int32_t SharedWeights[];
+    const uint32_t Idx = threadIdx.x + blockIdx.x * blockDim.x;
+    // Every thread has to take part in staging the weights.
+    const bool bValid = Idx < NumElements;
+    int32_t Packed[QuantizedMaxWidth / 4] = {};
+    int32_t NextPacked[QuantizedMaxWidth / 4];
+
+    if(bValid) {
+        const float InvScale = 1.f / Network.Layers[0].InputScale;
+        for(uint32_t i = 0; i < Network.NumInputDimensions; i++) {
+            int32_t Quantized = QuantizeActivation((float)EncodedInputs[(size_t)Idx * EncodedStride + i], InvScale);
+            Packed[i / 4] |= (Quantized & 0xFF) << (8 * (i % 4));
+        }
+    }
+    for(uint32_t l = 0; l < Network.NumLayers; l++) {
+        const FQuantizedLayerDevice & Layer = Network.Layers[l];
+        const uint32_t NumWords = Layer.NumInputs / 4;
+        __syncthreads();
+        for(uint32_t i = threadIdx.x; i < Layer.NumOutputs * NumWords; i += blockDim.x) {
+            SharedWeights[i] = ((const int32_t*)(Weights + Layer.WeightOffset))[i];
+        }
+        __syncthreads();
+        if(!bValid) continue;
+        const bool bLastLayer = l + 1 == Network.NumLayers;
+        const float NextInvScale = bLastLayer ? 0.f : 1.f / Network.Layers[l + 1].InputScale;
+        for(uint32_t i = 0; i < QuantizedMaxWidth / 4; i++) NextPacked[i] = 0;
+        for(uint32_t o = 0; o < Layer.NumOutputs; o++) {
+            int32_t Sum = 0;
+            for(uint32_t k = 0; k < NumWords; k++) Sum = __dp4a(Packed[k], SharedWeights[o * NumWords + k], Sum);
+            float Value = (float)Sum * Layer.InputScale * WeightScales[Layer.ScaleOffset + o];
+            if(Layer.bReLU) Value = fmaxf(Value, 0.f);
+            if(bLastLayer) {
+                if(o < Network.NumOutputDimensions) Outputs[(size_t)Idx * Network.NumOutputDimensions + o] = Value;
+            } else {
+                NextPacked[o / 4] |= (QuantizeActivation(Value, NextInvScale) & 0xFF) << (8 * (o % 4));
+            }
+        }
+        for(uint32_t i = 0; i < QuantizedMaxWidth / 4; i++) Packed[i] = NextPacked[i];
+    }
+}
+
 
 class MIGINNMLPCacheNetworkImpl {
 public:
     MIGINNMLPCacheNetworkImpl () = default;
     MIGINNResultType Initialize (const MIGINNNetworkConfig &Params) {
+        // Kept for re-creating the network on resume.
+        Config = Params;
         try {
             auto MLP = Params.Details.MLP;
             auto ExtraOptions = nlohmann::json::parse(MLP.InExtraOptionsJson);
@@ -36,12 +117,47 @@ public:
             Network = std::make_shared<NetworkClass>(MLP.InNumInputDimensions, MLP.InNumOutputDimensions, EncodingOptions,
                                                      NetworkOptions);
             Trainer = std::make_shared<decltype(Trainer)::element_type>(Network, Optimizer, Loss);
+            // A "student" section distills the network into a smaller one that serves the inference.
+            // It has its own copy of the encoding, so trainable encodings are distilled too.
+            auto ServingNetworkOptions = NetworkOptions;
+            if(ExtraOptions.contains("student")) {
+                auto StudentOptions = ExtraOptions["student"];
+                ServingNetworkOptions = StudentOptions["network"];
+                StudentLoss.reset(tcnn::create_loss<PrecisionClass>(StudentOptions.value("loss", nlohmann::json{{"otype", "L2"}})));
+                StudentOptimizer.reset(tcnn::create_optimizer<PrecisionClass>(StudentOptions.value("optimizer", OptimizerOptions)));
+                StudentNetwork = std::make_shared<NetworkClass>(MLP.InNumInputDimensions, MLP.InNumOutputDimensions, EncodingOptions,
+                                                                ServingNetworkOptions);
+                StudentTrainer = std::make_shared<decltype(StudentTrainer)::element_type>(StudentNetwork, StudentOptimizer, StudentLoss);
+            }
+            // The quantized path re-implements the fully fused ReLU MLP, nothing else.
+            // Every layer, the first one included, must fit the packed activations and the shared weights of the kernel,
+            // so the encoded inputs can't be wider than the hidden layers (e.g. a 12 frequency encoding of 8 dims is 192).
+            NetworkWidth = ServingNetworkOptions.value("n_neurons", 128u);
+            NumHiddenLayers = ServingNetworkOptions.value("n_hidden_layers", 5u);
+            bQuantizedInference = MLP.InQuantizedInference
+                && ServingNetworkOptions.value("otype", std::string{}) == "FullyFusedMLP"
+                && ServingNetworkOptions.value("activation", std::string{"ReLU"}) == "ReLU"
+                && ServingNetworkOptions.value("output_activation", std::string{"None"}) == "None"
+                && NetworkWidth <= QuantizedMaxWidth && NumHiddenLayers + 1 <= QuantizedMaxLayers
+                && GetServingNetwork()->encoding()->padded_output_width() <= QuantizedMaxWidth;
+            QuantizationRefreshInterval = std::max(MLP.InQuantizationRefreshInterval, 1u);
+            DeduplicationQuantum = MLP.InDeduplicationQuantum;
+            ResultCache.Configure(DeduplicationQuantum > 0.f ? MLP.InLog2ResultCacheSize : 0, MLP.InNumOutputDimensions, DeduplicationQuantum,
+                                  {MLP.InResultCacheMaxAge, MLP.InResultCacheTolerance, MLP.InResultCacheMinRefreshProbability});
+            NumTrainSteps = 0;
         } catch(std::runtime_error & e) {
             return MIGINNResultType::eInternalError;
         }
         return MIGINNResultType::eSuccess;
     }
 
+    ~MIGINNMLPCacheNetworkImpl () {
+        // Nothing useful can be done about failures here.
+        try {
+            ReleaseQuantizedNetwork();
+        } catch(std::runtime_error & e) {}
+    }
+
     [[nodiscard]] MIGINNResultType Inference (const MIGINNInferenceParams & Params) const {
         using namespace tcnn;
         // Retarget inputs & outputs to the shared input & output buffer
@@ -53,10 +169,10 @@ public:
                 (float*)((std::byte*)GOutputBufferAddress + Params.InOutputBufferOffset),
                 Network->output_width(), Params.InNumElements
         );
-        Network->inference(GCUDAStream, InputMatrix, OutputMatrix);
+        if(DeduplicationQuantum > 0.f) return DeduplicatedInference(InputMatrix, OutputMatrix);
+        return InferenceOn(InputMatrix, OutputMatrix);
 //        auto ncopyelement = Network->input_width() * Params.InNumElements;
 //        identity<<<ncopyelement / 32, 32, 0, GCUDAStream>>>(InputMatrix.data(), OutputMatrix.data());
-        return MIGINNResultType::eSuccess;
     }
 
     MIGINNResultType Train (const MIGINNTrainNetworkParams & Params) {
@@ -70,18 +186,263 @@ public:
                 (float*)((std::byte*)GInputBufferAddress + Params.InInputBufferTargetOffset),
                 Network->output_width(), Params.InNumElements
         );
-        auto TrainContext = Trainer->training_step(InputMatrix, TargetMatrix);
+        try {
+            Trainer->training_step(InputMatrix, TargetMatrix);
+            if(StudentTrainer) {
+                // Distill on the same inputs: the student learns the teacher's prediction, not the noisy sample.
+                if(DistillationTargets.n() < Params.InNumElements) {
+                    DistillationTargets = GPUMatrix<float>(Network->output_width(), Params.InNumElements, GCUDAStream);
+                }
+                auto TeacherOutputs = DistillationTargets.slice_cols(0, Params.InNumElements);
+                Network->inference(GCUDAStream, InputMatrix, TeacherOutputs);
+                StudentTrainer->training_step(InputMatrix, TeacherOutputs);
+            }
+        } catch(std::runtime_error & e) {
+            return MIGINNResultType::eCUDAError;
+        }
+        if(ResultCache.IsEnabled()) {
+            try {
+                ResultCache.AdvanceWeightVersion();
+            } catch(std::runtime_error & e) {
+                return MIGINNResultType::eCUDAError;
+            }
+        }
+        if(bQuantizedInference && NumTrainSteps++ % QuantizationRefreshInterval == 0) {
+            return RefreshQuantizedNetwork(InputMatrix);
+        }
+        return MIGINNResultType::eSuccess;
+    }
+
+    MIGINNResultType Suspend () {
+        try {
+            // Spill the weights and the optimizer state to host memory.
+            Snapshot = {{"teacher", Trainer->serialize(true)}};
+            if(StudentTrainer) Snapshot["student"] = StudentTrainer->serialize(true);
+        } catch(std::runtime_error & e) {
+            return MIGINNResultType::eInternalError;
+        }
+        // Release the device memory held by the network, then give the arenas back to the driver.
+        try {
+            ReleaseQuantizedNetwork();
+        } catch(std::runtime_error & e) {
+            return MIGINNResultType::eCUDAError;
+        }
+        try {
+            Deduplicator.Release();
+            // Cached results are cheap to rebuild, they are not kept across a suspension.
+            ResultCache.Release();
+        } catch(std::runtime_error & e) {
+            return MIGINNResultType::eCUDAError;
+        }
+        EncodedScratch = {};
+        DistillationTargets = {};
+        StudentTrainer.reset();
+        StudentNetwork.reset();
+        StudentOptimizer.reset();
+        StudentLoss.reset();
+        Trainer.reset();
+        Network.reset();
+        Optimizer.reset();
+        Loss.reset();
+        tcnn::free_all_gpu_memory_arenas();
+        return MIGINNResultType::eSuccess;
+    }
+
+    MIGINNResultType Resume () {
+        auto Result = Initialize(Config);
+        if(Result != MIGINNResultType::eSuccess) return Result;
+        try {
+            Trainer->deserialize(Snapshot["teacher"]);
+            if(StudentTrainer) StudentTrainer->deserialize(Snapshot["student"]);
+        } catch(std::runtime_error & e) {
+            return MIGINNResultType::eInternalError;
+        }
+        Snapshot = {};
         return MIGINNResultType::eSuccess;
     }
 
 
 protected:
+    // The student when distilling, the trained network otherwise.
+    [[nodiscard]] const std::shared_ptr<NetworkClass> & GetServingNetwork () const {
+        return StudentNetwork ? StudentNetwork : Network;
+    }
+
+    MIGINNResultType InferenceOn (const tcnn::GPUMatrix<float> & InputMatrix, tcnn::GPUMatrix<float> & OutputMatrix) const {
+        if(QuantizedNetwork.NumLayers) return QuantizedInference(InputMatrix, OutputMatrix.data(), InputMatrix.n());
+        GetServingNetwork()->inference(GCUDAStream, InputMatrix, OutputMatrix);
+        return MIGINNResultType::eSuccess;
+    }
+
+    // Run the network once per distinct quantized query, then copy the results to every query.
+    MIGINNResultType DeduplicatedInference (const tcnn::GPUMatrix<float> & InputMatrix, tcnn::GPUMatrix<float> & OutputMatrix) const {
+        using namespace tcnn;
+        try {
+            const uint32_t NumUniqueElements = Deduplicator.Deduplicate(InputMatrix.data(), InputMatrix.m(), InputMatrix.n(),
+                                                                        DeduplicationQuantum, BATCH_SIZE_GRANULARITY);
+            if(NumUniqueElements == 0) return MIGINNResultType::eSuccess;
+            // The networks run on whole batches of BATCH_SIZE_GRANULARITY, the padding is evaluated and dropped.
+            const uint32_t NumPadded = next_multiple(NumUniqueElements, BATCH_SIZE_GRANULARITY);
+            GPUMatrix<float> UniqueInputs((float*)Deduplicator.GetUniqueInputs(), InputMatrix.m(), NumPadded);
+            GPUMatrix<float> UniqueOutputs(Deduplicator.GetUniqueOutputs(OutputMatrix.m()), OutputMatrix.m(), NumPadded);
+            if(ResultCache.IsEnabled()) {
+                // Only the unique queries the result cache can not reuse are evaluated.
+                const uint32_t NumRefresh = ResultCache.Lookup(UniqueInputs.data(), InputMatrix.m(), NumUniqueElements, UniqueOutputs.data(),
+                                                               BATCH_SIZE_GRANULARITY);
+                if(NumRefresh) {
+                    const uint32_t NumRefreshPadded = next_multiple(NumRefresh, BATCH_SIZE_GRANULARITY);
+                    GPUMatrix<float> RefreshInputs((float*)ResultCache.GetRefreshInputs(), InputMatrix.m(), NumRefreshPadded);
+                    GPUMatrix<float> RefreshOutputs(ResultCache.GetRefreshOutputs(), OutputMatrix.m(), NumRefreshPadded);
+                    auto Result = InferenceOn(RefreshInputs, RefreshOutputs);
+                    if(Result != MIGINNResultType::eSuccess) return Result;
+                    ResultCache.Store(UniqueOutputs.data());
+                }
+            } else {
+                auto Result = InferenceOn(UniqueInputs, UniqueOutputs);
+                if(Result != MIGINNResultType::eSuccess) return Result;
+            }
+            Deduplicator.Scatter(UniqueOutputs.data(), OutputMatrix.m(), OutputMatrix.data());
+        } catch(std::runtime_error & e) {
+            return MIGINNResultType::eCUDAError;
+        }
+        return MIGINNResultType::eSuccess;
+    }
+
+    // Encode the inputs with the float encoding, then run the INT8 layers.
+    MIGINNResultType QuantizedInference (const tcnn::GPUMatrix<float> & InputMatrix, float * Outputs, uint32_t NumElements) const {
+        using namespace tcnn;
+        const auto & ServingNetwork = GetServingNetwork();
+        try {
+            const uint32_t EncodedWidth = ServingNetwork->encoding()->padded_output_width();
+            if(EncodedScratch.n() < NumElements) EncodedScratch = GPUMatrix<PrecisionClass>(EncodedWidth, NumElements, GCUDAStream);
+            auto Encoded = EncodedScratch.slice_cols(0, NumElements);
+            ServingNetwork->encoding()->inference_mixed_precision(GCUDAStream, InputMatrix, Encoded);
+            // The largest layer: QuantizedMaxWidth inputs (checked on initialization) by QuantizedMaxWidth outputs, one byte each.
+            const uint32_t SharedMemorySize = QuantizedMaxWidth * QuantizedMaxWidth;
+            QuantizedMLPInference<<<(NumElements + QuantizedBlockSize - 1) / QuantizedBlockSize, QuantizedBlockSize, SharedMemorySize, GCUDAStream>>>(
+                    NumElements, Encoded.data(), EncodedWidth, Outputs, QuantizedNetwork, QuantizedWeights, QuantizedWeightScales
+            );
+            checkCUDA(cudaGetLastError());
+        } catch(std::runtime_error & e) {
+            return MIGINNResultType::eCUDAError;
+        }
+        return MIGINNResultType::eSuccess;
+    }
+
+    // Quantize the current training weights, calibrated on the encoded inputs of this training step.
+    MIGINNResultType RefreshQuantizedNetwork (const tcnn::GPUMatrix<float> & InputMatrix) {
+        using namespace tcnn;
+        const auto & ServingNetwork = GetServingNetwork();
+        // Encodings work on batches of BATCH_SIZE_GRANULARITY.
+        const uint32_t NumCalibration = std::min(InputMatrix.n(), QuantizationCalibrationSize) / BATCH_SIZE_GRANULARITY * BATCH_SIZE_GRANULARITY;
+        if(NumCalibration == 0) return MIGINNResultType::eSuccess;
+        try {
+            // The layers of the fully fused MLP: row-major and without biases, the output padded to 16.
+            const uint32_t EncodedWidth = ServingNetwork->encoding()->padded_output_width();
+            const uint32_t PaddedOutputWidth = next_multiple(ServingNetwork->output_width(), 16u);
+            std::vector<MIGINNFloatLayer> Layers;
+            Layers.push_back({EncodedWidth, NetworkWidth, {}, true});
+            for(uint32_t i = 1; i < NumHiddenLayers; i++) Layers.push_back({NetworkWidth, NetworkWidth, {}, true});
+            Layers.push_back({NetworkWidth, PaddedOutputWidth, {}, false});
+
+            // The MLP parameters come first, the encoding parameters follow.
+            size_t NumParams = 0;
+            for(const auto & Layer : Layers) NumParams += (size_t)Layer.NumInputs * Layer.NumOutputs;
+            std::vector<PrecisionClass> Params(NumParams);
+            checkCUDA(cudaMemcpyAsync(Params.data(), ServingNetwork->inference_params(), NumParams * sizeof(PrecisionClass), cudaMemcpyDeviceToHost, GCUDAStream));
+
+            GPUMatrix<PrecisionClass> Encoded(EncodedWidth, NumCalibration, GCUDAStream);
+            ServingNetwork->encoding()->inference_mixed_precision(GCUDAStream, InputMatrix.slice_cols(0, NumCalibration), Encoded);
+            std::vector<PrecisionClass> EncodedHost((size_t)EncodedWidth * NumCalibration);
+            checkCUDA(cudaMemcpyAsync(EncodedHost.data(), Encoded.data(), EncodedHost.size() * sizeof(PrecisionClass), cudaMemcpyDeviceToHost, GCUDAStream));
+            checkCUDA(cudaStreamSynchronize(GCUDAStream));
+
+            size_t Offset = 0;
+            for(auto & Layer : Layers) {
+                Layer.Weights.resize((size_t)Layer.NumInputs * Layer.NumOutputs);
+                for(auto & Weight : Layer.Weights) Weight = (float)Params[Offset++];
+            }
+            std::vector<float> Calibration(EncodedHost.size());
+            for(size_t i = 0; i < EncodedHost.size(); i++) Calibration[i] = (float)EncodedHost[i];
+            Quantizer.Quantize(Layers, Calibration.data(), NumCalibration);
+            UploadQuantizedNetwork(EncodedWidth);
+        } catch(std::exception & e) {
+            return MIGINNResultType::eInternalError;
+        }
+        return MIGINNResultType::eSuccess;
+    }
+
+    // Throws on CUDA errors.
+    void UploadQuantizedNetwork (uint32_t EncodedWidth) {
+        std::vector<int8_t> Weights;
+        std::vector<float> WeightScales;
+        FQuantizedNetworkDevice Description {};
+        for(const auto & Layer : Quantizer.GetLayers()) {
+            auto & LayerDescription = Description.Layers[Description.NumLayers++];
+            LayerDescription.NumInputs = Layer.NumInputs;
+            LayerDescription.NumOutputs = Layer.NumOutputs;
+            LayerDescription.WeightOffset = (uint32_t)Weights.size();
+            LayerDescription.ScaleOffset = (uint32_t)WeightScales.size();
+            LayerDescription.InputScale = Layer.InputScale;
+            LayerDescription.bReLU = Layer.bReLU;
+            Weights.insert(Weights.end(), Layer.Weights.begin(), Layer.Weights.end());
+            WeightScales.insert(WeightScales.end(), Layer.WeightScales.begin(), Layer.WeightScales.end());
+        }
+        Description.NumInputDimensions = EncodedWidth;
+        Description.NumOutputDimensions = GetServingNetwork()->output_width();
+        // Sizes only change with the configuration, so this allocates once.
+        if(!QuantizedWeights) {
+            checkCUDA(cudaMalloc(&QuantizedWeights, Weights.size()));
+            checkCUDA(cudaMalloc(&QuantizedWeightScales, WeightScales.size() * sizeof(float)));
+        }
+        checkCUDA(cudaMemcpyAsync(QuantizedWeights, Weights.data(), Weights.size(), cudaMemcpyHostToDevice, GCUDAStream));
+        checkCUDA(cudaMemcpyAsync(QuantizedWeightScales, WeightScales.data(), WeightScales.size() * sizeof(float), cudaMemcpyHostToDevice, GCUDAStream));
+        checkCUDA(cudaStreamSynchronize(GCUDAStream));
+        QuantizedNetwork = Description;
+    }
+
+    void ReleaseQuantizedNetwork () {
+        QuantizedNetwork.NumLayers = 0;
+        NumTrainSteps = 0;
+        if(QuantizedWeights) checkCUDA(cudaFree(QuantizedWeights));
+        QuantizedWeights = nullptr;
+        if(QuantizedWeightScales) checkCUDA(cudaFree(QuantizedWeightScales));
+        QuantizedWeightScales = nullptr;
+    }
+
     typedef tcnn::network_precision_t PrecisionClass;
     typedef tcnn::NetworkWithInputEncoding<tcnn::network_precision_t> NetworkClass;
     std::shared_ptr<NetworkClass> Network;
     std::shared_ptr<tcnn::Loss<PrecisionClass> > Loss;
     std::shared_ptr<tcnn::Optimizer<PrecisionClass> > Optimizer;
     std::shared_ptr<tcnn::Trainer<float, PrecisionClass, PrecisionClass> > Trainer;
+    // Distillation.
+    std::shared_ptr<NetworkClass> StudentNetwork;
+    std::shared_ptr<tcnn::Loss<PrecisionClass> > StudentLoss;
+    std::shared_ptr<tcnn::Optimizer<PrecisionClass> > StudentOptimizer;
+    std::shared_ptr<tcnn::Trainer<float, PrecisionClass, PrecisionClass> > StudentTrainer;
+    tcnn::GPUMatrix<float> DistillationTargets {};
+    MIGINNNetworkConfig Config {};
+    // Host copy of the trainer state while suspended.
+    nlohmann::json Snapshot {};
+
+    // INT8 inference.
+    bool bQuantizedInference {};
+    uint32_t NetworkWidth {};
+    uint32_t NumHiddenLayers {};
+    uint32_t QuantizationRefreshInterval {};
+    uint32_t NumTrainSteps {};
+    MIGINNQuantizedMLPCPU Quantizer {};
+    // No layers until the first refresh, inference stays in float until then.
+    FQuantizedNetworkDevice QuantizedNetwork {};
+    int8_t * QuantizedWeights {};
+    float * QuantizedWeightScales {};
+    mutable tcnn::GPUMatrix<PrecisionClass> EncodedScratch {};
+
+    // Query deduplication, disabled at zero.
+    float DeduplicationQuantum {};
+    mutable MIGINNQueryDeduplicator Deduplicator {};
+    mutable MIGINNInferenceResultCache ResultCache {};
 };
 
 // Make sure the unique_ptr is compilable.
@@ -90,6 +451,8 @@ MIGINNMLPCacheNetwork::~MIGINNMLPCacheNetwork() = default;
 
 MIGINNResultType MIGINNMLPCacheNetwork::Inference(const MIGINNInferenceParams &Params) const {return Impl->Inference(Params);}
 MIGINNResultType MIGINNMLPCacheNetwork::Train(const MIGINNTrainNetworkParams &Params) {return Impl->Train(Params);}
+MIGINNResultType MIGINNMLPCacheNetwork::Suspend() {return Impl->Suspend();}
+MIGINNResultType MIGINNMLPCacheNetwork::Resume() {return Impl->Resume();}
 
 
 std::unique_ptr<MIGINNCacheNetwork> MIGINNMLPCacheNetwork::Create (const MIGINNNetworkConfig &Params) {
@@ -0,0 +1,150 @@
+/*
+ * Project MIGINN : MIGINN_QueryDedup.cu
+ * Created: 2024/03/17
+ * This program is unlicensed. See LICENSE for more.
+ */
+#include <algorithm>
+#include <cstddef>
+#include "MIGINN.h"
+#include "MIGINNCUDAHelper.cuh"
+#include "MIGINNInternal.cuh"
+#include "MIGINNQueryDedup.h"
+#include "MIGINNQueryDedup.cuh"
+
+constexpr uint32_t QueryDedupBlockSize = 128;
+
+// Insert the key of every element. The element that creates an entry owns it.
+__global__ void QueryDedupInsert (
+        uint32_t NumElements, const float * Inputs, uint32_t NumInputDimensions, float InvQuantum, uint32_t TableSize,
+        unsigned long long * Keys, uint32_t * Owners, uint32_t * ElementEntries) {
+    uint32_t Idx = threadIdx.x + blockIdx.x * blockDim.x;
+    if(Idx >= NumElements) return;
+    const uint64_t Key = MIGINNQueryDedup::ComputeKey(Inputs + (size_t)Idx * NumInputDimensions, NumInputDimensions, InvQuantum);
+    // Queries that find no room get an entry of their own past the table.
+    uint32_t Entry = TableSize + Idx;
+    for(uint32_t Probe = 0; Probe < MIGINNQueryDedup::MaxProbes; Probe++) {
+        uint32_t Index = ((uint32_t)Key + Probe) & (TableSize - 1);
+        unsigned long long Current = atomicCAS(&Keys[Index], MIGINNQueryDedup::EmptyKey, Key);
+        if(Current == MIGINNQueryDedup::EmptyKey) {
+            Owners[Index] = Idx;
+            Entry = Index;
+            break;
+        }
+        if(Current == Key) {
+            Entry = Index;
+            break;
+        }
+    }
+    ElementEntries[Idx] = Entry;
+}
+
+// Give every owned entry a unique query index and pack its input.
+__global__ void QueryDedupCompact (
+        uint32_t NumElements, const float * Inputs, uint32_t NumInputDimensions, uint32_t TableSize,
+        const uint32_t * Owners, const uint32_t * ElementEntries, uint32_t * Slots, uint32_t * Counter, float * UniqueInputs) {
+    uint32_t Idx = threadIdx.x + blockIdx.x * blockDim.x;
+    if(Idx >= NumElements) return;
+    const uint32_t Entry = ElementEntries[Idx];
+    if(Entry < TableSize && Owners[Entry] != Idx) return;
+    const uint32_t Slot = atomicAdd(Counter, 1u);
+    Slots[Entry] = Slot;
+    for(uint32_t i = 0; i < NumInputDimensions; i++) {
+        UniqueInputs[(size_t)Slot * NumInputDimensions + i] = Inputs[(size_t)Idx * NumInputDimensions + i];
+    }
+}
+
+__global__ void QueryDedupScatter (
+        uint32_t NumElements, uint32_t NumOutputDimensions, const uint32_t * Slots, const uint32_t * ElementEntries,
+        const float * UniqueOutputs, float * Outputs) {
+    uint32_t Idx = threadIdx.x + blockIdx.x * blockDim.x;
+    if(Idx >= NumElements) return;
+    const uint32_t Slot = Slots[ElementEntries[Idx]];
+    for(uint32_t i = 0; i < NumOutputDimensions; i++) {
+        Outputs[(size_t)Idx * NumOutputDimensions + i] = UniqueOutputs[(size_t)Slot * NumOutputDimensions + i];
+    }
+}
+
+MIGINNQueryDeduplicator::~MIGINNQueryDeduplicator() {
+    // Nothing useful can be done about failures here.
+    try {
+        Release();
+    } catch(std::runtime_error & e) {}
+}
+
+uint32_t MIGINNQueryDeduplicator::Deduplicate(const float *Inputs, uint32_t NumInputDimensions, uint32_t InNumElements, float Quantum,
+                                              uint32_t Granularity) {
+    NumElements = InNumElements;
+    TableSize = MIGINNQueryDedup::GetTableSize(NumElements);
+    PaddedNumElements = 0;
+    if(NumElements == 0) return 0;
+    // Grow only, batch sizes hardly change between frames.
+    if(TableSize > TableCapacity || NumElements > ElementCapacity) {
+        if(Keys) checkCUDA(cudaFree(Keys));
+        if(Owners) checkCUDA(cudaFree(Owners));
+        if(Slots) checkCUDA(cudaFree(Slots));
+        if(ElementEntries) checkCUDA(cudaFree(ElementEntries));
+        TableCapacity = std::max(TableCapacity, TableSize);
+        ElementCapacity = std::max(ElementCapacity, NumElements);
+        checkCUDA(cudaMalloc(&Keys, TableCapacity * sizeof(unsigned long long)));
+        checkCUDA(cudaMalloc(&Owners, TableCapacity * sizeof(uint32_t)));
+        checkCUDA(cudaMalloc(&Slots, ((size_t)TableCapacity + ElementCapacity) * sizeof(uint32_t)));
+        checkCUDA(cudaMalloc(&ElementEntries, ElementCapacity * sizeof(uint32_t)));
+    }
+    if(!Counter) checkCUDA(cudaMalloc(&Counter, sizeof(uint32_t)));
+    // The unique queries never outnumber the queries.
+    PaddedNumElements = (NumElements + Granularity - 1) / Granularity * Granularity;
+    const size_t UniqueInputsSize = (size_t)PaddedNumElements * NumInputDimensions;
+    if(UniqueInputsSize > UniqueInputsCapacity) {
+        if(UniqueInputs) checkCUDA(cudaFree(UniqueInputs));
+        UniqueInputsCapacity = UniqueInputsSize;
+        checkCUDA(cudaMalloc(&UniqueInputs, UniqueInputsCapacity * sizeof(float)));
+    }
+
+    checkCUDA(cudaMemsetAsync(Keys, 0xff, TableSize * sizeof(unsigned long long), GCUDAStream));
+    checkCUDA(cudaMemsetAsync(Counter, 0, sizeof(uint32_t), GCUDAStream));
+    const uint32_t NumBlocks = (NumElements + QueryDedupBlockSize - 1) / QueryDedupBlockSize;
+    QueryDedupInsert<<<NumBlocks, QueryDedupBlockSize, 0, GCUDAStream>>>(
+            NumElements, Inputs, NumInputDimensions, 1.f / Quantum, TableSize, Keys, Owners, ElementEntries
+    );
+    QueryDedupCompact<<<NumBlocks, QueryDedupBlockSize, 0, GCUDAStream>>>(
+            NumElements, Inputs, NumInputDimensions, TableSize, Owners, ElementEntries, Slots, Counter, UniqueInputs
+    );
+    checkCUDA(cudaGetLastError());
+    uint32_t NumUniqueElements = 0;
+    checkCUDA(cudaMemcpyAsync(&NumUniqueElements, Counter, sizeof(uint32_t), cudaMemcpyDeviceToHost, GCUDAStream));
+    checkCUDA(cudaStreamSynchronize(GCUDAStream));
+    return NumUniqueElements;
+}
+
+void MIGINNQueryDeduplicator::Scatter(const float *InUniqueOutputs, uint32_t NumOutputDimensions, float *Outputs) const {
+    if(NumElements == 0) return;
+    QueryDedupScatter<<<(NumElements + QueryDedupBlockSize - 1) / QueryDedupBlockSize, QueryDedupBlockSize, 0, GCUDAStream>>>(
+            NumElements, NumOutputDimensions, Slots, ElementEntries, InUniqueOutputs, Outputs
+    );
+    checkCUDA(cudaGetLastError());
+}
+
+float *MIGINNQueryDeduplicator::GetUniqueOutputs(uint32_t NumOutputDimensions) {
+    const size_t Size = (size_t)PaddedNumElements * NumOutputDimensions;
+    if(Size > UniqueOutputsCapacity) {
+        if(UniqueOutputs) checkCUDA(cudaFree(UniqueOutputs));
+        UniqueOutputsCapacity = Size;
+        checkCUDA(cudaMalloc(&UniqueOutputs, UniqueOutputsCapacity * sizeof(float)));
+    }
+    return UniqueOutputs;
+}
+
+void MIGINNQueryDeduplicator::Release() {
+    for(void * Allocation : {(void*)Keys, (void*)Owners, (void*)Slots, (void*)ElementEntries, (void*)Counter, (void*)UniqueInputs, (void*)UniqueOutputs}) {
+        if(Allocation) checkCUDA(cudaFree(Allocation));
+    }
+    Keys = nullptr;
+    Owners = nullptr;
+    Slots = nullptr;
+    ElementEntries = nullptr;
+    Counter = nullptr;
+    UniqueInputs = nullptr;
+    UniqueOutputs = nullptr;
+    NumElements = PaddedNumElements = TableSize = ElementCapacity = TableCapacity = 0;
+    UniqueInputsCapacity = UniqueOutputsCapacity = 0;
+}
@@ -0,0 +1,182 @@
+/*
+ * Project MIGINN : MIGINN_ResultCache.cu
+ * Created: 2024/03/19
+ * This program is unlicensed. See LICENSE for more.
+ */
+#include <algorithm>
+#include <cstddef>
+#include "MIGINN.h"
+#include "MIGINNCUDAHelper.cuh"
+#include "MIGINNInternal.cuh"
+#include "MIGINNResultCache.cuh"
+
+constexpr uint32_t ResultCacheBlockSize = 128;
+
+// Serve the queries the cache may reuse, pack the others. Queries are deduplicated, so no two threads share a key.
+__global__ void ResultCacheLookup (
+        uint32_t NumElements, const float * Inputs, uint32_t NumInputDimensions, float InvQuantum, float * Outputs,
+        uint32_t NumOutputDimensions, uint32_t TableSize, uint32_t WeightVersion, uint32_t Frame, MIGINNResultCache::FPolicy Policy,
+        unsigned long long * Keys, uint32_t * Versions, const float * ErrorBounds, const float * Values,
+        uint32_t * Counter, uint32_t * RefreshElements, uint32_t * RefreshEntries, unsigned long long * RefreshKeys, float * RefreshInputs) {
+    uint32_t Idx = threadIdx.x + blockIdx.x * blockDim.x;
+    if(Idx >= NumElements) return;
+    const float * Input = Inputs + (size_t)Idx * NumInputDimensions;
+    const uint64_t Key = MIGINNQueryDedup::ComputeKey(Input, NumInputDimensions, InvQuantum);
+    uint32_t Entry = TableSize;
+    for(uint32_t Probe = 0; Probe < MIGINNResultCache::MaxProbes; Probe++) {
+        uint32_t Index = ((uint32_t)Key + Probe) & (TableSize - 1);
+        if(Keys[Index] == Key) {
+            Entry = Index;
+            break;
+        }
+    }
+    // Not cached: take a free entry, or one stale enough to be replaced. Losing a race moves on to the next entry.
+    bool bInserted = false;
+    for(uint32_t Probe = 0; Probe < MIGINNResultCache::MaxProbes && Entry == TableSize; Probe++) {
+        uint32_t Index = ((uint32_t)Key + Probe) & (TableSize - 1);
+        const unsigned long long Current = Keys[Index];
+        const uint32_t Version = Versions[Index];
+        const bool bStale = Version != MIGINNResultCache::InvalidVersion && WeightVersion - Version >= Policy.MaxAge;
+        if((Current == MIGINNQueryDedup::EmptyKey || bStale) && atomicCAS(&Keys[Index], Current, Key) == Current) {
+            Versions[Index] = MIGINNResultCache::InvalidVersion;
+            Entry = Index;
+            bInserted = true;
+        }
+    }
+    if(Entry < TableSize && !bInserted
+        && !MIGINNResultCache::NeedsRefresh(Key, Versions[Entry], ErrorBounds[Entry], WeightVersion, Frame, Policy)) {
+        for(uint32_t i = 0; i < NumOutputDimensions; i++) {
+            Outputs[(size_t)Idx * NumOutputDimensions + i] = Values[(size_t)Entry * NumOutputDimensions + i];
+        }
+        return;
+    }
+    const uint32_t Slot = atomicAdd(Counter, 1u);
+    RefreshElements[Slot] = Idx;
+    RefreshEntries[Slot] = Entry;
+    RefreshKeys[Slot] = Key;
+    for(uint32_t i = 0; i < NumInputDimensions; i++) {
+        RefreshInputs[(size_t)Slot * NumInputDimensions + i] = Input[i];
+    }
+}
+
+__global__ void ResultCacheStore (
+        uint32_t NumRefresh, uint32_t NumOutputDimensions, uint32_t TableSize, uint32_t WeightVersion,
+        const uint32_t * RefreshElements, const uint32_t * RefreshEntries, const unsigned long long * RefreshKeys, const float * RefreshOutputs,
+        const unsigned long long * Keys, uint32_t * Versions, float * ErrorBounds, float * Values, float * Outputs) {
+    uint32_t Idx = threadIdx.x + blockIdx.x * blockDim.x;
+    if(Idx >= NumRefresh) return;
+    const float * Result = RefreshOutputs + (size_t)Idx * NumOutputDimensions;
+    for(uint32_t i = 0; i < NumOutputDimensions; i++) {
+        Outputs[(size_t)RefreshElements[Idx] * NumOutputDimensions + i] = Result[i];
+    }
+    const uint32_t Entry = RefreshEntries[Idx];
+    // The entry may have been taken over by another query of the batch.
+    if(Entry == TableSize || Keys[Entry] != RefreshKeys[Idx]) return;
+    float * Cached = Values + (size_t)Entry * NumOutputDimensions;
+    ErrorBounds[Entry] = Versions[Entry] == MIGINNResultCache::InvalidVersion
+            ? 0.f : MIGINNResultCache::ComputeErrorBound(Cached, Result, NumOutputDimensions);
+    Versions[Entry] = WeightVersion;
+    for(uint32_t i = 0; i < NumOutputDimensions; i++) Cached[i] = Result[i];
+}
+
+__global__ void ResultCacheExpire (uint32_t TableSize, uint32_t WeightVersion, MIGINNResultCache::FPolicy Policy,
+                                   unsigned long long * Keys, uint32_t * Versions) {
+    uint32_t Idx = threadIdx.x + blockIdx.x * blockDim.x;
+    if(Idx >= TableSize) return;
+    if(MIGINNResultCache::IsExpired(Versions[Idx], WeightVersion, Policy)) {
+        Keys[Idx] = MIGINNQueryDedup::EmptyKey;
+        Versions[Idx] = MIGINNResultCache::InvalidVersion;
+    }
+}
+
+MIGINNInferenceResultCache::~MIGINNInferenceResultCache() {
+    // Nothing useful can be done about failures here.
+    try {
+        Release();
+    } catch(std::runtime_error & e) {}
+}
+
+void MIGINNInferenceResultCache::Configure(uint32_t InLog2TableSize, uint32_t InNumOutputDimensions, float InQuantum,
+                                           const MIGINNResultCache::FPolicy &InPolicy) {
+    // The configuration is validated here, a bad one only disables the cache.
+    const bool bValid = InLog2TableSize <= 30 && InNumOutputDimensions > 0 && InQuantum > 0.f && InPolicy.Tolerance > 0.f;
+    Log2TableSize = bValid ? InLog2TableSize : 0;
+    NumOutputDimensions = InNumOutputDimensions;
+    Quantum = InQuantum;
+    Policy = InPolicy;
+}
+
+uint32_t MIGINNInferenceResultCache::Lookup(const float *Inputs, uint32_t NumInputDimensions, uint32_t NumElements, float *Outputs,
+                                            uint32_t Granularity) {
+    const uint32_t TableSize = 1u << Log2TableSize;
+    if(!Keys) {
+        checkCUDA(cudaMalloc(&Keys, TableSize * sizeof(unsigned long long)));
+        checkCUDA(cudaMalloc(&Versions, TableSize * sizeof(uint32_t)));
+        checkCUDA(cudaMalloc(&ErrorBounds, TableSize * sizeof(float)));
+        checkCUDA(cudaMalloc(&Values, (size_t)TableSize * NumOutputDimensions * sizeof(float)));
+        checkCUDA(cudaMalloc(&Counter, sizeof(uint32_t)));
+        checkCUDA(cudaMemsetAsync(Keys, 0xff, TableSize * sizeof(unsigned long long), GCUDAStream));
+        checkCUDA(cudaMemsetAsync(Versions, 0xff, TableSize * sizeof(uint32_t), GCUDAStream));
+    }
+    const uint32_t PaddedNumElements = (NumElements + Granularity - 1) / Granularity * Granularity;
+    if(PaddedNumElements > RefreshCapacity || NumInputDimensions != RefreshInputDimensions) {
+        for(void * Allocation : {(void*)RefreshElements, (void*)RefreshEntries, (void*)RefreshKeys, (void*)RefreshInputs, (void*)RefreshOutputs}) {
+            if(Allocation) checkCUDA(cudaFree(Allocation));
+        }
+        RefreshCapacity = std::max(RefreshCapacity, PaddedNumElements);
+        RefreshInputDimensions = NumInputDimensions;
+        checkCUDA(cudaMalloc(&RefreshElements, RefreshCapacity * sizeof(uint32_t)));
+        checkCUDA(cudaMalloc(&RefreshEntries, RefreshCapacity * sizeof(uint32_t)));
+        checkCUDA(cudaMalloc(&RefreshKeys, RefreshCapacity * sizeof(unsigned long long)));
+        checkCUDA(cudaMalloc(&RefreshInputs, (size_t)RefreshCapacity * NumInputDimensions * sizeof(float)));
+        checkCUDA(cudaMalloc(&RefreshOutputs, (size_t)RefreshCapacity * NumOutputDimensions * sizeof(float)));
+    }
+    NumRefresh = 0;
+    if(NumElements == 0) return 0;
+    checkCUDA(cudaMemsetAsync(Counter, 0, sizeof(uint32_t), GCUDAStream));
+    ResultCacheLookup<<<(NumElements + ResultCacheBlockSize - 1) / ResultCacheBlockSize, ResultCacheBlockSize, 0, GCUDAStream>>>(
+            NumElements, Inputs, NumInputDimensions, 1.f / Quantum, Outputs, NumOutputDimensions, TableSize, WeightVersion, Frame++, Policy,
+            Keys, Versions, ErrorBounds, Values, Counter, RefreshElements, RefreshEntries, RefreshKeys, RefreshInputs
+    );
+    checkCUDA(cudaGetLastError());
+    checkCUDA(cudaMemcpyAsync(&NumRefresh, Counter, sizeof(uint32_t), cudaMemcpyDeviceToHost, GCUDAStream));
+    checkCUDA(cudaStreamSynchronize(GCUDAStream));
+    return NumRefresh;
+}
+
+void MIGINNInferenceResultCache::Store(float *Outputs) const {
+    if(NumRefresh == 0) return;
+    ResultCacheStore<<<(NumRefresh + ResultCacheBlockSize - 1) / ResultCacheBlockSize, ResultCacheBlockSize, 0, GCUDAStream>>>(
+            NumRefresh, NumOutputDimensions, 1u << Log2TableSize, WeightVersion,
+            RefreshElements, RefreshEntries, RefreshKeys, RefreshOutputs, Keys, Versions, ErrorBounds, Values, Outputs
+    );
+    checkCUDA(cudaGetLastError());
+}
+
+void MIGINNInferenceResultCache::AdvanceWeightVersion() {
+    WeightVersion++;
+    if(!Keys) return;
+    const uint32_t TableSize = 1u << Log2TableSize;
+    ResultCacheExpire<<<(TableSize + ResultCacheBlockSize - 1) / ResultCacheBlockSize, ResultCacheBlockSize, 0, GCUDAStream>>>(
+            TableSize, WeightVersion, Policy, Keys, Versions
+    );
+    checkCUDA(cudaGetLastError());
+}
+
+void MIGINNInferenceResultCache::Release() {
+    for(void * Allocation : {(void*)Keys, (void*)Versions, (void*)ErrorBounds, (void*)Values, (void*)Counter,
+                             (void*)RefreshElements, (void*)RefreshEntries, (void*)RefreshKeys, (void*)RefreshInputs, (void*)RefreshOutputs}) {
+        if(Allocation) checkCUDA(cudaFree(Allocation));
+    }
+    Keys = nullptr;
+    Versions = nullptr;
+    ErrorBounds = nullptr;
+    Values = nullptr;
+    Counter = nullptr;
+    RefreshElements = nullptr;
+    RefreshEntries = nullptr;
+    RefreshKeys = nullptr;
+    RefreshInputs = nullptr;
+    RefreshOutputs = nullptr;
+    NumRefresh = RefreshCapacity = RefreshInputDimensions = 0;
+}